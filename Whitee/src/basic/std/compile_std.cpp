@@ -8,5 +8,6 @@ bool _debugIrOptimize = true;  // IR优化
 bool _debugMachineIr = true;  // 机器IR
 
 bool _optimizeMachineIr = false;  // 机器IR优化 O2
+bool _parallelizeLoop = false;  // 自动并行化：无跨迭代依赖的外层循环由多个线程执行
 
 bool _isBuildingIr = true; // Used for IR Phi.
\ No newline at end of file
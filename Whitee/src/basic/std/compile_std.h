@@ -9,6 +9,7 @@ extern bool _debugIrOptimize;
 extern bool _debugMachineIr;
 extern bool _isBuildingIr;
 extern bool _optimizeMachineIr;
+extern bool _parallelizeLoop;
 
 //enum OptimizeLevel
 //{
@@ -19,7 +20,7 @@ extern bool _optimizeMachineIr;
 //};
 enum OptimizeLevel
 {
-    O0,  // SSA IR生成优化 常量传播、复制传播，FIR优化 临时寄存器分配
+    O0,  // SSA IR生成优化 常量传播、复制传播，线性扫描寄存器分配
     O1,  // SSA IR优化 死代码删除、常量折叠、局部数组传播、常量数组全局化
     O2,  // MIR优化 汇编窥孔优化
 };
@@ -34,6 +35,8 @@ enum OptimizeLevel
 #define _LOOP_WEIGHT_BASE 10
 #define _MAX_DEPTH 6
 #define _MAX_LOOP_WEIGHT 1000000000
+#define _PARALLEL_THREAD_CNT 4  // 并行循环的线程数，与核数相同
+#define _PARALLEL_STACK_SHIFT 20  // 每个子线程的栈为 1 << 20 字节
 
 #define _SCO_SUCCESS 0
 #define _SCO_ARG_ERR -1
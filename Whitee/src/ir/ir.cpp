@@ -49,6 +49,12 @@ ParameterValue::ParameterValue (shared_ptr<Function>& function, shared_ptr<FuncF
 	dimensions = funcFParam->dimensions;
 }
 
+ParameterValue::ParameterValue (shared_ptr<Function>& function, const string& name, VariableType variableType, const vector<int>& dimensions)
+	: BaseValue (ValueType::PARAMETER), name (name), variableType (variableType), dimensions (dimensions)
+{
+	this->function = function;
+}
+
 GlobalValue::GlobalValue (shared_ptr<VarDefNode>& varDef)
 	: BaseValue (ValueType::GLOBAL)
 {
@@ -95,6 +101,32 @@ void Function::abandonUse ()
 	name = "abandon_function_" + name;
 }
 
+/**
+ * @brief 函数是否适合内联：非main、非直接递归、入口块无前驱，指令数与局部数组数不超过限制
+ * @param maxInsCnt 最大指令数（包括phi）
+ * @param maxPointerSituationCnt 最大局部数组数，内联后数组空间并入调用者的栈帧
+ * @return true 适合；false 不适合
+ */
+bool Function::fitInline (unsigned int maxInsCnt, unsigned int maxPointerSituationCnt)
+{
+	if (!valid || name == "main" || entryBlock == nullptr || !entryBlock->predecessors.empty ())
+		return false;
+	shared_ptr<Function> self = s_p_c<Function> (shared_from_this ());
+	if (callees.count (self) != 0)
+		return false;
+	unsigned int insCnt = 0, pointerSituationCnt = 0;
+	for (auto& bb : blocks)
+	{
+		insCnt += bb->instructions.size () + bb->phis.size ();
+		for (auto& ins : bb->instructions)
+		{
+			if (ins->type == InstructionType::ALLOC)
+				++pointerSituationCnt;
+		}
+	}
+	return insCnt <= maxInsCnt && pointerSituationCnt <= maxPointerSituationCnt;
+}
+
 // 替换value
 void BasicBlock::replaceUse (shared_ptr<Value>& toBeReplaced, shared_ptr<Value>& replaceValue)
 {
@@ -551,11 +583,6 @@ PhiMoveInstruction::PhiMoveInstruction (shared_ptr<PhiInstruction>& phi)
 	: Instruction (InstructionType::PHI_MOV, phi->block, L_VAL_RESULT), phi (phi)
 {
 	caughtVarName = phi->caughtVarName;
-	for (auto& op : phi->operands)
-	{
-		unordered_set<shared_ptr<Value>> tempSet;
-		blockALiveValues[op.first] = tempSet;
-	}
 }
 
 unordered_map<int, shared_ptr<NumberValue>> numberValueMap;  // 常数公用表
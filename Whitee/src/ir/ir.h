@@ -189,7 +189,16 @@ public:
     unordered_set<shared_ptr<Value>> variableWithoutReg;   // 必须存在内存中的，寄存器放不下的变量
     unsigned int requiredStackSize = 0; // required size in bytes.
 
-    bool side_effect = true;
+    bool side_effect = true;  // 修改了自己范围之外的资源：写全局变量、写参数所引用的数组、输入输出
+
+    // 读写摘要，包括调用的函数
+    unordered_set<shared_ptr<Value>> modGlobals;  // 可能写的全局变量
+    unordered_set<shared_ptr<Value>> refGlobals;  // 可能读的全局变量
+    unordered_set<unsigned int> modParams;        // 可能写其所指数组的指针参数下标
+    unordered_set<unsigned int> refParams;        // 可能读其所指数组的指针参数下标
+    bool modUnknown = false;                      // 通过无法确定基对象的指针写
+    bool refUnknown = false;                      // 通过无法确定基对象的指针读
+    bool inputOutput = false;                     // 调用了运行时函数
 
     unordered_map<string, VariableType> variables; // @Deprecated
 
@@ -204,6 +213,10 @@ public:
 
     bool fitInline(unsigned int maxInsCnt, unsigned int maxPointerSituationCnt);
 
+    inline bool modifiesMemory() const { return !modGlobals.empty() || !modParams.empty() || modUnknown; }
+
+    inline bool readsMemory() const { return !refGlobals.empty() || !refParams.empty() || refUnknown; }
+
     unsigned long long hashCode() override { return 0; }
 
     bool equals(shared_ptr<Value> &value) override { return false; }
@@ -220,7 +233,6 @@ public:
     unordered_set<shared_ptr<PhiInstruction>> phis;   // 块中的phi
 
     unsigned int loopDepth = 1;                   // 用于寄存器权重计算
-    unordered_set<shared_ptr<Value>> aliveValues; // 此basic block中活跃的变量
 
     unordered_map<string, shared_ptr<Value>> ssa_map;  // SSA MAP
 
@@ -252,7 +264,7 @@ public:
 
     ResultType resultType;
     string caughtVarName;                         // Lvalue 局部变量名
-    unordered_set<shared_ptr<Value>> aliveValues; // 此instruction时活跃的变量.
+    unordered_set<shared_ptr<Value>> aliveValues; // 调用指令后仍活跃的变量，由活跃变量分析导出
     
     Instruction(InstructionType type, shared_ptr<BasicBlock> &block, ResultType resultType)
         : Value(ValueType::INSTRUCTION), type(type), resultType(resultType), block(block){};
@@ -365,6 +377,8 @@ public:
 
     ParameterValue(shared_ptr<Function> &function, shared_ptr<FuncFParamNode> &funcFParam);
 
+    ParameterValue(shared_ptr<Function> &function, const string &name, VariableType variableType, const vector<int> &dimensions);
+
     string toString() override;
 
     string getIdent() override;
@@ -495,6 +509,7 @@ public:
     vector<shared_ptr<Value>> params;    // 参数
     InvokeType invokeType;
     string targetName;         // 仅用于运行时函数
+    bool parallel = false;     // 并行调用：由运行时把 [params[0], params[1]) 分给多个线程，各自以子范围调用targetFunction
 
     InvokeInstruction(shared_ptr<Function> &targetFunction, vector<shared_ptr<Value>> &params, shared_ptr<BasicBlock> &bb)
         : Instruction(InstructionType::INVOKE, bb, targetFunction->funcType == FuncType::FUNC_INT ? R_VAL_RESULT : OTHER_RESULT),
@@ -704,8 +719,6 @@ class PhiMoveInstruction : public Instruction
 public:
     shared_ptr<PhiInstruction> phi;  // phi指令，一个phi_move对应一个phi，但此phi_move在每个phi的operand块最后
 
-    unordered_map<shared_ptr<BasicBlock>, unordered_set<shared_ptr<Value>>> blockALiveValues;  // 所在块中活跃的变量
-
     explicit PhiMoveInstruction(shared_ptr<PhiInstruction> &phi);
 
     string toString() override;
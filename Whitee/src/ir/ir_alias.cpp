@@ -0,0 +1,290 @@
+﻿/*********************************************************************
+ * @file   ir_alias.cpp
+ * @brief  数组与全局变量的别名分析
+ * 
+ * @date   October 2026
+ *********************************************************************/
+#include "ir_alias.h"
+
+#include <iostream>
+
+/**
+ * @brief 收集逃逸的局部数组：除了作为load、store的地址，还有其他使用（函数实参、指针运算）
+ * @param func 
+ */
+AliasAnalysis::AliasAnalysis(shared_ptr<Function> &func)
+{
+    for (auto &bb : func->blocks)
+    {
+        for (auto &ins : bb->instructions)
+        {
+            if (ins->type != ALLOC)
+                continue;
+            for (auto &user : ins->users)
+            {
+                shared_ptr<Instruction> userIns = s_p_c<Instruction>(user);
+                if (userIns->type == LOAD && s_p_c<LoadInstruction>(userIns)->address == ins)
+                    continue;
+                if (userIns->type == STORE && s_p_c<StoreInstruction>(userIns)->address == ins && s_p_c<StoreInstruction>(userIns)->value != ins)
+                    continue;
+                escapedAllocs.insert(ins);
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief 值是否为指针：数组、全局变量、指针参数及其加偏移
+ * @param value 
+ * @return 
+ */
+bool AliasAnalysis::isPointer(const shared_ptr<Value> &value)
+{
+    switch (value->value_type)
+    {
+    case GLOBAL:
+    case CONSTANT:
+        return true;
+    case PARAMETER:
+        return s_p_c<ParameterValue>(value)->variableType == POINTER;
+    case INSTRUCTION:
+    {
+        shared_ptr<Instruction> ins = s_p_c<Instruction>(value);
+        if (ins->type == ALLOC)
+            return true;
+        if (ins->type == BINARY && s_p_c<BinaryInstruction>(ins)->op == "+")
+            return isPointer(s_p_c<BinaryInstruction>(ins)->lhs) || isPointer(s_p_c<BinaryInstruction>(ins)->rhs);
+        return false;
+    }
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief 求地址 + 偏移（字）的内存位置；指针运算的偏移以字节为单位
+ * @param address 
+ * @param offset 为nullptr时为基对象的任意位置
+ * @return 
+ */
+MemoryLocation AliasAnalysis::getLocation(const shared_ptr<Value> &address, const shared_ptr<Value> &offset)
+{
+    MemoryLocation location;
+    location.precise = offset != nullptr;
+    shared_ptr<Value> pointer = address;
+    while (pointer->value_type == INSTRUCTION && s_p_c<Instruction>(pointer)->type == BINARY)
+    {
+        shared_ptr<BinaryInstruction> binary = s_p_c<BinaryInstruction>(pointer);
+        if (binary->op != "+")
+            break;
+        shared_ptr<Value> bytes = isPointer(binary->lhs) ? binary->rhs : binary->lhs;
+        pointer = isPointer(binary->lhs) ? binary->lhs : binary->rhs;
+        if (bytes->value_type == NUMBER && s_p_c<NumberValue>(bytes)->number % 4 == 0)
+            location.constant += s_p_c<NumberValue>(bytes)->number / 4;
+        else
+            location.precise = false;
+    }
+    if (isPointer(pointer) && (pointer->value_type != INSTRUCTION || s_p_c<Instruction>(pointer)->type == ALLOC))
+        location.base = pointer;
+    else
+        location.precise = false;
+    if (!location.precise)
+        return location;
+    if (offset->value_type == NUMBER)
+        location.constant += s_p_c<NumberValue>(offset)->number;
+    else if (offset->value_type == INSTRUCTION && s_p_c<Instruction>(offset)->type == BINARY && s_p_c<BinaryInstruction>(offset)->op == "+"
+             && s_p_c<BinaryInstruction>(offset)->rhs->value_type == NUMBER)
+    {
+        location.index = s_p_c<BinaryInstruction>(offset)->lhs;
+        location.constant += s_p_c<NumberValue>(s_p_c<BinaryInstruction>(offset)->rhs)->number;
+    }
+    else if (offset->value_type == INSTRUCTION && s_p_c<Instruction>(offset)->type == BINARY && s_p_c<BinaryInstruction>(offset)->op == "+"
+             && s_p_c<BinaryInstruction>(offset)->lhs->value_type == NUMBER)
+    {
+        location.index = s_p_c<BinaryInstruction>(offset)->rhs;
+        location.constant += s_p_c<NumberValue>(s_p_c<BinaryInstruction>(offset)->lhs)->number;
+    }
+    else
+        location.index = offset;
+    return location;
+}
+
+/**
+ * @brief load或store访问的位置
+ * @param ins 
+ * @return 
+ */
+MemoryLocation AliasAnalysis::getLocation(const shared_ptr<Instruction> &ins)
+{
+    if (ins->type == LOAD)
+        return getLocation(s_p_c<LoadInstruction>(ins)->address, s_p_c<LoadInstruction>(ins)->offset);
+    if (ins->type == STORE)
+        return getLocation(s_p_c<StoreInstruction>(ins)->address, s_p_c<StoreInstruction>(ins)->offset);
+    cerr << "Error occurs in process alias analysis: get location of a non-memory instruction." << endl;
+    return MemoryLocation();
+}
+
+/**
+ * @brief 是否为未逃逸的局部数组，只能通过本函数中的load、store访问
+ * @param base 
+ * @return 
+ */
+bool AliasAnalysis::isLocalObject(const shared_ptr<Value> &base) const
+{
+    return base != nullptr && base->value_type == INSTRUCTION && escapedAllocs.count(base) == 0;
+}
+
+/**
+ * @brief 是否为全局标量：SysY不能取标量的地址，只能通过load、store直接访问
+ * @param base 
+ * @return 
+ */
+bool AliasAnalysis::isScalarGlobal(const shared_ptr<Value> &base)
+{
+    return base != nullptr && base->value_type == GLOBAL && s_p_c<GlobalValue>(base)->variableType == INT;
+}
+
+/**
+ * @brief 两个位置是否重叠
+ * @param a 
+ * @param b 
+ * @return 
+ */
+AliasResult AliasAnalysis::alias(const MemoryLocation &a, const MemoryLocation &b) const
+{
+    if (a.base != b.base && (isScalarGlobal(a.base) || isScalarGlobal(b.base)))
+        return NO_ALIAS;
+    if (a.base == nullptr || b.base == nullptr)  // 未知的指针不会指向未逃逸的局部数组
+        return isLocalObject(a.base) || isLocalObject(b.base) ? NO_ALIAS : MAY_ALIAS;
+    if (a.base != b.base)
+    {
+        // 指针参数可能指向全局变量、调用者的数组，但不是本函数的局部数组
+        if (a.base->value_type == PARAMETER || b.base->value_type == PARAMETER)
+            return a.base->value_type == INSTRUCTION || b.base->value_type == INSTRUCTION ? NO_ALIAS : MAY_ALIAS;
+        return NO_ALIAS;  // 不同的局部数组、全局变量
+    }
+    if (!a.precise || !b.precise || a.index != b.index)
+        return MAY_ALIAS;
+    return a.constant == b.constant ? MUST_ALIAS : NO_ALIAS;
+}
+
+/**
+ * @brief 调用是否可能读写位置：普通函数按其读写摘要，写的参数换为实参；运行时函数只访问数组参数
+ * @param invoke 
+ * @param location 
+ * @param write 是否为写
+ * @return 
+ */
+bool AliasAnalysis::invokeMayAccess(const shared_ptr<InvokeInstruction> &invoke, const MemoryLocation &location, bool write) const
+{
+    if (isLocalObject(location.base))
+        return false;
+    switch (invoke->invokeType)
+    {
+    case COMMON:
+    {
+        shared_ptr<Function> &callee = invoke->targetFunction;
+        const unordered_set<shared_ptr<Value>> &globals = write ? callee->modGlobals : callee->refGlobals;
+        const unordered_set<unsigned int> &params = write ? callee->modParams : callee->refParams;
+        if (isScalarGlobal(location.base))
+            return globals.count(location.base) != 0;
+        if (write ? callee->modUnknown : callee->refUnknown)
+            return location.base == nullptr || location.base->value_type != CONSTANT || !write;
+        if (location.base == nullptr)
+            return !globals.empty() || !params.empty();
+        if (location.base->value_type == GLOBAL && globals.count(location.base) != 0)
+            return true;
+        if (location.base->value_type == PARAMETER)  // 指针参数可能指向被调用函数直接访问的全局数组
+        {
+            for (auto &global : globals)
+            {
+                if (s_p_c<GlobalValue>(global)->variableType == POINTER)
+                    return true;
+            }
+        }
+        for (auto index : params)
+        {
+            if (index < invoke->params.size() && alias(getLocation(invoke->params.at(index), nullptr), location) != NO_ALIAS)
+                return true;
+        }
+        return false;
+    }
+    case GET_ARRAY:
+    case PUT_ARRAY:
+        if ((invoke->invokeType == GET_ARRAY) != write)
+            return false;
+        for (auto &param : invoke->params)
+        {
+            if (isPointer(param) && alias(getLocation(param, nullptr), location) != NO_ALIAS)
+                return true;
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief 指令是否可能写位置
+ * @param ins 
+ * @param location 
+ * @return 
+ */
+bool AliasAnalysis::mayModify(const shared_ptr<Instruction> &ins, const MemoryLocation &location) const
+{
+    if (ins->type == STORE)
+        return alias(getLocation(ins), location) != NO_ALIAS;
+    if (ins->type == INVOKE)
+        return invokeMayAccess(s_p_c<InvokeInstruction>(ins), location, true);
+    return false;
+}
+
+/**
+ * @brief 指令是否可能读位置
+ * @param ins 
+ * @param location 
+ * @return 
+ */
+bool AliasAnalysis::mayRead(const shared_ptr<Instruction> &ins, const MemoryLocation &location) const
+{
+    if (ins->type == LOAD)
+        return alias(getLocation(ins), location) != NO_ALIAS;
+    if (ins->type == INVOKE)
+        return invokeMayAccess(s_p_c<InvokeInstruction>(ins), location, false);
+    return false;
+}
+
+/**
+ * @brief 指令可能写内存：store、getarray与写内存的函数的调用
+ * @param ins 
+ * @return 
+ */
+bool AliasAnalysis::isMemoryDef(const shared_ptr<Instruction> &ins)
+{
+    if (ins->type == STORE)
+        return true;
+    if (ins->type != INVOKE)
+        return false;
+    shared_ptr<InvokeInstruction> invoke = s_p_c<InvokeInstruction>(ins);
+    if (invoke->invokeType == COMMON)
+        return invoke->targetFunction->modifiesMemory();
+    return invoke->invokeType == GET_ARRAY;
+}
+
+/**
+ * @brief 指令只读内存：load、putarray与只读内存的函数的调用
+ * @param ins 
+ * @return 
+ */
+bool AliasAnalysis::isMemoryUse(const shared_ptr<Instruction> &ins)
+{
+    if (ins->type == LOAD)
+        return true;
+    if (ins->type != INVOKE)
+        return false;
+    shared_ptr<InvokeInstruction> invoke = s_p_c<InvokeInstruction>(ins);
+    if (invoke->invokeType == COMMON)
+        return !invoke->targetFunction->modifiesMemory() && invoke->targetFunction->readsMemory();
+    return invoke->invokeType == PUT_ARRAY;
+}
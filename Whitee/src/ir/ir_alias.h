@@ -0,0 +1,59 @@
+﻿#ifndef COMPILER_IR_ALIAS_H
+#define COMPILER_IR_ALIAS_H
+
+#include "ir.h"
+
+enum AliasResult
+{
+    NO_ALIAS,   // 一定不重叠
+    MAY_ALIAS,  // 可能重叠
+    MUST_ALIAS  // 一定为同一个字
+};
+
+/**
+ * 内存位置：base[index + constant]，以字为单位
+ */
+struct MemoryLocation
+{
+    shared_ptr<Value> base;   // 基对象：局部数组、全局变量、常量数组或指针参数；无法确定为nullptr
+    shared_ptr<Value> index;  // 下标中非常数的部分，没有为nullptr
+    int constant = 0;         // 下标中常数的部分
+    bool precise = false;     // 下标可以比较；false时可能是基对象的任意位置
+};
+
+/**
+ * 函数内的别名分析：区分不同的基对象，同一基对象按 下标 + 常数 区分；调用按被调用函数的读写摘要，
+ * 未逃逸（未作为指针传出）的局部数组不被调用访问
+ */
+class AliasAnalysis
+{
+public:
+    unordered_set<shared_ptr<Value>> escapedAllocs;  // 作为指针被使用的局部数组
+
+    explicit AliasAnalysis(shared_ptr<Function> &func);
+
+    static bool isPointer(const shared_ptr<Value> &value);
+
+    static MemoryLocation getLocation(const shared_ptr<Value> &address, const shared_ptr<Value> &offset);
+
+    static MemoryLocation getLocation(const shared_ptr<Instruction> &ins);  // load或store访问的位置
+
+    AliasResult alias(const MemoryLocation &a, const MemoryLocation &b) const;
+
+    bool mayModify(const shared_ptr<Instruction> &ins, const MemoryLocation &location) const;  // 指令可能写此位置
+
+    bool mayRead(const shared_ptr<Instruction> &ins, const MemoryLocation &location) const;  // 指令可能读此位置
+
+    static bool isMemoryDef(const shared_ptr<Instruction> &ins);  // 指令可能写内存
+
+    static bool isMemoryUse(const shared_ptr<Instruction> &ins);  // 指令只读内存
+
+    bool isLocalObject(const shared_ptr<Value> &base) const;  // 未逃逸的局部数组
+
+    static bool isScalarGlobal(const shared_ptr<Value> &base);  // 全局标量，不能作为指针传递
+
+private:
+    bool invokeMayAccess(const shared_ptr<InvokeInstruction> &invoke, const MemoryLocation &location, bool write) const;
+};
+
+#endif
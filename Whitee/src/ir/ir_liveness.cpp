@@ -0,0 +1,271 @@
+﻿/*********************************************************************
+ * @file   ir_liveness.cpp
+ * @brief  活跃变量分析，位向量后向数据流
+ * 
+ * @date   October 2026
+ *********************************************************************/
+#include "ir_liveness.h"
+
+#include <iostream>
+#include <stack>
+
+/**
+ * @brief 与other求并集
+ * @param other 另一个位向量
+ * @return true 自身发生变化；false 未变化
+ */
+bool BitVector::unionWith(const BitVector &other)
+{
+    bool changed = false;
+    for (size_t i = 0; i < words.size(); ++i)
+    {
+        unsigned long long merged = words[i] | other.words[i];
+        if (merged != words[i])
+        {
+            words[i] = merged;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+/**
+ * @brief 查找下一个置位
+ * @param from 起始编号
+ * @return 从from开始第一个置位的编号，没有则返回size
+ */
+size_t BitVector::findNext(size_t from) const
+{
+    if (from >= size)
+        return size;
+    size_t i = from >> 6;
+    unsigned long long word = words[i] & (~0ULL << (from & 63));
+    while (true)
+    {
+        if (word != 0)
+            return (i << 6) + __builtin_ctzll(word);
+        if (++i == words.size())
+            return size;
+        word = words[i];
+    }
+}
+
+/**
+ * @brief 对phi消除后的函数进行活跃变量分析
+ * @param func 
+ */
+LivenessAnalysis::LivenessAnalysis(shared_ptr<Function> &func)
+{
+    numberValues(func);
+    computeReversePostOrder(func);
+    solve();
+}
+
+/**
+ * @brief 稠密编号：函数参数与所有左值（包括phi、phi_move）
+ * @param func 
+ */
+void LivenessAnalysis::numberValues(shared_ptr<Function> &func)
+{
+    for (auto &arg : func->params)
+    {
+        valueIndex[arg] = values.size();
+        values.push_back(arg);
+    }
+    for (auto &bb : func->blocks)
+    {
+        for (auto &ins : bb->instructions)
+        {
+            if (ins->resultType == L_VAL_RESULT && valueIndex.count(ins) == 0)  // 同一phi_move位于多个块中，只编号一次
+            {
+                valueIndex[ins] = values.size();
+                values.push_back(ins);
+            }
+        }
+    }
+}
+
+/**
+ * @brief 计算基本块逆后序，不可达块排在最后
+ * @param func 
+ */
+void LivenessAnalysis::computeReversePostOrder(shared_ptr<Function> &func)
+{
+    unordered_set<shared_ptr<BasicBlock>> visited;
+    vector<shared_ptr<BasicBlock>> postOrder;
+    stack<pair<shared_ptr<BasicBlock>, unordered_set<shared_ptr<BasicBlock>>::iterator>> dfsStack;
+    if (func->entryBlock != nullptr)
+    {
+        visited.insert(func->entryBlock);
+        dfsStack.push({func->entryBlock, func->entryBlock->successors.begin()});
+    }
+    while (!dfsStack.empty())
+    {
+        auto &top = dfsStack.top();
+        if (top.second == top.first->successors.end())  // 后继都已访问，加入后序
+        {
+            postOrder.push_back(top.first);
+            dfsStack.pop();
+            continue;
+        }
+        shared_ptr<BasicBlock> suc = *top.second;
+        ++top.second;
+        if (visited.count(suc) == 0)
+        {
+            visited.insert(suc);
+            dfsStack.push({suc, suc->successors.begin()});
+        }
+    }
+    reversePostOrder.assign(postOrder.rbegin(), postOrder.rend());
+    for (auto &bb : func->blocks)
+    {
+        if (visited.count(bb) == 0)
+            reversePostOrder.push_back(bb);
+    }
+}
+
+/**
+ * @brief 获得指令使用的被追踪值的编号；phi使用其phi_move，phi_move在各前驱块使用对应的操作数
+ * @param ins 指令
+ * @param bb 指令所在的块（phi_move会出现在多个块中）
+ * @param used 使用的值的编号
+ */
+void LivenessAnalysis::getUsedValues(shared_ptr<Instruction> &ins, shared_ptr<BasicBlock> &bb, vector<unsigned int> &used)
+{
+    used.clear();
+    vector<shared_ptr<Value>> operands;
+    switch (ins->type)
+    {
+    case RET:
+        operands.push_back(s_p_c<ReturnInstruction>(ins)->value);
+        break;
+    case BR:
+        operands.push_back(s_p_c<BranchInstruction>(ins)->condition);
+        break;
+    case INVOKE:
+        operands = s_p_c<InvokeInstruction>(ins)->params;
+        break;
+    case UNARY:
+        operands.push_back(s_p_c<UnaryInstruction>(ins)->value);
+        break;
+    case BINARY:
+    case CMP:
+        operands.push_back(s_p_c<BinaryInstruction>(ins)->lhs);
+        operands.push_back(s_p_c<BinaryInstruction>(ins)->rhs);
+        break;
+    case STORE:
+        operands.push_back(s_p_c<StoreInstruction>(ins)->value);
+        operands.push_back(s_p_c<StoreInstruction>(ins)->address);
+        operands.push_back(s_p_c<StoreInstruction>(ins)->offset);
+        break;
+    case LOAD:
+        operands.push_back(s_p_c<LoadInstruction>(ins)->address);
+        operands.push_back(s_p_c<LoadInstruction>(ins)->offset);
+        break;
+    case PHI:
+        operands.push_back(s_p_c<PhiInstruction>(ins)->phiMove);
+        break;
+    case PHI_MOV:
+    {
+        shared_ptr<PhiInstruction> phi = s_p_c<PhiMoveInstruction>(ins)->phi;
+        if (phi->operands.count(bb) != 0)
+            operands.push_back(phi->operands.at(bb));
+        else
+            cerr << "Error occurs in process liveness analysis: phi move is not in an operand block." << endl;
+        break;
+    }
+    default:
+        break;
+    }
+    for (auto &val : operands)
+    {
+        if (val != nullptr && valueIndex.count(val) != 0)
+            used.push_back(valueIndex.at(val));
+    }
+}
+
+/**
+ * @brief 获得指令定义的值的编号
+ * @param ins 
+ * @return 编号；不定义被追踪的值时返回-1
+ */
+int LivenessAnalysis::getDefinedValue(shared_ptr<Instruction> &ins)
+{
+    if (ins->resultType != L_VAL_RESULT || valueIndex.count(ins) == 0)
+        return -1;
+    return (int)valueIndex.at(ins);
+}
+
+/**
+ * @brief 迭代求解 in = use ∪ (out - def)，out = ∪ in(suc)；按后序（逆后序的反向）访问，通常两三轮即收敛
+ */
+void LivenessAnalysis::solve()
+{
+    unsigned int size = values.size();
+    unordered_map<shared_ptr<BasicBlock>, BitVector> useSet, defSet;
+    vector<unsigned int> used;
+    for (auto &bb : reversePostOrder)
+    {
+        BitVector use(size), def(size);
+        for (auto &ins : bb->instructions)
+        {
+            getUsedValues(ins, bb, used);
+            for (auto index : used)
+            {
+                if (!def.test(index))  // 向上暴露的使用
+                    use.set(index);
+            }
+            int defined = getDefinedValue(ins);
+            if (defined >= 0)
+                def.set(defined);
+        }
+        useSet[bb] = use;
+        defSet[bb] = def;
+        liveIn[bb] = use;
+        liveOut[bb] = BitVector(size);
+    }
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto it = reversePostOrder.rbegin(); it != reversePostOrder.rend(); ++it)
+        {
+            shared_ptr<BasicBlock> bb = *it;
+            BitVector &out = liveOut.at(bb);
+            for (auto &suc : bb->successors)
+            {
+                if (liveIn.count(suc) != 0)
+                    out.unionWith(liveIn.at(suc));
+            }
+            BitVector &in = liveIn.at(bb);
+            const BitVector &use = useSet.at(bb);
+            const BitVector &def = defSet.at(bb);
+            for (size_t i = 0; i < in.words.size(); ++i)
+            {
+                unsigned long long word = use.words[i] | (out.words[i] & ~def.words[i]);
+                if (word != in.words[i])
+                {
+                    in.words[i] = word;
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief 越过一条指令向前推进活跃集合：live由ins执行后活跃的值更新为执行前活跃的值
+ * @param ins 指令
+ * @param bb 指令所在的块
+ * @param live 活跃的值
+ */
+void LivenessAnalysis::stepBackward(shared_ptr<Instruction> &ins, shared_ptr<BasicBlock> &bb, BitVector &live)
+{
+    int defined = getDefinedValue(ins);
+    if (defined >= 0)
+        live.reset(defined);
+    vector<unsigned int> used;
+    getUsedValues(ins, bb, used);
+    for (auto index : used)
+        live.set(index);
+}
@@ -0,0 +1,61 @@
+﻿#ifndef COMPILER_IR_LIVENESS_H
+#define COMPILER_IR_LIVENESS_H
+
+#include "ir.h"
+
+/**
+ * 定长位向量，第i位代表编号为i的值
+ */
+class BitVector
+{
+public:
+    size_t size = 0;
+    vector<unsigned long long> words;
+
+    BitVector() = default;
+
+    explicit BitVector(size_t size)
+        : size(size), words((size + 63) / 64, 0){};
+
+    inline void set(size_t i) { words[i >> 6] |= 1ULL << (i & 63); }
+
+    inline void reset(size_t i) { words[i >> 6] &= ~(1ULL << (i & 63)); }
+
+    inline bool test(size_t i) const { return (words[i >> 6] >> (i & 63)) & 1ULL; }
+
+    bool unionWith(const BitVector &other);  // 并集，返回是否发生变化
+
+    size_t findNext(size_t from) const;  // 从from开始第一个置位的编号，没有则返回size
+};
+
+/**
+ * 函数的活跃变量分析：对参数与左值稠密编号，以位向量在逆后序上迭代求解后向数据流
+ */
+class LivenessAnalysis
+{
+public:
+    vector<shared_ptr<Value>> values;                       // 编号 --> 值
+    unordered_map<shared_ptr<Value>, unsigned int> valueIndex; // 值 --> 编号
+    vector<shared_ptr<BasicBlock>> reversePostOrder;          // 基本块的逆后序
+    unordered_map<shared_ptr<BasicBlock>, BitVector> liveIn;  // 块入口活跃的值
+    unordered_map<shared_ptr<BasicBlock>, BitVector> liveOut; // 块出口活跃的值
+
+    explicit LivenessAnalysis(shared_ptr<Function> &func);
+
+    inline bool isTracked(const shared_ptr<Value> &value) const { return valueIndex.count(value) != 0; }
+
+    void getUsedValues(shared_ptr<Instruction> &ins, shared_ptr<BasicBlock> &bb, vector<unsigned int> &used);
+
+    int getDefinedValue(shared_ptr<Instruction> &ins);
+
+    void stepBackward(shared_ptr<Instruction> &ins, shared_ptr<BasicBlock> &bb, BitVector &live);
+
+private:
+    void numberValues(shared_ptr<Function> &func);
+
+    void computeReversePostOrder(shared_ptr<Function> &func);
+
+    void solve();
+};
+
+#endif
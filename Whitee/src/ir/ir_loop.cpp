@@ -0,0 +1,186 @@
+﻿/*********************************************************************
+ * @file   ir_loop.cpp
+ * @brief  支配树与自然循环
+ * 
+ * @date   October 2026
+ *********************************************************************/
+#include "ir_loop.h"
+
+#include <algorithm>
+#include <stack>
+
+/**
+ * @brief 计算可达块的逆后序与直接支配者
+ * @param func 
+ */
+DominatorTree::DominatorTree(shared_ptr<Function> &func)
+{
+    unordered_set<shared_ptr<BasicBlock>> visited;
+    vector<shared_ptr<BasicBlock>> postOrder;
+    stack<pair<shared_ptr<BasicBlock>, unordered_set<shared_ptr<BasicBlock>>::iterator>> dfsStack;
+    if (func->entryBlock == nullptr)
+        return;
+    visited.insert(func->entryBlock);
+    dfsStack.push({func->entryBlock, func->entryBlock->successors.begin()});
+    while (!dfsStack.empty())
+    {
+        auto &top = dfsStack.top();
+        if (top.second == top.first->successors.end())
+        {
+            postOrder.push_back(top.first);
+            dfsStack.pop();
+            continue;
+        }
+        shared_ptr<BasicBlock> suc = *top.second;
+        ++top.second;
+        if (visited.count(suc) == 0)
+        {
+            visited.insert(suc);
+            dfsStack.push({suc, suc->successors.begin()});
+        }
+    }
+    reversePostOrder.assign(postOrder.rbegin(), postOrder.rend());
+    for (unsigned int i = 0; i < reversePostOrder.size(); ++i)
+        order[reversePostOrder[i]] = i;
+
+    idom[func->entryBlock] = func->entryBlock;
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (unsigned int i = 1; i < reversePostOrder.size(); ++i)
+        {
+            shared_ptr<BasicBlock> bb = reversePostOrder[i];
+            shared_ptr<BasicBlock> newIdom;
+            for (auto &pred : bb->predecessors)  // 已处理的前驱的支配者求交
+            {
+                if (idom.count(pred) == 0)
+                    continue;
+                newIdom = newIdom == nullptr ? pred : intersect(pred, newIdom);
+            }
+            if (newIdom != nullptr && (idom.count(bb) == 0 || idom.at(bb) != newIdom))
+            {
+                idom[bb] = newIdom;
+                changed = true;
+            }
+        }
+    }
+}
+
+/**
+ * @brief 沿支配树向上找两块的最近公共支配者
+ * @param a 
+ * @param b 
+ * @return 最近公共支配者
+ */
+shared_ptr<BasicBlock> DominatorTree::intersect(shared_ptr<BasicBlock> a, shared_ptr<BasicBlock> b)
+{
+    while (a != b)
+    {
+        while (order.at(a) > order.at(b))
+            a = idom.at(a);
+        while (order.at(b) > order.at(a))
+            b = idom.at(b);
+    }
+    return a;
+}
+
+/**
+ * @brief a是否支配b，不可达块不被任何块支配
+ * @param a 
+ * @param b 
+ * @return 支配则为true
+ */
+bool DominatorTree::dominates(const shared_ptr<BasicBlock> &a, shared_ptr<BasicBlock> b) const
+{
+    if (!isReachable(a) || !isReachable(b))
+        return false;
+    while (order.at(b) > order.at(a))  // 支配者的逆后序编号更小
+        b = idom.at(b);
+    return a == b;
+}
+
+struct LoopSizeGreater
+{
+    bool operator()(const shared_ptr<Loop> &a, const shared_ptr<Loop> &b) const
+    {
+        return a->blocks.size() > b->blocks.size();
+    }
+};
+
+/**
+ * @brief 由回边找出自然循环并建立嵌套关系
+ * @param domTree 
+ */
+LoopInfo::LoopInfo(DominatorTree &domTree)
+{
+    unordered_map<shared_ptr<BasicBlock>, shared_ptr<Loop>> headerLoop;
+    for (auto &bb : domTree.reversePostOrder)
+    {
+        for (auto &suc : bb->successors)
+        {
+            if (!domTree.dominates(suc, bb))  // 回边：后继支配此块
+                continue;
+            shared_ptr<Loop> loop;
+            if (headerLoop.count(suc) == 0)
+            {
+                loop = make_shared<Loop>();
+                loop->header = suc;
+                loop->blocks.insert(suc);
+                headerLoop[suc] = loop;
+                loops.push_back(loop);
+            }
+            loop = headerLoop.at(suc);
+            loop->latches.push_back(bb);
+            stack<shared_ptr<BasicBlock>> work;  // 自回边起点向前，直到循环头
+            if (loop->blocks.insert(bb).second)
+                work.push(bb);
+            while (!work.empty())
+            {
+                shared_ptr<BasicBlock> top = work.top();
+                work.pop();
+                for (auto &pred : top->predecessors)
+                {
+                    if (domTree.isReachable(pred) && loop->blocks.insert(pred).second)
+                        work.push(pred);
+                }
+            }
+        }
+    }
+    stable_sort(loops.begin(), loops.end(), LoopSizeGreater());  // 外层循环的块更多，先处理
+    for (auto &loop : loops)
+    {
+        if (blockLoop.count(loop->header) != 0)  // 已处理的包含循环头的最小循环即外层循环
+            loop->parent = blockLoop.at(loop->header);
+        for (auto &bb : loop->blocks)
+            blockLoop[bb] = loop;
+        if (loop->parent != nullptr)
+        {
+            loop->parent->children.push_back(loop);
+            loop->depth = loop->parent->depth + 1;
+        }
+        for (auto &pred : loop->header->predecessors)
+        {
+            if (loop->contains(pred))
+                continue;
+            if (loop->preheader == nullptr)
+                loop->preheader = pred;
+            else  // 多个循环外前驱
+            {
+                loop->preheader = nullptr;
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief 包含块的最内层循环
+ * @param bb 
+ * @return 不在循环中则为nullptr
+ */
+shared_ptr<Loop> LoopInfo::getLoop(const shared_ptr<BasicBlock> &bb) const
+{
+    auto it = blockLoop.find(bb);
+    return it == blockLoop.end() ? nullptr : it->second;
+}
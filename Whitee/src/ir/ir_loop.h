@@ -0,0 +1,57 @@
+﻿#ifndef COMPILER_IR_LOOP_H
+#define COMPILER_IR_LOOP_H
+
+#include "ir.h"
+
+/**
+ * 支配树：在可达块的逆后序上迭代求直接支配者（Cooper-Harvey-Kennedy）
+ */
+class DominatorTree
+{
+public:
+    vector<shared_ptr<BasicBlock>> reversePostOrder;                     // 可达块的逆后序
+    unordered_map<shared_ptr<BasicBlock>, unsigned int> order;            // 块 --> 逆后序编号
+    unordered_map<shared_ptr<BasicBlock>, shared_ptr<BasicBlock>> idom;  // 块 --> 直接支配者，入口块为自身
+
+    explicit DominatorTree(shared_ptr<Function> &func);
+
+    inline bool isReachable(const shared_ptr<BasicBlock> &bb) const { return order.count(bb) != 0; }
+
+    bool dominates(const shared_ptr<BasicBlock> &a, shared_ptr<BasicBlock> b) const;  // a支配b
+
+private:
+    shared_ptr<BasicBlock> intersect(shared_ptr<BasicBlock> a, shared_ptr<BasicBlock> b);
+};
+
+/**
+ * 自然循环：回边的目标为循环头，同一循环头的回边合并为一个循环
+ */
+class Loop
+{
+public:
+    shared_ptr<BasicBlock> header;
+    unordered_set<shared_ptr<BasicBlock>> blocks;  // 循环内的块，包括循环头
+    vector<shared_ptr<BasicBlock>> latches;        // 回边的起点
+    shared_ptr<BasicBlock> preheader;              // 循环头唯一的循环外前驱，没有则为nullptr
+    shared_ptr<Loop> parent;                       // 外层循环
+    vector<shared_ptr<Loop>> children;             // 内层循环
+    unsigned int depth = 1;                        // 嵌套深度，最外层为1
+
+    inline bool contains(const shared_ptr<BasicBlock> &bb) const { return blocks.count(bb) != 0; }
+};
+
+/**
+ * 函数的循环嵌套森林
+ */
+class LoopInfo
+{
+public:
+    vector<shared_ptr<Loop>> loops;                                  // 外层循环在前
+    unordered_map<shared_ptr<BasicBlock>, shared_ptr<Loop>> blockLoop; // 块 --> 包含此块的最内层循环
+
+    explicit LoopInfo(DominatorTree &domTree);
+
+    shared_ptr<Loop> getLoop(const shared_ptr<BasicBlock> &bb) const;  // 不在循环中则为nullptr
+};
+
+#endif
@@ -0,0 +1,189 @@
+﻿/*********************************************************************
+ * @file   ir_memory_ssa.cpp
+ * @brief  Memory SSA与内存位置的最近写查询
+ * 
+ * @date   October 2026
+ *********************************************************************/
+#include "ir_memory_ssa.h"
+
+const unsigned int _MEMORY_WALK_MAX_STEPS = 1000;  // 一次查询最多经过的内存访问数，超过则保守返回
+
+/**
+ * @brief 为可达块中的load、store与调用建立def、use，放置phi并重命名
+ * @param func 
+ * @param domTree 
+ * @param aliasAnalysis 
+ */
+MemorySSA::MemorySSA(shared_ptr<Function> &func, DominatorTree &domTree, AliasAnalysis &aliasAnalysis)
+    : aliasAnalysis(aliasAnalysis), domTree(domTree)
+{
+    liveOnEntry = make_shared<MemoryAccess>(LIVE_ON_ENTRY, func->entryBlock, nullptr);
+    if (func->entryBlock == nullptr)
+        return;
+    for (auto &bb : domTree.reversePostOrder)
+    {
+        if (bb != func->entryBlock)
+            domChildren[domTree.idom.at(bb)].push_back(bb);
+        for (auto &ins : bb->instructions)
+        {
+            if (AliasAnalysis::isMemoryDef(ins))
+                accesses[ins] = make_shared<MemoryAccess>(MEMORY_DEF, bb, ins);
+            else if (AliasAnalysis::isMemoryUse(ins))
+                accesses[ins] = make_shared<MemoryAccess>(MEMORY_USE, bb, ins);
+        }
+    }
+    placePhis();
+    rename(func->entryBlock, liveOnEntry);
+}
+
+/**
+ * @brief 在含def的块的迭代支配边界放置phi
+ */
+void MemorySSA::placePhis()
+{
+    unordered_map<shared_ptr<BasicBlock>, unordered_set<shared_ptr<BasicBlock>>> frontiers;
+    for (auto &bb : domTree.reversePostOrder)
+    {
+        if (bb->predecessors.size() < 2)
+            continue;
+        for (auto &pred : bb->predecessors)
+        {
+            if (!domTree.isReachable(pred))
+                continue;
+            for (shared_ptr<BasicBlock> runner = pred; runner != domTree.idom.at(bb); runner = domTree.idom.at(runner))
+                frontiers[runner].insert(bb);
+        }
+    }
+    vector<shared_ptr<BasicBlock>> workList;
+    unordered_set<shared_ptr<BasicBlock>> defBlocks;
+    for (auto &it : accesses)
+    {
+        if (it.second->type == MEMORY_DEF && defBlocks.count(it.second->block) == 0)
+        {
+            defBlocks.insert(it.second->block);
+            workList.push_back(it.second->block);
+        }
+    }
+    while (!workList.empty())
+    {
+        shared_ptr<BasicBlock> bb = workList.back();
+        workList.pop_back();
+        if (frontiers.count(bb) == 0)
+            continue;
+        for (auto &frontier : frontiers.at(bb))
+        {
+            if (phis.count(frontier) != 0)
+                continue;
+            phis[frontier] = make_shared<MemoryAccess>(MEMORY_PHI, frontier, nullptr);
+            if (defBlocks.count(frontier) == 0)  // phi也是一个def
+            {
+                defBlocks.insert(frontier);
+                workList.push_back(frontier);
+            }
+        }
+    }
+}
+
+/**
+ * @brief 沿支配树重命名：每个访问指向之前最近的内存版本，并填写后继phi的操作数
+ * @param bb 
+ * @param incoming 进入块时的内存版本
+ */
+void MemorySSA::rename(const shared_ptr<BasicBlock> &bb, shared_ptr<MemoryAccess> incoming)
+{
+    if (phis.count(bb) != 0)
+        incoming = phis.at(bb);
+    for (auto &ins : bb->instructions)
+    {
+        if (accesses.count(ins) == 0)
+            continue;
+        shared_ptr<MemoryAccess> access = accesses.at(ins);
+        access->definingAccess = incoming;
+        if (access->type == MEMORY_DEF)
+            incoming = access;
+    }
+    for (auto &suc : bb->successors)
+    {
+        if (phis.count(suc) != 0)
+            phis.at(suc)->operands[bb] = incoming;
+    }
+    if (domChildren.count(bb) != 0)
+    {
+        for (auto &child : domChildren.at(bb))
+            rename(child, incoming);
+    }
+}
+
+/**
+ * @brief load或store的位置在指令之前最近一次可能被写的内存版本
+ * @param ins 
+ * @return 
+ */
+shared_ptr<MemoryAccess> MemorySSA::getClobberingAccess(const shared_ptr<Instruction> &ins)
+{
+    if (accesses.count(ins) == 0)
+        return nullptr;
+    return getClobberingAccess(accesses.at(ins)->definingAccess, aliasAnalysis.getLocation(ins));
+}
+
+/**
+ * @brief 从start向上查找最近一次可能写location的内存版本；start与结果之间的任何路径上都没有写location的指令
+ * @param start 开始的内存版本
+ * @param location 
+ * @return def、phi或函数入口
+ */
+shared_ptr<MemoryAccess> MemorySSA::getClobberingAccess(const shared_ptr<MemoryAccess> &start, const MemoryLocation &location)
+{
+    phiClobbers.clear();
+    visitingPhis.clear();
+    walkSteps = 0;
+    shared_ptr<MemoryAccess> result = walk(start, location);
+    if (result == nullptr || walkSteps > _MEMORY_WALK_MAX_STEPS)
+        return start;
+    return result;
+}
+
+/**
+ * @brief 沿def链向上，跳过不写location的def；遇到phi时各操作数的结果相同则越过phi，
+ *        正在求的phi（回边）视为不提供新的写
+ * @param access 
+ * @param location 
+ * @return 结果；回到正在求的phi时为nullptr
+ */
+shared_ptr<MemoryAccess> MemorySSA::walk(shared_ptr<MemoryAccess> access, const MemoryLocation &location)
+{
+    while (access->type == MEMORY_DEF)
+    {
+        if (++walkSteps > _MEMORY_WALK_MAX_STEPS || aliasAnalysis.mayModify(access->ins, location))
+            return access;
+        access = access->definingAccess;
+    }
+    if (access->type != MEMORY_PHI)
+        return access;
+    if (phiClobbers.count(access) != 0)
+        return phiClobbers.at(access);
+    if (visitingPhis.count(access) != 0)
+        return nullptr;
+    visitingPhis.insert(access);
+    shared_ptr<MemoryAccess> result;
+    for (auto &it : access->operands)
+    {
+        shared_ptr<MemoryAccess> clobber = walk(it.second, location);
+        if (clobber == nullptr)
+            continue;
+        if (result == nullptr)
+            result = clobber;
+        else if (result != clobber)
+        {
+            result = access;
+            break;
+        }
+    }
+    visitingPhis.erase(access);
+    if (result == nullptr)  // 各操作数都回到正在求的phi，结果取决于外层，不记录
+        return nullptr;
+    if (walkSteps > _MEMORY_WALK_MAX_STEPS)
+        result = access;
+    phiClobbers[access] = result;
+    return result;
+}
@@ -0,0 +1,63 @@
+﻿#ifndef COMPILER_IR_MEMORY_SSA_H
+#define COMPILER_IR_MEMORY_SSA_H
+
+#include "ir.h"
+#include "ir_alias.h"
+#include "ir_loop.h"
+
+enum MemoryAccessType
+{
+    MEMORY_DEF,     // 可能写内存的指令：store、有副作用的调用
+    MEMORY_USE,     // 只读内存的指令：load
+    MEMORY_PHI,     // 汇合点的内存版本
+    LIVE_ON_ENTRY   // 函数入口的内存
+};
+
+/**
+ * Memory SSA中的内存访问：整个内存视为一个变量，每个def产生一个新版本
+ */
+class MemoryAccess
+{
+public:
+    MemoryAccessType type;
+    shared_ptr<BasicBlock> block;
+    shared_ptr<Instruction> ins;                                                // def与use对应的指令
+    shared_ptr<MemoryAccess> definingAccess;                                    // def与use之前的内存版本
+    unordered_map<shared_ptr<BasicBlock>, shared_ptr<MemoryAccess>> operands;  // phi：前驱块 --> 内存版本
+
+    MemoryAccess(MemoryAccessType type, shared_ptr<BasicBlock> block, shared_ptr<Instruction> ins)
+        : type(type), block(block), ins(ins){};
+};
+
+/**
+ * 函数的Memory SSA：在def所在块的迭代支配边界放置phi，沿支配树重命名
+ */
+class MemorySSA
+{
+public:
+    AliasAnalysis &aliasAnalysis;
+    DominatorTree &domTree;
+    shared_ptr<MemoryAccess> liveOnEntry;
+    unordered_map<shared_ptr<Instruction>, shared_ptr<MemoryAccess>> accesses;  // 指令 --> def或use
+    unordered_map<shared_ptr<BasicBlock>, shared_ptr<MemoryAccess>> phis;        // 块 --> 块入口的phi
+
+    MemorySSA(shared_ptr<Function> &func, DominatorTree &domTree, AliasAnalysis &aliasAnalysis);
+
+    shared_ptr<MemoryAccess> getClobberingAccess(const shared_ptr<Instruction> &ins);  // load或store的位置最近一次可能被写的内存版本
+
+    shared_ptr<MemoryAccess> getClobberingAccess(const shared_ptr<MemoryAccess> &start, const MemoryLocation &location);
+
+private:
+    unordered_map<shared_ptr<BasicBlock>, vector<shared_ptr<BasicBlock>>> domChildren;
+    unordered_map<shared_ptr<MemoryAccess>, shared_ptr<MemoryAccess>> phiClobbers;  // 本次查询中已求出的phi的结果
+    unordered_set<shared_ptr<MemoryAccess>> visitingPhis;                          // 本次查询中正在求的phi
+    unsigned int walkSteps = 0;
+
+    void placePhis();
+
+    void rename(const shared_ptr<BasicBlock> &bb, shared_ptr<MemoryAccess> incoming);
+
+    shared_ptr<MemoryAccess> walk(shared_ptr<MemoryAccess> access, const MemoryLocation &location);
+};
+
+#endif
@@ -301,7 +301,7 @@ string InvokeInstruction::toString()
         {
             s += getSsaName(v) + " = ";
         }
-        s += "call " + targetFunction->name + " [args";
+        s += (parallel ? "parallel call " : "call ") + targetFunction->name + " [args";
     }
     else
     {
@@ -6,7 +6,10 @@
  * @date   May 2022
  *********************************************************************/
 #include "ir_utils.h"
+#include "ir_liveness.h"
+#include "ir_alias.h"
 
+#include <algorithm>
 #include <iostream>
 #include <queue>
 
@@ -195,78 +198,165 @@ void build_relation_tree(const shared_ptr<BasicBlock> &bb)
 }
 
 /**
- * @brief 函数有副作用：修改了自己范围之外的资源    修改全局变量、修改输入参数所引用的对象、做输入输出操作、调用其他有副作用的函数
- * @param module 此module中的函数
+ * @brief 记录函数通过指针的一次读写：全局变量与指针参数所指的数组在函数外可见，局部数组与常量数组不计
+ * @param func 
+ * @param address 指针
+ * @param write 是否为写
+ * @return 摘要是否变化
  */
-void function_is_side_effect(shared_ptr<Module> &module)
+bool add_mod_ref(shared_ptr<Function> &func, const shared_ptr<Value> &address, bool write)
 {
-    for (auto &func : module->functions)
+    shared_ptr<Value> base = AliasAnalysis::getLocation(address, nullptr).base;
+    if (base == nullptr)
     {
-        func->side_effect = false;
-        for (auto &arg : func->params)
+        bool &unknown = write ? func->modUnknown : func->refUnknown;
+        bool changed = !unknown;
+        unknown = true;
+        return changed;
+    }
+    if (base->value_type == GLOBAL)
+        return (write ? func->modGlobals : func->refGlobals).insert(base).second;
+    if (base->value_type == PARAMETER)
+    {
+        for (unsigned int i = 0; i < func->params.size(); ++i)
         {
-            if (s_p_c<ParameterValue>(arg)->variableType == VariableType::POINTER)   // 函数参数为指针
-            {
-                func->side_effect = true;
-                goto FUNC_SIDE_EFFECT_CONTINUE;
-            }
+            if (func->params.at(i) == base)
+                return (write ? func->modParams : func->refParams).insert(i).second;
         }
-        for (auto &bb : func->blocks)
+    }
+    return false;
+}
+
+/**
+ * @brief 由函数的指令与被调用函数的摘要更新函数的读写摘要
+ * @param func 
+ * @return 摘要是否变化
+ */
+bool collect_mod_ref(shared_ptr<Function> &func)
+{
+    bool changed = false;
+    for (auto &bb : func->blocks)
+    {
+        for (auto &ins : bb->instructions)
         {
-            for (auto &ins : bb->instructions)
+            if (ins->type == STORE)
+                changed |= add_mod_ref(func, s_p_c<StoreInstruction>(ins)->address, true);
+            else if (ins->type == LOAD)
+                changed |= add_mod_ref(func, s_p_c<LoadInstruction>(ins)->address, false);
+            else if (ins->type == INVOKE)
             {
-                if (ins->type == InstructionType::STORE)
+                shared_ptr<InvokeInstruction> invoke = s_p_c<InvokeInstruction>(ins);
+                if (invoke->invokeType != COMMON)  // 运行时函数：输入输出，getarray写、putarray读数组参数
                 {
-                    if (s_p_c<StoreInstruction>(ins)->address->value_type != INSTRUCTION)  // store一个全局变量
+                    changed |= !func->inputOutput;
+                    func->inputOutput = true;
+                    for (auto &param : invoke->params)
                     {
-                        func->side_effect = true;
-                        goto FUNC_SIDE_EFFECT_CONTINUE;
+                        if (AliasAnalysis::isPointer(param) && (invoke->invokeType == GET_ARRAY || invoke->invokeType == PUT_ARRAY))
+                            changed |= add_mod_ref(func, param, invoke->invokeType == GET_ARRAY);
                     }
+                    continue;
                 }
-                else if (ins->type == InstructionType::LOAD)
+                shared_ptr<Function> callee = invoke->targetFunction;
+                unsigned int oldSize = func->modGlobals.size() + func->refGlobals.size();
+                func->modGlobals.insert(callee->modGlobals.begin(), callee->modGlobals.end());
+                func->refGlobals.insert(callee->refGlobals.begin(), callee->refGlobals.end());
+                changed |= func->modGlobals.size() + func->refGlobals.size() != oldSize;
+                changed |= (callee->modUnknown && !func->modUnknown) || (callee->refUnknown && !func->refUnknown) || (callee->inputOutput && !func->inputOutput);
+                func->modUnknown |= callee->modUnknown;
+                func->refUnknown |= callee->refUnknown;
+                func->inputOutput |= callee->inputOutput;
+                for (auto index : callee->modParams)  // 被调用函数写的参数，换为实参
                 {
-                    if (s_p_c<LoadInstruction>(ins)->address->value_type != INSTRUCTION)  // load一个全局变量
-                    {
-                        func->side_effect = true;
-                        goto FUNC_SIDE_EFFECT_CONTINUE;
-                    }
+                    if (index < invoke->params.size())
+                        changed |= add_mod_ref(func, invoke->params.at(index), true);
                 }
-                else if (ins->type == InstructionType::BINARY)
+                for (auto index : callee->refParams)
                 {
-                    // 使用了全局变量
-                    if (s_p_c<BinaryInstruction>(ins)->lhs->value_type == ValueType::CONSTANT || s_p_c<BinaryInstruction>(ins)->lhs->value_type == ValueType::GLOBAL 
-                        || s_p_c<BinaryInstruction>(ins)->rhs->value_type == ValueType::CONSTANT || s_p_c<BinaryInstruction>(ins)->rhs->value_type == ValueType::GLOBAL)
-                    {
-                        func->side_effect = true;
-                        goto FUNC_SIDE_EFFECT_CONTINUE;
-                    }
-                }
-                else if (ins->type == InstructionType::INVOKE)
-                {
-                    if (s_p_c<InvokeInstruction>(ins)->invokeType != COMMON)  // 调用了系统函数
-                    {
-                        func->side_effect = true;
-                        goto FUNC_SIDE_EFFECT_CONTINUE;
-                    }
-                    else if (s_p_c<InvokeInstruction>(ins)->targetFunction->side_effect)  // 调用了有副作用的函数
-                    {
-                        func->side_effect = true;
-                        goto FUNC_SIDE_EFFECT_CONTINUE;
-                    }
-                    for (auto &arg : s_p_c<InvokeInstruction>(ins)->params)
-                    {
-                        if (arg->value_type == ValueType::GLOBAL || arg->value_type == ValueType::CONSTANT)  // 函数的实参为全局变量
-                        {
-                            func->side_effect = true;
-                            goto FUNC_SIDE_EFFECT_CONTINUE;
-                        }
-                    }
+                    if (index < invoke->params.size())
+                        changed |= add_mod_ref(func, invoke->params.at(index), false);
                 }
             }
         }
-    FUNC_SIDE_EFFECT_CONTINUE:
-        continue;
     }
+    return changed;
+}
+
+/**
+ * @brief Tarjan求调用图的强连通分量，分量按被调用者在前的顺序加入sccs
+ * @param func 
+ * @param index 函数 --> 访问序号
+ * @param lowLink 函数 --> 能到达的最小序号
+ * @param sccStack 
+ * @param sccs 
+ */
+void call_graph_scc(shared_ptr<Function> func, unordered_map<shared_ptr<Function>, unsigned int> &index, unordered_map<shared_ptr<Function>, unsigned int> &lowLink,
+                    vector<shared_ptr<Function>> &sccStack, vector<vector<shared_ptr<Function>>> &sccs)
+{
+    unsigned int order = index.size();
+    index[func] = order;
+    lowLink[func] = order;
+    sccStack.push_back(func);
+    for (auto &callee : func->callees)
+    {
+        if (index.count(callee) == 0)
+        {
+            call_graph_scc(callee, index, lowLink, sccStack, sccs);
+            lowLink[func] = min(lowLink.at(func), lowLink.at(callee));
+        }
+        else if (find(sccStack.begin(), sccStack.end(), callee) != sccStack.end())
+            lowLink[func] = min(lowLink.at(func), index.at(callee));
+    }
+    if (lowLink.at(func) != index.at(func))
+        return;
+    vector<shared_ptr<Function>> scc;
+    shared_ptr<Function> top;
+    do
+    {
+        top = sccStack.back();
+        sccStack.pop_back();
+        scc.push_back(top);
+    } while (top != func);
+    sccs.push_back(scc);
+}
+
+/**
+ * @brief 函数的读写摘要与副作用：沿调用图自底向上求每个函数可能读写的全局变量、指针参数所指的数组，以及是否输入输出，
+ *        递归的函数在强连通分量内迭代至不变；有副作用即修改了自己范围之外的资源：写全局变量、写参数所引用的数组、输入输出
+ * @param module 此module中的函数
+ */
+void function_is_side_effect(shared_ptr<Module> &module)
+{
+    unordered_map<shared_ptr<Function>, unsigned int> index, lowLink;
+    vector<shared_ptr<Function>> sccStack;
+    vector<vector<shared_ptr<Function>>> sccs;
+    for (auto &func : module->functions)
+    {
+        func->modGlobals.clear();
+        func->refGlobals.clear();
+        func->modParams.clear();
+        func->refParams.clear();
+        func->modUnknown = false;
+        func->refUnknown = false;
+        func->inputOutput = false;
+    }
+    for (auto &func : module->functions)
+    {
+        if (index.count(func) == 0)
+            call_graph_scc(func, index, lowLink, sccStack, sccs);
+    }
+    for (auto &scc : sccs)
+    {
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (auto &func : scc)
+                changed |= collect_mod_ref(func);
+        }
+    }
+    for (auto &func : module->functions)
+        func->side_effect = func->modifiesMemory() || func->inputOutput;
 }
 
 /**
@@ -356,13 +446,19 @@ void fixRightValue(shared_ptr<Module> &module)
             {
                 if (ins->users.size() == 1 && ins->resultType == R_VAL_RESULT)
                 {
-                    // 如果此右值仅被一次使用，且使用与此指令不在同一个块
-                    if (ins->users.begin()->get()->value_type == ValueType::INSTRUCTION && ins->block != s_p_c<Instruction>(*ins->users.begin())->block)
+                    // 如果此右值仅被一次使用，且使用与此指令不在同一个块，或使用为phi
+                    shared_ptr<Value> user = *ins->users.begin();
+                    if (user->value_type == ValueType::INSTRUCTION && (ins->block != s_p_c<Instruction>(user)->block || s_p_c<Instruction>(user)->type == PHI))
                     {
                         ins->resultType = L_VAL_RESULT;
                         ins->caughtVarName = generateTempLeftValueName();
                     }
                 }
+                else if (ins->users.size() > 1 && ins->resultType == R_VAL_RESULT)  // 折叠等替换使用后，右值可能被多次使用
+                {
+                    ins->resultType = L_VAL_RESULT;
+                    ins->caughtVarName = generateTempLeftValueName();
+                }
             }
         }
     }
@@ -443,17 +539,138 @@ void phi_elimination(shared_ptr<Function> &func)
 }
 
 /**
- * @brief 将块中的AliveValues加入块内ins中
+ * @brief 由活跃变量分析导出调用指令处活跃的变量（不含调用结果），后端据此保存现场
  * @param func 
  */
 void mergeAliveValuesToInstruction(shared_ptr<Function> &func)
 {
+    LivenessAnalysis liveness(func);
     for (auto &bb : func->blocks)
     {
-        for (auto &ins : bb->instructions)
+        BitVector live = liveness.liveOut.at(bb);
+        for (auto it = bb->instructions.rbegin(); it != bb->instructions.rend(); ++it)
+        {
+            shared_ptr<Instruction> ins = *it;
+            if (ins->type == INVOKE)
+            {
+                ins->aliveValues.clear();
+                for (unsigned int i = live.findNext(0); i < live.size; i = live.findNext(i + 1))
+                {
+                    if (liveness.values[i] != ins)
+                        ins->aliveValues.insert(liveness.values[i]);
+                }
+            }
+            liveness.stepBackward(ins, bb, live);
+        }
+    }
+}
+
+/**
+ * @brief 值映射，未映射的值（常量、全局变量等）保持不变
+ * @param valueMap 原值 --> 新值
+ * @param value 原值
+ * @return 新值
+ */
+shared_ptr<Value> mapValue(unordered_map<shared_ptr<Value>, shared_ptr<Value>> &valueMap, const shared_ptr<Value> &value)
+{
+    return valueMap.count(value) != 0 ? valueMap.at(value) : value;
+}
+
+/**
+ * @brief 复制一条非phi、非返回的指令，操作数与块按映射替换
+ * @param ins 原指令
+ * @param bb 新指令所在的块
+ * @param valueMap 原值 --> 新值，未映射的值（常量、全局变量等）保持不变
+ * @param blockMap 原块 --> 新块
+ * @return 新指令
+ */
+shared_ptr<Instruction> cloneInstruction(shared_ptr<Instruction> &ins, shared_ptr<BasicBlock> &bb,
+                                         unordered_map<shared_ptr<Value>, shared_ptr<Value>> &valueMap,
+                                         unordered_map<shared_ptr<BasicBlock>, shared_ptr<BasicBlock>> &blockMap)
+{
+    shared_ptr<Instruction> newIns;
+    switch (ins->type)
+    {
+    case BR:
+    {
+        shared_ptr<BranchInstruction> br = s_p_c<BranchInstruction>(ins);
+        shared_ptr<Value> condition = mapValue(valueMap, br->condition);
+        newIns = make_shared<BranchInstruction>(condition, blockMap.at(br->trueBlock), blockMap.at(br->falseBlock), bb);
+        user_use(newIns, {condition});
+        break;
+    }
+    case JMP:
+        newIns = make_shared<JumpInstruction>(blockMap.at(s_p_c<JumpInstruction>(ins)->targetBlock), bb);
+        break;
+    case INVOKE:
+    {
+        shared_ptr<InvokeInstruction> invoke = s_p_c<InvokeInstruction>(ins);
+        vector<shared_ptr<Value>> params;
+        for (auto &param : invoke->params)
+            params.push_back(mapValue(valueMap, param));
+        if (invoke->invokeType == COMMON)
         {
-            unordered_set<shared_ptr<Value>> blockAliveValues = bb->aliveValues;
-            ins->aliveValues.merge(blockAliveValues);
+            newIns = make_shared<InvokeInstruction>(invoke->targetFunction, params, bb);
+            bb->function->callees.insert(invoke->targetFunction);
+            invoke->targetFunction->callers.insert(bb->function);
         }
+        else
+        {
+            string sysFuncName = invoke->invokeType == START_TIME ? "starttime" : invoke->invokeType == STOP_TIME ? "stoptime" : invoke->targetName;
+            newIns = make_shared<InvokeInstruction>(sysFuncName, params, bb);
+        }
+        user_use(newIns, params);
+        break;
+    }
+    case UNARY:
+    {
+        shared_ptr<UnaryInstruction> unary = s_p_c<UnaryInstruction>(ins);
+        shared_ptr<Value> value = mapValue(valueMap, unary->value);
+        newIns = make_shared<UnaryInstruction>(unary->op, value, bb);
+        user_use(newIns, {value});
+        break;
+    }
+    case BINARY:
+    case CMP:
+    {
+        shared_ptr<BinaryInstruction> binary = s_p_c<BinaryInstruction>(ins);
+        shared_ptr<Value> lhs = mapValue(valueMap, binary->lhs);
+        shared_ptr<Value> rhs = mapValue(valueMap, binary->rhs);
+        newIns = make_shared<BinaryInstruction>(binary->op, lhs, rhs, bb);
+        user_use(newIns, {lhs, rhs});
+        break;
+    }
+    case ALLOC:
+    {
+        shared_ptr<AllocInstruction> alloc = s_p_c<AllocInstruction>(ins);
+        newIns = make_shared<AllocInstruction>(alloc->name, alloc->bytes, alloc->units, bb);
+        break;
+    }
+    case STORE:
+    {
+        shared_ptr<StoreInstruction> store = s_p_c<StoreInstruction>(ins);
+        shared_ptr<Value> value = mapValue(valueMap, store->value);
+        shared_ptr<Value> address = mapValue(valueMap, store->address);
+        shared_ptr<Value> offset = mapValue(valueMap, store->offset);
+        newIns = make_shared<StoreInstruction>(value, address, offset, bb);
+        user_use(newIns, {value, address, offset});
+        break;
+    }
+    case LOAD:
+    {
+        shared_ptr<LoadInstruction> load = s_p_c<LoadInstruction>(ins);
+        shared_ptr<Value> address = mapValue(valueMap, load->address);
+        shared_ptr<Value> offset = mapValue(valueMap, load->offset);
+        newIns = make_shared<LoadInstruction>(address, offset, bb);
+        user_use(newIns, {address, offset});
+        break;
+    }
+    default:
+        cerr << "Error occurs in process clone instruction: invalid instruction type." << endl;
+        return nullptr;
     }
+    newIns->type = ins->type;  // 比较可能已被改为二元运算
+    newIns->resultType = ins->resultType;
+    newIns->caughtVarName = ins->caughtVarName;
+    return newIns;
 }
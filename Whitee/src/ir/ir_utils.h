@@ -21,6 +21,12 @@ extern void user_use(const shared_ptr<Value> &user, initializer_list<shared_ptr<
 
 extern void user_use(const shared_ptr<Value> &user, const vector<shared_ptr<Value>> &used);
 
+extern shared_ptr<Value> mapValue(unordered_map<shared_ptr<Value>, shared_ptr<Value>> &valueMap, const shared_ptr<Value> &value);
+
+extern shared_ptr<Instruction> cloneInstruction(shared_ptr<Instruction> &ins, shared_ptr<BasicBlock> &bb,
+                                                unordered_map<shared_ptr<Value>, shared_ptr<Value>> &valueMap,
+                                                unordered_map<shared_ptr<BasicBlock>, shared_ptr<BasicBlock>> &blockMap);
+
 // used in ir built finished.
 extern void removePhiUserBlocksAndMultiCmp(shared_ptr<Module> &module);
 
@@ -0,0 +1,829 @@
+﻿/*********************************************************************
+ * @file   ir_vector.cpp
+ * @brief  向量化分析：识别可用NEON处理的计数循环，以及块内可打包的直线代码（SLP）
+ * 
+ * @date   October 2026
+ *********************************************************************/
+#include "ir_vector.h"
+
+#include <algorithm>
+
+/**
+ * @brief 识别可向量化的循环：循环头（及其后的回边块）构成的计数循环，访问的数组下标为 iv + 常数，运算只有加、减、乘，
+ *        其他跨迭代的值只能是线性phi与累加；并为向量值分配Q寄存器
+ * @param loop 
+ * @param aliasAnalysis 
+ * @param vectorLoop 识别结果
+ * @return 是否可以向量化
+ */
+bool VectorLoop::analyse(shared_ptr<Loop> &loop, AliasAnalysis &aliasAnalysis, VectorLoop &vectorLoop)
+{
+    if (!loop->children.empty() || loop->latches.size() != 1 || loop->preheader == nullptr || loop->header->predecessors.size() != 2)
+        return false;
+    vectorLoop.header = loop->header;
+    vectorLoop.latch = loop->latches.front();
+    vectorLoop.preheader = loop->preheader;
+    vectorLoop.instructions = vectorLoop.header->instructions;
+    if (vectorLoop.latch != vectorLoop.header)  // 循环头直接跳转到只有它一个前驱的回边块
+    {
+        shared_ptr<Instruction> jump = vectorLoop.header->instructions.back();
+        if (loop->blocks.size() != 2 || jump->type != JMP || s_p_c<JumpInstruction>(jump)->targetBlock != vectorLoop.latch ||
+            vectorLoop.latch->predecessors.size() != 1)
+            return false;
+        vectorLoop.instructions.pop_back();
+        vectorLoop.instructions.insert(vectorLoop.instructions.end(), vectorLoop.latch->instructions.begin(), vectorLoop.latch->instructions.end());
+    }
+    if (!vectorLoop.analyseInduction(loop) || !vectorLoop.analysePhis(loop))
+        return false;
+    unsigned int streamCount = 0;
+    for (auto &ins : vectorLoop.instructions)
+    {
+        if (ins->type == INVOKE || ins->type == ALLOC || ins->type == RET)
+            return false;
+        if (ins->type != STORE)
+            continue;
+        shared_ptr<StoreInstruction> store = s_p_c<StoreInstruction>(ins);
+        shared_ptr<Value> base;
+        int constant;
+        if (!isInvariant(store->address, loop) || !vectorLoop.getStreamOffset(store->offset, loop, base, constant) || !vectorLoop.markVector(store->value, loop))
+            return false;
+        vectorLoop.streamOffsets[ins] = constant;
+        vectorLoop.streamBases[ins] = base;
+        vectorLoop.marked.insert(ins);
+    }
+    for (auto &phi : vectorLoop.reductions)
+    {
+        shared_ptr<BinaryInstruction> update = s_p_c<BinaryInstruction>(phi->operands.at(vectorLoop.latch));
+        shared_ptr<Value> value = update->lhs == phi ? update->rhs : update->lhs;
+        shared_ptr<Instruction> multiply;
+        if (update->op == "+" && value->value_type == INSTRUCTION && loop->contains(s_p_c<Instruction>(value)->block))
+            multiply = s_p_c<Instruction>(value);
+        if (multiply != nullptr && multiply->type == BINARY && s_p_c<BinaryInstruction>(multiply)->op == "*" && multiply->users.size() == 1)
+        {
+            // s + a * b 合并为一条乘加
+            if (!vectorLoop.markVector(s_p_c<BinaryInstruction>(multiply)->lhs, loop) || !vectorLoop.markVector(s_p_c<BinaryInstruction>(multiply)->rhs, loop))
+                return false;
+            vectorLoop.fusedMultiplies[update] = multiply;
+        }
+        else if (!vectorLoop.markVector(value, loop))
+            return false;
+        vectorLoop.marked.insert(update);
+    }
+    for (auto &ins : vectorLoop.instructions)
+    {
+        if (vectorLoop.marked.count(ins) == 0 || ins->type == PHI)  // 线性phi在循环前展开
+            continue;
+        vectorLoop.body.push_back(ins);
+        if (ins->type == LOAD || ins->type == STORE)
+            ++streamCount;
+    }
+    if (streamCount == 0 || streamCount > _VECTOR_MAX_STREAMS)
+        return false;
+    return vectorLoop.checkDependence(aliasAnalysis) && vectorLoop.allocVectorRegs();
+}
+
+/**
+ * @brief 值是否为循环不变量：非指令，或定义在循环外的指令
+ * @param value 
+ * @param loop 
+ * @return 
+ */
+bool VectorLoop::isInvariant(const shared_ptr<Value> &value, shared_ptr<Loop> &loop)
+{
+    if (value->value_type != INSTRUCTION)
+        return value->value_type != UNDEFINED;
+    return !loop->contains(s_p_c<Instruction>(value)->block);
+}
+
+/**
+ * @brief 识别归纳变量：回边块末尾的分支条件为 iv + 1 < bound（或<=）且为真时回到循环头
+ * @param loop 
+ * @return 
+ */
+bool VectorLoop::analyseInduction(shared_ptr<Loop> &loop)
+{
+    shared_ptr<Instruction> last = latch->instructions.back();
+    if (last->type != BR)
+        return false;
+    shared_ptr<BranchInstruction> br = s_p_c<BranchInstruction>(last);
+    if (br->trueBlock != header || br->condition->value_type != INSTRUCTION || s_p_c<Instruction>(br->condition)->type != CMP)
+        return false;
+    shared_ptr<BinaryInstruction> cmp = s_p_c<BinaryInstruction>(br->condition);
+    shared_ptr<Value> next;
+    if (isInvariant(cmp->rhs, loop))
+        next = cmp->lhs, bound = cmp->rhs, op = cmp->op;
+    else if (isInvariant(cmp->lhs, loop))
+        next = cmp->rhs, bound = cmp->lhs, op = BinaryInstruction::swapOpConst(cmp->op);
+    else
+        return false;
+    if ((op != "<" && op != "<=") || next->value_type != INSTRUCTION || s_p_c<Instruction>(next)->type != BINARY)
+        return false;
+    shared_ptr<BinaryInstruction> increment = s_p_c<BinaryInstruction>(next);
+    shared_ptr<Value> base;
+    if (increment->op == "+" && increment->rhs == Number(1))
+        base = increment->lhs;
+    else if (increment->op == "+" && increment->lhs == Number(1))
+        base = increment->rhs;
+    else
+        return false;
+    if (base->value_type != INSTRUCTION || s_p_c<Instruction>(base)->type != PHI || s_p_c<Instruction>(base)->block != header)
+        return false;
+    iv = s_p_c<PhiInstruction>(base);
+    return iv->operands.count(latch) != 0 && iv->operands.at(latch) == next;
+}
+
+/**
+ * @brief 识别循环头的其他phi：线性phi（每次迭代加常数）与累加（s = s + x，s只被此运算使用）
+ * @param loop 
+ * @return 是否所有phi都能识别
+ */
+bool VectorLoop::analysePhis(shared_ptr<Loop> &loop)
+{
+    for (auto &phi : header->phis)
+    {
+        if (phi->operands.size() != 2 || phi->operands.count(preheader) == 0 || phi->operands.count(latch) == 0)
+            return false;
+        if (phi == iv)
+        {
+            linearSteps[phi] = 1;
+            continue;
+        }
+        shared_ptr<Value> next = phi->operands.at(latch);
+        if (next->value_type != INSTRUCTION || s_p_c<Instruction>(next)->type != BINARY || !loop->contains(s_p_c<Instruction>(next)->block))
+            return false;
+        shared_ptr<BinaryInstruction> update = s_p_c<BinaryInstruction>(next);
+        if (update->op == "+" && update->lhs == phi && update->rhs->value_type == NUMBER)
+        {
+            linearSteps[phi] = s_p_c<NumberValue>(update->rhs)->number;
+            continue;
+        }
+        if (update->op == "+" && update->rhs == phi && update->lhs->value_type == NUMBER)
+        {
+            linearSteps[phi] = s_p_c<NumberValue>(update->lhs)->number;
+            continue;
+        }
+        if (!((update->op == "+" && (update->lhs == phi) != (update->rhs == phi)) || (update->op == "-" && update->lhs == phi && update->rhs != phi)))
+            return false;
+        for (auto &user : phi->users)  // 循环内只被累加使用，各次迭代的中间值不需要
+        {
+            if (user != update && loop->contains(s_p_c<Instruction>(user)->block))
+                return false;
+        }
+        for (auto &user : update->users)
+        {
+            if (user != phi && loop->contains(s_p_c<Instruction>(user)->block))
+                return false;
+        }
+        reductions.push_back(phi);
+    }
+    return true;
+}
+
+/**
+ * @brief 标记需要向量化的值：循环不变量广播，线性phi展开为各通道的值，load与运算逐条向量化
+ * @param value 
+ * @param loop 
+ * @return 能否向量化
+ */
+bool VectorLoop::markVector(const shared_ptr<Value> &value, shared_ptr<Loop> &loop)
+{
+    if (isInvariant(value, loop))
+    {
+        if (find(invariants.begin(), invariants.end(), value) == invariants.end())
+            invariants.push_back(value);
+        return true;
+    }
+    if (value->value_type != INSTRUCTION)
+        return false;
+    shared_ptr<Instruction> ins = s_p_c<Instruction>(value);
+    if (marked.count(ins) != 0)
+        return true;
+    switch (ins->type)
+    {
+    case PHI:
+    {
+        shared_ptr<PhiInstruction> phi = s_p_c<PhiInstruction>(ins);
+        if (linearSteps.count(phi) == 0)
+            return false;
+        inductions.emplace_back(phi, linearSteps.at(phi));
+        marked.insert(ins);
+        return true;
+    }
+    case LOAD:
+    {
+        shared_ptr<LoadInstruction> load = s_p_c<LoadInstruction>(ins);
+        shared_ptr<Value> base;
+        int constant;
+        if (!isInvariant(load->address, loop) || !getStreamOffset(load->offset, loop, base, constant))
+            return false;
+        streamOffsets[ins] = constant;
+        streamBases[ins] = base;
+        marked.insert(ins);
+        return true;
+    }
+    case BINARY:
+    {
+        shared_ptr<BinaryInstruction> binary = s_p_c<BinaryInstruction>(ins);
+        if (binary->op != "+" && binary->op != "-" && binary->op != "*")
+            return false;
+        if (!markVector(binary->lhs, loop) || !markVector(binary->rhs, loop))
+            return false;
+        marked.insert(ins);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief 下标是否为 iv + 常数 或 iv + 不变量（如二维数组的行首）
+ * @param offset 下标（字）
+ * @param loop 
+ * @param base 不变量，没有则为nullptr
+ * @param constant 常数
+ * @return 
+ */
+bool VectorLoop::getStreamOffset(const shared_ptr<Value> &offset, shared_ptr<Loop> &loop, shared_ptr<Value> &base, int &constant)
+{
+    base = nullptr;
+    constant = 0;
+    if (offset == iv)
+        return true;
+    if (offset->value_type != INSTRUCTION || s_p_c<Instruction>(offset)->type != BINARY)
+        return false;
+    shared_ptr<BinaryInstruction> binary = s_p_c<BinaryInstruction>(offset);
+    shared_ptr<Value> other;
+    if (binary->op == "+" && binary->lhs == iv)
+        other = binary->rhs;
+    else if (binary->op == "+" && binary->rhs == iv)
+        other = binary->lhs;
+    else if (binary->op == "-" && binary->lhs == iv && binary->rhs->value_type == NUMBER)
+    {
+        constant = -s_p_c<NumberValue>(binary->rhs)->number;
+        return true;
+    }
+    else
+        return false;
+    if (other->value_type == NUMBER)
+        constant = s_p_c<NumberValue>(other)->number;
+    else if (isInvariant(other, loop))
+        base = other;
+    else
+        return false;
+    return true;
+}
+
+/**
+ * @brief 检查store与其他访问的依赖：同一地址的距离为0或不小于向量宽度；距离为负时load须在store之前；
+ *        不同地址须不重叠
+ * @param aliasAnalysis 
+ * @return 向量化后是否保持原有的读写顺序
+ */
+bool VectorLoop::checkDependence(AliasAnalysis &aliasAnalysis)
+{
+    vector<shared_ptr<Instruction>> accesses;
+    for (auto &ins : body)
+    {
+        if (ins->type == LOAD || ins->type == STORE)
+            accesses.push_back(ins);
+    }
+    for (unsigned int i = 0; i < accesses.size(); ++i)
+    {
+        if (accesses.at(i)->type != STORE)
+            continue;
+        shared_ptr<Value> address = s_p_c<StoreInstruction>(accesses.at(i))->address;
+        for (unsigned int j = 0; j < accesses.size(); ++j)
+        {
+            if (i == j)
+                continue;
+            shared_ptr<Instruction> other = accesses.at(j);
+            shared_ptr<Value> otherAddress = other->type == LOAD ? s_p_c<LoadInstruction>(other)->address : s_p_c<StoreInstruction>(other)->address;
+            if (address != otherAddress)
+            {
+                if (aliasAnalysis.alias(AliasAnalysis::getLocation(address, nullptr), AliasAnalysis::getLocation(otherAddress, nullptr)) != NO_ALIAS)
+                    return false;
+                continue;
+            }
+            if (streamBases.at(accesses.at(i)) != streamBases.at(other))  // 不同的行无法比较距离
+                return false;
+            int distance = streamOffsets.at(accesses.at(i)) - streamOffsets.at(other);
+            if (distance == 0 || distance >= (int)_VECTOR_WIDTH || distance <= -(int)_VECTOR_WIDTH)
+                continue;
+            if (other->type == LOAD && distance < 0 && j < i)
+                continue;
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 分配Q寄存器：广播的不变量、线性phi及其增量、累加值在整个向量循环中占用，
+ *        循环体中的值在最后一次使用后释放
+ * @return Q寄存器是否足够
+ */
+bool VectorLoop::allocVectorRegs()
+{
+    vector<int> freeRegs(begin(_VECTOR_Q_REGS), end(_VECTOR_Q_REGS));
+    reverse(freeRegs.begin(), freeRegs.end());
+    unsigned int persistent = invariants.size() + inductions.size() * 2 + reductions.size();
+    if (persistent > freeRegs.size())
+        return false;
+    for (auto &value : invariants)
+    {
+        vectorRegs[value] = freeRegs.back();
+        freeRegs.pop_back();
+    }
+    for (auto &induction : inductions)
+    {
+        vectorRegs[induction.first] = freeRegs.back();
+        freeRegs.pop_back();
+        stepRegs[induction.first] = freeRegs.back();
+        freeRegs.pop_back();
+    }
+    for (auto &phi : reductions)
+    {
+        vectorRegs[phi] = freeRegs.back();
+        vectorRegs[phi->operands.at(latch)] = freeRegs.back();
+        freeRegs.pop_back();
+    }
+    unordered_map<shared_ptr<Value>, unsigned int> lastUse;
+    vector<vector<shared_ptr<Value>>> operands(body.size());
+    for (unsigned int i = 0; i < body.size(); ++i)
+    {
+        shared_ptr<Instruction> ins = body.at(i);
+        if (ins->type == STORE)
+            operands.at(i).push_back(s_p_c<StoreInstruction>(ins)->value);
+        else if (fusedMultiplies.count(ins) != 0)
+        {
+            operands.at(i).push_back(s_p_c<BinaryInstruction>(fusedMultiplies.at(ins))->lhs);
+            operands.at(i).push_back(s_p_c<BinaryInstruction>(fusedMultiplies.at(ins))->rhs);
+        }
+        else if (ins->type == BINARY)
+        {
+            operands.at(i).push_back(s_p_c<BinaryInstruction>(ins)->lhs);
+            operands.at(i).push_back(s_p_c<BinaryInstruction>(ins)->rhs);
+        }
+        for (auto &operand : operands.at(i))
+            lastUse[operand] = i;
+    }
+    for (unsigned int i = 0; i < body.size(); ++i)
+    {
+        shared_ptr<Instruction> ins = body.at(i);
+        for (auto &operand : operands.at(i))
+        {
+            // 循环体中定义的值最后一次使用后，其寄存器可作为本条指令的结果
+            if (lastUse.at(operand) == i && operand->value_type == INSTRUCTION && s_p_c<Instruction>(operand)->type != PHI
+                && vectorRegs.count(operand) != 0 && find(invariants.begin(), invariants.end(), operand) == invariants.end())
+            {
+                freeRegs.push_back(vectorRegs.at(operand));
+                lastUse[operand] = body.size();  // 同一值作为两个操作数时只释放一次
+            }
+        }
+        if (ins->type == STORE || vectorRegs.count(ins) != 0)
+            continue;
+        if (freeRegs.empty())
+            return false;
+        vectorRegs[ins] = freeRegs.back();
+        freeRegs.pop_back();
+    }
+    return true;
+}
+
+/**
+ * @brief 按下标常数部分排序store
+ * @param a 
+ * @param b 
+ * @return 
+ */
+static bool compareSlpStore(const pair<int, shared_ptr<Instruction>> &a, const pair<int, shared_ptr<Instruction>> &b)
+{
+    return a.first < b.first;
+}
+
+/**
+ * @brief 在块中寻找SLP打包：按地址与下标中非常数部分将store分组，常数连续的_VECTOR_WIDTH个store作为根，
+ *        自底向上匹配同构的表达式树
+ * @param bb 
+ * @param aliasAnalysis 
+ * @param packs 找到的打包，互不相交
+ */
+void SlpPack::analyse(shared_ptr<BasicBlock> &bb, AliasAnalysis &aliasAnalysis, vector<shared_ptr<SlpPack>> &packs)
+{
+    unordered_map<shared_ptr<Instruction>, unsigned int> positions;
+    vector<pair<pair<shared_ptr<Value>, shared_ptr<Value>>, vector<pair<int, shared_ptr<Instruction>>>>> groups;
+    for (unsigned int i = 0; i < bb->instructions.size(); ++i)
+    {
+        shared_ptr<Instruction> ins = bb->instructions.at(i);
+        positions[ins] = i;
+        if (ins->type != STORE)
+            continue;
+        shared_ptr<StoreInstruction> store = s_p_c<StoreInstruction>(ins);
+        shared_ptr<Value> index;
+        int constant;
+        decomposeOffset(store->offset, index, constant);
+        pair<shared_ptr<Value>, shared_ptr<Value>> key(store->address, index);
+        auto group = groups.begin();
+        while (group != groups.end() && group->first != key)
+            ++group;
+        if (group == groups.end())
+        {
+            groups.emplace_back(key, vector<pair<int, shared_ptr<Instruction>>>());
+            group = groups.end() - 1;
+        }
+        group->second.emplace_back(constant, ins);
+    }
+    unordered_set<shared_ptr<Instruction>> claimed;
+    for (auto &group : groups)
+    {
+        vector<pair<int, shared_ptr<Instruction>>> &stores = group.second;
+        if (stores.size() < _VECTOR_WIDTH)
+            continue;
+        stable_sort(stores.begin(), stores.end(), compareSlpStore);
+        bool duplicated = false;  // 同一位置写多次，不打包
+        for (unsigned int i = 1; i < stores.size(); ++i)
+            duplicated = duplicated || stores.at(i).first == stores.at(i - 1).first;
+        if (duplicated)
+            continue;
+        unsigned int i = 0;
+        while (i + _VECTOR_WIDTH <= stores.size())
+        {
+            if (stores.at(i + _VECTOR_WIDTH - 1).first - stores.at(i).first != (int)_VECTOR_WIDTH - 1)
+            {
+                ++i;
+                continue;
+            }
+            shared_ptr<SlpPack> pack = make_shared<SlpPack>();
+            pack->positions = &positions;
+            pack->claimed = &claimed;
+            vector<shared_ptr<Value>> lanes, values;
+            for (unsigned int k = 0; k < _VECTOR_WIDTH; ++k)
+            {
+                shared_ptr<StoreInstruction> store = s_p_c<StoreInstruction>(stores.at(i + k).second);
+                lanes.push_back(store);
+                values.push_back(store->value);
+                if (pack->position == nullptr || positions.at(store) > positions.at(pack->position))
+                    pack->position = store;
+            }
+            pack->root = make_shared<SlpNode>(SLP_STORE, lanes);
+            shared_ptr<SlpNode> value;
+            if (pack->buildMemoryNode(pack->root))
+                value = pack->buildNode(values, bb, 0);
+            if (value == nullptr)
+            {
+                ++i;
+                continue;
+            }
+            pack->root->operands.push_back(value);
+            pack->nodes.push_back(pack->root);
+            pack->findKept();
+            bool valid = pack->nodes.size() <= sizeof(_VECTOR_Q_REGS) / sizeof(_VECTOR_Q_REGS[0]);
+            for (auto &ins : pack->packed)
+            {
+                if (pack->kept.count(ins) == 0)
+                    pack->replaced.insert(ins);
+            }
+            vector<shared_ptr<Instruction>> replaced(pack->replaced.begin(), pack->replaced.end());
+            for (auto &ins : replaced)
+                valid = valid && pack->absorbOperands(ins);
+            if (!valid || !pack->checkMemoryOrder(bb, aliasAnalysis) || !pack->isProfitable())
+            {
+                ++i;
+                continue;
+            }
+            for (unsigned int k = 0; k < pack->nodes.size(); ++k)
+                pack->nodes.at(k)->reg = _VECTOR_Q_REGS[k];
+            claimed.insert(pack->packed.begin(), pack->packed.end());
+            claimed.insert(pack->replaced.begin(), pack->replaced.end());
+            packs.push_back(pack);
+            i += _VECTOR_WIDTH;
+        }
+    }
+}
+
+/**
+ * @brief 下标分解为 index + constant，沿加减常数的运算向上查找
+ * @param offset 下标
+ * @param index 非常数的部分，没有为nullptr
+ * @param constant 常数的部分
+ */
+void SlpPack::decomposeOffset(const shared_ptr<Value> &offset, shared_ptr<Value> &index, int &constant)
+{
+    index = offset;
+    constant = 0;
+    while (index->value_type == INSTRUCTION && s_p_c<Instruction>(index)->type == BINARY)
+    {
+        shared_ptr<BinaryInstruction> binary = s_p_c<BinaryInstruction>(index);
+        if ((binary->op == "+" || binary->op == "-") && binary->rhs->value_type == NUMBER)
+        {
+            constant += binary->op == "+" ? s_p_c<NumberValue>(binary->rhs)->number : -s_p_c<NumberValue>(binary->rhs)->number;
+            index = binary->lhs;
+        }
+        else if (binary->op == "+" && binary->lhs->value_type == NUMBER)
+        {
+            constant += s_p_c<NumberValue>(binary->lhs)->number;
+            index = binary->rhs;
+        }
+        else
+            break;
+    }
+    if (index->value_type == NUMBER)
+    {
+        constant += s_p_c<NumberValue>(index)->number;
+        index = nullptr;
+    }
+}
+
+/**
+ * @brief 为各通道的值构建向量值：相同的值广播；同构的load、运算打包；否则逐个插入
+ * @param lanes 各通道的值
+ * @param bb 
+ * @param depth 表达式树的深度
+ * @return 向量值；通道中有只能使用一次的临时值而无法打包时为nullptr
+ */
+shared_ptr<SlpNode> SlpPack::buildNode(vector<shared_ptr<Value>> &lanes, shared_ptr<BasicBlock> &bb, unsigned int depth)
+{
+    bool same = true, isomorphic = depth < _SLP_MAX_DEPTH;
+    unordered_set<shared_ptr<Value>> distinct(lanes.begin(), lanes.end());
+    for (auto &lane : lanes)
+    {
+        same = same && lane == lanes.front();
+        if (lane->value_type != INSTRUCTION)
+        {
+            isomorphic = false;
+            continue;
+        }
+        shared_ptr<Instruction> ins = s_p_c<Instruction>(lane);
+        shared_ptr<Instruction> first = lanes.front()->value_type == INSTRUCTION ? s_p_c<Instruction>(lanes.front()) : nullptr;
+        if (ins->block != bb || claimed->count(ins) != 0 || packed.count(ins) != 0 || first == nullptr || ins->type != first->type)
+            isomorphic = false;
+        else if (ins->type == BINARY && s_p_c<BinaryInstruction>(ins)->op != s_p_c<BinaryInstruction>(first)->op)
+            isomorphic = false;
+    }
+    isomorphic = isomorphic && distinct.size() == lanes.size();
+    shared_ptr<SlpNode> node;
+    if (same)
+        node = make_shared<SlpNode>(SLP_SPLAT, lanes);
+    else if (isomorphic && s_p_c<Instruction>(lanes.front())->type == LOAD)
+    {
+        node = make_shared<SlpNode>(SLP_LOAD, lanes);
+        if (!buildMemoryNode(node))
+            node = nullptr;
+    }
+    else if (isomorphic && s_p_c<Instruction>(lanes.front())->type == BINARY)
+    {
+        string op = s_p_c<BinaryInstruction>(lanes.front())->op;
+        if (op == "+" || op == "-" || op == "*")
+        {
+            // 子树打包失败时回退，整体逐个插入
+            unsigned int nodeCount = nodes.size(), inputCount = inputs.size();
+            unordered_set<shared_ptr<Instruction>> packedBefore = packed;
+            for (auto &lane : lanes)
+                packed.insert(s_p_c<Instruction>(lane));
+            vector<shared_ptr<Value>> lhs, rhs;
+            for (auto &lane : lanes)
+            {
+                lhs.push_back(s_p_c<BinaryInstruction>(lane)->lhs);
+                rhs.push_back(s_p_c<BinaryInstruction>(lane)->rhs);
+            }
+            shared_ptr<SlpNode> left = buildNode(lhs, bb, depth + 1);
+            shared_ptr<SlpNode> right = left == nullptr ? nullptr : buildNode(rhs, bb, depth + 1);
+            if (right != nullptr)
+            {
+                node = make_shared<SlpNode>(SLP_BINARY, lanes);
+                node->op = op;
+                node->operands.push_back(left);
+                node->operands.push_back(right);
+            }
+            else
+            {
+                nodes.resize(nodeCount);
+                inputs.resize(inputCount);
+                packed = packedBefore;
+            }
+        }
+    }
+    if (node == nullptr)
+        node = make_shared<SlpNode>(SLP_GATHER, lanes);
+    if (node->kind == SLP_SPLAT || node->kind == SLP_GATHER)
+    {
+        for (auto &lane : lanes)
+        {
+            if (lane->value_type == UNDEFINED || (lane->value_type == INSTRUCTION && s_p_c<Instruction>(lane)->resultType == R_VAL_RESULT))
+                return nullptr;  // 临时值在使用处才生成，无法推迟读取
+            addInput(lane);
+        }
+    }
+    nodes.push_back(node);
+    return node;
+}
+
+/**
+ * @brief 连续访问的load或store：各通道地址相同，下标的常数部分依次加一
+ * @param node 
+ * @return 
+ */
+bool SlpPack::buildMemoryNode(shared_ptr<SlpNode> &node)
+{
+    for (unsigned int i = 0; i < node->lanes.size(); ++i)
+    {
+        shared_ptr<Instruction> ins = s_p_c<Instruction>(node->lanes.at(i));
+        shared_ptr<Value> address = ins->type == LOAD ? s_p_c<LoadInstruction>(ins)->address : s_p_c<StoreInstruction>(ins)->address;
+        shared_ptr<Value> offset = ins->type == LOAD ? s_p_c<LoadInstruction>(ins)->offset : s_p_c<StoreInstruction>(ins)->offset;
+        shared_ptr<Value> index;
+        int constant;
+        decomposeOffset(offset, index, constant);
+        if (i == 0)
+        {
+            node->address = address;
+            node->index = index;
+            node->constant = constant;
+        }
+        else if (address != node->address || index != node->index || constant != node->constant + (int)i)
+            return false;
+    }
+    for (auto &value : {node->address, node->index})
+    {
+        if (value != nullptr && value->value_type == INSTRUCTION && s_p_c<Instruction>(value)->resultType == R_VAL_RESULT)
+            return false;
+    }
+    for (auto &lane : node->lanes)
+        packed.insert(s_p_c<Instruction>(lane));
+    addInput(node->address);
+    if (node->index != nullptr)
+        addInput(node->index);
+    return true;
+}
+
+/**
+ * @brief 记录在生成位置读入的标量值
+ * @param value 
+ */
+void SlpPack::addInput(const shared_ptr<Value> &value)
+{
+    if (find(inputs.begin(), inputs.end(), value) == inputs.end())
+        inputs.push_back(value);
+}
+
+/**
+ * @brief 打包以外仍使用的值（及计算它的打包指令）照常按标量生成，打包只是额外计算一次
+ */
+void SlpPack::findKept()
+{
+    vector<shared_ptr<Instruction>> worklist;
+    for (auto &ins : packed)
+    {
+        if (ins->type == STORE)
+            continue;
+        for (auto &user : ins->users)
+        {
+            if (user->value_type != INSTRUCTION || packed.count(s_p_c<Instruction>(user)) == 0)
+            {
+                worklist.push_back(ins);
+                break;
+            }
+        }
+    }
+    for (auto &input : inputs)
+    {
+        if (input->value_type == INSTRUCTION && packed.count(s_p_c<Instruction>(input)) != 0)
+            worklist.push_back(s_p_c<Instruction>(input));
+    }
+    while (!worklist.empty())
+    {
+        shared_ptr<Instruction> ins = worklist.back();
+        worklist.pop_back();
+        if (!kept.insert(ins).second || ins->type != BINARY)
+            continue;
+        for (auto &operand : {s_p_c<BinaryInstruction>(ins)->lhs, s_p_c<BinaryInstruction>(ins)->rhs})
+        {
+            if (operand->value_type == INSTRUCTION && packed.count(s_p_c<Instruction>(operand)) != 0)
+                worklist.push_back(s_p_c<Instruction>(operand));
+        }
+    }
+}
+
+/**
+ * @brief 不再生成的指令所用的临时值只能在使用处生成，须一并不再生成；
+ *        只被不再生成的指令使用的左值（如各通道的下标）也不再生成
+ * @param ins 
+ * @return 临时值另有使用者时为false
+ */
+bool SlpPack::absorbOperands(const shared_ptr<Instruction> &ins)
+{
+    vector<shared_ptr<Value>> operands;
+    if (ins->type == LOAD)
+        operands = {s_p_c<LoadInstruction>(ins)->address, s_p_c<LoadInstruction>(ins)->offset};
+    else if (ins->type == STORE)
+        operands = {s_p_c<StoreInstruction>(ins)->value, s_p_c<StoreInstruction>(ins)->address, s_p_c<StoreInstruction>(ins)->offset};
+    else if (ins->type == BINARY)
+        operands = {s_p_c<BinaryInstruction>(ins)->lhs, s_p_c<BinaryInstruction>(ins)->rhs};
+    else if (ins->type == UNARY)
+        operands = {s_p_c<UnaryInstruction>(ins)->value};
+    for (auto &operand : operands)
+    {
+        if (operand->value_type != INSTRUCTION)
+            continue;
+        shared_ptr<Instruction> temp = s_p_c<Instruction>(operand);
+        if (replaced.count(temp) != 0)
+            continue;
+        bool temporary = temp->resultType == R_VAL_RESULT;
+        bool absorbable = temp->block == ins->block && (temp->type == BINARY || temp->type == UNARY) && claimed->count(temp) == 0 && packed.count(temp) == 0
+                          && find(inputs.begin(), inputs.end(), operand) == inputs.end();
+        for (auto &user : temp->users)
+            absorbable = absorbable && user->value_type == INSTRUCTION && replaced.count(s_p_c<Instruction>(user)) != 0;
+        if (!absorbable)
+        {
+            if (temporary)
+                return false;
+            continue;
+        }
+        unordered_set<shared_ptr<Instruction>> replacedBefore = replaced;
+        replaced.insert(temp);
+        if (!absorbOperands(temp))
+        {
+            if (temporary)
+                return false;
+            replaced = replacedBefore;  // 左值照常生成
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief load推迟到生成位置，之间不能有写其位置的指令，也不能读到打包中在它之前的store；
+ *        store推迟到生成位置，之间不能有读写其位置的标量指令
+ * @param bb 
+ * @param aliasAnalysis 
+ * @return 
+ */
+bool SlpPack::checkMemoryOrder(shared_ptr<BasicBlock> &bb, AliasAnalysis &aliasAnalysis)
+{
+    unsigned int end = positions->at(position);
+    for (auto &ins : packed)
+    {
+        if (ins->type != LOAD && ins->type != STORE)
+            continue;
+        unsigned int begin = positions->at(ins);
+        MemoryLocation location = AliasAnalysis::getLocation(ins);
+        if (ins->type == LOAD)
+        {
+            for (unsigned int i = begin + 1; i < end; ++i)
+            {
+                shared_ptr<Instruction> &other = bb->instructions.at(i);
+                if (!(other->type == STORE && packed.count(other) != 0) && aliasAnalysis.mayModify(other, location))
+                    return false;
+            }
+            for (auto &store : packed)
+            {
+                if (store->type == STORE && positions->at(store) < begin && aliasAnalysis.alias(location, AliasAnalysis::getLocation(store)) != NO_ALIAS)
+                    return false;
+            }
+        }
+        else
+        {
+            for (unsigned int i = begin + 1; i < end; ++i)
+            {
+                shared_ptr<Instruction> &other = bb->instructions.at(i);
+                if (packed.count(other) != 0 && replaced.count(other) != 0)
+                    continue;
+                if (aliasAnalysis.mayModify(other, location) || aliasAnalysis.mayRead(other, location))
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 收益估计：不再生成的标量指令数与向量指令数（含打包插入）比较；仍需标量生成的值不计收益
+ * @return 
+ */
+bool SlpPack::isProfitable()
+{
+    int scalarCost = 0, vectorCost = 0;
+    for (auto &ins : replaced)
+        scalarCost += ins->type == LOAD || ins->type == STORE ? 2 : 1;
+    for (auto &node : nodes)
+    {
+        switch (node->kind)
+        {
+        case SLP_LOAD:
+        case SLP_STORE:
+            vectorCost += node->index == nullptr ? 3 : 4;
+            break;
+        case SLP_BINARY:
+            vectorCost += 1;
+            break;
+        case SLP_SPLAT:
+            vectorCost += 2;
+            break;
+        case SLP_GATHER:
+            vectorCost += 2 * (int)_VECTOR_WIDTH;
+            break;
+        }
+    }
+    return vectorCost < scalarCost;
+}
+
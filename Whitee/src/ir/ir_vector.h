@@ -0,0 +1,126 @@
+﻿#ifndef COMPILER_IR_VECTOR_H
+#define COMPILER_IR_VECTOR_H
+
+#include "ir.h"
+#include "ir_loop.h"
+#include "ir_alias.h"
+
+const unsigned int _VECTOR_WIDTH = 4;        // 一个Q寄存器中32位整数的个数
+const unsigned int _VECTOR_MAX_STREAMS = 6;  // 向量化循环中连续访问数组的最多个数，每个占用一个地址寄存器
+const int _VECTOR_Q_REGS[] = {0, 1, 2, 3, 8, 9, 10, 11, 12, 13, 14, 15};  // 可用的Q寄存器，Q4-Q7由被调用者保存
+const unsigned int _SLP_MAX_DEPTH = 6;        // SLP打包的表达式树的最大深度
+
+/**
+ * 向量化循环：只有一个块（或循环头加回边块）的计数循环，归纳变量步长为1；在前置块末尾执行向量循环，每次处理_VECTOR_WIDTH次迭代，
+ * 再以更新后的归纳变量、累加值进入原循环完成余下的迭代（至少一次）
+ */
+class VectorLoop
+{
+public:
+    shared_ptr<BasicBlock> header;
+    shared_ptr<BasicBlock> latch;  // 与循环头相同，或为循环头直接跳转到的块
+    shared_ptr<BasicBlock> preheader;
+    shared_ptr<PhiInstruction> iv;
+    shared_ptr<Value> bound;  // ivNext op bound 为真时继续
+    string op;                // "<" 或 "<="
+
+    vector<shared_ptr<Instruction>> body;                            // 需要向量化的load、store、运算及累加，程序顺序
+    unordered_map<shared_ptr<PhiInstruction>, int> linearSteps;      // 线性phi（包括归纳变量）--> 步长
+    unordered_map<shared_ptr<Instruction>, int> streamOffsets;       // load、store --> 下标 iv + 常数 中的常数
+    unordered_map<shared_ptr<Instruction>, shared_ptr<Value>> streamBases;  // load、store --> 下标 iv + 不变量 中的不变量
+    vector<shared_ptr<Value>> invariants;                            // 需要广播到各通道的循环不变量
+    vector<pair<shared_ptr<PhiInstruction>, int>> inductions;        // 作为向量使用的线性phi及其步长
+    vector<shared_ptr<PhiInstruction>> reductions;                   // 累加的phi
+    unordered_map<shared_ptr<Instruction>, shared_ptr<Instruction>> fusedMultiplies;  // 累加 --> 合并为乘加的乘法
+    unordered_map<shared_ptr<Value>, int> vectorRegs;                // 向量值 --> Q寄存器
+    unordered_map<shared_ptr<PhiInstruction>, int> stepRegs;         // 线性phi --> 每次向量迭代增量所在的Q寄存器
+
+    static bool analyse(shared_ptr<Loop> &loop, AliasAnalysis &aliasAnalysis, VectorLoop &vectorLoop);
+
+private:
+    vector<shared_ptr<Instruction>> instructions;  // 循环头与回边块中的指令，程序顺序
+    unordered_set<shared_ptr<Instruction>> marked;  // 需要向量化的指令
+
+    static bool isInvariant(const shared_ptr<Value> &value, shared_ptr<Loop> &loop);
+
+    bool analyseInduction(shared_ptr<Loop> &loop);
+
+    bool analysePhis(shared_ptr<Loop> &loop);
+
+    bool markVector(const shared_ptr<Value> &value, shared_ptr<Loop> &loop);
+
+    bool getStreamOffset(const shared_ptr<Value> &offset, shared_ptr<Loop> &loop, shared_ptr<Value> &base, int &constant);
+
+    bool checkDependence(AliasAnalysis &aliasAnalysis);
+
+    bool allocVectorRegs();
+};
+
+/**
+ * SLP打包的向量值的来源
+ */
+enum SlpNodeKind
+{
+    SLP_LOAD,    // 连续的load
+    SLP_STORE,   // 连续的store，打包的根
+    SLP_BINARY,  // 同构的运算
+    SLP_SPLAT,   // 各通道为同一个值
+    SLP_GATHER   // 各通道为不同的标量值，逐个插入
+};
+
+/**
+ * SLP打包的一个向量值，通道i对应第i个store的表达式树中的同一位置
+ */
+class SlpNode
+{
+public:
+    SlpNodeKind kind;
+    vector<shared_ptr<Value>> lanes;
+    vector<shared_ptr<SlpNode>> operands;  // 运算的左右操作数，store的值
+    string op;                             // 运算的操作符
+    shared_ptr<Value> address;             // load、store：通道i访问 address + (index + constant + i) * 4
+    shared_ptr<Value> index;               // 下标中非常数的部分，没有为nullptr
+    int constant = 0;
+    int reg = 0;                           // 所在的Q寄存器
+
+    SlpNode(SlpNodeKind kind, vector<shared_ptr<Value>> &lanes) : kind(kind), lanes(lanes){};
+};
+
+/**
+ * SLP打包：块中_VECTOR_WIDTH个下标连续的store及其同构的表达式树，在最后一个store处以向量指令代替
+ */
+class SlpPack
+{
+public:
+    shared_ptr<SlpNode> root;
+    shared_ptr<Instruction> position;                  // 最后一个store，在此生成向量指令
+    vector<shared_ptr<SlpNode>> nodes;                 // 后序，即生成顺序
+    unordered_set<shared_ptr<Instruction>> replaced;   // 由向量指令代替、不再生成的指令
+    vector<shared_ptr<Value>> inputs;                  // 在position处读入的标量值
+
+    static void analyse(shared_ptr<BasicBlock> &bb, AliasAnalysis &aliasAnalysis, vector<shared_ptr<SlpPack>> &packs);
+
+private:
+    const unordered_map<shared_ptr<Instruction>, unsigned int> *positions = nullptr;  // 指令在块中的位置
+    const unordered_set<shared_ptr<Instruction>> *claimed = nullptr;                 // 已被其他打包使用的指令
+    unordered_set<shared_ptr<Instruction>> packed;                                    // 打包的load、store、运算
+    unordered_set<shared_ptr<Instruction>> kept;                                      // 打包后仍有标量使用者，照常生成
+
+    static void decomposeOffset(const shared_ptr<Value> &offset, shared_ptr<Value> &index, int &constant);
+
+    shared_ptr<SlpNode> buildNode(vector<shared_ptr<Value>> &lanes, shared_ptr<BasicBlock> &bb, unsigned int depth);
+
+    bool buildMemoryNode(shared_ptr<SlpNode> &node);
+
+    void addInput(const shared_ptr<Value> &value);
+
+    void findKept();
+
+    bool absorbOperands(const shared_ptr<Instruction> &ins);
+
+    bool checkMemoryOrder(shared_ptr<BasicBlock> &bb, AliasAnalysis &aliasAnalysis);
+
+    bool isProfitable();
+};
+
+#endif
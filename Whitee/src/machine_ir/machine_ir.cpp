@@ -6,6 +6,7 @@
  * @date   June 2022
  *********************************************************************/
 #include "machine_ir.h"
+#include "../basic/std/compile_std.h"
 
 #include <iostream>
 #include <set>
@@ -16,7 +17,10 @@ ofstream machineIrStream;  // 汇编输出文件
 extern int const_pool_id;
 extern int ins_count;
 extern int pre_ins_count;
+extern int vector_loop_id;
+extern int slp_pack_count;
 extern set<int> invalid_imm;
+extern map<string, int> parallelWorkers;
 
 extern OptimizeLevel optimizeLevel;
 
@@ -28,8 +32,12 @@ string convertImm(int imm, const string &reg);
 
 string convertImm(int imm, const string &reg, bool mov);
 
+void parallelRuntimeToARM();
+
 void MachineModule::toARM()   // 汇编载入全局变量与const array
 {
+    if (vector_loop_id != 0 || slp_pack_count != 0)  // 生成了向量指令
+        machineIrStream << ".fpu neon" << endl;
     machineIrStream << ".data" << endl;
     for (const auto &variable : globalVariables)
     {
@@ -84,6 +92,139 @@ void MachineModule::toARM()   // 汇编载入全局变量与const array
     {
         func->toARM(this->globalVariables, this->globalConstants);
     }
+    if (!parallelWorkers.empty())  // 有并行调用
+        parallelRuntimeToARM();
+}
+
+/**
+ * @brief 并行调用的运行时：__whitee_parallel_W(lo, hi, ...) 把 [lo, hi) 分为_PARALLEL_THREAD_CNT段，
+ *        clone出子线程执行其余各段（clone失败的段由自己执行），自己执行第一段，然后在futex上等待子线程退出（CLONE_CHILD_CLEARTID清零tid）；
+ *        各段以 W(start, end, 原参数...) 执行，栈上的参数复制到各线程的栈上，与普通函数相同由被调用者弹出
+ */
+void parallelRuntimeToARM()
+{
+    int threads = _PARALLEL_THREAD_CNT;
+    machineIrStream << ".data" << endl;
+    for (auto &worker : parallelWorkers)  // 描述：函数地址，栈上的参数个数
+        machineIrStream << "__whitee_parallel_desc_" + worker.first + ": .word " + worker.first + ", " + to_string(worker.second) << endl;
+    machineIrStream << "__whitee_parallel_ctx: .zero 16" << endl;  // 描述，R2，R3，栈上参数的地址
+    machineIrStream << "__whitee_parallel_tid: .zero " + to_string(max(threads - 1, 1) * 4) << endl;
+    machineIrStream << ".bss" << endl;
+    machineIrStream << "__whitee_parallel_stack: .zero " + to_string(max(threads - 1, 1) << _PARALLEL_STACK_SHIFT) << endl;
+    machineIrStream << ".text" << endl;
+    for (auto &worker : parallelWorkers)
+    {
+        machineIrStream << "__whitee_parallel_" + worker.first + ":" << endl;
+        machineIrStream << "    LDR R12, =__whitee_parallel_desc_" + worker.first << endl;
+        machineIrStream << "    B __whitee_parallel_for" << endl;
+    }
+    // R11 = lo，R10 = end，R9 = 每段的长度，R5 = 线程序号；循环至少执行一次
+    machineIrStream << "__whitee_parallel_for:" << endl;
+    machineIrStream << "    PUSH {R4, R5, R6, R7, R8, R9, R10, R11, LR}" << endl;
+    machineIrStream << "    LDR R4, =__whitee_parallel_ctx" << endl;
+    machineIrStream << "    STR R12, [R4]" << endl;
+    machineIrStream << "    STR R2, [R4, #4]" << endl;
+    machineIrStream << "    STR R3, [R4, #8]" << endl;
+    machineIrStream << "    ADD R5, SP, #36" << endl;
+    machineIrStream << "    STR R5, [R4, #12]" << endl;
+    machineIrStream << "    SUB R9, R1, R0" << endl;
+    machineIrStream << "    CMP R9, #1" << endl;
+    machineIrStream << "    MOVLT R9, #1" << endl;
+    machineIrStream << "    ADD R10, R0, R9" << endl;
+    machineIrStream << "    MOV R11, R0" << endl;
+    machineIrStream << "    ADD R9, R9, #" + to_string(threads - 1) << endl;
+    machineIrStream << "    MOV R5, #" + to_string(threads) << endl;
+    machineIrStream << "    SDIV R9, R9, R5" << endl;
+    machineIrStream << "    MOV R5, #1" << endl;
+    machineIrStream << "__whitee_parallel_spawn:" << endl;
+    machineIrStream << "    CMP R5, #" + to_string(threads) << endl;
+    machineIrStream << "    BGE __whitee_parallel_main" << endl;
+    machineIrStream << "    MUL R6, R5, R9" << endl;
+    machineIrStream << "    ADD R6, R6, R11" << endl;
+    machineIrStream << "    CMP R6, R10" << endl;
+    machineIrStream << "    BGE __whitee_parallel_main" << endl;
+    machineIrStream << "    ADD R8, R6, R9" << endl;
+    machineIrStream << "    CMP R8, R10" << endl;
+    machineIrStream << "    MOVGT R8, R10" << endl;
+    machineIrStream << "    LDR R4, =__whitee_parallel_tid" << endl;
+    machineIrStream << "    SUB R0, R5, #1" << endl;
+    machineIrStream << "    ADD R4, R4, R0, LSL #2" << endl;
+    machineIrStream << "    LDR R1, =__whitee_parallel_stack" << endl;
+    machineIrStream << "    ADD R1, R1, R5, LSL #" + to_string(_PARALLEL_STACK_SHIFT) << endl;
+    machineIrStream << "    MOV R2, R4" << endl;
+    machineIrStream << "    MOV R3, #0" << endl;
+    machineIrStream << "    LDR R0, =0x350F00" << endl;  // CLONE_VM | FS | FILES | SIGHAND | THREAD | SYSVSEM | PARENT_SETTID | CHILD_CLEARTID
+    machineIrStream << "    MOV R7, #120" << endl;  // clone
+    machineIrStream << "    SVC #0" << endl;
+    machineIrStream << "    CMP R0, #0" << endl;
+    machineIrStream << "    BEQ __whitee_parallel_thread" << endl;
+    machineIrStream << "    BLT __whitee_parallel_fallback" << endl;
+    machineIrStream << "__whitee_parallel_next:" << endl;
+    machineIrStream << "    ADD R5, R5, #1" << endl;
+    machineIrStream << "    B __whitee_parallel_spawn" << endl;
+    // clone失败时tid仍为0，不等待，在当前线程执行此段；被调用函数不保存R8-R11
+    machineIrStream << "__whitee_parallel_fallback:" << endl;
+    machineIrStream << "    PUSH {R8, R9, R10, R11}" << endl;
+    machineIrStream << "    BL __whitee_parallel_run" << endl;
+    machineIrStream << "    POP {R8, R9, R10, R11}" << endl;
+    machineIrStream << "    B __whitee_parallel_next" << endl;
+    machineIrStream << "__whitee_parallel_main:" << endl;
+    machineIrStream << "    MOV R6, R11" << endl;
+    machineIrStream << "    ADD R8, R11, R9" << endl;
+    machineIrStream << "    CMP R8, R10" << endl;
+    machineIrStream << "    MOVGT R8, R10" << endl;
+    machineIrStream << "    BL __whitee_parallel_run" << endl;
+    machineIrStream << "    LDR R4, =__whitee_parallel_tid" << endl;
+    machineIrStream << "    MOV R5, #" + to_string(threads - 1) << endl;
+    machineIrStream << "__whitee_parallel_join:" << endl;
+    machineIrStream << "    CMP R5, #0" << endl;
+    machineIrStream << "    BLE __whitee_parallel_joined" << endl;
+    machineIrStream << "    LDR R2, [R4]" << endl;
+    machineIrStream << "    CMP R2, #0" << endl;
+    machineIrStream << "    ADDEQ R4, R4, #4" << endl;
+    machineIrStream << "    SUBEQ R5, R5, #1" << endl;
+    machineIrStream << "    BEQ __whitee_parallel_join" << endl;
+    machineIrStream << "    MOV R0, R4" << endl;
+    machineIrStream << "    MOV R1, #0" << endl;  // FUTEX_WAIT
+    machineIrStream << "    MOV R3, #0" << endl;
+    machineIrStream << "    MOV R7, #240" << endl;  // futex
+    machineIrStream << "    SVC #0" << endl;
+    machineIrStream << "    B __whitee_parallel_join" << endl;
+    machineIrStream << "__whitee_parallel_joined:" << endl;
+    machineIrStream << "    DMB ISH" << endl;
+    machineIrStream << "    POP {R4, R5, R6, R7, R8, R9, R10, R11, LR}" << endl;
+    machineIrStream << "    LDR R12, =__whitee_parallel_ctx" << endl;  // 与普通函数相同，弹出调用者压栈的参数
+    machineIrStream << "    LDR R12, [R12]" << endl;
+    machineIrStream << "    LDR R12, [R12, #4]" << endl;
+    machineIrStream << "    ADD SP, SP, R12, LSL #2" << endl;
+    machineIrStream << "    BX LR" << endl;
+    machineIrStream << "__whitee_parallel_thread:" << endl;
+    machineIrStream << "    BL __whitee_parallel_run" << endl;
+    machineIrStream << "    MOV R0, #0" << endl;
+    machineIrStream << "    MOV R7, #1" << endl;  // exit，只退出当前线程
+    machineIrStream << "    SVC #0" << endl;
+    // 执行 [R6, R8)：复制栈上的参数后调用函数
+    machineIrStream << "__whitee_parallel_run:" << endl;
+    machineIrStream << "    PUSH {R4, R5, R6, LR}" << endl;
+    machineIrStream << "    LDR R12, =__whitee_parallel_ctx" << endl;
+    machineIrStream << "    LDR R4, [R12, #12]" << endl;
+    machineIrStream << "    LDR R5, [R12]" << endl;
+    machineIrStream << "    LDR R5, [R5, #4]" << endl;
+    machineIrStream << "__whitee_parallel_copy:" << endl;
+    machineIrStream << "    SUBS R5, R5, #1" << endl;
+    machineIrStream << "    LDRGE R0, [R4, R5, LSL #2]" << endl;
+    machineIrStream << "    PUSHGE {R0}" << endl;
+    machineIrStream << "    BGT __whitee_parallel_copy" << endl;
+    machineIrStream << "    LDR R12, =__whitee_parallel_ctx" << endl;
+    machineIrStream << "    MOV R0, R6" << endl;
+    machineIrStream << "    MOV R1, R8" << endl;
+    machineIrStream << "    LDR R2, [R12, #4]" << endl;
+    machineIrStream << "    LDR R3, [R12, #8]" << endl;
+    machineIrStream << "    LDR R12, [R12]" << endl;
+    machineIrStream << "    LDR R12, [R12]" << endl;
+    machineIrStream << "    BLX R12" << endl;  // 由被调用函数弹出栈上的参数
+    machineIrStream << "    POP {R4, R5, R6, PC}" << endl;
+    machineIrStream << ".ltorg" << endl;
 }
 
 void MachineFunc::toARM(vector<shared_ptr<Value>> &global_vars, vector<shared_ptr<Value>> &global_consts)
@@ -597,3 +738,41 @@ void Comment::toARM(shared_ptr<MachineFunc> &machineFunc)
 {
     machineIrStream << "    @" + content << endl;
 }
+
+void VectorMemoryIns::toARM(shared_ptr<MachineFunc> &machineFunc)
+{
+    machineIrStream << "        " + instype2string.at(this->type) + " {Q" + rd->value + "}, [R" + base->value + "]!" << endl;
+    ins_count++;
+}
+
+void VectorBinaryIns::toARM(shared_ptr<MachineFunc> &machineFunc)
+{
+    machineIrStream << "        " + instype2string.at(this->type) + " Q" + rd->value + ", Q" + op1->value + ", Q" + op2->value << endl;
+    ins_count++;
+}
+
+/**
+ * @brief Q寄存器的通道lane位于D(2q + lane/2)的第lane%2个32位
+ * @param q Q寄存器编号
+ * @param lane 
+ * @return 
+ */
+string laneOperand(const string &q, int lane)
+{
+    return "D" + to_string(stoi(q) * 2 + lane / 2) + "[" + to_string(lane % 2) + "]";
+}
+
+void VectorMovIns::toARM(shared_ptr<MachineFunc> &machineFunc)
+{
+    string t_op, v_op;
+    if (this->type == mit::VDUP)
+        t_op = "Q" + des->value, v_op = "R" + src->value;
+    else if (this->type == mit::VMOV_IMM)
+        t_op = "Q" + des->value, v_op = "#" + src->value;
+    else if (des->state == QREG)
+        t_op = laneOperand(des->value, lane), v_op = "R" + src->value;
+    else
+        t_op = "R" + des->value, v_op = laneOperand(src->value, lane);
+    machineIrStream << "        " + instype2string.at(this->type) + " " + t_op + ", " + v_op << endl;
+    ins_count++;
+}
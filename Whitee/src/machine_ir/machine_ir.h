@@ -46,6 +46,12 @@ class BXIns;
 
 class GlobalIns;
 
+class VectorMemoryIns;
+
+class VectorBinaryIns;
+
+class VectorMovIns;
+
 class PhiTmp;
 
 extern bool readRegister(shared_ptr<Value> &val, shared_ptr<Operand> &op, shared_ptr<MachineFunc> &machineFunc, vector<shared_ptr<MachineIns>> &res, bool mov, bool regRequired);
@@ -91,7 +97,16 @@ namespace mit
         BLINK,  // BL
         BRETURN, 
         GLOBAL,
-        COMMENT  // 注释
+        COMMENT,  // 注释
+        VLD1,     // 向量加载
+        VST1,     // 向量存储
+        VADD,     // 向量加法
+        VSUB,     // 向量减法
+        VMUL,     // 向量乘法
+        VMLA,     // 向量乘加
+        VDUP,     // 通用寄存器广播到各通道
+        VMOV_IMM, // 立即数广播到各通道
+        VMOV_LANE // 通用寄存器与一个通道之间移动
     };
 }
 
@@ -130,7 +145,8 @@ enum State
     VIRTUAL, // 局部变量
     REG,   // register
     IMM,   // immediate
-    LABEL
+    LABEL,
+    QREG   // NEON Q寄存器
 };
 
 class MachineModule
@@ -439,6 +455,59 @@ public:
     void toARM(shared_ptr<MachineFunc> &machineFunc) override;
 };
 
+/**
+ * For vld1/vst1 {Qd}, [Rn]!，访问后地址增加16
+ */
+class VectorMemoryIns : public MachineIns
+{
+public:
+    shared_ptr<Operand> rd;
+    shared_ptr<Operand> base;
+
+    VectorMemoryIns(mit::InsType type, shared_ptr<Operand> &rd, shared_ptr<Operand> &base)
+        : MachineIns(type, NON, NONE, 0), rd(rd), base(base){};
+
+    string toString() override;
+
+    void toARM(shared_ptr<MachineFunc> &machineFunc) override;
+};
+
+/**
+ * For vadd/vsub/vmul/vmla Qd, Qn, Qm
+ */
+class VectorBinaryIns : public MachineIns
+{
+public:
+    shared_ptr<Operand> op1;
+    shared_ptr<Operand> op2;
+    shared_ptr<Operand> rd;
+
+    VectorBinaryIns(mit::InsType type, shared_ptr<Operand> &op1, shared_ptr<Operand> &op2, shared_ptr<Operand> &rd)
+        : MachineIns(type, NON, NONE, 0), op1(op1), op2(op2), rd(rd){};
+
+    string toString() override;
+
+    void toARM(shared_ptr<MachineFunc> &machineFunc) override;
+};
+
+/**
+ * For vdup Qd, Rn；vmov Qd, #imm；vmov Rd, Qn[lane]；vmov Qd[lane], Rn
+ */
+class VectorMovIns : public MachineIns
+{
+public:
+    shared_ptr<Operand> des;
+    shared_ptr<Operand> src;
+    int lane;  // 只用于VMOV_LANE
+
+    VectorMovIns(mit::InsType type, shared_ptr<Operand> &des, shared_ptr<Operand> &src, int lane)
+        : MachineIns(type, NON, NONE, 0), des(des), src(src), lane(lane){};
+
+    string toString() override;
+
+    void toARM(shared_ptr<MachineFunc> &machineFunc) override;
+};
+
 class PhiTmp : public Value   //？？？？没用
 {
 public:
@@ -10,12 +10,17 @@
 #include <set>
 #include <stack>
 #include <algorithm>
+#include <climits>
 
 #include "machine_ir_build.h"
+#include "../ir/ir_alias.h"
+#include "../ir/ir_vector.h"
 #include "../basic/std/compile_std.h"
 
 extern bool judgeImmValid (unsigned int imm, bool mov);
 
+extern OptimizeLevel optimizeLevel;
+
 unordered_map<shared_ptr<BasicBlock>, shared_ptr<MachineBB>> IRB2MachB;
 
 int const_pool_id = 0;  // 全局变量加载次数
@@ -54,7 +59,16 @@ unordered_map<mit::InsType, string> instype2string = {
 	{mit::MLS, "MLS"},
 	{mit::MLA, "MLA"},
 	{mit::GLOBAL, "GLOBAL"},
-	{mit::COMMENT, "COMMENT"} };
+	{mit::COMMENT, "COMMENT"},
+	{mit::VLD1, "VLD1.32"},
+	{mit::VST1, "VST1.32"},
+	{mit::VADD, "VADD.I32"},
+	{mit::VSUB, "VSUB.I32"},
+	{mit::VMUL, "VMUL.I32"},
+	{mit::VMLA, "VMLA.I32"},
+	{mit::VDUP, "VDUP.32"},
+	{mit::VMOV_IMM, "VMOV.I32"},
+	{mit::VMOV_LANE, "VMOV.32"} };
 
 // 移位汇编指令
 unordered_map<SType, string> stype2string {
@@ -79,7 +93,8 @@ unordered_map<State, string> state2string {
 										  {REG, "R"},
 										  {GLOB_INT, "@"},
 										  {GLOB_POINTER, "@*"},
-										  {LABEL, "."} };
+										  {LABEL, "."},
+										  {QREG, "Q"} };
 
 void loadImm2Reg (int num, shared_ptr<Operand> des, vector<shared_ptr<MachineIns>>& res, bool mov);
 
@@ -91,14 +106,29 @@ vector<shared_ptr<MachineIns>> genJmpIns (shared_ptr<Instruction>& ins);
 
 vector<shared_ptr<MachineIns>> genInvokeIns2 (shared_ptr<Instruction>& ins, shared_ptr<MachineFunc>& machineFunc, shared_ptr<Module>& module);
 
+bool isSiblingTailCall (shared_ptr<BasicBlock>& bb, unsigned int index);
+
+vector<shared_ptr<MachineIns>> genTailInvokeIns (shared_ptr<Instruction>& ins, shared_ptr<MachineFunc>& machineFunc);
+
 vector<shared_ptr<MachineIns>> genUnaryIns (shared_ptr<Instruction>& ins, shared_ptr<MachineFunc>& machineFunc);
 
 vector<shared_ptr<MachineIns>> genBinaryIns (shared_ptr<Instruction>& ins, shared_ptr<MachineFunc>& machineFunc);
 
+vector<shared_ptr<MachineIns>> genConstDivIns (shared_ptr<Instruction>& ins, shared_ptr<MachineFunc>& machineFunc);
+
+struct MulStep;
+
+bool decomposeMul (int c, vector<MulStep>& steps);
+
+vector<shared_ptr<MachineIns>> genConstMulIns (shared_ptr<Instruction>& ins, shared_ptr<MachineFunc>& machineFunc, vector<MulStep>& steps);
+
 vector<shared_ptr<MachineIns>> genStoreIns (shared_ptr<Instruction>& ins, shared_ptr<MachineFunc>& machineFunc);
 
 vector<shared_ptr<MachineIns>> genLoadIns (shared_ptr<Instruction>& ins, shared_ptr<MachineFunc>& machineFunc);
 
+void loadLocalArrayAddress (shared_ptr<Value>& array, shared_ptr<Value>& index, shared_ptr<MachineFunc>& machineFunc, vector<shared_ptr<MachineIns>>& res,
+							shared_ptr<Operand>& base, shared_ptr<Operand>& offset, shared_ptr<Shift>& shift, bool& release_base, bool& release_offset);
+
 void genAlloc (shared_ptr<MachineFunc>& machineFunc, shared_ptr<Instruction>& ins);
 
 vector<shared_ptr<MachineIns>> genBIns (shared_ptr<Instruction>& ins, shared_ptr<MachineFunc>& machineFunc);
@@ -111,11 +141,52 @@ vector<shared_ptr<MachineIns>> genPhi (shared_ptr<Instruction>& ins, shared_ptr<
 
 vector<shared_ptr<MachineIns>> genGlobIns (shared_ptr<MachineModule>& machineModule);
 
+void ifConversion (shared_ptr<MachineFunc>& machineFunc);
+
+bool convertBranch (shared_ptr<MachineBB>& head, unordered_map<string, shared_ptr<MachineBB>>& labelBlocks, unordered_map<string, int>& labelRefs,
+					unordered_set<shared_ptr<MachineBB>>& removed);
+
+bool fuseCompareChain (shared_ptr<MachineBB>& head, unordered_map<string, shared_ptr<MachineBB>>& labelBlocks, unordered_map<string, int>& labelRefs,
+					   unordered_set<shared_ptr<MachineBB>>& removed);
+
+int predicableCost (shared_ptr<MachineBB>& machineBB, unsigned int tailCount);
+
+Cond inverseCond (Cond cond);
+
+struct ScheduleNode;
+
+void scheduleInstructions (shared_ptr<MachineFunc>& machineFunc);
+
+void scheduleRegion (vector<ScheduleNode>& nodes, vector<shared_ptr<MachineIns>>& result);
+
+bool getDefUse (shared_ptr<MachineIns>& ins, vector<string>& defs, vector<string>& uses);
+
+int insLatency (shared_ptr<MachineIns>& ins);
+
+bool memoryConflict (shared_ptr<MachineIns>& first, shared_ptr<MachineIns>& second);
+
+void findVectorLoops (shared_ptr<Function>& func);
+
+vector<shared_ptr<MachineIns>> genVectorLoop (shared_ptr<VectorLoop>& vectorLoop, shared_ptr<MachineFunc>& machineFunc);
+
+void findSlpPacks (shared_ptr<BasicBlock>& bb, shared_ptr<MachineFunc>& machineFunc);
+
+vector<shared_ptr<MachineIns>> genSlpPack (shared_ptr<SlpPack>& pack, shared_ptr<MachineFunc>& machineFunc);
+
 set<string> tempRegPool; // 未分配临时寄存器
 unordered_map<shared_ptr<Value>, string> lValRegMap;  // 左值对应的寄存器
 unordered_map<shared_ptr<Value>, string> rValRegMap;  // 已使用的临时寄存器寄存器
 unordered_set<string> regInUse;  // 正在使用寄存器
 
+unordered_map<shared_ptr<BasicBlock>, shared_ptr<VectorLoop>> vectorLoops;  // 前置块 --> 在其末尾生成的向量循环
+int vector_loop_id = 0;  // 向量循环的标签编号
+shared_ptr<AliasAnalysis> functionAlias;  // 当前函数的别名分析，O0时为空
+unordered_map<shared_ptr<Instruction>, shared_ptr<SlpPack>> slpPositions;  // 最后一个打包的store --> SLP打包
+unordered_set<shared_ptr<Instruction>> slpReplaced;  // 当前块中由SLP打包代替的指令
+int slp_pack_count = 0;  // 生成的SLP打包数量
+
+map<string, int> parallelWorkers;  // 并行调用的函数 --> 栈上传递的参数个数
+
 /**
  * @brief 在这一步中我们需要记录变量的地址，对于本地变量，我们需要记录到SP的偏移量，对于全局变量，我们需要记录标签
  * @param module
@@ -214,12 +285,18 @@ shared_ptr<MachineModule> buildMachineModule (shared_ptr<Module>& module)
 		func_epilogue->MachineInstructions.push_back (moveStack);
 		machineFunction->machineBlocks.push_back (func_epilogue);
 
+		findVectorLoops (func);
 		/// 对于func中的每个块，将其映射到machineFunc中。
 		for (auto& bb : func->blocks)
 		{
 			// if (_debugMachineIr) cout << "block" + to_string(bb->id) + ":" << endl;
 			machineFunction->machineBlocks.push_back (bbToMachineBB (bb, machineFunction, module));
 		}
+		if (optimizeLevel != O0)  // 小的分支改为条件执行，再在块内调度指令隐藏延迟
+		{
+			ifConversion (machineFunction);
+			scheduleInstructions (machineFunction);
+		}
 		// 将每个machineFunction加入machineModule
 		machineModule->machineFunctions.push_back (machineFunction);
 	}
@@ -330,8 +407,11 @@ shared_ptr<MachineBB> bbToMachineBB (shared_ptr<BasicBlock>& bb, shared_ptr<Mach
 {
 	shared_ptr<MachineBB> machineBB = make_shared<MachineBB> (bb->id, machineFunction);
 	IRB2MachB.insert (pair<shared_ptr<BasicBlock>, shared_ptr<MachineBB>> (bb, machineBB));
-	for (auto& ins : bb->instructions)
+	bool tailCall = false;  // 已生成尾调用，其后的return无需再生成
+	findSlpPacks (bb, machineFunction);
+	for (unsigned int index = 0; index < bb->instructions.size (); ++index)
 	{
+		shared_ptr<Instruction>& ins = bb->instructions.at (index);
 		/*
 		  * 对于每个 ins，我们需要将其映射到 machineIns。
 		  * 对于除 BR、JMP、RET、STORE 之外的每种类型的 ins 中的结果（ssa 左值），
@@ -340,10 +420,19 @@ shared_ptr<MachineBB> bbToMachineBB (shared_ptr<BasicBlock>& bb, shared_ptr<Mach
 		vector<shared_ptr<MachineIns>> res;
 		string content = ins->toString ();
 		shared_ptr<Comment> ir = make_shared<Comment> (content);  // 注释显示此IR
+		if (slpReplaced.count (ins) != 0)  // 由SLP打包的向量指令代替，在最后一个打包的store处生成
+		{
+			if (slpPositions.count (ins) != 0)
+				res = genSlpPack (slpPositions.at (ins), machineFunction);
+			machineBB->MachineInstructions.insert (machineBB->MachineInstructions.end (), ir);
+			machineBB->MachineInstructions.insert (machineBB->MachineInstructions.end (), res.begin (), res.end ());
+			continue;
+		}
 		switch (ins->type)
 		{
 		case RET:
-			res = genRetIns (ins, machineFunction);
+			if (!tailCall)
+				res = genRetIns (ins, machineFunction);
 			break;
 		case BR:
 			res = genBIns (ins, machineFunction);
@@ -353,7 +442,13 @@ shared_ptr<MachineBB> bbToMachineBB (shared_ptr<BasicBlock>& bb, shared_ptr<Mach
 			res = genJmpIns (ins);
 			break;
 		case INVOKE:
-			res = genInvokeIns2 (ins, machineFunction, module);
+			if (isSiblingTailCall (bb, index))
+			{
+				res = genTailInvokeIns (ins, machineFunction);
+				tailCall = true;
+			}
+			else
+				res = genInvokeIns2 (ins, machineFunction, module);
 			break;
 		case UNARY:
 			res = genUnaryIns (ins, machineFunction);
@@ -383,6 +478,14 @@ shared_ptr<MachineBB> bbToMachineBB (shared_ptr<BasicBlock>& bb, shared_ptr<Mach
 		default:
 			break;
 		}
+		// 前置块跳入循环头之前，先执行向量循环
+		if ((ins->type == JMP || ins->type == BR) && vectorLoops.count (bb) != 0 && rValRegMap.empty () && !res.empty () &&
+			res.back ()->type == mit::BRANCH && res.back ()->cond == NON &&
+			s_p_c<BIns> (res.back ())->label == "block" + to_string (vectorLoops.at (bb)->header->id))
+		{
+			vector<shared_ptr<MachineIns>> vectorIns = genVectorLoop (vectorLoops.at (bb), machineFunction);
+			res.insert (res.end () - 1, vectorIns.begin (), vectorIns.end ());
+		}
 		// 将此IR对应的机器码加入
 		machineBB->MachineInstructions.insert (machineBB->MachineInstructions.end (), ir);
 		machineBB->MachineInstructions.insert (machineBB->MachineInstructions.end (), res.begin (), res.end ());
@@ -563,6 +666,22 @@ void loadMemory2Reg (shared_ptr<Value>& var, shared_ptr<Operand>& des, shared_pt
 	}
 }
 
+/**
+ * @brief 判断没有寄存器的值能否在使用处重新计算而不必存入栈中：局部数组起始地址加合法立即数，一条ADD即可算出
+ * @param val 
+ * @return true 可重新计算；false 不可
+ */
+bool canRematerialize (shared_ptr<Value>& val)
+{
+	if (val->value_type != INSTRUCTION || s_p_c<Instruction> (val)->type != BINARY ||
+		s_p_c<Instruction> (val)->resultType != L_VAL_RESULT || lValRegMap.count (val) != 0)
+		return false;
+	shared_ptr<BinaryInstruction> bi = s_p_c<BinaryInstruction> (val);
+	if (bi->op != "+" || bi->rhs->value_type != NUMBER || !judgeImmValid (s_p_c<NumberValue> (bi->rhs)->number, false))
+		return false;
+	return bi->lhs->value_type == INSTRUCTION && s_p_c<Instruction> (bi->lhs)->type == ALLOC;
+}
+
 /**
  * @brief 加载一个值到register
  * @param val 被加载的值
@@ -591,6 +710,25 @@ void loadVal2Reg (shared_ptr<Value>& val, shared_ptr<Operand>& des, shared_ptr<M
 		shared_ptr<ConstantValue> const_var = s_p_c<ConstantValue> (val);
 		loadConst2Reg (const_var, des, res);
 	}
+	else if (canRematerialize (val))  // 重新计算地址，代替从栈中取出
+	{
+		shared_ptr<BinaryInstruction> bi = s_p_c<BinaryInstruction> (val);
+		int offset = machineFunc->var2offset.at (to_string (bi->lhs->id)) + compensate + s_p_c<NumberValue> (bi->rhs)->number;
+		if (judgeImmValid (offset, false))  // sp加偏移量
+		{
+			shared_ptr<Operand> stack = make_shared<Operand> (REG, "13");
+			shared_ptr<Operand> off = make_shared<Operand> (IMM, to_string (offset));
+			shared_ptr<BinaryIns> addrToReg = make_shared<BinaryIns> (mit::ADD, NON, NONE, 0, stack, off, des);
+			res.push_back (addrToReg);
+		}
+		else    // 先取数组起始地址，再加偏移量
+		{
+			loadVal2Reg (bi->lhs, des, machineFunc, res, mov, compensate, reg);
+			shared_ptr<Operand> imm = make_shared<Operand> (IMM, to_string (s_p_c<NumberValue> (bi->rhs)->number));
+			shared_ptr<BinaryIns> add = make_shared<BinaryIns> (mit::ADD, NON, NONE, 0, des, imm, des);
+			res.push_back (add);
+		}
+	}
 	else    // 局部变量
 	{
 		shared_ptr<Operand> off;
@@ -971,6 +1109,99 @@ vector<shared_ptr<MachineIns>> genJmpIns (shared_ptr<Instruction>& ins)
 	return res;
 }
 
+/**
+ * @brief 判断调用是否为兄弟尾调用：调用自定义函数后直接返回其结果，目标函数的参数都在R0至R3中，且实参不指向当前函数的栈
+ * @param bb IR的基本块
+ * @param index 调用指令在块中的位置
+ * @return true 可以释放当前栈帧后直接跳转到目标函数
+ */
+bool isSiblingTailCall (shared_ptr<BasicBlock>& bb, unsigned int index)
+{
+	if (index + 1 >= bb->instructions.size () || bb->instructions.at (index + 1)->type != RET)
+		return false;
+	shared_ptr<InvokeInstruction> invoke = s_p_c<InvokeInstruction> (bb->instructions.at (index));
+	shared_ptr<ReturnInstruction> ret = s_p_c<ReturnInstruction> (bb->instructions.at (index + 1));
+	if (invoke->invokeType != COMMON || invoke->targetFunction == nullptr || invoke->params.size () > 4 || invoke->parallel)
+		return false;
+	if (ret->funcType == FUNC_INT && ret->value != invoke)
+		return false;
+	for (auto& param : invoke->params)
+	{
+		if (AliasAnalysis::isPointer (param))  // 局部数组在跳转前已随栈帧释放
+		{
+			shared_ptr<Value> base = AliasAnalysis::getLocation (param, nullptr).base;
+			if (base == nullptr || base->value_type == INSTRUCTION)
+				return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief 生成兄弟尾调用：参数放入R0至R3，释放栈帧并取回LR，然后B到目标函数，由目标函数直接返回到当前函数的调用者
+ * @param ins IR指令
+ * @param machineFunc
+ * @return 生成的机器指令
+ */
+vector<shared_ptr<MachineIns>> genTailInvokeIns (shared_ptr<Instruction>& ins, shared_ptr<MachineFunc>& machineFunc)
+{
+	vector<shared_ptr<MachineIns>> res;
+	shared_ptr<InvokeInstruction> invoke = s_p_c<InvokeInstruction> (ins);
+	for (int i = invoke->params.size () - 1; i >= 0; --i)  // 参数加载入R0至R3
+	{
+		shared_ptr<Operand> init_param = make_shared<Operand> (REG, to_string (i));
+		if (lValRegMap.count (invoke->params[i]) == 0 && rValRegMap.count (invoke->params[i]) == 0)  // 不在寄存器内
+		{
+			loadVal2Reg (invoke->params[i], init_param, machineFunc, res, true, 0, to_string (i));
+		}
+		else  // 在寄存器内
+		{
+			string init_reg;
+			if (lValRegMap.count (invoke->params[i]) != 0)
+			{
+				init_reg = lValRegMap.at (invoke->params[i]);
+			}
+			else
+			{
+				init_reg = rValRegMap.at (invoke->params[i]);
+				rValRegMap.erase (invoke->params[i]);
+				releaseTempRegister (init_reg);
+			}
+			init_param->value = init_reg;
+		}
+		if (init_param->value != to_string (i))
+		{
+			shared_ptr<Operand> des = make_shared<Operand> (REG, to_string (i));
+			shared_ptr<MovIns> mov2R = make_shared<MovIns> (NON, NONE, 0, des, init_param);
+			res.push_back (mov2R);
+		}
+	}
+	// 与return相同地释放栈帧，大立即数借用LR，R0至R3已存放参数
+	shared_ptr<Operand> stack = make_shared<Operand> (REG, "13");
+	shared_ptr<Operand> lr = make_shared<Operand> (REG, "14");
+	int para_size = machineFunc->params.size () > 4 ? machineFunc->params.size () - 4 : 0;
+	int restore_size = machineFunc->stackSize + para_size * 4;
+	shared_ptr<Operand> restore_stack;
+	if (judgeImmValid (restore_size, false))
+	{
+		restore_stack = make_shared<Operand> (IMM, to_string (restore_size));
+	}
+	else
+	{
+		restore_stack = lr;
+		loadImm2Reg (restore_size, restore_stack, res, true);
+	}
+	shared_ptr<BinaryIns> restore_func = make_shared<BinaryIns> (mit::ADD, NON, NONE, 0, stack, restore_stack, stack);
+	res.push_back (restore_func);
+	shared_ptr<Operand> lrOff = make_shared<Operand> (IMM, to_string (-20 - para_size * 4));
+	shared_ptr<MemoryIns> restoreLR = make_shared<MemoryIns> (mit::LOAD, NON, NONE, 0, lr, stack, lrOff);
+	res.push_back (restoreLR);
+	string targetName = invoke->targetFunction->name;
+	shared_ptr<BIns> b = make_shared<BIns> (NON, NONE, 0, targetName);
+	res.push_back (b);
+	return res;
+}
+
 /**
  * @brief 将调用函数转为机器码
  * @param ins IR指令
@@ -1093,7 +1324,12 @@ vector<shared_ptr<MachineIns>> genInvokeIns2 (shared_ptr<Instruction>& ins, shar
 	}
 	// 目标函数的函数名
 	string targetName;
-	if (invoke->targetFunction != nullptr)  // 自定义函数
+	if (invoke->targetFunction != nullptr && invoke->parallel)  // 并行调用，经运行时分给多个线程
+	{
+		targetName = "__whitee_parallel_" + invoke->targetFunction->name;
+		parallelWorkers[invoke->targetFunction->name] = max ((int)invoke->params.size () - 4, 0);
+	}
+	else if (invoke->targetFunction != nullptr)  // 自定义函数
 	{
 		targetName = invoke->targetFunction->name;
 	}
@@ -1200,6 +1436,27 @@ vector<shared_ptr<MachineIns>> genUnaryIns (shared_ptr<Instruction>& ins, shared
 			store2Memory (rd, ui->id, machineFunc, res);
 		}
 	}
+	else if (ui->op == "+")  // 正号仅由活跃范围拆分生成，即复制
+	{
+		shared_ptr<Operand> op2 = make_shared<Operand> (REG, "3");
+		bool release2 = readRegister (ui->value, op2, machineFunc, res, true, true);
+		if (release2)
+		{
+			releaseTempRegister (op2->value);
+		}
+		shared_ptr<Operand> rd = make_shared<Operand> (REG, "1");
+		shared_ptr<Value> u_ins = ins;
+		bool release_rd = writeRegister (u_ins, rd, machineFunc, res);
+		if (rd->value != op2->value)
+		{
+			shared_ptr<MovIns> mv = make_shared<MovIns> (NON, NONE, 0, rd, op2);
+			res.push_back (mv);
+		}
+		if (release_rd)
+		{
+			store2Memory (rd, ui->id, machineFunc, res);
+		}
+	}
 	else  // 取反转为cmp值与0，相等则变为1，否则变为0
 	{
 		shared_ptr<Operand> op2 = make_shared<Operand> (IMM, "0");
@@ -1228,6 +1485,381 @@ vector<shared_ptr<MachineIns>> genUnaryIns (shared_ptr<Instruction>& ins, shared
 	return res;
 }
 
+/**
+ * @brief 计算有符号除以常数的魔数（Granlund-Montgomery），n / d = ((n * magic) >> 32 [+ n]) >> shift + (n < 0)
+ * @param d 除数的绝对值，不为2的幂
+ * @param magic 魔数，为负时乘积高位需再加n
+ * @param shift 右移位数
+ */
+void computeDivMagic (unsigned int d, int& magic, int& shift)
+{
+	const unsigned int two31 = 0x80000000u;
+	unsigned int anc = two31 - 1 - two31 % d;  // |nc|
+	int p = 31;
+	unsigned int q1 = two31 / anc, r1 = two31 - q1 * anc;  // 2^p / |nc|
+	unsigned int q2 = two31 / d, r2 = two31 - q2 * d;  // 2^p / d
+	unsigned int delta;
+	do
+	{
+		p++;
+		q1 = 2 * q1;
+		r1 = 2 * r1;
+		if (r1 >= anc)
+		{
+			q1++;
+			r1 -= anc;
+		}
+		q2 = 2 * q2;
+		r2 = 2 * r2;
+		if (r2 >= d)
+		{
+			q2++;
+			r2 -= d;
+		}
+		delta = d - r2;
+	} while (q1 < delta || (q1 == delta && r1 == 0));
+	magic = (int)(q2 + 1);
+	shift = p - 32;
+}
+
+/**
+ * @brief 将除以常数、对常数取余转为乘法与移位：2的幂用移位修正负数，其余用SMULL乘魔数取高位
+ * @param ins IR指令，rhs为非零且不为INT_MIN的常数
+ * @param machineFunc
+ * @return 生成的机器指令
+ */
+vector<shared_ptr<MachineIns>> genConstDivIns (shared_ptr<Instruction>& ins, shared_ptr<MachineFunc>& machineFunc)
+{
+	vector<shared_ptr<MachineIns>> res;
+	shared_ptr<BinaryInstruction> bi = s_p_c<BinaryInstruction> (ins);
+	int divisor = s_p_c<NumberValue> (bi->rhs)->number;
+	unsigned int absDivisor = divisor < 0 ? 0u - (unsigned int)divisor : (unsigned int)divisor;
+	bool isDiv = bi->op == "/";
+	shared_ptr<Operand> n = make_shared<Operand> (REG, "2");
+	bool release_n = readRegister (bi->lhs, n, machineFunc, res, true, true);
+	shared_ptr<Operand> rd = make_shared<Operand> (REG, "1");
+	shared_ptr<Value> d_ins = ins;
+	bool release_rd;
+	if (absDivisor == 1)  // 商为±n，余数为0
+	{
+		if (release_n)
+			releaseTempRegister (n->value);
+		release_rd = writeRegister (d_ins, rd, machineFunc, res);
+		shared_ptr<Operand> zero = make_shared<Operand> (IMM, "0");
+		if (!isDiv)
+			res.push_back (make_shared<MovIns> (NON, NONE, 0, rd, zero));
+		else if (divisor < 0)
+			res.push_back (make_shared<BinaryIns> (mit::RSB, NON, NONE, 0, n, zero, rd));
+		else if (rd->value != n->value)
+			res.push_back (make_shared<MovIns> (NON, NONE, 0, rd, n));
+	}
+	else if ((absDivisor & (absDivisor - 1)) == 0)  // 2的幂：负数先加2^k-1再算术右移
+	{
+		int k = __builtin_ctz (absDivisor);
+		shared_ptr<Operand> t = make_shared<Operand> (REG, allocTempRegister ());
+		shared_ptr<Operand> k_imm = make_shared<Operand> (IMM, to_string (k));
+		if (k == 1)  // t = n + (n >>> 31)
+		{
+			res.push_back (make_shared<BinaryIns> (mit::ADD, NON, LSR, 31, n, n, t));
+		}
+		else   // t = n + ((n >> 31) >>> (32 - k))
+		{
+			shared_ptr<Operand> imm31 = make_shared<Operand> (IMM, "31");
+			res.push_back (make_shared<BinaryIns> (mit::ASR, NON, NONE, 31, n, imm31, t));
+			res.push_back (make_shared<BinaryIns> (mit::ADD, NON, LSR, 32 - k, n, t, t));
+		}
+		if (isDiv)
+		{
+			releaseTempRegister (t->value);
+			if (release_n)
+				releaseTempRegister (n->value);
+			release_rd = writeRegister (d_ins, rd, machineFunc, res);
+			res.push_back (make_shared<BinaryIns> (mit::ASR, NON, NONE, k, t, k_imm, rd));
+			if (divisor < 0)
+			{
+				shared_ptr<Operand> zero = make_shared<Operand> (IMM, "0");
+				res.push_back (make_shared<BinaryIns> (mit::RSB, NON, NONE, 0, rd, zero, rd));
+			}
+		}
+		else   // n - ((t >> k) << k)
+		{
+			res.push_back (make_shared<BinaryIns> (mit::ASR, NON, NONE, k, t, k_imm, t));
+			releaseTempRegister (t->value);
+			if (release_n)
+				releaseTempRegister (n->value);
+			release_rd = writeRegister (d_ins, rd, machineFunc, res);
+			res.push_back (make_shared<BinaryIns> (mit::SUB, NON, LSL, k, n, t, rd));
+		}
+	}
+	else
+	{
+		int magic, shift;
+		computeDivMagic (absDivisor, magic, shift);
+		shared_ptr<Operand> lo = make_shared<Operand> (REG, allocTempRegister ());
+		shared_ptr<Operand> hi = make_shared<Operand> (REG, allocTempRegister ());
+		loadImm2Reg (magic, lo, res, true);
+		res.push_back (make_shared<TriIns> (mit::SMULL, NON, NONE, 0, hi, n, lo, lo));  // lo, hi = n * magic
+		if (magic < 0)  // 魔数超过2^31，按有符号数相乘少加了一次n
+			res.push_back (make_shared<BinaryIns> (mit::ADD, NON, NONE, 0, hi, n, hi));
+		if (shift > 0)
+		{
+			shared_ptr<Operand> s_imm = make_shared<Operand> (IMM, to_string (shift));
+			res.push_back (make_shared<BinaryIns> (mit::ASR, NON, NONE, shift, hi, s_imm, hi));
+		}
+		if (isDiv)
+		{
+			releaseTempRegister (lo->value);
+			releaseTempRegister (hi->value);
+			if (release_n)
+				releaseTempRegister (n->value);
+			release_rd = writeRegister (d_ins, rd, machineFunc, res);
+			if (divisor > 0)  // rd = hi + (n >>> 31)
+				res.push_back (make_shared<BinaryIns> (mit::ADD, NON, LSR, 31, hi, n, rd));
+			else  // rd = (n >> 31) - hi
+				res.push_back (make_shared<BinaryIns> (mit::RSB, NON, ASR, 31, hi, n, rd));
+		}
+		else   // n - q * |d|，余数符号与除数无关
+		{
+			res.push_back (make_shared<BinaryIns> (mit::ADD, NON, LSR, 31, hi, n, hi));
+			loadImm2Reg ((int)absDivisor, lo, res, true);
+			releaseTempRegister (lo->value);
+			releaseTempRegister (hi->value);
+			if (release_n)
+				releaseTempRegister (n->value);
+			release_rd = writeRegister (d_ins, rd, machineFunc, res);
+			res.push_back (make_shared<TriIns> (mit::MLS, NON, NONE, 0, hi, lo, n, rd));  // rd = n - hi * lo
+		}
+	}
+	if (release_rd)
+	{
+		store2Memory (rd, ins->id, machineFunc, res);
+	}
+	return res;
+}
+
+/**
+ * 常数乘法分解的一步，累加值acc初始为被乘数n
+ */
+enum MulStepType
+{
+	MUL_SHIFT_ADD,  // acc = acc + (acc << k)
+	MUL_SHIFT_RSB,  // acc = (acc << k) - acc
+	MUL_SHIFT,      // acc = acc << k
+	MUL_ADD_N,      // acc = acc + (n << k)
+	MUL_SUB_N,      // acc = acc - (n << k)
+	MUL_NEG         // acc = -acc
+};
+
+struct MulStep
+{
+	MulStepType type;
+	int shift;
+};
+
+const int _MUL_CHAIN_DEPTH = 3;  // 分解最多的指令数
+
+/**
+ * @brief Cortex-A72上一步分解的代价：带LSL #0~3的加减为1周期，更大的移位为2周期
+ * @param step 
+ * @return 代价
+ */
+int mulStepCost (const MulStep& step)
+{
+	if (step.type == MUL_SHIFT || step.type == MUL_NEG || step.shift <= 3)
+		return 1;
+	return 2;
+}
+
+int searchMulChain (long long c, int budget, int depth, vector<MulStep>& best);
+
+/**
+ * @brief 尝试以一步step从from得到目标值，若更优则更新best
+ * @param from 上一步的系数
+ * @param step 
+ * @param budget 总代价须小于此值
+ * @param depth 剩余步数
+ * @param bestCost 当前最优代价
+ * @param best 当前最优分解
+ */
+void tryMulStep (long long from, MulStep step, int budget, int depth, int& bestCost, vector<MulStep>& best)
+{
+	if (from == 0 || from > 0xFFFFFFFFLL || from < -0xFFFFFFFFLL)
+		return;
+	int cost = mulStepCost (step);
+	int limit = min (budget, bestCost) - cost;
+	if (limit <= 0)
+		return;
+	vector<MulStep> sub;
+	int subCost = searchMulChain (from, limit, depth - 1, sub);
+	if (subCost != INT_MAX && subCost + cost < bestCost)
+	{
+		bestCost = subCost + cost;
+		best = sub;
+		best.push_back (step);
+	}
+}
+
+/**
+ * @brief 搜索计算n * c的移位加减序列
+ * @param c 乘数
+ * @param budget 总代价须小于此值
+ * @param depth 剩余步数
+ * @param best 找到的分解
+ * @return 代价；找不到返回INT_MAX
+ */
+int searchMulChain (long long c, int budget, int depth, vector<MulStep>& best)
+{
+	if (c == 1)
+	{
+		best.clear ();
+		return 0;
+	}
+	int bestCost = INT_MAX;
+	if (depth == 0 || budget <= 0 || c == 0)
+		return bestCost;
+	if (depth == 1)  // 最后一步只能从n本身出发
+	{
+		MulStep step = {MUL_NEG, 0};
+		if (c > 0 && (c & (c - 1)) == 0)
+			step = {MUL_SHIFT, __builtin_ctzll (c)};
+		else if (c > 2 && ((c - 1) & (c - 2)) == 0)
+			step = {MUL_SHIFT_ADD, __builtin_ctzll (c - 1)};
+		else if (c > 2 && (c & (c + 1)) == 0)
+			step = {MUL_SHIFT_RSB, __builtin_ctzll (c + 1)};
+		else if (c < 0 && ((1 - c) & -c) == 0)
+			step = {MUL_SUB_N, __builtin_ctzll (1 - c)};
+		else if (c != -1)
+			return bestCost;
+		if (mulStepCost (step) >= budget)
+			return bestCost;
+		best.assign (1, step);
+		return mulStepCost (step);
+	}
+	if (c % 2 == 0)  // 提出2的幂
+	{
+		int k = __builtin_ctzll (c);
+		tryMulStep (c >> k, {MUL_SHIFT, k}, budget, depth, bestCost, best);
+	}
+	for (int k = 1; k < 32; ++k)
+	{
+		long long power = 1LL << k;
+		if (c % (power + 1) == 0)
+			tryMulStep (c / (power + 1), {MUL_SHIFT_ADD, k}, budget, depth, bestCost, best);
+		if (k >= 2 && c % (power - 1) == 0)
+			tryMulStep (c / (power - 1), {MUL_SHIFT_RSB, k}, budget, depth, bestCost, best);
+	}
+	for (int k = 0; k < 32; ++k)
+	{
+		long long power = 1LL << k;
+		tryMulStep (c - power, {MUL_ADD_N, k}, budget, depth, bestCost, best);
+		tryMulStep (c + power, {MUL_SUB_N, k}, budget, depth, bestCost, best);
+	}
+	if (c < 0)
+		tryMulStep (-c, {MUL_NEG, 0}, budget, depth, bestCost, best);
+	return bestCost;
+}
+
+/**
+ * @brief 生成分解中的一步
+ * @param step 
+ * @param acc 累加值所在寄存器
+ * @param n 被乘数所在寄存器
+ * @param des 目的寄存器
+ * @param res 生成的机器指令
+ */
+void genMulStep (const MulStep& step, shared_ptr<Operand>& acc, shared_ptr<Operand>& n, shared_ptr<Operand>& des, vector<shared_ptr<MachineIns>>& res)
+{
+	SType stype = step.shift == 0 ? NONE : LSL;
+	shared_ptr<Operand> imm = make_shared<Operand> (IMM, to_string (step.shift));
+	switch (step.type)
+	{
+	case MUL_SHIFT_ADD:
+		res.push_back (make_shared<BinaryIns> (mit::ADD, NON, stype, step.shift, acc, acc, des));
+		break;
+	case MUL_SHIFT_RSB:
+		res.push_back (make_shared<BinaryIns> (mit::RSB, NON, stype, step.shift, acc, acc, des));
+		break;
+	case MUL_SHIFT:
+		res.push_back (make_shared<BinaryIns> (mit::LSL, NON, NONE, step.shift, acc, imm, des));
+		break;
+	case MUL_ADD_N:
+		res.push_back (make_shared<BinaryIns> (mit::ADD, NON, stype, step.shift, acc, n, des));
+		break;
+	case MUL_SUB_N:
+		res.push_back (make_shared<BinaryIns> (mit::SUB, NON, stype, step.shift, acc, n, des));
+		break;
+	case MUL_NEG:
+		res.push_back (make_shared<BinaryIns> (mit::RSB, NON, NONE, 0, acc, imm, des));
+		break;
+	}
+}
+
+/**
+ * @brief 分解乘以常数c：代价须低于MUL（延迟3周期）加上载入常数的MOV或MOVW/MOVT
+ * @param c 乘数
+ * @param steps 分解结果，c为0或1时为空
+ * @return true 应使用分解；false 应使用MUL
+ */
+bool decomposeMul (int c, vector<MulStep>& steps)
+{
+	steps.clear ();
+	if (c == 0)
+		return true;
+	int mulCost = 3 + (judgeImmValid (c, true) || (c > 0 && c < 65536) ? 1 : 2);
+	return searchMulChain (c, mulCost, _MUL_CHAIN_DEPTH, steps) != INT_MAX;
+}
+
+/**
+ * @brief 将乘以常数转为移位加减序列
+ * @param ins IR指令，至少一个操作数为常数
+ * @param machineFunc
+ * @param steps decomposeMul得到的分解
+ * @return 生成的机器指令
+ */
+vector<shared_ptr<MachineIns>> genConstMulIns (shared_ptr<Instruction>& ins, shared_ptr<MachineFunc>& machineFunc, vector<MulStep>& steps)
+{
+	vector<shared_ptr<MachineIns>> res;
+	shared_ptr<BinaryInstruction> bi = s_p_c<BinaryInstruction> (ins);
+	bool constRhs = bi->rhs->value_type == NUMBER;
+	int c = s_p_c<NumberValue> (constRhs ? bi->rhs : bi->lhs)->number;
+	shared_ptr<Value> factor = constRhs ? bi->lhs : bi->rhs;
+	shared_ptr<Operand> n = make_shared<Operand> (REG, "2");
+	bool release_n = readRegister (factor, n, machineFunc, res, true, true);
+	shared_ptr<Operand> acc = n;
+	if (steps.size () > 1)  // 中间结果放在临时寄存器，n可能还要使用
+	{
+		acc = make_shared<Operand> (REG, allocTempRegister ());
+		genMulStep (steps[0], n, n, acc, res);
+		for (size_t i = 1; i + 1 < steps.size (); ++i)
+			genMulStep (steps[i], acc, n, acc, res);
+		releaseTempRegister (acc->value);
+	}
+	if (release_n)
+		releaseTempRegister (n->value);
+	shared_ptr<Operand> rd = make_shared<Operand> (REG, "1");
+	shared_ptr<Value> m_ins = ins;
+	bool release_rd = writeRegister (m_ins, rd, machineFunc, res);
+	if (c == 0)
+	{
+		shared_ptr<Operand> zero = make_shared<Operand> (IMM, "0");
+		res.push_back (make_shared<MovIns> (NON, NONE, 0, rd, zero));
+	}
+	else if (steps.empty ())
+	{
+		if (rd->value != n->value)
+			res.push_back (make_shared<MovIns> (NON, NONE, 0, rd, n));
+	}
+	else
+	{
+		genMulStep (steps.back (), acc, n, rd, res);
+	}
+	if (release_rd)
+	{
+		store2Memory (rd, ins->id, machineFunc, res);
+	}
+	return res;
+}
+
 /**
  * @brief 将二元表达式转为机器码
  * @param ins IR指令
@@ -1237,6 +1869,22 @@ vector<shared_ptr<MachineIns>> genUnaryIns (shared_ptr<Instruction>& ins, shared
 vector<shared_ptr<MachineIns>> genBinaryIns (shared_ptr<Instruction>& ins, shared_ptr<MachineFunc>& machineFunc)
 {
 	vector<shared_ptr<MachineIns>> res;
+	shared_ptr<Value> val = ins;
+	if (canRematerialize (val))  // 在每个使用处重新计算，无需在此计算并存入栈
+		return res;
+	shared_ptr<BinaryInstruction> bin = s_p_c<BinaryInstruction> (ins);
+	if ((bin->op == "/" || bin->op == "%") && bin->rhs->value_type == NUMBER &&
+		s_p_c<NumberValue> (bin->rhs)->number != 0 && s_p_c<NumberValue> (bin->rhs)->number != INT_MIN)  // 除以常数不用SDIV
+	{
+		return genConstDivIns (ins, machineFunc);
+	}
+	if (bin->op == "*" && (bin->lhs->value_type == NUMBER || bin->rhs->value_type == NUMBER))  // 乘以常数尽量不用MUL
+	{
+		vector<MulStep> steps;
+		int c = s_p_c<NumberValue> (bin->rhs->value_type == NUMBER ? bin->rhs : bin->lhs)->number;
+		if (decomposeMul (c, steps))
+			return genConstMulIns (ins, machineFunc, steps);
+	}
 	shared_ptr<Operand> rd;
 	if (s_p_c<BinaryInstruction> (ins)->op == "%")  // 取余需要，先进行除法，在对结果进行三元乘减
 	{
@@ -1446,6 +2094,63 @@ void genAlloc (shared_ptr<MachineFunc>& machineFunc, shared_ptr<Instruction>& in
 	machineFunc->stackPointer += al->bytes;
 }
 
+/**
+ * @brief 计算局部数组元素的寻址方式：常数下标并入sp的偏移量，[sp, #off]；变量下标先算出数组起始地址，[base, idx, LSL #2]
+ * @param array 局部数组
+ * @param index 下标
+ * @param machineFunc
+ * @param res 生成的机器指令
+ * @param base 基址寄存器
+ * @param offset 偏移量，立即数或寄存器
+ * @param shift 偏移量的移位方式
+ * @param release_base 基址寄存器是否需要释放
+ * @param release_offset 偏移量寄存器是否需要释放
+ */
+void loadLocalArrayAddress (shared_ptr<Value>& array, shared_ptr<Value>& index, shared_ptr<MachineFunc>& machineFunc, vector<shared_ptr<MachineIns>>& res,
+							shared_ptr<Operand>& base, shared_ptr<Operand>& offset, shared_ptr<Shift>& shift, bool& release_base, bool& release_offset)
+{
+	int arrayOffset = machineFunc->var2offset.at (to_string (array->id));  // 数组起始地址相对sp的偏移量
+	base->state = REG;
+	base->value = "13";
+	release_base = false;
+	shift->type = NONE;
+	shift->shift = 0;
+	if (index->value_type == NUMBER)  // 下标为常数
+	{
+		string reg = allocTempRegister ();
+		offset->value = reg;
+		loadOffset (arrayOffset + s_p_c<NumberValue> (index)->number * 4, offset, reg, res);
+		release_offset = true;
+		if (offset->state == IMM)
+		{
+			releaseTempRegister (reg);
+			release_offset = false;
+		}
+	}
+	else    // 下标在寄存器内
+	{
+		release_offset = readRegister (index, offset, machineFunc, res, true, true);
+		shift->type = LSL;
+		shift->shift = 2;  // 左移两位，即*4
+		shared_ptr<Operand> stack = make_shared<Operand> (REG, "13");
+		shared_ptr<Operand> start = make_shared<Operand> (REG, allocTempRegister ());
+		shared_ptr<Operand> off;
+		if (judgeImmValid (arrayOffset, false))
+		{
+			off = make_shared<Operand> (IMM, to_string (arrayOffset));
+		}
+		else
+		{
+			off = start;
+			loadImm2Reg (arrayOffset, off, res, true);
+		}
+		shared_ptr<BinaryIns> addrToReg = make_shared<BinaryIns> (mit::ADD, NON, NONE, 0, stack, off, start);
+		res.push_back (addrToReg);
+		base = start;
+		release_base = true;
+	}
+}
+
 /**
  * @brief 将load转为机器码
  * @param ins IR指令
@@ -1501,56 +2206,21 @@ vector<shared_ptr<MachineIns>> genLoadIns (shared_ptr<Instruction>& ins, shared_
 	}
 	else  // 局部变量
 	{
-		// 计算相对sp偏移量
-		shared_ptr<Operand> f_pre = make_shared<Operand> (REG, "2");
-		f_pre->value = allocTempRegister ();
-		f_pre->state = REG;
-		loadImm2Reg (machineFunc->var2offset.at (to_string (li->address->id)), f_pre, res, true);
-		shared_ptr<Operand> t_off = make_shared<Operand> (REG, "3");
-		bool release_off;
-		shared_ptr<Shift> t_s = make_shared<Shift> ();  // 移位方式
-		if (li->offset->value_type == NUMBER)  // offset 为常数
-		{
-			int off = s_p_c<NumberValue> (li->offset)->number * 4;
-			if (judgeImmValid (off, false))  // 合法立即数，直接使用
-			{
-				t_off->state = IMM;
-				t_off->value = to_string (off);
-				release_off = false;
-			}
-			else    // 非法立即数，需要加载至寄存器
-			{
-				t_off->value = allocTempRegister ();
-				t_off->state = REG;
-				loadImm2Reg (off, t_off, res, true);
-				release_off = true;
-			}
-			t_s->type = NONE;
-			t_s->shift = 0;
-		}
-		else   // offset在寄存器内
-		{
-			release_off = readRegister (li->offset, t_off, machineFunc, res, true, true);
-			t_s->type = LSL;
-			t_s->shift = 2;  // 左移两位，即*4
-		}
-		if (release_off)
-			releaseTempRegister (t_off->value);
-		releaseTempRegister (f_pre->value);
-		shared_ptr<Operand> f_aft = make_shared<Operand> (REG, "3");  // 最终结果，相对于sp偏移量
-		f_aft->value = allocTempRegister ();
-		f_aft->state = REG;
-		shared_ptr<BinaryIns> add = make_shared<BinaryIns> (mit::ADD, NON, t_s, f_pre, t_off, f_aft);
-		res.push_back (add);
-		releaseTempRegister (f_aft->value);
-		// 以sp为基地址，加载
-		shared_ptr<Operand> des = make_shared<Operand> (REG, "2");
-		shared_ptr<Value> l_ins = ins;
-		bool release_des = writeRegister (l_ins, des, machineFunc, res);  // 读取值的目的寄存器
-		shared_ptr<Operand> base = make_shared<Operand> (REG, "13");
-		shared_ptr<MemoryIns> load = make_shared<MemoryIns> (mit::LOAD, NON, NONE, 0, des, base, f_aft);
-		res.push_back (load);
-		if (release_des)
+		shared_ptr<Operand> t_base = make_shared<Operand> (REG, "13");
+		shared_ptr<Operand> t_offset = make_shared<Operand> (REG, "3");
+		shared_ptr<Shift> t_s = make_shared<Shift> ();
+		bool release_base, release_offset;
+		loadLocalArrayAddress (li->address, li->offset, machineFunc, res, t_base, t_offset, t_s, release_base, release_offset);
+		if (release_offset)
+			releaseTempRegister (t_offset->value);
+		if (release_base)
+			releaseTempRegister (t_base->value);
+		shared_ptr<Operand> des = make_shared<Operand> (REG, "2");
+		shared_ptr<Value> l_ins = ins;
+		bool release_des = writeRegister (l_ins, des, machineFunc, res);  // 读取值的目的寄存器
+		shared_ptr<MemoryIns> load = make_shared<MemoryIns> (mit::LOAD, NON, t_s, des, t_base, t_offset);
+		res.push_back (load);
+		if (release_des)
 		{
 			store2Memory (des, li->id, machineFunc, res);
 		}
@@ -1611,56 +2281,21 @@ vector<shared_ptr<MachineIns>> genStoreIns (shared_ptr<Instruction>& ins, shared
 	}
 	else   // 局部变量
 	{
-		// 计算相对sp偏移量
-		shared_ptr<Operand> f_pre = make_shared<Operand> (REG, "2");
-		f_pre->value = allocTempRegister ();
-		f_pre->state = REG;
-		loadImm2Reg (machineFunc->var2offset.at (to_string (si->address->id)), f_pre, res, true);
-		shared_ptr<Operand> t_off = make_shared<Operand> (REG, "3");
-		bool release_offset;
+		shared_ptr<Operand> t_base = make_shared<Operand> (REG, "13");
+		shared_ptr<Operand> t_offset = make_shared<Operand> (REG, "3");
 		shared_ptr<Shift> t_s = make_shared<Shift> ();
-		if (si->offset->value_type == NUMBER)  // offset 为常数
-		{
-			int off = s_p_c<NumberValue> (si->offset)->number * 4;
-			if (judgeImmValid (off, false))  // 合法立即数，直接使用
-			{
-				t_off->value = to_string (off);
-				t_off->state = IMM;
-				release_offset = false;
-			}
-			else    // 非法立即数，需要加载至寄存器
-			{
-				t_off->value = allocTempRegister ();
-				t_off->state = REG;
-				loadImm2Reg (off, t_off, res, true);
-				release_offset = true;
-			}
-			t_s->type = NONE;
-			t_s->shift = 0;
-		}
-		else   // offset在寄存器内
-		{
-			release_offset = readRegister (si->offset, t_off, machineFunc, res, true, true);
-			t_s->type = LSL;
-			t_s->shift = 2;  // 左移两位，即*4
-		}
-		releaseTempRegister (f_pre->value);
-		if (release_offset)
-			releaseTempRegister (t_off->value);
-		shared_ptr<Operand> f_aft = make_shared<Operand> (REG, "3");  // 最终结果，相对于sp偏移量
-		f_aft->value = allocTempRegister ();
-		f_aft->state = REG;
-		shared_ptr<BinaryIns> add = make_shared<BinaryIns> (mit::ADD, NON, t_s, f_pre, t_off, f_aft);
-		res.push_back (add);
-		// 以sp为基地址，store
+		bool release_base, release_offset;
+		loadLocalArrayAddress (si->address, si->offset, machineFunc, res, t_base, t_offset, t_s, release_base, release_offset);
 		shared_ptr<Operand> obj = make_shared<Operand> (REG, "2");
 		bool release_obj = readRegister (si->value, obj, machineFunc, res, true, true);  // 需要store的值
-		shared_ptr<Operand> base = make_shared<Operand> (REG, "13");
-		shared_ptr<MemoryIns> store = make_shared<MemoryIns> (mit::STORE, NON, NONE, 0, obj, base, f_aft);
+		shared_ptr<MemoryIns> store = make_shared<MemoryIns> (mit::STORE, NON, t_s, obj, t_base, t_offset);
 		res.push_back (store);
 		if (release_obj)
 			releaseTempRegister (obj->value);
-		releaseTempRegister (f_aft->value);
+		if (release_offset)
+			releaseTempRegister (t_offset->value);
+		if (release_base)
+			releaseTempRegister (t_base->value);
 	}
 	return res;
 }
@@ -1684,8 +2319,11 @@ vector<shared_ptr<MachineIns>> genPhiMov (shared_ptr<Instruction>& ins, shared_p
 	if (release_target)
 		releaseTempRegister (op->value);
 	bool release_des = writeRegister (p_ins, des, machineFunc, res);
-	shared_ptr<MovIns> move2Des = make_shared<MovIns> (NON, NONE, 0, des, op);  // mov至一个寄存器
-	res.push_back (move2Des);
+	if (des->value != op->value)  // 与操作数合并到同一寄存器时无需mov
+	{
+		shared_ptr<MovIns> move2Des = make_shared<MovIns> (NON, NONE, 0, des, op);  // mov至一个寄存器
+		res.push_back (move2Des);
+	}
 	if (release_des)
 	{
 		store2Memory (des, ins->id, machineFunc, res);
@@ -1709,8 +2347,11 @@ vector<shared_ptr<MachineIns>> genPhi (shared_ptr<Instruction>& ins, shared_ptr<
 	shared_ptr<Operand> target = make_shared<Operand> (REG, "2");
 	shared_ptr<Value> p_ins = ins;
 	bool release_target = writeRegister (p_ins, target, machineFunc, res);
-	shared_ptr<MovIns> move2Target = make_shared<MovIns> (NON, NONE, 0, target, phi_mov);  // 将copy的值移入phi的值所在寄存器，不能相同
-	res.push_back (move2Target);
+	if (target->value != phi_mov->value)  // phi与phi_move合并到同一寄存器时无需mov
+	{
+		shared_ptr<MovIns> move2Target = make_shared<MovIns> (NON, NONE, 0, target, phi_mov);  // 将copy的值移入phi的值所在寄存器
+		res.push_back (move2Target);
+	}
 	if (release_target)
 	{
 		store2Memory (target, ins->id, machineFunc, res);
@@ -1777,6 +2418,988 @@ vector<shared_ptr<MachineIns>> genGlobIns (shared_ptr<MachineModule>& machineMod
 	return res;
 }
 
+const int _IF_CONVERSION_MAX_COST = 4;  // 菱形两分支条件执行的最大代价，三角形只有一个分支可跳过，为其一半
+
+/**
+ * @brief if转换：块以 B<c> false; B true 结尾，分支块只有此一个前驱、代价小且都可条件执行时，
+ *        将其指令改为条件执行后接在此块末尾，删除分支块；支持菱形（两分支跳到同一块）与三角形（一个分支跳到另一个）
+ * @param machineFunc 
+ */
+void ifConversion (shared_ptr<MachineFunc>& machineFunc)
+{
+	unordered_map<string, shared_ptr<MachineBB>> labelBlocks;  // 标签 --> 块
+	unordered_map<string, int> labelRefs;  // 标签 --> 跳转到此的指令数
+	for (auto& machineBB : machineFunc->machineBlocks)
+	{
+		labelBlocks["block" + to_string (machineBB->index)] = machineBB;
+		for (auto& ins : machineBB->MachineInstructions)
+		{
+			if (ins->type == mit::BRANCH)
+				++labelRefs[s_p_c<BIns> (ins)->label];
+		}
+	}
+	unordered_set<shared_ptr<MachineBB>> removed;
+	for (auto& head : machineFunc->machineBlocks)
+	{
+		if (removed.count (head) != 0)
+			continue;
+		while (convertBranch (head, labelBlocks, labelRefs, removed) || fuseCompareChain (head, labelBlocks, labelRefs, removed))  // 合并后的块末尾可能又是一个分支
+			;
+	}
+	vector<shared_ptr<MachineBB>>& blocks = machineFunc->machineBlocks;
+	for (auto it = blocks.begin (); it != blocks.end ();)
+	{
+		if (removed.count (*it) != 0)
+			it = blocks.erase (it);
+		else
+			++it;
+	}
+}
+
+/**
+ * @brief 对块末尾的分支进行if转换，汇合块只剩此块跳入时也合并到此块，省去跳转
+ * @param head 
+ * @param labelBlocks 
+ * @param labelRefs 
+ * @param removed 已合并的块
+ * @return 是否转换
+ */
+bool convertBranch (shared_ptr<MachineBB>& head, unordered_map<string, shared_ptr<MachineBB>>& labelBlocks, unordered_map<string, int>& labelRefs,
+					unordered_set<shared_ptr<MachineBB>>& removed)
+{
+	vector<shared_ptr<MachineIns>>& headIns = head->MachineInstructions;
+	if (headIns.size () < 2)
+		return false;
+	shared_ptr<MachineIns> condBranch = headIns.at (headIns.size () - 2);
+	shared_ptr<MachineIns> jump = headIns.back ();
+	if (condBranch->type != mit::BRANCH || condBranch->cond == NON || jump->type != mit::BRANCH || jump->cond != NON)
+		return false;
+	string falseLabel = s_p_c<BIns> (condBranch)->label;
+	string trueLabel = s_p_c<BIns> (jump)->label;
+	if (trueLabel == falseLabel)
+		return false;
+	string labels[2] = {trueLabel, falseLabel};
+	shared_ptr<MachineBB> branches[2];  // 条件成立、不成立时执行的块，不能转换时为nullptr
+	string exits[2];
+	int costs[2] = {0, 0};
+	for (int i = 0; i < 2; ++i)
+	{
+		if (labelBlocks.count (labels[i]) == 0 || labelRefs.at (labels[i]) != 1)
+			continue;
+		shared_ptr<MachineBB> branch = labelBlocks.at (labels[i]);
+		if (branch == head || removed.count (branch) != 0 || branch->MachineInstructions.empty ())
+			continue;
+		shared_ptr<MachineIns> exit = branch->MachineInstructions.back ();
+		if (exit->type != mit::BRANCH || exit->cond != NON)
+			continue;
+		costs[i] = predicableCost (branch, 1);
+		if (costs[i] < 0)
+			continue;
+		branches[i] = branch;
+		exits[i] = s_p_c<BIns> (exit)->label;
+	}
+	vector<shared_ptr<MachineBB>> converted;
+	vector<Cond> conds;
+	string target;
+	if (branches[0] != nullptr && branches[1] != nullptr && exits[0] == exits[1] && costs[0] + costs[1] <= _IF_CONVERSION_MAX_COST)  // 菱形
+	{
+		converted = {branches[0], branches[1]};
+		conds = {inverseCond (condBranch->cond), condBranch->cond};
+		target = exits[0];
+	}
+	else if (branches[0] != nullptr && exits[0] == falseLabel && costs[0] * 2 <= _IF_CONVERSION_MAX_COST)  // 成立时执行的三角形
+	{
+		converted = {branches[0]};
+		conds = {inverseCond (condBranch->cond)};
+		target = falseLabel;
+	}
+	else if (branches[1] != nullptr && exits[1] == trueLabel && costs[1] * 2 <= _IF_CONVERSION_MAX_COST)  // 不成立时执行的三角形
+	{
+		converted = {branches[1]};
+		conds = {condBranch->cond};
+		target = trueLabel;
+	}
+	else
+		return false;
+	headIns.erase (headIns.end () - 2, headIns.end ());
+	for (unsigned int i = 0; i < converted.size (); ++i)
+	{
+		vector<shared_ptr<MachineIns>>& branchIns = converted.at (i)->MachineInstructions;
+		for (auto it = branchIns.begin (); it != branchIns.end () - 1; ++it)
+		{
+			if ((*it)->type != mit::COMMENT)
+				(*it)->cond = conds.at (i);
+			headIns.push_back (*it);
+		}
+		removed.insert (converted.at (i));
+	}
+	--labelRefs.at (trueLabel);  // 分支块的跳转与此块的跳转合并为一个
+	--labelRefs.at (falseLabel);
+	if (converted.size () == 2)
+		--labelRefs.at (target);
+	if (labelBlocks.count (target) != 0 && labelRefs.at (target) == 1 && labelBlocks.at (target) != head && removed.count (labelBlocks.at (target)) == 0)
+	{
+		vector<shared_ptr<MachineIns>>& targetIns = labelBlocks.at (target)->MachineInstructions;
+		headIns.insert (headIns.end (), targetIns.begin (), targetIns.end ());
+		removed.insert (labelBlocks.at (target));
+		--labelRefs.at (target);
+	}
+	else
+		headIns.push_back (make_shared<BIns> (NON, NONE, 0, target));
+	return true;
+}
+
+/**
+ * @brief 合并短路求值的条件链：a && b 中 a 成立时进入只做 b 比较的块，两次比较失败的条件相同时，
+ *        将 b 的比较（及其操作数的准备）改为 a 成立时条件执行的 CMP，接在此块末尾，只保留 b 的跳转；a || b 同理
+ * @param head 
+ * @param labelBlocks 
+ * @param labelRefs 
+ * @param removed 已合并的块
+ * @return 是否合并
+ */
+bool fuseCompareChain (shared_ptr<MachineBB>& head, unordered_map<string, shared_ptr<MachineBB>>& labelBlocks, unordered_map<string, int>& labelRefs,
+					   unordered_set<shared_ptr<MachineBB>>& removed)
+{
+	vector<shared_ptr<MachineIns>>& headIns = head->MachineInstructions;
+	if (headIns.size () < 2)
+		return false;
+	shared_ptr<MachineIns> condBranch = headIns.at (headIns.size () - 2);
+	shared_ptr<MachineIns> jump = headIns.back ();
+	if (condBranch->type != mit::BRANCH || condBranch->cond == NON || jump->type != mit::BRANCH || jump->cond != NON)
+		return false;
+	string falseLabel = s_p_c<BIns> (condBranch)->label;
+	string trueLabel = s_p_c<BIns> (jump)->label;
+	// 先看 && 的形式：成立时进入的块失败时跳到同一处；再看 || 的形式：不成立时进入的块成立时跳到同一处
+	string labels[2] = {trueLabel, falseLabel};
+	Cond conds[2] = {inverseCond (condBranch->cond), condBranch->cond};
+	for (int i = 0; i < 2; ++i)
+	{
+		if (labelBlocks.count (labels[i]) == 0 || labelRefs.at (labels[i]) != 1)
+			continue;
+		shared_ptr<MachineBB> next = labelBlocks.at (labels[i]);
+		vector<shared_ptr<MachineIns>>& nextIns = next->MachineInstructions;
+		if (next == head || removed.count (next) != 0 || nextIns.size () < 3)
+			continue;
+		unsigned int position = nextIns.size () - 3;
+		while (position > 0 && nextIns.at (position)->type == mit::COMMENT)  // 跳过比较与跳转间的注释
+			--position;
+		shared_ptr<MachineIns> cmp = nextIns.at (position);
+		shared_ptr<MachineIns> nextCondBranch = nextIns.at (nextIns.size () - 2);
+		shared_ptr<MachineIns> nextJump = nextIns.back ();
+		if (cmp->type != mit::CMP || cmp->cond != NON || nextCondBranch->type != mit::BRANCH || nextCondBranch->cond != condBranch->cond
+			|| nextJump->type != mit::BRANCH || nextJump->cond != NON)
+			continue;
+		string shared = i == 0 ? s_p_c<BIns> (nextCondBranch)->label : s_p_c<BIns> (nextJump)->label;  // 两个比较共同的去向
+		if (shared != (i == 0 ? falseLabel : trueLabel))
+			continue;
+		int cost = predicableCost (next, nextIns.size () - position);
+		if (cost < 0 || cost * 2 > _IF_CONVERSION_MAX_COST)
+			continue;
+		// 不执行条件比较时，CPSR保留第一次比较的结果，与第二次比较的跳转条件相同，仍跳到共同的去向
+		headIns.erase (headIns.end () - 2, headIns.end ());
+		for (auto it = nextIns.begin (); it != nextIns.end () - 2; ++it)
+		{
+			if ((*it)->type != mit::COMMENT)
+				(*it)->cond = conds[i];
+			headIns.push_back (*it);
+		}
+		headIns.push_back (nextCondBranch);
+		headIns.push_back (nextJump);
+		removed.insert (next);
+		--labelRefs.at (labels[i]);
+		--labelRefs.at (shared);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * @brief 块中除最后的跳转外的指令条件执行的代价，乘法与load为2：不能有比较、调用、栈操作、已有条件的指令，除法与长乘法延迟大也不转换
+ * @param machineBB 
+ * @param tailCount 末尾不计入的指令数
+ * @return 代价，不能条件执行时为-1
+ */
+int predicableCost (shared_ptr<MachineBB>& machineBB, unsigned int tailCount)
+{
+	int cost = 0;
+	vector<shared_ptr<MachineIns>>& instructions = machineBB->MachineInstructions;
+	if (instructions.size () < tailCount)
+		return -1;
+	for (auto it = instructions.begin (); it != instructions.end () - tailCount; ++it)
+	{
+		switch ((*it)->type)
+		{
+		case mit::COMMENT:
+			continue;
+		case mit::MUL:
+		case mit::MLS:
+		case mit::MLA:
+		case mit::LOAD:
+		case mit::PSEUDO_LOAD:
+			++cost;  // 延迟为2，与下面的指令共加1
+			[[fallthrough]];
+		case mit::ADD:
+		case mit::SUB:
+		case mit::RSB:
+		case mit::AND:
+		case mit::ORR:
+		case mit::ASR:
+		case mit::LSR:
+		case mit::LSL:
+		case mit::STORE:
+		case mit::MOV:
+		case mit::MOVW:
+		case mit::MOVT:
+			if ((*it)->cond != NON)
+				return -1;
+			++cost;
+			break;
+		default:
+			return -1;
+		}
+	}
+	return cost;
+}
+
+/**
+ * @brief 相反的条件
+ * @param cond 
+ * @return 
+ */
+Cond inverseCond (Cond cond)
+{
+	switch (cond)
+	{
+	case EQ:
+		return NE;
+	case NE:
+		return EQ;
+	case LS:
+		return GE;
+	case GE:
+		return LS;
+	case LE:
+		return GT;
+	case GT:
+		return LE;
+	default:
+		return NON;
+	}
+}
+
+struct ScheduleNode
+{
+	vector<shared_ptr<MachineIns>> instructions;  // 指令，前面是其注释
+	vector<string> defs;  // 写的寄存器，CPSR记为"CPSR"
+	vector<string> uses;  // 读的寄存器
+	int latency;
+	int height;  // 到区域末尾的最长延迟
+	int earliest;  // 操作数就绪的最早周期
+	int predCount;  // 未调度的前驱数
+	vector<pair<int, int>> succs;  // 后继的编号，延迟
+};
+
+const int _SCHEDULE_ISSUE_WIDTH = 2;  // Cortex-A72每周期最多发射两条指令
+
+/**
+ * @brief 列表调度：块被跳转、调用、栈操作、向量指令分为多个区域，区域内按寄存器与内存的依赖图，
+ *        优先发射到区域末尾延迟最长的指令；寄存器已分配，保留读写顺序，不增加寄存器压力
+ * @param machineFunc 
+ */
+void scheduleInstructions (shared_ptr<MachineFunc>& machineFunc)
+{
+	for (auto& machineBB : machineFunc->machineBlocks)
+	{
+		vector<shared_ptr<MachineIns>> result;
+		vector<ScheduleNode> nodes;
+		vector<shared_ptr<MachineIns>> comments;  // 注释随其后的指令移动
+		for (auto& ins : machineBB->MachineInstructions)
+		{
+			if (ins->type == mit::COMMENT)
+			{
+				comments.push_back (ins);
+				continue;
+			}
+			ScheduleNode node;
+			if (getDefUse (ins, node.defs, node.uses))
+			{
+				node.instructions = comments;
+				node.instructions.push_back (ins);
+				node.latency = insLatency (ins);
+				nodes.push_back (node);
+			}
+			else  // 屏障，之前的区域先调度
+			{
+				scheduleRegion (nodes, result);
+				nodes.clear ();
+				result.insert (result.end (), comments.begin (), comments.end ());
+				result.push_back (ins);
+			}
+			comments.clear ();
+		}
+		scheduleRegion (nodes, result);
+		result.insert (result.end (), comments.begin (), comments.end ());
+		machineBB->MachineInstructions = result;
+	}
+}
+
+/**
+ * @brief 调度一个区域：建立依赖图，按周期发射就绪的指令，同一周期优先高度大的，再按原顺序
+ * @param nodes 
+ * @param result 调度后的指令加在末尾
+ */
+void scheduleRegion (vector<ScheduleNode>& nodes, vector<shared_ptr<MachineIns>>& result)
+{
+	int count = nodes.size ();
+	for (int i = 0; i < count; ++i)
+	{
+		nodes.at (i).height = nodes.at (i).latency;
+		nodes.at (i).earliest = 0;
+		nodes.at (i).predCount = 0;
+		nodes.at (i).succs.clear ();
+	}
+	for (int i = 0; i < count; ++i)
+	{
+		ScheduleNode& first = nodes.at (i);
+		for (int j = i + 1; j < count; ++j)
+		{
+			ScheduleNode& second = nodes.at (j);
+			int latency = -1;  // 无依赖
+			for (auto& def : first.defs)
+			{
+				if (find (second.uses.begin (), second.uses.end (), def) != second.uses.end ())  // 写后读
+					latency = max (latency, first.latency);
+				if (find (second.defs.begin (), second.defs.end (), def) != second.defs.end ())  // 写后写
+					latency = max (latency, 1);
+			}
+			for (auto& use : first.uses)
+			{
+				if (find (second.defs.begin (), second.defs.end (), use) != second.defs.end ())  // 读后写
+					latency = max (latency, 0);
+			}
+			if (memoryConflict (first.instructions.back (), second.instructions.back ()))
+				latency = max (latency, first.instructions.back ()->type == mit::STORE ? 1 : 0);
+			if (latency >= 0)
+			{
+				first.succs.push_back ({j, latency});
+				++second.predCount;
+			}
+		}
+	}
+	for (int i = count - 1; i >= 0; --i)
+	{
+		for (auto& succ : nodes.at (i).succs)
+			nodes.at (i).height = max (nodes.at (i).height, succ.second + nodes.at (succ.first).height);
+	}
+	vector<int> ready;
+	for (int i = 0; i < count; ++i)
+	{
+		if (nodes.at (i).predCount == 0)
+			ready.push_back (i);
+	}
+	int cycle = 0;
+	int issued = 0;  // 本周期已发射的指令数
+	while (!ready.empty ())
+	{
+		int best = -1;
+		int earliest = INT_MAX;
+		for (unsigned int k = 0; k < ready.size (); ++k)
+		{
+			ScheduleNode& node = nodes.at (ready.at (k));
+			earliest = min (earliest, node.earliest);
+			if (node.earliest > cycle)
+				continue;
+			if (best < 0 || node.height > nodes.at (ready.at (best)).height
+				|| (node.height == nodes.at (ready.at (best)).height && ready.at (k) < ready.at (best)))
+				best = k;
+		}
+		if (best < 0)  // 没有就绪的指令，等待到最早的一条
+		{
+			cycle = earliest;
+			issued = 0;
+			continue;
+		}
+		ScheduleNode& node = nodes.at (ready.at (best));
+		ready.erase (ready.begin () + best);
+		result.insert (result.end (), node.instructions.begin (), node.instructions.end ());
+		for (auto& succ : node.succs)
+		{
+			ScheduleNode& next = nodes.at (succ.first);
+			next.earliest = max (next.earliest, cycle + succ.second);
+			if (--next.predCount == 0)
+				ready.push_back (succ.first);
+		}
+		if (++issued == _SCHEDULE_ISSUE_WIDTH)
+		{
+			++cycle;
+			issued = 0;
+		}
+	}
+}
+
+/**
+ * @brief 指令读写的寄存器；条件执行的指令还读CPSR与其目的寄存器（不执行时保留原值）
+ * @param ins 
+ * @param defs 
+ * @param uses 
+ * @return 能否参与调度，跳转、调用、栈操作、向量指令与写PC的指令为屏障
+ */
+bool getDefUse (shared_ptr<MachineIns>& ins, vector<string>& defs, vector<string>& uses)
+{
+	vector<shared_ptr<Operand>> defOps;
+	vector<shared_ptr<Operand>> useOps;
+	switch (ins->type)
+	{
+	case mit::ADD:
+	case mit::SUB:
+	case mit::RSB:
+	case mit::MUL:
+	case mit::DIV:
+	case mit::AND:
+	case mit::ORR:
+	case mit::ASR:
+	case mit::LSR:
+	case mit::LSL:
+	{
+		shared_ptr<BinaryIns> binary = s_p_c<BinaryIns> (ins);
+		defOps = {binary->rd};
+		useOps = {binary->op1, binary->op2};
+		break;
+	}
+	case mit::MLA:
+	case mit::MLS:
+	case mit::SMULL:
+	{
+		shared_ptr<TriIns> tri = s_p_c<TriIns> (ins);
+		defOps = {tri->rd};
+		useOps = {tri->op1, tri->op2, tri->op3};
+		if (ins->type == mit::SMULL)  // SMULL rd(低位), op1(高位), op2, op3
+		{
+			defOps.push_back (tri->op1);
+			useOps.erase (useOps.begin ());
+		}
+		break;
+	}
+	case mit::LOAD:
+	case mit::STORE:
+	{
+		shared_ptr<MemoryIns> memory = s_p_c<MemoryIns> (ins);
+		if (ins->type == mit::LOAD)
+			defOps = {memory->rd};
+		else
+			useOps = {memory->rd};
+		useOps.push_back (memory->base);
+		useOps.push_back (memory->offset);
+		break;
+	}
+	case mit::PSEUDO_LOAD:
+		defOps = {s_p_c<PseudoLoad> (ins)->rd};
+		break;
+	case mit::CMP:
+		useOps = {s_p_c<CmpIns> (ins)->op1, s_p_c<CmpIns> (ins)->op2};
+		defs.push_back ("CPSR");
+		break;
+	case mit::MOV:
+	case mit::MOVW:
+	case mit::MOVT:
+		defOps = {s_p_c<MovIns> (ins)->op1};
+		useOps = {s_p_c<MovIns> (ins)->op2};
+		if (ins->type == mit::MOVT)  // 保留低16位
+			useOps.push_back (s_p_c<MovIns> (ins)->op1);
+		break;
+	default:
+		return false;
+	}
+	for (auto& op : defOps)
+	{
+		if (op->state != REG || op->value == "15")
+			return false;
+		defs.push_back (op->value);
+		if (ins->cond != NON)
+			uses.push_back (op->value);
+	}
+	for (auto& op : useOps)
+	{
+		if (op->state == REG)
+			uses.push_back (op->value);
+	}
+	if (ins->cond != NON)
+		uses.push_back ("CPSR");
+	return true;
+}
+
+/**
+ * @brief Cortex-A72上指令的结果延迟
+ * @param ins 
+ * @return 周期数
+ */
+int insLatency (shared_ptr<MachineIns>& ins)
+{
+	switch (ins->type)
+	{
+	case mit::LOAD:
+	case mit::PSEUDO_LOAD:
+	case mit::SMULL:
+		return 4;
+	case mit::MUL:
+	case mit::MLA:
+	case mit::MLS:
+		return 3;
+	case mit::DIV:
+		return 12;  // 4~12，取最坏情况
+	default:
+		return 1;
+	}
+}
+
+/**
+ * @brief 两条访存指令是否可能冲突：至少一条为store，且不是同一基址寄存器加不同的立即数偏移
+ *        （基址在两者之间被改写时，两者已通过基址寄存器的依赖排序）
+ * @param first 
+ * @param second 
+ * @return 
+ */
+bool memoryConflict (shared_ptr<MachineIns>& first, shared_ptr<MachineIns>& second)
+{
+	if ((first->type != mit::LOAD && first->type != mit::STORE) || (second->type != mit::LOAD && second->type != mit::STORE))
+		return false;
+	if (first->type == mit::LOAD && second->type == mit::LOAD)
+		return false;
+	shared_ptr<MemoryIns> a = s_p_c<MemoryIns> (first);
+	shared_ptr<MemoryIns> b = s_p_c<MemoryIns> (second);
+	if (a->base->state == REG && b->base->state == REG && a->base->value == b->base->value && a->offset->state == IMM && b->offset->state == IMM)
+		return abs (stoi (a->offset->value) - stoi (b->offset->value)) < _W_LEN;
+	return true;
+}
+
+/**
+ * @brief 识别函数中可以向量化的循环，记录其前置块
+ * @param func 
+ */
+void findVectorLoops (shared_ptr<Function>& func)
+{
+	vectorLoops.clear ();
+	functionAlias = nullptr;
+	if (optimizeLevel == O0 || func->entryBlock == nullptr)
+		return;
+	DominatorTree domTree (func);
+	LoopInfo loopInfo (domTree);
+	functionAlias = make_shared<AliasAnalysis> (func);
+	for (auto& loop : loopInfo.loops)
+	{
+		shared_ptr<VectorLoop> vectorLoop = make_shared<VectorLoop> ();
+		if (VectorLoop::analyse (loop, *functionAlias, *vectorLoop))
+			vectorLoops[vectorLoop->preheader] = vectorLoop;
+	}
+}
+
+/**
+ * @brief 值在前置块末尾能否读入寄存器：常数、全局量、可重新计算的地址，或已分配寄存器、栈位置
+ * @param val 
+ * @param machineFunc 
+ * @return 
+ */
+bool canLoadVectorInput (shared_ptr<Value>& val, shared_ptr<MachineFunc>& machineFunc)
+{
+	if (val->value_type == NUMBER || val->value_type == GLOBAL || val->value_type == CONSTANT || canRematerialize (val))
+		return true;
+	return lValRegMap.count (val) != 0 || machineFunc->var2offset.count (to_string (val->id)) != 0;
+}
+
+/**
+ * @brief 寄存器加立即数，非法立即数先加载至tmp
+ * @param rd 
+ * @param imm 
+ * @param tmp 
+ * @param res 
+ */
+void addImm2Reg (shared_ptr<Operand>& rd, int imm, shared_ptr<Operand>& tmp, vector<shared_ptr<MachineIns>>& res)
+{
+	if (imm == 0)
+		return;
+	mit::InsType type = imm > 0 ? mit::ADD : mit::SUB;
+	shared_ptr<Operand> op2 = make_shared<Operand> (IMM, to_string (abs (imm)));
+	if (!judgeImmValid (abs (imm), false) || imm == INT_MIN)
+	{
+		type = mit::ADD;
+		loadImm2Reg (imm, tmp, res, true);
+		op2 = tmp;
+	}
+	res.push_back (make_shared<BinaryIns> (type, NON, NONE, 0, rd, op2, rd));
+}
+
+/**
+ * @brief 将向量循环的结果写入phi_move所在的寄存器或栈位置
+ * @param val phi_move
+ * @param src 结果所在寄存器
+ * @param tmp 临时寄存器
+ * @param machineFunc 
+ * @param res 
+ * @param compensate 相对于当前sp的偏移量
+ */
+void storeVectorOutput (shared_ptr<Value> val, shared_ptr<Operand>& src, shared_ptr<Operand>& tmp, shared_ptr<MachineFunc>& machineFunc,
+						vector<shared_ptr<MachineIns>>& res, int compensate)
+{
+	if (lValRegMap.count (val) != 0)
+	{
+		shared_ptr<Operand> des = make_shared<Operand> (REG, lValRegMap.at (val));
+		res.push_back (make_shared<MovIns> (NON, NONE, 0, des, src));
+		return;
+	}
+	shared_ptr<Operand> stack = make_shared<Operand> (REG, "13");
+	shared_ptr<Operand> offset;
+	loadOffset (machineFunc->var2offset.at (to_string (val->id)) + compensate, offset, tmp->value, res);
+	res.push_back (make_shared<MemoryIns> (mit::STORE, NON, NONE, 0, src, stack, offset));
+}
+
+/**
+ * @brief 在前置块末尾生成向量循环：R0为归纳变量，R1为向量迭代次数，每次处理_VECTOR_WIDTH次迭代；
+ *        完成后更新线性phi与累加phi的phi_move，原循环作为尾部处理余下的迭代（至少一次）
+ * @param vectorLoop 
+ * @param machineFunc 
+ * @return 机器指令；寄存器不足或值无法读入时为空
+ */
+vector<shared_ptr<MachineIns>> genVectorLoop (shared_ptr<VectorLoop>& vectorLoop, shared_ptr<MachineFunc>& machineFunc)
+{
+	vector<shared_ptr<MachineIns>> res;
+	vector<shared_ptr<Value>> inputs = { vectorLoop->bound };
+	vector<shared_ptr<Instruction>> streams;
+	for (auto& it : vectorLoop->linearSteps)
+		inputs.push_back (it.first->phiMove);
+	for (auto& phi : vectorLoop->reductions)
+		inputs.push_back (phi->phiMove);
+	inputs.insert (inputs.end (), vectorLoop->invariants.begin (), vectorLoop->invariants.end ());
+	for (auto& ins : vectorLoop->body)
+	{
+		if (ins->type != LOAD && ins->type != STORE)
+			continue;
+		streams.push_back (ins);
+		inputs.push_back (ins->type == LOAD ? s_p_c<LoadInstruction> (ins)->address : s_p_c<StoreInstruction> (ins)->address);
+		if (vectorLoop->streamBases.at (ins) != nullptr)
+			inputs.push_back (vectorLoop->streamBases.at (ins));
+	}
+	unordered_set<string> inputRegs;
+	for (auto& val : inputs)
+	{
+		if (val == nullptr || !canLoadVectorInput (val, machineFunc))
+			return res;
+		if (lValRegMap.count (val) != 0)
+			inputRegs.insert (lValRegMap.at (val));
+	}
+	// 标量寄存器：R0、R1之外，两个临时寄存器与各数组的地址；不足时借用未保存输入的R4-R12
+	vector<string> scratch = { "2", "3", "14" };
+	shared_ptr<StackIns> push = make_shared<StackIns> (NON, NONE, 0, true);
+	shared_ptr<StackIns> pop = make_shared<StackIns> (NON, NONE, 0, false);
+	for (int i = 4; i <= 12 && scratch.size () < streams.size () + 2; ++i)
+	{
+		if (inputRegs.count (to_string (i)) != 0)
+			continue;
+		scratch.push_back (to_string (i));
+		push->regs.push_back (make_shared<Operand> (REG, to_string (i)));
+	}
+	if (scratch.size () < streams.size () + 2)
+		return res;
+	pop->regs = push->regs;
+	int compensate = push->regs.size () * _W_LEN;
+	string loopLabel = "vector_loop" + to_string (vector_loop_id);
+	string skipLabel = "vector_skip" + to_string (vector_loop_id);
+	vector_loop_id++;
+	shared_ptr<Operand> iv = make_shared<Operand> (REG, "0");
+	shared_ptr<Operand> count = make_shared<Operand> (REG, "1");
+	shared_ptr<Operand> tmp1 = make_shared<Operand> (REG, scratch.at (0));
+	shared_ptr<Operand> tmp2 = make_shared<Operand> (REG, scratch.at (1));
+	shared_ptr<Operand> zero = make_shared<Operand> (IMM, "0");
+	shared_ptr<Operand> one = make_shared<Operand> (IMM, "1");
+	if (!push->regs.empty ())
+		res.push_back (push);
+
+	// 向量迭代次数：(bound - iv - 1) / 4，"<="时为 (bound - iv) / 4，保证原循环至少执行一次
+	shared_ptr<Value> ivMove = vectorLoop->iv->phiMove;
+	loadVal2Reg (ivMove, iv, machineFunc, res, true, compensate, "0");
+	loadVal2Reg (vectorLoop->bound, count, machineFunc, res, true, compensate, "1");
+	res.push_back (make_shared<CmpIns> (NON, NONE, 0, count, iv));
+	res.push_back (make_shared<BIns> (LE, NONE, 0, skipLabel));
+	res.push_back (make_shared<BinaryIns> (mit::SUB, NON, NONE, 0, count, iv, count));
+	if (vectorLoop->op == "<")
+		res.push_back (make_shared<BinaryIns> (mit::SUB, NON, NONE, 0, count, one, count));
+	res.push_back (make_shared<BinaryIns> (mit::LSR, NON, NONE, 2, count, count, count));
+	res.push_back (make_shared<CmpIns> (NON, NONE, 0, count, zero));
+	res.push_back (make_shared<BIns> (LE, NONE, 0, skipLabel));
+
+	// 各数组的起始地址：address + (iv + 不变量 + 常数) * 4
+	unordered_map<shared_ptr<Instruction>, shared_ptr<Operand>> streamRegs;
+	for (unsigned int i = 0; i < streams.size (); ++i)
+	{
+		shared_ptr<Instruction> ins = streams.at (i);
+		shared_ptr<Operand> ptr = make_shared<Operand> (REG, scratch.at (i + 2));
+		shared_ptr<Value> address = ins->type == LOAD ? s_p_c<LoadInstruction> (ins)->address : s_p_c<StoreInstruction> (ins)->address;
+		loadVal2Reg (address, ptr, machineFunc, res, true, compensate, ptr->value);
+		res.push_back (make_shared<BinaryIns> (mit::ADD, NON, LSL, 2, ptr, iv, ptr));
+		if (vectorLoop->streamBases.at (ins) != nullptr)
+		{
+			loadVal2Reg (vectorLoop->streamBases.at (ins), tmp1, machineFunc, res, true, compensate, tmp1->value);
+			res.push_back (make_shared<BinaryIns> (mit::ADD, NON, LSL, 2, ptr, tmp1, ptr));
+		}
+		addImm2Reg (ptr, vectorLoop->streamOffsets.at (ins) * _W_LEN, tmp1, res);
+		streamRegs[ins] = ptr;
+	}
+	// 不变量广播到各通道，线性phi的各通道依次加步长，累加值清零
+	for (auto& val : vectorLoop->invariants)
+	{
+		shared_ptr<Operand> q = make_shared<Operand> (QREG, to_string (vectorLoop->vectorRegs.at (val)));
+		loadVal2Reg (val, tmp1, machineFunc, res, true, compensate, tmp1->value);
+		res.push_back (make_shared<VectorMovIns> (mit::VDUP, q, tmp1, 0));
+	}
+	for (auto& induction : vectorLoop->inductions)
+	{
+		shared_ptr<Operand> q = make_shared<Operand> (QREG, to_string (vectorLoop->vectorRegs.at (induction.first)));
+		shared_ptr<Operand> step = make_shared<Operand> (QREG, to_string (vectorLoop->stepRegs.at (induction.first)));
+		shared_ptr<Value> move = induction.first->phiMove;
+		loadVal2Reg (move, tmp1, machineFunc, res, true, compensate, tmp1->value);
+		for (int lane = 0; lane < (int)_VECTOR_WIDTH; ++lane)
+		{
+			if (lane != 0)
+				addImm2Reg (tmp1, induction.second, tmp2, res);
+			res.push_back (make_shared<VectorMovIns> (mit::VMOV_LANE, q, tmp1, lane));
+		}
+		loadImm2Reg (induction.second * (int)_VECTOR_WIDTH, tmp1, res, true);
+		res.push_back (make_shared<VectorMovIns> (mit::VDUP, step, tmp1, 0));
+	}
+	unordered_map<shared_ptr<Instruction>, shared_ptr<PhiInstruction>> reductionUpdates;
+	for (auto& phi : vectorLoop->reductions)
+	{
+		shared_ptr<Operand> acc = make_shared<Operand> (QREG, to_string (vectorLoop->vectorRegs.at (phi)));
+		res.push_back (make_shared<VectorMovIns> (mit::VMOV_IMM, acc, zero, 0));
+		reductionUpdates[s_p_c<Instruction> (phi->operands.at (vectorLoop->latch))] = phi;
+	}
+	// 线性phi的结果与累加无关，在循环前写入：phi + 步长 * 4 * 次数
+	for (auto& it : vectorLoop->linearSteps)
+	{
+		if (it.first == vectorLoop->iv)
+			res.push_back (make_shared<BinaryIns> (mit::ADD, NON, LSL, 2, iv, count, tmp1));
+		else
+		{
+			shared_ptr<Value> move = it.first->phiMove;
+			loadVal2Reg (move, tmp1, machineFunc, res, true, compensate, tmp1->value);
+			loadImm2Reg (it.second * (int)_VECTOR_WIDTH, tmp2, res, true);
+			res.push_back (make_shared<BinaryIns> (mit::MUL, NON, NONE, 0, tmp2, count, tmp2));
+			res.push_back (make_shared<BinaryIns> (mit::ADD, NON, NONE, 0, tmp1, tmp2, tmp1));
+		}
+		storeVectorOutput (it.first->phiMove, tmp1, tmp2, machineFunc, res, compensate);
+	}
+
+	// 向量循环体
+	res.push_back (make_shared<GlobalIns> (loopLabel, ""));
+	for (auto& ins : vectorLoop->body)
+	{
+		if (ins->type == LOAD)
+		{
+			shared_ptr<Operand> q = make_shared<Operand> (QREG, to_string (vectorLoop->vectorRegs.at (ins)));
+			res.push_back (make_shared<VectorMemoryIns> (mit::VLD1, q, streamRegs.at (ins)));
+		}
+		else if (ins->type == STORE)
+		{
+			shared_ptr<Operand> q = make_shared<Operand> (QREG, to_string (vectorLoop->vectorRegs.at (s_p_c<StoreInstruction> (ins)->value)));
+			res.push_back (make_shared<VectorMemoryIns> (mit::VST1, q, streamRegs.at (ins)));
+		}
+		else if (vectorLoop->fusedMultiplies.count (ins) != 0)  // acc += a * b
+		{
+			shared_ptr<BinaryInstruction> mul = s_p_c<BinaryInstruction> (vectorLoop->fusedMultiplies.at (ins));
+			shared_ptr<Operand> acc = make_shared<Operand> (QREG, to_string (vectorLoop->vectorRegs.at (ins)));
+			shared_ptr<Operand> op1 = make_shared<Operand> (QREG, to_string (vectorLoop->vectorRegs.at (mul->lhs)));
+			shared_ptr<Operand> op2 = make_shared<Operand> (QREG, to_string (vectorLoop->vectorRegs.at (mul->rhs)));
+			res.push_back (make_shared<VectorBinaryIns> (mit::VMLA, op1, op2, acc));
+		}
+		else if (reductionUpdates.count (ins) != 0)  // acc += x，减法的累加在循环后从初值中减去
+		{
+			shared_ptr<BinaryInstruction> update = s_p_c<BinaryInstruction> (ins);
+			shared_ptr<Value> value = update->lhs == reductionUpdates.at (ins) ? update->rhs : update->lhs;
+			shared_ptr<Operand> acc = make_shared<Operand> (QREG, to_string (vectorLoop->vectorRegs.at (ins)));
+			shared_ptr<Operand> op2 = make_shared<Operand> (QREG, to_string (vectorLoop->vectorRegs.at (value)));
+			res.push_back (make_shared<VectorBinaryIns> (mit::VADD, acc, op2, acc));
+		}
+		else
+		{
+			shared_ptr<BinaryInstruction> bi = s_p_c<BinaryInstruction> (ins);
+			mit::InsType type = bi->op == "+" ? mit::VADD : bi->op == "-" ? mit::VSUB : mit::VMUL;
+			shared_ptr<Operand> rd = make_shared<Operand> (QREG, to_string (vectorLoop->vectorRegs.at (ins)));
+			shared_ptr<Operand> op1 = make_shared<Operand> (QREG, to_string (vectorLoop->vectorRegs.at (bi->lhs)));
+			shared_ptr<Operand> op2 = make_shared<Operand> (QREG, to_string (vectorLoop->vectorRegs.at (bi->rhs)));
+			res.push_back (make_shared<VectorBinaryIns> (type, op1, op2, rd));
+		}
+	}
+	for (auto& induction : vectorLoop->inductions)
+	{
+		shared_ptr<Operand> q = make_shared<Operand> (QREG, to_string (vectorLoop->vectorRegs.at (induction.first)));
+		shared_ptr<Operand> step = make_shared<Operand> (QREG, to_string (vectorLoop->stepRegs.at (induction.first)));
+		res.push_back (make_shared<VectorBinaryIns> (mit::VADD, q, step, q));
+	}
+	res.push_back (make_shared<BinaryIns> (mit::SUB, NON, NONE, 0, count, one, count));
+	res.push_back (make_shared<CmpIns> (NON, NONE, 0, count, zero));
+	res.push_back (make_shared<BIns> (GT, NONE, 0, loopLabel));
+
+	// 累加值：各通道求和后与初值相加（减）
+	for (auto& phi : vectorLoop->reductions)
+	{
+		shared_ptr<Operand> acc = make_shared<Operand> (QREG, to_string (vectorLoop->vectorRegs.at (phi)));
+		shared_ptr<BinaryInstruction> update = s_p_c<BinaryInstruction> (phi->operands.at (vectorLoop->latch));
+		shared_ptr<Value> move = phi->phiMove;
+		res.push_back (make_shared<VectorMovIns> (mit::VMOV_LANE, tmp1, acc, 0));
+		for (int lane = 1; lane < (int)_VECTOR_WIDTH; ++lane)
+		{
+			res.push_back (make_shared<VectorMovIns> (mit::VMOV_LANE, tmp2, acc, lane));
+			res.push_back (make_shared<BinaryIns> (mit::ADD, NON, NONE, 0, tmp1, tmp2, tmp1));
+		}
+		loadVal2Reg (move, tmp2, machineFunc, res, true, compensate, tmp2->value);
+		res.push_back (make_shared<BinaryIns> (update->op == "+" ? mit::ADD : mit::SUB, NON, NONE, 0, tmp2, tmp1, tmp1));
+		storeVectorOutput (move, tmp1, tmp2, machineFunc, res, compensate);
+	}
+	res.push_back (make_shared<GlobalIns> (skipLabel, ""));
+	if (!pop->regs.empty ())
+		res.push_back (pop);
+	return res;
+}
+
+/**
+ * @brief 寻找块中的SLP打包；打包读入的值须在生成处可读：能从寄存器或栈读入，或是块中此前生成的左值
+ * @param bb 
+ * @param machineFunc 
+ */
+void findSlpPacks (shared_ptr<BasicBlock>& bb, shared_ptr<MachineFunc>& machineFunc)
+{
+	slpPositions.clear ();
+	slpReplaced.clear ();
+	if (functionAlias == nullptr)
+		return;
+	vector<shared_ptr<SlpPack>> packs;
+	SlpPack::analyse (bb, *functionAlias, packs);
+	for (auto& pack : packs)
+	{
+		bool valid = true;
+		for (auto& val : pack->inputs)
+		{
+			bool defined = val->value_type == INSTRUCTION && s_p_c<Instruction> (val)->block == bb && s_p_c<Instruction> (val)->resultType == L_VAL_RESULT;
+			valid = valid && (defined || canLoadVectorInput (val, machineFunc));
+		}
+		if (!valid)
+			continue;
+		slpPositions[pack->position] = pack;
+		slpReplaced.insert (pack->replaced.begin (), pack->replaced.end ());
+	}
+}
+
+/**
+ * @brief 读入打包使用的标量值：已在左值寄存器中的直接使用，否则加载至tmp
+ * @param val 
+ * @param tmp 
+ * @param machineFunc 
+ * @param res 
+ * @param compensate 相对于当前sp的偏移量
+ * @return 值所在的寄存器
+ */
+shared_ptr<Operand> readSlpInput (shared_ptr<Value>& val, shared_ptr<Operand>& tmp, shared_ptr<MachineFunc>& machineFunc,
+								  vector<shared_ptr<MachineIns>>& res, int compensate)
+{
+	if (lValRegMap.count (val) != 0)
+		return make_shared<Operand> (REG, lValRegMap.at (val));
+	loadVal2Reg (val, tmp, machineFunc, res, true, compensate, tmp->value);
+	return tmp;
+}
+
+/**
+ * @brief 生成SLP打包的向量指令：按后序，load、store先计算首地址，广播与插入逐个读入标量值
+ * @param pack 
+ * @param machineFunc 
+ * @return 机器指令
+ */
+vector<shared_ptr<MachineIns>> genSlpPack (shared_ptr<SlpPack>& pack, shared_ptr<MachineFunc>& machineFunc)
+{
+	vector<shared_ptr<MachineIns>> res;
+	// 两个标量寄存器：优先使用空闲的临时寄存器，不足时保存正在使用的临时寄存器
+	vector<string> scratch;
+	while (scratch.size () < 2 && !tempRegPool.empty ())
+		scratch.push_back (allocTempRegister ());
+	unsigned int allocated = scratch.size ();
+	vector<int> borrowed;
+	for (int i = 0; i <= 14 && scratch.size () < 2; ++i)
+	{
+		string reg = to_string (i);
+		if (find (scratch.begin (), scratch.end (), reg) != scratch.end ())
+			continue;
+		for (auto& it : rValRegMap)
+		{
+			if (it.second == reg)
+			{
+				scratch.push_back (reg);
+				borrowed.push_back (i);
+				break;
+			}
+		}
+	}
+	shared_ptr<StackIns> push = make_shared<StackIns> (NON, NONE, 0, true);
+	shared_ptr<StackIns> pop = make_shared<StackIns> (NON, NONE, 0, false);
+	for (int reg : borrowed)
+		push->regs.push_back (make_shared<Operand> (REG, to_string (reg)));
+	pop->regs = push->regs;
+	int compensate = push->regs.size () * _W_LEN;
+	if (!push->regs.empty ())
+		res.push_back (push);
+	shared_ptr<Operand> ptr = make_shared<Operand> (REG, scratch.at (0));
+	shared_ptr<Operand> tmp = make_shared<Operand> (REG, scratch.at (1));
+	for (auto& node : pack->nodes)
+	{
+		shared_ptr<Operand> q = make_shared<Operand> (QREG, to_string (node->reg));
+		switch (node->kind)
+		{
+		case SLP_LOAD:
+		case SLP_STORE:
+			loadVal2Reg (node->address, ptr, machineFunc, res, true, compensate, ptr->value);
+			if (node->index != nullptr)
+			{
+				shared_ptr<Operand> index = readSlpInput (node->index, tmp, machineFunc, res, compensate);
+				res.push_back (make_shared<BinaryIns> (mit::ADD, NON, LSL, 2, ptr, index, ptr));
+			}
+			addImm2Reg (ptr, node->constant * _W_LEN, tmp, res);
+			if (node->kind == SLP_LOAD)
+				res.push_back (make_shared<VectorMemoryIns> (mit::VLD1, q, ptr));
+			else
+			{
+				shared_ptr<Operand> value = make_shared<Operand> (QREG, to_string (node->operands.at (0)->reg));
+				res.push_back (make_shared<VectorMemoryIns> (mit::VST1, value, ptr));
+			}
+			break;
+		case SLP_BINARY:
+		{
+			mit::InsType type = node->op == "+" ? mit::VADD : node->op == "-" ? mit::VSUB : mit::VMUL;
+			shared_ptr<Operand> op1 = make_shared<Operand> (QREG, to_string (node->operands.at (0)->reg));
+			shared_ptr<Operand> op2 = make_shared<Operand> (QREG, to_string (node->operands.at (1)->reg));
+			res.push_back (make_shared<VectorBinaryIns> (type, op1, op2, q));
+			break;
+		}
+		case SLP_SPLAT:
+		{
+			shared_ptr<Operand> value = readSlpInput (node->lanes.at (0), tmp, machineFunc, res, compensate);
+			res.push_back (make_shared<VectorMovIns> (mit::VDUP, q, value, 0));
+			break;
+		}
+		case SLP_GATHER:
+			for (int lane = 0; lane < (int)_VECTOR_WIDTH; ++lane)
+			{
+				shared_ptr<Operand> value = readSlpInput (node->lanes.at (lane), tmp, machineFunc, res, compensate);
+				res.push_back (make_shared<VectorMovIns> (mit::VMOV_LANE, q, value, lane));
+			}
+			break;
+		}
+	}
+	if (!pop->regs.empty ())
+		res.push_back (pop);
+	for (unsigned int i = 0; i < allocated; ++i)
+		releaseTempRegister (scratch.at (i));
+	slp_pack_count++;
+	return res;
+}
+
 string BinaryIns::toString ()
 {
 	string type = instype2string.at (this->type);
@@ -1892,6 +3515,36 @@ string GlobalIns::toString ()
 	return out;
 }
 
+string VectorMemoryIns::toString ()
+{
+	string type = instype2string.at (this->type);
+	string op1 = state2string.at (rd->state) + rd->value;
+	string op2 = state2string.at (base->state) + base->value;
+	string out = type + " {" + op1 + "}, [" + op2 + "]!";
+	return out;
+}
+
+string VectorBinaryIns::toString ()
+{
+	string type = instype2string.at (this->type);
+	string op1_ = state2string.at (op1->state) + op1->value;
+	string op2_ = state2string.at (op2->state) + op2->value;
+	string rd_ = state2string.at (rd->state) + rd->value;
+	string out = type + " " + rd_ + ", " + op1_ + ", " + op2_;
+	return out;
+}
+
+string VectorMovIns::toString ()
+{
+	string type = instype2string.at (this->type);
+	string des_ = state2string.at (des->state) + des->value;
+	string src_ = state2string.at (src->state) + src->value;
+	string out = type + " " + des_ + ", " + src_;
+	if (this->type == mit::VMOV_LANE)
+		out += " [" + to_string (lane) + "]";
+	return out;
+}
+
 string Comment::toString ()
 {
 	return content;
@@ -109,18 +109,7 @@ int main(int argc, char **argv)
     else 
     {
         fixRightValue(module);
-        for (auto &func : module->functions)
-        {
-            phi_elimination(func);
-            getFunctionRequiredStackSize(func);
-        }
-        if (_debugIr)
-        {
-            ofstream irStream;
-            irStream.open(debugMessageDirectory + "final_ir.txt", ios::out | ios::trunc);
-            irStream << module->toString() << endl;
-            irStream.close();
-        }
+        endOptimize(module, optimizeLevel);
     }
 
     cout << "[Machine IR]" << endl
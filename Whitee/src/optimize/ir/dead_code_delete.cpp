@@ -78,9 +78,17 @@ void dead_code_delete(shared_ptr<Module> &module)
     {
         unused_block_delete(func);
         auto blocks = func->blocks;
-        for (auto &bb : blocks)
+        bool changed = true;
+        while (changed)  // abandonUse会使不再被使用的操作数级联失效，而操作数可能已被遍历过，重复直至不再变化
         {
-            unused_instruction_delete(bb);
+            changed = false;
+            for (auto &bb : blocks)
+            {
+                size_t insCnt = bb->instructions.size();
+                unused_instruction_delete(bb);
+                if (bb->instructions.size() != insCnt)
+                    changed = true;
+            }
         }
     }
     fixRightValue(module);
@@ -32,11 +32,11 @@ void endOptimize(shared_ptr<Module> &module, OptimizeLevel level)
     }
     for (auto &func : module->functions)
     {
+        calculateVariableWeight(func);
         if (level >= O1)
-        {
-            calculateVariableWeight(func);
             registerAlloc(func);
-        }
+        else
+            linearScanRegisterAlloc(func);  // 快速编译：线性扫描代替图着色
         getFunctionRequiredStackSize(func);
         mergeAliveValuesToInstruction(func);
     }
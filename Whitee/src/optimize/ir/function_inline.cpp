@@ -0,0 +1,302 @@
+﻿#include "ir_optimize.h"
+
+#include <algorithm>
+
+const unsigned int _INLINE_BASE_INS_CNT = 30;           // 不在循环中的调用点，可内联的被调函数指令数
+const unsigned int _INLINE_LOOP_INS_CNT = 40;           // 调用点每深一层循环，增加的可内联指令数
+const unsigned int _INLINE_MAX_INS_CNT = 150;           // 多个调用点时，可内联的被调函数最大指令数
+const unsigned int _INLINE_SINGLE_CALL_INS_CNT = 400;   // 唯一调用点内联后原函数可删除，放宽限制
+const unsigned int _INLINE_CALLER_MAX_INS_CNT = 3000;   // 调用者内联后的最大指令数
+const unsigned int _INLINE_MAX_LOCAL_ARRAY_CNT = 0;     // 被调函数中的局部数组数
+
+void visitCallGraph(const shared_ptr<Function> &func, unordered_set<shared_ptr<Function>> &visited, vector<shared_ptr<Function>> &postOrder);
+
+bool isRecursive(const shared_ptr<Function> &func);
+
+unsigned int countInstructions(const shared_ptr<Function> &func);
+
+unsigned int countCallSites(const shared_ptr<Function> &caller, const shared_ptr<Function> &callee);
+
+void inlineCallSites(shared_ptr<Function> &caller, unordered_set<shared_ptr<Function>> &recursive);
+
+void inlineCallSite(shared_ptr<Function> &caller, shared_ptr<InvokeInstruction> &invoke);
+
+/**
+ * @brief 函数内联：按调用图后序（被调函数先于调用者）处理，被调函数已完成内联后再决定是否展开到调用者中；
+ *        预算由被调函数大小与调用点所在循环深度决定，递归函数不内联
+ * @param module 
+ */
+void functionInline(shared_ptr<Module> &module)
+{
+    unordered_set<shared_ptr<Function>> visited;
+    vector<shared_ptr<Function>> postOrder;
+    for (auto &func : module->functions)
+        visitCallGraph(func, visited, postOrder);
+    unordered_set<shared_ptr<Function>> recursive;
+    for (auto &func : postOrder)
+    {
+        if (isRecursive(func))
+            recursive.insert(func);
+    }
+    for (auto &func : postOrder)
+    {
+        if (func->valid)
+            inlineCallSites(func, recursive);
+    }
+}
+
+/**
+ * @brief 调用图的后序遍历
+ * @param func 
+ * @param visited 已访问的函数
+ * @param postOrder 后序
+ */
+void visitCallGraph(const shared_ptr<Function> &func, unordered_set<shared_ptr<Function>> &visited, vector<shared_ptr<Function>> &postOrder)
+{
+    if (visited.count(func) != 0)
+        return;
+    visited.insert(func);
+    for (auto &callee : func->callees)
+        visitCallGraph(callee, visited, postOrder);
+    postOrder.push_back(func);
+}
+
+/**
+ * @brief 函数能否经调用图回到自身（直接或间接递归）
+ * @param func 
+ * @return true 递归；false 非递归
+ */
+bool isRecursive(const shared_ptr<Function> &func)
+{
+    unordered_set<shared_ptr<Function>> visited;
+    vector<shared_ptr<Function>> workList(func->callees.begin(), func->callees.end());
+    while (!workList.empty())
+    {
+        shared_ptr<Function> f = workList.back();
+        workList.pop_back();
+        if (f == func)
+            return true;
+        if (visited.count(f) != 0)
+            continue;
+        visited.insert(f);
+        workList.insert(workList.end(), f->callees.begin(), f->callees.end());
+    }
+    return false;
+}
+
+/**
+ * @brief 函数的指令数，包括phi
+ * @param func 
+ * @return 指令数
+ */
+unsigned int countInstructions(const shared_ptr<Function> &func)
+{
+    unsigned int cnt = 0;
+    for (auto &bb : func->blocks)
+        cnt += bb->instructions.size() + bb->phis.size();
+    return cnt;
+}
+
+/**
+ * @brief caller中调用callee的次数
+ * @param caller 
+ * @param callee 
+ * @return 调用点数
+ */
+unsigned int countCallSites(const shared_ptr<Function> &caller, const shared_ptr<Function> &callee)
+{
+    unsigned int cnt = 0;
+    for (auto &bb : caller->blocks)
+    {
+        for (auto &ins : bb->instructions)
+        {
+            if (ins->type == INVOKE && s_p_c<InvokeInstruction>(ins)->invokeType == COMMON && s_p_c<InvokeInstruction>(ins)->targetFunction == callee)
+                ++cnt;
+        }
+    }
+    return cnt;
+}
+
+/**
+ * @brief 内联caller中满足预算的调用点
+ * @param caller 调用者
+ * @param recursive 递归函数
+ */
+void inlineCallSites(shared_ptr<Function> &caller, unordered_set<shared_ptr<Function>> &recursive)
+{
+    vector<shared_ptr<InvokeInstruction>> callSites;
+    for (auto &bb : caller->blocks)
+    {
+        for (auto &ins : bb->instructions)
+        {
+            if (ins->type != INVOKE || s_p_c<InvokeInstruction>(ins)->invokeType != COMMON)
+                continue;
+            shared_ptr<InvokeInstruction> invoke = s_p_c<InvokeInstruction>(ins);
+            if (invoke->targetFunction != caller && recursive.count(invoke->targetFunction) == 0)
+                callSites.push_back(invoke);
+        }
+    }
+    unsigned int callerSize = countInstructions(caller);
+    for (auto &invoke : callSites)
+    {
+        shared_ptr<Function> callee = invoke->targetFunction;
+        unsigned int calleeSize = countInstructions(callee);
+        unsigned int budget;
+        if (callee->callers.size() == 1 && countCallSites(caller, callee) == 1)
+            budget = _INLINE_SINGLE_CALL_INS_CNT;
+        else
+            budget = min(_INLINE_BASE_INS_CNT + invoke->block->loopDepth * _INLINE_LOOP_INS_CNT, _INLINE_MAX_INS_CNT);
+        if (callerSize + calleeSize > _INLINE_CALLER_MAX_INS_CNT || !callee->fitInline(budget, _INLINE_MAX_LOCAL_ARRAY_CNT))
+            continue;
+        inlineCallSite(caller, invoke);
+        callerSize += calleeSize;
+    }
+}
+
+/**
+ * @brief 将一个调用点替换为被调函数体：调用所在块在调用后拆分，复制的函数体夹在两者之间，
+ *        参数替换为实参，返回指令改为跳转到拆分出的块，多个返回值由phi汇合
+ * @param caller 调用者
+ * @param invoke 调用指令
+ */
+void inlineCallSite(shared_ptr<Function> &caller, shared_ptr<InvokeInstruction> &invoke)
+{
+    shared_ptr<Function> callee = invoke->targetFunction;
+    shared_ptr<BasicBlock> callBlock = invoke->block;
+
+    // 1. 在调用指令后拆分块，后继改由拆分出的块连接
+    shared_ptr<BasicBlock> returnBlock = make_shared<BasicBlock>(caller, true, callBlock->loopDepth);
+    auto pos = find(callBlock->instructions.begin(), callBlock->instructions.end(), invoke);
+    for (auto it = pos + 1; it != callBlock->instructions.end(); ++it)
+    {
+        (*it)->block = returnBlock;
+        returnBlock->instructions.push_back(*it);
+    }
+    callBlock->instructions.erase(pos, callBlock->instructions.end());
+    for (auto suc : callBlock->successors)
+    {
+        suc->predecessors.erase(callBlock);
+        suc->predecessors.insert(returnBlock);
+        returnBlock->successors.insert(suc);
+        for (auto &phi : suc->phis)
+            phi->replaceUse(callBlock, returnBlock);
+    }
+    callBlock->successors.clear();
+
+    // 2. 复制被调函数的可达块，按逆后序保证定义先于使用
+    unordered_map<shared_ptr<Value>, shared_ptr<Value>> valueMap;
+    unordered_map<shared_ptr<BasicBlock>, shared_ptr<BasicBlock>> blockMap;
+    for (size_t i = 0; i < callee->params.size(); ++i)
+        valueMap[callee->params.at(i)] = invoke->params.at(i);
+    DominatorTree domTree(callee);
+    vector<shared_ptr<BasicBlock>> newBlocks;
+    unsigned int baseDepth = callee->entryBlock->loopDepth;  // 被调函数的循环深度从0开始计
+    for (auto &bb : domTree.reversePostOrder)
+    {
+        unsigned int depth = bb->loopDepth > baseDepth ? bb->loopDepth - baseDepth : 0;
+        shared_ptr<BasicBlock> newBlock = make_shared<BasicBlock>(caller, true, callBlock->loopDepth + depth);
+        blockMap[bb] = newBlock;
+        newBlocks.push_back(newBlock);
+    }
+    vector<pair<shared_ptr<PhiInstruction>, shared_ptr<PhiInstruction>>> phis;  // (原phi, 复制的phi)
+    vector<pair<shared_ptr<BasicBlock>, shared_ptr<Value>>> returnValues;      // (返回块, 返回值)
+    for (auto &bb : domTree.reversePostOrder)
+    {
+        shared_ptr<BasicBlock> newBlock = blockMap.at(bb);
+        for (auto &phi : bb->phis)
+        {
+            shared_ptr<PhiInstruction> newPhi = make_shared<PhiInstruction>(phi->localVarName, newBlock);
+            newBlock->phis.insert(newPhi);
+            valueMap[phi] = newPhi;
+            phis.emplace_back(phi, newPhi);
+        }
+        for (auto &ins : bb->instructions)
+        {
+            shared_ptr<Instruction> newIns;
+            if (ins->type == RET)
+            {
+                newIns = make_shared<JumpInstruction>(returnBlock, newBlock);
+                shared_ptr<Value> value = s_p_c<ReturnInstruction>(ins)->value;
+                if (value != nullptr)
+                    returnValues.emplace_back(newBlock, mapValue(valueMap, value));
+                newBlock->successors.insert(returnBlock);
+                returnBlock->predecessors.insert(newBlock);
+            }
+            else
+            {
+                newIns = cloneInstruction(ins, newBlock, valueMap, blockMap);
+                valueMap[ins] = newIns;
+            }
+            newBlock->instructions.push_back(newIns);
+        }
+        for (auto &suc : bb->successors)
+        {
+            if (blockMap.count(suc) != 0)
+            {
+                newBlock->successors.insert(blockMap.at(suc));
+                blockMap.at(suc)->predecessors.insert(newBlock);
+            }
+        }
+    }
+    for (auto &it : phis)
+    {
+        for (auto &operand : it.first->operands)
+        {
+            if (blockMap.count(operand.first) == 0)  // 不可达的前驱
+                continue;
+            shared_ptr<Value> value = mapValue(valueMap, operand.second);
+            it.second->operands[blockMap.at(operand.first)] = value;
+            value->users.insert(it.second);
+        }
+    }
+
+    // 3. 调用结果替换为返回值
+    if (!invoke->users.empty())
+    {
+        shared_ptr<Value> result;
+        string name = generatePhiLeftValueName(callee->name);
+        if (returnValues.empty())  // 被调函数不返回
+        {
+            result = make_shared<UndefinedValue>(name);
+        }
+        else if (returnValues.size() == 1)
+        {
+            result = returnValues.front().second;
+        }
+        else
+        {
+            shared_ptr<PhiInstruction> phi = make_shared<PhiInstruction>(name, returnBlock);
+            for (auto &it : returnValues)
+            {
+                phi->operands[it.first] = it.second;
+                it.second->users.insert(phi);
+            }
+            returnBlock->phis.insert(phi);
+            result = phi;
+        }
+        unordered_set<shared_ptr<Value>> users = invoke->users;
+        shared_ptr<Value> toBeReplaced = invoke;
+        for (auto &user : users)
+            user->replaceUse(toBeReplaced, result);
+        invoke->users.clear();
+    }
+
+    // 4. 删除调用，跳转到复制的入口块
+    for (auto &param : invoke->params)
+        param->users.erase(invoke);
+    invoke->valid = false;
+    shared_ptr<BasicBlock> entry = blockMap.at(callee->entryBlock);
+    callBlock->instructions.push_back(make_shared<JumpInstruction>(entry, callBlock));
+    callBlock->successors.insert(entry);
+    entry->predecessors.insert(callBlock);
+
+    auto blockPos = find(caller->blocks.begin(), caller->blocks.end(), callBlock) + 1;
+    newBlocks.push_back(returnBlock);
+    caller->blocks.insert(blockPos, newBlocks.begin(), newBlocks.end());
+
+    if (countCallSites(caller, callee) == 0)
+    {
+        caller->callees.erase(callee);
+        callee->callers.erase(caller);
+    }
+}
@@ -0,0 +1,269 @@
+﻿#include "ir_optimize.h"
+
+#include "../../basic/std/compile_std.h"
+
+#include <algorithm>
+#include <map>
+#include <stack>
+
+void move_function_codes(shared_ptr<Function> &func);
+
+bool is_pinned_instruction(const shared_ptr<Instruction> &ins);
+
+shared_ptr<BasicBlock> schedule_early(shared_ptr<Instruction> &ins, shared_ptr<BasicBlock> &entry, unordered_map<shared_ptr<Instruction>, shared_ptr<BasicBlock>> &earlyBlocks,
+                                      unordered_map<shared_ptr<BasicBlock>, unsigned int> &domDepth);
+
+shared_ptr<BasicBlock> schedule_late(shared_ptr<Instruction> &ins, DominatorTree &domTree, unordered_map<shared_ptr<BasicBlock>, unsigned int> &domDepth);
+
+shared_ptr<BasicBlock> find_common_dominator(shared_ptr<BasicBlock> a, shared_ptr<BasicBlock> b, DominatorTree &domTree, unordered_map<shared_ptr<BasicBlock>, unsigned int> &domDepth);
+
+bool is_less_frequent(shared_ptr<BasicBlock> &from, shared_ptr<BasicBlock> &to);
+
+bool insert_before_first_use(shared_ptr<BasicBlock> &bb, shared_ptr<Instruction> &ins);
+
+/**
+ * @brief 全局代码移动（Click GCM）：phi、跳转、访存、调用固定在原块，其余运算先求最早可放的块（操作数都已定义），
+ *        再求最晚可放的块（使用的最近公共支配者），在两者之间的支配树路径上选循环最浅、最靠后的块；
+ *        循环深度不变时，只有目标块执行得更少才下沉
+ * @param module 
+ */
+void global_code_motion(shared_ptr<Module> &module)
+{
+    for (auto &func : module->functions)
+    {
+        if (func->entryBlock != nullptr)
+            move_function_codes(func);
+    }
+}
+
+/**
+ * @brief 对一个函数进行全局代码移动：逆后序求最早块，其逆序（使用先于定义）求最晚块并立即移动
+ * @param func 
+ */
+void move_function_codes(shared_ptr<Function> &func)
+{
+    DominatorTree domTree(func);
+    if (domTree.reversePostOrder.size() != func->blocks.size())  // 有不可达块
+        return;
+    LoopInfo loopInfo(domTree);
+    unordered_map<shared_ptr<BasicBlock>, unsigned int> domDepth;   // 块 --> 支配树深度
+    unordered_map<shared_ptr<BasicBlock>, unsigned int> loopDepth;  // 块 --> 所在最内层循环的深度
+    for (auto &bb : domTree.reversePostOrder)
+    {
+        domDepth[bb] = bb == func->entryBlock ? 0 : domDepth.at(domTree.idom.at(bb)) + 1;
+        loopDepth[bb] = 0;
+    }
+    for (auto &loop : loopInfo.loops)  // 外层循环在前，内层覆盖外层
+    {
+        for (auto bb : loop->blocks)
+            loopDepth[bb] = loop->depth;
+    }
+
+    map<pair<shared_ptr<BasicBlock>, shared_ptr<BasicBlock>>, bool> lessFrequent;  // (原块, 下沉的块) --> 下沉的块是否执行得更少
+    unordered_map<shared_ptr<Instruction>, shared_ptr<BasicBlock>> earlyBlocks;
+    vector<shared_ptr<Instruction>> floating;  // 可移动的指令，按逆后序
+    for (auto &bb : domTree.reversePostOrder)
+    {
+        for (auto &ins : bb->instructions)
+        {
+            if (is_pinned_instruction(ins))
+                continue;
+            earlyBlocks[ins] = schedule_early(ins, func->entryBlock, earlyBlocks, domDepth);
+            floating.push_back(ins);
+        }
+    }
+
+    for (auto it = floating.rbegin(); it != floating.rend(); ++it)
+    {
+        shared_ptr<Instruction> ins = *it;
+        shared_ptr<BasicBlock> early = earlyBlocks.at(ins);
+        shared_ptr<BasicBlock> late = schedule_late(ins, domTree, domDepth);
+        if (late == nullptr || !domTree.dominates(early, late))
+            continue;
+        shared_ptr<BasicBlock> best = late;  // 循环深度相同时取更靠后的块，只在需要的路径上计算
+        for (shared_ptr<BasicBlock> bb = late; bb != early;)
+        {
+            bb = domTree.idom.at(bb);
+            if (loopDepth.at(bb) < loopDepth.at(best))
+                best = bb;
+        }
+        if (best == ins->block)
+            continue;
+        if (loopDepth.at(best) == loopDepth.at(ins->block))
+        {
+            pair<shared_ptr<BasicBlock>, shared_ptr<BasicBlock>> sink(ins->block, best);
+            if (lessFrequent.count(sink) == 0)
+                lessFrequent[sink] = is_less_frequent(ins->block, best);
+            if (!lessFrequent.at(sink))
+                continue;
+        }
+        vector<shared_ptr<Instruction>> &oldInstructions = ins->block->instructions;
+        oldInstructions.erase(find(oldInstructions.begin(), oldInstructions.end(), ins));
+        ins->block = best;
+        if (!insert_before_first_use(best, ins) && ins->resultType == R_VAL_RESULT)  // 不再紧邻唯一的使用
+        {
+            ins->resultType = L_VAL_RESULT;
+            ins->caughtVarName = generateTempLeftValueName();
+        }
+    }
+}
+
+/**
+ * @brief 只有一元、二元运算可以移动；比较与跳转相邻，访存、调用有顺序要求，phi、跳转、返回固定
+ * @param ins 
+ * @return 
+ */
+bool is_pinned_instruction(const shared_ptr<Instruction> &ins)
+{
+    return ins->type != UNARY && ins->type != BINARY;
+}
+
+/**
+ * @brief 最早块：操作数所在块（可移动的操作数为其最早块）中支配树最深的块，没有指令操作数时为入口块
+ * @param ins 
+ * @param entry 
+ * @param earlyBlocks 已求出的最早块
+ * @param domDepth 
+ * @return 
+ */
+shared_ptr<BasicBlock> schedule_early(shared_ptr<Instruction> &ins, shared_ptr<BasicBlock> &entry, unordered_map<shared_ptr<Instruction>, shared_ptr<BasicBlock>> &earlyBlocks,
+                                      unordered_map<shared_ptr<BasicBlock>, unsigned int> &domDepth)
+{
+    vector<shared_ptr<Value>> operands;
+    if (ins->type == UNARY)
+        operands.push_back(s_p_c<UnaryInstruction>(ins)->value);
+    else
+    {
+        operands.push_back(s_p_c<BinaryInstruction>(ins)->lhs);
+        operands.push_back(s_p_c<BinaryInstruction>(ins)->rhs);
+    }
+    shared_ptr<BasicBlock> early = entry;
+    for (auto &operand : operands)
+    {
+        if (operand->value_type != INSTRUCTION)
+            continue;
+        shared_ptr<Instruction> operandIns = s_p_c<Instruction>(operand);
+        shared_ptr<BasicBlock> bb = earlyBlocks.count(operandIns) != 0 ? earlyBlocks.at(operandIns) : operandIns->block;
+        if (domDepth.at(bb) > domDepth.at(early))
+            early = bb;
+    }
+    return early;
+}
+
+/**
+ * @brief 最晚块：所有使用所在块的最近公共支配者，phi的使用在对应的前驱块末尾
+ * @param ins 
+ * @param domTree 
+ * @param domDepth 
+ * @return 没有使用或使用不是指令时为nullptr
+ */
+shared_ptr<BasicBlock> schedule_late(shared_ptr<Instruction> &ins, DominatorTree &domTree, unordered_map<shared_ptr<BasicBlock>, unsigned int> &domDepth)
+{
+    shared_ptr<BasicBlock> late;
+    for (auto &user : ins->users)
+    {
+        if (user->value_type != INSTRUCTION)
+            return nullptr;
+        shared_ptr<Instruction> userIns = s_p_c<Instruction>(user);
+        if (userIns->type != PHI)
+        {
+            late = find_common_dominator(late, userIns->block, domTree, domDepth);
+            continue;
+        }
+        for (auto &operand : s_p_c<PhiInstruction>(userIns)->operands)
+        {
+            if (operand.second == ins)
+                late = find_common_dominator(late, operand.first, domTree, domDepth);
+        }
+    }
+    return late;
+}
+
+/**
+ * @brief 沿支配树向上求两块的最近公共支配者
+ * @param a 为nullptr时直接返回b
+ * @param b 
+ * @param domTree 
+ * @param domDepth 
+ * @return 
+ */
+shared_ptr<BasicBlock> find_common_dominator(shared_ptr<BasicBlock> a, shared_ptr<BasicBlock> b, DominatorTree &domTree, unordered_map<shared_ptr<BasicBlock>, unsigned int> &domDepth)
+{
+    if (a == nullptr)
+        return b;
+    while (domDepth.at(a) > domDepth.at(b))
+        a = domTree.idom.at(a);
+    while (domDepth.at(b) > domDepth.at(a))
+        b = domTree.idom.at(b);
+    while (a != b)
+    {
+        a = domTree.idom.at(a);
+        b = domTree.idom.at(b);
+    }
+    return a;
+}
+
+/**
+ * @brief 下沉的块是否执行得更少：从原块出发、不经过下沉的块，能到达函数返回或回到原块
+ * @param from 
+ * @param to 
+ * @return 
+ */
+bool is_less_frequent(shared_ptr<BasicBlock> &from, shared_ptr<BasicBlock> &to)
+{
+    unordered_set<shared_ptr<BasicBlock>> visited{to};
+    stack<shared_ptr<BasicBlock>> work;
+    work.push(from);
+    while (!work.empty())
+    {
+        shared_ptr<BasicBlock> bb = work.top();
+        work.pop();
+        if (bb->instructions.back()->type == RET)
+            return true;
+        for (auto &suc : bb->successors)
+        {
+            if (suc == from)
+                return true;
+            if (visited.insert(suc).second)
+                work.push(suc);
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 插入到块中第一个使用之前（没有使用时在跳转之前），插入处尚未使用的右值不能过多，以免临时寄存器不足，且不隔开cmp与br
+ * @param bb 
+ * @param ins 
+ * @return 是否紧邻在唯一的使用之前，可以仍为右值
+ */
+bool insert_before_first_use(shared_ptr<BasicBlock> &bb, shared_ptr<Instruction> &ins)
+{
+    unordered_set<shared_ptr<Instruction>> pending;  // 已定义、在本块中尚未使用的右值
+    unsigned int pos = 0;
+    unsigned int i = 0;
+    for (; i < bb->instructions.size(); ++i)
+    {
+        shared_ptr<Instruction> &cur = bb->instructions.at(i);
+        if (pending.size() + 3 <= _TMP_REG_CNT && (i + 1 != bb->instructions.size() || pending.empty()))  // 二元运算最多占用3个临时寄存器
+            pos = i;
+        if (ins->users.count(cur) != 0 || i + 1 == bb->instructions.size())
+            break;
+        for (auto it = pending.begin(); it != pending.end();)
+        {
+            if ((*it)->users.count(cur) != 0)
+                it = pending.erase(it);
+            else
+                ++it;
+        }
+        if (cur->resultType != R_VAL_RESULT)
+            continue;
+        for (auto &user : cur->users)
+        {
+            if (user->value_type == INSTRUCTION && s_p_c<Instruction>(user)->block == bb && s_p_c<Instruction>(user)->type != PHI)
+                pending.insert(cur);
+        }
+    }
+    bb->instructions.insert(bb->instructions.begin() + pos, ins);
+    return pos == i && ins->users.size() == 1 && ins->users.count(bb->instructions.at(pos + 1)) != 0;
+}
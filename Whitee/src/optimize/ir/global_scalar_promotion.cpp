@@ -0,0 +1,235 @@
+﻿#include "ir_optimize.h"
+
+#include <algorithm>
+
+void promote_function_globals(shared_ptr<Function> &func);
+
+bool is_global_promotion_profitable(shared_ptr<Function> &func, shared_ptr<Value> &global, AliasAnalysis &aliasAnalysis);
+
+void promote_function_global(shared_ptr<Function> &func, shared_ptr<Value> &global, DominatorTree &domTree, AliasAnalysis &aliasAnalysis);
+
+bool update_promoted_dirty(shared_ptr<BasicBlock> &bb, shared_ptr<Value> &global, AliasAnalysis &aliasAnalysis, bool dirty);
+
+unsigned long long promotion_block_weight(const shared_ptr<BasicBlock> &bb);
+
+extern void replace_load(shared_ptr<Instruction> &load, const shared_ptr<Value> &value);
+
+extern void remove_store(shared_ptr<Instruction> &store);
+
+extern void make_left_value(const shared_ptr<Value> &value);
+
+/**
+ * @brief 全局标量的标量替换：函数中对全局标量的读写换为SSA值，入口load一次，
+ *        在可能读它的调用前与返回前写回（有修改时），在可能写它的调用后重新load
+ * @param module 
+ */
+void global_scalar_promotion(shared_ptr<Module> &module)
+{
+    for (auto &func : module->functions)
+    {
+        if (func->entryBlock != nullptr)
+            promote_function_globals(func);
+    }
+}
+
+/**
+ * @brief 对函数中读写的每个全局标量，收益大于代价时进行替换
+ * @param func 
+ */
+void promote_function_globals(shared_ptr<Function> &func)
+{
+    vector<shared_ptr<Value>> globals;  // 按出现顺序，保证输出稳定
+    for (auto &bb : func->blocks)
+    {
+        for (auto &ins : bb->instructions)
+        {
+            shared_ptr<Value> address = ins->type == LOAD ? s_p_c<LoadInstruction>(ins)->address : ins->type == STORE ? s_p_c<StoreInstruction>(ins)->address : nullptr;
+            if (address != nullptr && AliasAnalysis::isScalarGlobal(address) && find(globals.begin(), globals.end(), address) == globals.end())
+                globals.push_back(address);
+        }
+    }
+    if (globals.empty())
+        return;
+    DominatorTree domTree(func);
+    if (domTree.reversePostOrder.size() != func->blocks.size())  // 有不可达块
+        return;
+    AliasAnalysis aliasAnalysis(func);
+    for (auto &global : globals)
+    {
+        if (is_global_promotion_profitable(func, global, aliasAnalysis))
+            promote_function_global(func, global, domTree, aliasAnalysis);
+    }
+}
+
+/**
+ * @brief 按循环深度加权：去掉的循环中的load、store多于入口、返回与调用处增加的load、store；
+ *        循环外的冗余访问已由访存消除处理，替换只会延长入口load的活跃区间
+ * @param func 
+ * @param global 
+ * @param aliasAnalysis 
+ * @return 
+ */
+bool is_global_promotion_profitable(shared_ptr<Function> &func, shared_ptr<Value> &global, AliasAnalysis &aliasAnalysis)
+{
+    MemoryLocation location = AliasAnalysis::getLocation(global, nullptr);
+    unsigned long long benefit = 0, cost = promotion_block_weight(func->entryBlock);
+    for (auto &bb : func->blocks)
+    {
+        unsigned long long weight = promotion_block_weight(bb);
+        for (auto &ins : bb->instructions)
+        {
+            if ((ins->type == LOAD && s_p_c<LoadInstruction>(ins)->address == global) || (ins->type == STORE && s_p_c<StoreInstruction>(ins)->address == global))
+                benefit += bb->loopDepth > 0 ? weight : 0;
+            else if (ins->type == INVOKE)
+                cost += weight * (aliasAnalysis.mayRead(ins, location) + aliasAnalysis.mayModify(ins, location));
+            else if (ins->type == RET)
+                cost += weight;
+        }
+    }
+    return benefit > cost;
+}
+
+/**
+ * @brief 替换一个全局标量：先求各块入口是否有未写回的修改，再沿逆后序重命名，有多个前驱的块放置phi
+ * @param func 
+ * @param global 
+ * @param domTree 
+ * @param aliasAnalysis 
+ */
+void promote_function_global(shared_ptr<Function> &func, shared_ptr<Value> &global, DominatorTree &domTree, AliasAnalysis &aliasAnalysis)
+{
+    // 各块出口是否有未写回的修改
+    unordered_map<shared_ptr<BasicBlock>, bool> dirtyOut;
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto &bb : domTree.reversePostOrder)
+        {
+            bool dirty = false;
+            for (auto &pred : bb->predecessors)
+                dirty = dirty || (dirtyOut.count(pred) != 0 && dirtyOut.at(pred));
+            dirty = update_promoted_dirty(bb, global, aliasAnalysis, dirty);
+            if (dirtyOut.count(bb) == 0 || dirtyOut.at(bb) != dirty)
+            {
+                dirtyOut[bb] = dirty;
+                changed = true;
+            }
+        }
+    }
+
+    MemoryLocation location = AliasAnalysis::getLocation(global, nullptr);
+    shared_ptr<Value> zero = Number(0);
+    shared_ptr<BasicBlock> entry = func->entryBlock;
+    shared_ptr<Instruction> init = make_shared<LoadInstruction>(global, zero, entry);
+    user_use(init, {global, zero});
+    make_left_value(init);
+    entry->instructions.insert(entry->instructions.begin(), init);
+    unordered_map<shared_ptr<BasicBlock>, shared_ptr<PhiInstruction>> blockPhis;
+    for (auto &bb : func->blocks)
+    {
+        if (bb->predecessors.size() > 1)
+        {
+            string name = generateTempLeftValueName();
+            shared_ptr<PhiInstruction> phi = make_shared<PhiInstruction>(name, bb);
+            bb->phis.insert(phi);
+            blockPhis[bb] = phi;
+        }
+    }
+    unordered_map<shared_ptr<BasicBlock>, shared_ptr<Value>> blockValues;  // 块末尾的值
+    for (auto &bb : domTree.reversePostOrder)
+    {
+        shared_ptr<Value> current = bb == entry ? init : blockPhis.count(bb) != 0 ? blockPhis.at(bb) : blockValues.at(*bb->predecessors.begin());
+        bool dirty = false;
+        for (auto &pred : bb->predecessors)
+            dirty = dirty || dirtyOut.at(pred);
+        for (auto it = bb->instructions.begin(); it != bb->instructions.end();)
+        {
+            shared_ptr<Instruction> ins = *it;
+            if (ins->type == LOAD && s_p_c<LoadInstruction>(ins)->address == global)
+            {
+                if (ins == init)
+                {
+                    ++it;
+                    continue;
+                }
+                replace_load(ins, current);
+                it = bb->instructions.erase(it);
+                continue;
+            }
+            if (ins->type == STORE && s_p_c<StoreInstruction>(ins)->address == global)
+            {
+                current = s_p_c<StoreInstruction>(ins)->value;
+                make_left_value(current);
+                dirty = true;
+                remove_store(ins);
+                it = bb->instructions.erase(it);
+                continue;
+            }
+            bool invokeAccess = ins->type == INVOKE && (aliasAnalysis.mayRead(ins, location) || aliasAnalysis.mayModify(ins, location));
+            if (dirty && (ins->type == RET || invokeAccess))  // 写回：调用可能读，或可能写（只写部分路径时保留之前的值）
+            {
+                shared_ptr<Instruction> store = make_shared<StoreInstruction>(current, global, zero, bb);
+                user_use(store, {current, global, zero});
+                it = bb->instructions.insert(it, store) + 1;
+                dirty = false;
+            }
+            if (ins->type == INVOKE && aliasAnalysis.mayModify(ins, location))  // 调用后重新load
+            {
+                shared_ptr<Instruction> reload = make_shared<LoadInstruction>(global, zero, bb);
+                user_use(reload, {global, zero});
+                make_left_value(reload);
+                it = bb->instructions.insert(it + 1, reload);
+                current = reload;
+                dirty = false;
+            }
+            ++it;
+        }
+        blockValues[bb] = current;
+    }
+    for (auto &it : blockPhis)
+    {
+        for (auto &pred : it.first->predecessors)
+        {
+            shared_ptr<Value> value = blockValues.at(pred);
+            it.second->operands[pred] = value;
+            value->users.insert(it.second);
+        }
+    }
+    for (auto &it : blockPhis)
+        remove_trivial_phi(it.second);
+}
+
+/**
+ * @brief 经过块后是否有未写回的修改：可能读或写此全局变量的调用前写回，与promote_function_global一致
+ * @param bb 
+ * @param global 
+ * @param aliasAnalysis 
+ * @param dirty 块入口是否有未写回的修改
+ * @return 
+ */
+bool update_promoted_dirty(shared_ptr<BasicBlock> &bb, shared_ptr<Value> &global, AliasAnalysis &aliasAnalysis, bool dirty)
+{
+    MemoryLocation location = AliasAnalysis::getLocation(global, nullptr);
+    for (auto &ins : bb->instructions)
+    {
+        if (ins->type == STORE && s_p_c<StoreInstruction>(ins)->address == global)
+            dirty = true;
+        else if (ins->type == INVOKE && (aliasAnalysis.mayRead(ins, location) || aliasAnalysis.mayModify(ins, location)))
+            dirty = false;
+    }
+    return dirty;
+}
+
+/**
+ * @brief 块的执行次数估计：_LOOP_WEIGHT_BASE的循环深度次方
+ * @param bb 
+ * @return 
+ */
+unsigned long long promotion_block_weight(const shared_ptr<BasicBlock> &bb)
+{
+    unsigned long long weight = 1;
+    for (int i = 0; i < min((int)bb->loopDepth, _MAX_DEPTH); ++i)
+        weight *= _LOOP_WEIGHT_BASE;
+    return weight;
+}
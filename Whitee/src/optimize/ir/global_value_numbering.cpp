@@ -0,0 +1,278 @@
+﻿#include "ir_optimize.h"
+
+#include "../../basic/std/compile_std.h"
+
+/**
+ * 可用表达式表中的一项
+ */
+struct AvailableValue
+{
+    shared_ptr<Instruction> ins;
+    unsigned int generation;  // 内存版本，只对读内存的load与调用有意义
+};
+
+unordered_map<unsigned long long, vector<AvailableValue>> availableValues;  // 哈希值 --> 支配当前块的可用表达式
+unordered_map<shared_ptr<BasicBlock>, vector<shared_ptr<BasicBlock>>> domChildren;  // 支配树的子结点
+unsigned int memoryGeneration;  // 最新的内存版本，每次写内存或进入多前驱块时递增
+unsigned int eliminatedCount;   // 当前函数删除的指令数
+
+void value_numbering_function(shared_ptr<Function> &func);
+
+void value_numbering_block(shared_ptr<BasicBlock> &bb, unsigned int generation);
+
+bool is_value_numbered(shared_ptr<Instruction> &ins);
+
+bool is_memory_clobber(shared_ptr<Instruction> &ins);
+
+bool is_memory_read(shared_ptr<Instruction> &ins);
+
+unsigned long long value_hash(shared_ptr<Instruction> &ins);
+
+bool same_value(shared_ptr<Instruction> &ins, shared_ptr<Instruction> &other);
+
+void replace_by_available(shared_ptr<Instruction> &ins, shared_ptr<Instruction> &available);
+
+/**
+ * @brief 全局值编号：沿支配树先序遍历，作用域哈希表记录支配当前块的表达式，相同的表达式替换为支配它的一个；
+ *        load与只读内存的函数的调用按内存版本编号，两次写内存之间相同地址的load、相同实参的调用视为相同
+ * @param module 
+ */
+void global_value_numbering(shared_ptr<Module> &module)
+{
+    ofstream irStream;
+    if (_debugIrOptimize)
+        irStream.open(debugMessageDirectory + "ir_gvn.txt", ios::out | ios::app);
+    for (auto &func : module->functions)
+    {
+        value_numbering_function(func);
+        if (_debugIrOptimize)
+            irStream << "function <" << func->name << ">: " << eliminatedCount << " eliminated" << endl;
+    }
+    if (_debugIrOptimize)
+        irStream.close();
+}
+
+/**
+ * @brief 对一个函数进行值编号
+ * @param func 
+ */
+void value_numbering_function(shared_ptr<Function> &func)
+{
+    availableValues.clear();
+    domChildren.clear();
+    memoryGeneration = 0;
+    eliminatedCount = 0;
+    if (func->entryBlock == nullptr)
+        return;
+    DominatorTree domTree(func);
+    for (auto &bb : domTree.reversePostOrder)
+    {
+        if (bb != func->entryBlock)
+            domChildren[domTree.idom.at(bb)].push_back(bb);
+    }
+    value_numbering_block(func->entryBlock, memoryGeneration);
+}
+
+/**
+ * @brief 值编号一个块，再递归处理支配树的子结点；退出时撤销本块加入的表达式
+ * @param bb 
+ * @param generation 进入块时的内存版本
+ */
+void value_numbering_block(shared_ptr<BasicBlock> &bb, unsigned int generation)
+{
+    vector<unsigned long long> scope;  // 本块加入的表达式的哈希值
+    for (auto it = bb->instructions.begin(); it != bb->instructions.end();)
+    {
+        shared_ptr<Instruction> ins = *it;
+        if (is_memory_clobber(ins))
+            generation = ++memoryGeneration;
+        if (!is_value_numbered(ins))
+        {
+            ++it;
+            continue;
+        }
+        unsigned long long hashCode = value_hash(ins);
+        bool replace = false;
+        if (availableValues.count(hashCode) != 0)
+        {
+            for (auto &available : availableValues.at(hashCode))
+            {
+                if (available.ins->valid && (!is_memory_read(ins) || available.generation == generation) && same_value(ins, available.ins))
+                {
+                    replace_by_available(ins, available.ins);
+                    replace = true;
+                    break;
+                }
+            }
+        }
+        if (replace)
+        {
+            it = bb->instructions.erase(it);
+            ++eliminatedCount;
+        }
+        else
+        {
+            availableValues[hashCode].push_back({ins, generation});
+            scope.push_back(hashCode);
+            ++it;
+        }
+    }
+    if (domChildren.count(bb) != 0)
+    {
+        for (auto &child : domChildren.at(bb))
+        {
+            if (child->predecessors.size() == 1)  // 唯一前驱即直接支配者，继承其出口的内存版本
+                value_numbering_block(child, generation);
+            else
+                value_numbering_block(child, ++memoryGeneration);
+        }
+    }
+    for (auto hashCode : scope)
+    {
+        availableValues.at(hashCode).pop_back();
+        if (availableValues.at(hashCode).empty())
+            availableValues.erase(hashCode);
+    }
+}
+
+/**
+ * @brief 指令是否参与值编号：一元、二元运算（比较需紧跟跳转，除外），load，无副作用（不写内存、不输入输出）函数的调用
+ * @param ins 
+ * @return 
+ */
+bool is_value_numbered(shared_ptr<Instruction> &ins)
+{
+    switch (ins->type)
+    {
+    case UNARY:
+    case BINARY:
+    case LOAD:
+        return true;
+    case INVOKE:
+    {
+        shared_ptr<InvokeInstruction> invoke = s_p_c<InvokeInstruction>(ins);
+        return invoke->invokeType == COMMON && !invoke->targetFunction->side_effect && invoke->resultType != OTHER_RESULT;
+    }
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief 指令是否可能写内存：store、getarray与写内存的函数的调用
+ * @param ins 
+ * @return 
+ */
+bool is_memory_clobber(shared_ptr<Instruction> &ins)
+{
+    return AliasAnalysis::isMemoryDef(ins);
+}
+
+/**
+ * @brief 参与值编号的指令是否读内存：load与读内存的函数的调用，其结果与内存版本有关
+ * @param ins 
+ * @return 
+ */
+bool is_memory_read(shared_ptr<Instruction> &ins)
+{
+    return ins->type == LOAD || (ins->type == INVOKE && s_p_c<InvokeInstruction>(ins)->targetFunction->readsMemory());
+}
+
+/**
+ * @brief 值编号使用的哈希值，相同的表达式应有相同的哈希值
+ * @param ins 
+ * @return 
+ */
+unsigned long long value_hash(shared_ptr<Instruction> &ins)
+{
+    if (ins->type == LOAD)
+    {
+        shared_ptr<LoadInstruction> load = s_p_c<LoadInstruction>(ins);
+        return (unsigned long long)load->address.get() * 31 + (unsigned long long)load->offset.get();
+    }
+    if (ins->type == INVOKE)
+    {
+        shared_ptr<InvokeInstruction> invoke = s_p_c<InvokeInstruction>(ins);
+        unsigned long long x = (unsigned long long)invoke->targetFunction.get();
+        for (auto &param : invoke->params)
+            x = x * 31 + (unsigned long long)param.get();
+        return x;
+    }
+    return ins->hashCode();
+}
+
+/**
+ * @brief 两条同类指令是否计算相同的值
+ * @param ins 
+ * @param other 
+ * @return 
+ */
+bool same_value(shared_ptr<Instruction> &ins, shared_ptr<Instruction> &other)
+{
+    if (ins->type != other->type)
+        return false;
+    if (ins->type == LOAD)
+    {
+        shared_ptr<LoadInstruction> load = s_p_c<LoadInstruction>(ins);
+        shared_ptr<LoadInstruction> otherLoad = s_p_c<LoadInstruction>(other);
+        return load->address == otherLoad->address && load->offset->equals(otherLoad->offset);
+    }
+    if (ins->type == INVOKE)
+    {
+        shared_ptr<InvokeInstruction> invoke = s_p_c<InvokeInstruction>(ins);
+        shared_ptr<InvokeInstruction> otherInvoke = s_p_c<InvokeInstruction>(other);
+        if (invoke->targetFunction != otherInvoke->targetFunction || invoke->params.size() != otherInvoke->params.size())
+            return false;
+        for (size_t i = 0; i < invoke->params.size(); ++i)
+        {
+            if (!invoke->params.at(i)->equals(otherInvoke->params.at(i)))
+                return false;
+        }
+        return true;
+    }
+    shared_ptr<Value> otherValue = other;
+    return ins->equals(otherValue);
+}
+
+/**
+ * @brief 将ins的使用替换为支配它的相同表达式，并删除ins；操作数即使不再被使用也不级联删除，
+ *        以免删除表中仍可用的表达式，留给死代码删除
+ * @param ins 被替换的指令
+ * @param available 支配ins的相同表达式
+ */
+void replace_by_available(shared_ptr<Instruction> &ins, shared_ptr<Instruction> &available)
+{
+    if (available->resultType == R_VAL_RESULT)  // 右值只能使用一次
+    {
+        available->resultType = L_VAL_RESULT;
+        available->caughtVarName = generateTempLeftValueName();
+    }
+    unordered_set<shared_ptr<Value>> users = ins->users;
+    shared_ptr<Value> toBeReplaced = ins;
+    shared_ptr<Value> replaceValue = available;
+    for (auto &user : users)
+        user->replaceUse(toBeReplaced, replaceValue);
+    vector<shared_ptr<Value>> operands;
+    switch (ins->type)
+    {
+    case UNARY:
+        operands.push_back(s_p_c<UnaryInstruction>(ins)->value);
+        break;
+    case BINARY:
+        operands.push_back(s_p_c<BinaryInstruction>(ins)->lhs);
+        operands.push_back(s_p_c<BinaryInstruction>(ins)->rhs);
+        break;
+    case LOAD:
+        operands.push_back(s_p_c<LoadInstruction>(ins)->address);
+        operands.push_back(s_p_c<LoadInstruction>(ins)->offset);
+        break;
+    case INVOKE:
+        operands = s_p_c<InvokeInstruction>(ins)->params;
+        break;
+    default:
+        break;
+    }
+    for (auto &operand : operands)
+        operand->users.erase(ins);
+    ins->valid = false;
+}
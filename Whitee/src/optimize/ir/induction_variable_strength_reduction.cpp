@@ -0,0 +1,426 @@
+﻿#include "ir_optimize.h"
+
+#include <algorithm>
+#include <climits>
+
+const unsigned int _IV_MAX_RECURRENCE = 4;  // 每个循环新增的递推变量数上限，避免寄存器压力过大
+
+/**
+ * 归纳变量：value = scale * basic + 循环不变量，basic为循环头的基本归纳变量
+ */
+struct InductionInfo
+{
+    shared_ptr<PhiInstruction> basic;
+    int scale;
+    bool hasMul;  // 计算中含乘法，值得强度削弱
+};
+
+/**
+ * 基本归纳变量：循环头的phi，每次迭代增加常数步长
+ */
+struct BasicInduction
+{
+    shared_ptr<Value> init;            // 来自前置块的初值
+    shared_ptr<BinaryInstruction> next;  // basic + step
+    int step;
+};
+
+unordered_map<shared_ptr<PhiInstruction>, BasicInduction> basicInductions;
+unordered_map<shared_ptr<Value>, InductionInfo> inductionInfos;  // 循环内的派生归纳变量
+unordered_map<shared_ptr<Value>, shared_ptr<Value>> preheaderClones;  // 派生归纳变量 --> 前置块中计算的初值
+
+bool strength_reduce_loop(shared_ptr<Loop> &loop, DominatorTree &domTree);
+
+bool find_induction(const shared_ptr<Value> &value, InductionInfo &info);
+
+bool is_invariant(const shared_ptr<Value> &value, shared_ptr<Loop> &loop);
+
+void analyse_derived_induction(shared_ptr<Instruction> &ins, shared_ptr<Loop> &loop);
+
+shared_ptr<Value> clone_to_preheader(const shared_ptr<Value> &value, shared_ptr<Loop> &loop);
+
+bool evaluate_at_init(const shared_ptr<Value> &value, shared_ptr<Loop> &loop, long long &result);
+
+void insert_before_terminator(shared_ptr<BasicBlock> &bb, const shared_ptr<Instruction> &ins);
+
+void remove_dead_induction(const shared_ptr<Value> &value);
+
+void replace_exit_test(shared_ptr<Loop> &loop, shared_ptr<PhiInstruction> &basic, vector<pair<shared_ptr<Instruction>, shared_ptr<PhiInstruction>>> &reduced);
+
+/**
+ * @brief 归纳变量强度削弱：循环中由基本归纳变量乘常数得到的派生归纳变量（如数组下标 i*stride + base），
+ *        改为在循环头以phi递推、每次迭代加常数；基本归纳变量只用于退出判断时，以递推变量替换判断并删除
+ * @param module 
+ */
+void induction_variable_strength_reduction(shared_ptr<Module> &module)
+{
+    for (auto &func : module->functions)
+    {
+        if (func->entryBlock == nullptr)
+            continue;
+        DominatorTree domTree(func);
+        LoopInfo loopInfo(domTree);
+        for (auto &loop : loopInfo.loops)
+            strength_reduce_loop(loop, domTree);
+    }
+}
+
+/**
+ * @brief 对一个循环进行强度削弱
+ * @param loop 
+ * @param domTree 
+ * @return 是否有改变
+ */
+bool strength_reduce_loop(shared_ptr<Loop> &loop, DominatorTree &domTree)
+{
+    if (loop->preheader == nullptr || loop->latches.size() != 1 || loop->header->predecessors.size() != 2)
+        return false;
+    shared_ptr<BasicBlock> latch = loop->latches.front();
+    basicInductions.clear();
+    inductionInfos.clear();
+    preheaderClones.clear();
+    for (auto &phi : loop->header->phis)
+    {
+        if (phi->operands.size() != 2 || phi->operands.count(loop->preheader) == 0 || phi->operands.count(latch) == 0)
+            continue;
+        shared_ptr<Value> next = phi->operands.at(latch);
+        if (next->value_type != INSTRUCTION || s_p_c<Instruction>(next)->type != BINARY || !loop->contains(s_p_c<Instruction>(next)->block))
+            continue;
+        shared_ptr<BinaryInstruction> binary = s_p_c<BinaryInstruction>(next);
+        int step;
+        if (binary->op == "+" && binary->lhs == phi && binary->rhs->value_type == NUMBER)
+            step = s_p_c<NumberValue>(binary->rhs)->number;
+        else if (binary->op == "+" && binary->rhs == phi && binary->lhs->value_type == NUMBER)
+            step = s_p_c<NumberValue>(binary->lhs)->number;
+        else if (binary->op == "-" && binary->lhs == phi && binary->rhs->value_type == NUMBER && s_p_c<NumberValue>(binary->rhs)->number != INT_MIN)
+            step = -s_p_c<NumberValue>(binary->rhs)->number;
+        else
+            continue;
+        basicInductions[phi] = {phi->operands.at(loop->preheader), binary, step};
+    }
+    if (basicInductions.empty())
+        return false;
+
+    // 按逆后序求派生归纳变量，操作数先于使用
+    vector<shared_ptr<Instruction>> candidates;
+    for (auto &bb : domTree.reversePostOrder)
+    {
+        if (!loop->contains(bb))
+            continue;
+        for (auto &ins : bb->instructions)
+        {
+            analyse_derived_induction(ins, loop);
+            if (inductionInfos.count(ins) != 0)
+                candidates.push_back(ins);
+        }
+    }
+
+    // 选择需要削弱的派生归纳变量：含乘法，且有不是派生归纳变量计算的使用
+    vector<pair<shared_ptr<Instruction>, shared_ptr<PhiInstruction>>> reduced;  // (原派生归纳变量, 递推phi)
+    for (auto &ins : candidates)
+    {
+        InductionInfo info = inductionInfos.at(ins);
+        if (!info.hasMul || info.scale == 0 || basicInductions.at(info.basic).next == ins)
+            continue;
+        bool rootUse = false, localUse = true;
+        for (auto &user : ins->users)
+        {
+            if (inductionInfos.count(user) == 0)
+                rootUse = true;
+            // 递推phi在回边块末尾已更新，只替换循环内的非phi使用
+            shared_ptr<Instruction> userIns = s_p_c<Instruction>(user);
+            if (userIns->type == PHI || !loop->contains(userIns->block))
+                localUse = false;
+        }
+        if (!rootUse || !localUse)
+            continue;
+        if (reduced.size() == _IV_MAX_RECURRENCE)
+            break;
+        BasicInduction &basic = basicInductions.at(info.basic);
+        shared_ptr<Value> init = clone_to_preheader(ins, loop);
+        string name = generateTempLeftValueName();
+        shared_ptr<PhiInstruction> phi = make_shared<PhiInstruction>(name, loop->header);
+        string addOp = "+";
+        shared_ptr<Value> phiValue = phi;
+        shared_ptr<Value> stepValue = Number((int)((unsigned)info.scale * (unsigned)basic.step));
+        shared_ptr<BinaryInstruction> next = make_shared<BinaryInstruction>(addOp, phiValue, stepValue, latch);
+        next->resultType = L_VAL_RESULT;
+        next->caughtVarName = name;
+        user_use(next, {phiValue, stepValue});
+        insert_before_terminator(latch, next);
+        phi->operands[loop->preheader] = init;
+        phi->operands[latch] = next;
+        user_use(phi, {init, next});
+        loop->header->phis.insert(phi);
+        unordered_set<shared_ptr<Value>> users = ins->users;
+        shared_ptr<Value> toBeReplaced = ins;
+        for (auto &user : users)
+        {
+            if (user != next)
+                user->replaceUse(toBeReplaced, phiValue);
+        }
+        reduced.emplace_back(ins, phi);
+    }
+    if (reduced.empty())
+        return false;
+    for (auto &it : reduced)
+        remove_dead_induction(it.first);
+    for (auto &it : basicInductions)
+    {
+        shared_ptr<PhiInstruction> basic = it.first;
+        replace_exit_test(loop, basic, reduced);
+    }
+    return true;
+}
+
+/**
+ * @brief 值的归纳变量信息：基本归纳变量本身或已分析的派生归纳变量
+ * @param value 
+ * @param info 
+ * @return 是否为归纳变量
+ */
+bool find_induction(const shared_ptr<Value> &value, InductionInfo &info)
+{
+    if (value->value_type != INSTRUCTION)
+        return false;
+    if (s_p_c<Instruction>(value)->type == PHI && basicInductions.count(s_p_c<PhiInstruction>(value)) != 0)
+    {
+        info = {s_p_c<PhiInstruction>(value), 1, false};
+        return true;
+    }
+    if (inductionInfos.count(value) == 0)
+        return false;
+    info = inductionInfos.at(value);
+    return true;
+}
+
+/**
+ * @brief 值是否为循环不变量：非指令（未定义值除外），或定义在循环外的指令
+ * @param value 
+ * @param loop 
+ * @return 
+ */
+bool is_invariant(const shared_ptr<Value> &value, shared_ptr<Loop> &loop)
+{
+    if (value->value_type != INSTRUCTION)
+        return value->value_type == NUMBER || value->value_type == PARAMETER || value->value_type == GLOBAL || value->value_type == CONSTANT;
+    return !loop->contains(s_p_c<Instruction>(value)->block);
+}
+
+/**
+ * @brief 派生归纳变量：iv ± 不变量、不变量 ± iv、iv * 常数、-iv、同一基本归纳变量的两个派生之和或差
+ * @param ins 
+ * @param loop 
+ */
+void analyse_derived_induction(shared_ptr<Instruction> &ins, shared_ptr<Loop> &loop)
+{
+    InductionInfo lhs, rhs;
+    if (ins->type == UNARY)
+    {
+        shared_ptr<UnaryInstruction> unary = s_p_c<UnaryInstruction>(ins);
+        if ((unary->op == "-" || unary->op == "+") && find_induction(unary->value, lhs))
+            inductionInfos[ins] = {lhs.basic, unary->op == "-" ? -lhs.scale : lhs.scale, lhs.hasMul};
+        return;
+    }
+    if (ins->type != BINARY)
+        return;
+    shared_ptr<BinaryInstruction> binary = s_p_c<BinaryInstruction>(ins);
+    bool lhsIv = find_induction(binary->lhs, lhs);
+    bool rhsIv = find_induction(binary->rhs, rhs);
+    if (!lhsIv && !rhsIv)
+        return;
+    if (binary->op == "+" || binary->op == "-")
+    {
+        int sign = binary->op == "+" ? 1 : -1;
+        if (lhsIv && rhsIv)
+        {
+            if (lhs.basic == rhs.basic)
+                inductionInfos[ins] = {lhs.basic, lhs.scale + sign * rhs.scale, lhs.hasMul || rhs.hasMul};
+        }
+        else if (lhsIv && is_invariant(binary->rhs, loop))
+            inductionInfos[ins] = lhs;
+        else if (rhsIv && is_invariant(binary->lhs, loop))
+            inductionInfos[ins] = {rhs.basic, sign * rhs.scale, rhs.hasMul};
+    }
+    else if (binary->op == "*")
+    {
+        if (lhsIv && binary->rhs->value_type == NUMBER)
+            inductionInfos[ins] = {lhs.basic, (int)((unsigned)lhs.scale * (unsigned)s_p_c<NumberValue>(binary->rhs)->number), true};
+        else if (rhsIv && binary->lhs->value_type == NUMBER)
+            inductionInfos[ins] = {rhs.basic, (int)((unsigned)rhs.scale * (unsigned)s_p_c<NumberValue>(binary->lhs)->number), true};
+    }
+}
+
+/**
+ * @brief 在前置块中以基本归纳变量的初值重新计算派生归纳变量，得到递推的初值
+ * @param value 派生归纳变量、基本归纳变量或循环不变量
+ * @param loop 
+ * @return 前置块中的值
+ */
+shared_ptr<Value> clone_to_preheader(const shared_ptr<Value> &value, shared_ptr<Loop> &loop)
+{
+    if (value->value_type == INSTRUCTION && s_p_c<Instruction>(value)->type == PHI && basicInductions.count(s_p_c<PhiInstruction>(value)) != 0)
+        return basicInductions.at(s_p_c<PhiInstruction>(value)).init;
+    if (inductionInfos.count(value) == 0)
+        return value;
+    if (preheaderClones.count(value) != 0)
+        return preheaderClones.at(value);
+    shared_ptr<Instruction> newIns;
+    if (s_p_c<Instruction>(value)->type == UNARY)
+    {
+        shared_ptr<UnaryInstruction> unary = s_p_c<UnaryInstruction>(value);
+        shared_ptr<Value> operand = clone_to_preheader(unary->value, loop);
+        newIns = make_shared<UnaryInstruction>(unary->op, operand, loop->preheader);
+        user_use(newIns, {operand});
+    }
+    else
+    {
+        shared_ptr<BinaryInstruction> binary = s_p_c<BinaryInstruction>(value);
+        shared_ptr<Value> lhs = clone_to_preheader(binary->lhs, loop);
+        shared_ptr<Value> rhs = clone_to_preheader(binary->rhs, loop);
+        newIns = make_shared<BinaryInstruction>(binary->op, lhs, rhs, loop->preheader);
+        user_use(newIns, {lhs, rhs});
+    }
+    insert_before_terminator(loop->preheader, newIns);
+    preheaderClones[value] = newIns;
+    return newIns;
+}
+
+/**
+ * @brief 以基本归纳变量的初值求派生归纳变量的常数值
+ * @param value 
+ * @param loop 
+ * @param result 
+ * @return 是否为常数
+ */
+bool evaluate_at_init(const shared_ptr<Value> &value, shared_ptr<Loop> &loop, long long &result)
+{
+    if (value->value_type == NUMBER)
+    {
+        result = s_p_c<NumberValue>(value)->number;
+        return true;
+    }
+    if (value->value_type != INSTRUCTION)
+        return false;
+    if (s_p_c<Instruction>(value)->type == PHI && basicInductions.count(s_p_c<PhiInstruction>(value)) != 0)
+        return evaluate_at_init(basicInductions.at(s_p_c<PhiInstruction>(value)).init, loop, result);
+    if (inductionInfos.count(value) == 0)
+        return false;
+    long long lhs, rhs;
+    if (s_p_c<Instruction>(value)->type == UNARY)
+    {
+        shared_ptr<UnaryInstruction> unary = s_p_c<UnaryInstruction>(value);
+        if (!evaluate_at_init(unary->value, loop, lhs))
+            return false;
+        result = unary->op == "-" ? -lhs : lhs;
+        return true;
+    }
+    shared_ptr<BinaryInstruction> binary = s_p_c<BinaryInstruction>(value);
+    if (!evaluate_at_init(binary->lhs, loop, lhs) || !evaluate_at_init(binary->rhs, loop, rhs))
+        return false;
+    result = binary->op == "+" ? lhs + rhs : binary->op == "-" ? lhs - rhs : lhs * rhs;
+    return result >= INT_MIN && result <= INT_MAX;
+}
+
+/**
+ * @brief 插入到块末尾的跳转之前；末尾为 比较 + 分支 时插入到比较之前
+ * @param bb 
+ * @param ins 
+ */
+void insert_before_terminator(shared_ptr<BasicBlock> &bb, const shared_ptr<Instruction> &ins)
+{
+    auto pos = bb->instructions.end() - 1;
+    if ((*pos)->type == BR && pos != bb->instructions.begin() && (*(pos - 1))->type == CMP)
+        --pos;
+    bb->instructions.insert(pos, ins);
+}
+
+/**
+ * @brief 删除不再使用的派生归纳变量，及其随之不再使用的派生操作数，使基本归纳变量的使用只剩自增
+ * @param value 
+ */
+void remove_dead_induction(const shared_ptr<Value> &value)
+{
+    if (inductionInfos.count(value) == 0 || !value->users.empty() || !value->valid)
+        return;
+    shared_ptr<Instruction> ins = s_p_c<Instruction>(value);
+    vector<shared_ptr<Value>> operands;
+    if (ins->type == UNARY)
+        operands.push_back(s_p_c<UnaryInstruction>(ins)->value);
+    else
+    {
+        operands.push_back(s_p_c<BinaryInstruction>(ins)->lhs);
+        operands.push_back(s_p_c<BinaryInstruction>(ins)->rhs);
+    }
+    ins->block->instructions.erase(find(ins->block->instructions.begin(), ins->block->instructions.end(), ins));
+    ins->valid = false;
+    for (auto &operand : operands)
+    {
+        operand->users.erase(ins);
+        remove_dead_induction(operand);
+    }
+}
+
+/**
+ * @brief 线性函数测试替换：基本归纳变量只用于自增与回边块的退出判断时，
+ *        改用一个递推变量判断（边界按 scale * bound + offset 换算，只在都为常数且不溢出时进行），并删除基本归纳变量
+ * @param loop 
+ * @param basic 基本归纳变量
+ * @param reduced 已削弱的派生归纳变量
+ */
+void replace_exit_test(shared_ptr<Loop> &loop, shared_ptr<PhiInstruction> &basic, vector<pair<shared_ptr<Instruction>, shared_ptr<PhiInstruction>>> &reduced)
+{
+    BasicInduction &induction = basicInductions.at(basic);
+    shared_ptr<BinaryInstruction> next = induction.next;
+    if (basic->users.size() != 1 || *basic->users.begin() != next || next->users.size() != 2)
+        return;
+    shared_ptr<BasicBlock> latch = loop->latches.front();
+    shared_ptr<Instruction> last = latch->instructions.back();
+    if (last->type != BR || s_p_c<BranchInstruction>(last)->condition->value_type != INSTRUCTION)
+        return;
+    shared_ptr<Value> condition = s_p_c<BranchInstruction>(last)->condition;
+    if (s_p_c<Instruction>(condition)->type != CMP || next->users.count(condition) == 0 || condition->users.size() != 1)
+        return;
+    shared_ptr<BinaryInstruction> cmp = s_p_c<BinaryInstruction>(condition);
+    string op = cmp->lhs == next ? cmp->op : BinaryInstruction::swapOpConst(cmp->op);
+    shared_ptr<Value> bound = cmp->lhs == next ? cmp->rhs : cmp->lhs;
+    long long init;
+    bool upward = op == "<" || op == "<=";
+    if (bound->value_type != NUMBER || (op != "<" && op != "<=" && op != ">" && op != ">=") || upward != (induction.step > 0) || !evaluate_at_init(basic, loop, init))
+        return;
+    long long boundNumber = s_p_c<NumberValue>(bound)->number;
+    for (auto &it : reduced)
+    {
+        InductionInfo info = inductionInfos.at(it.first);
+        long long initValue;
+        if (info.basic != basic || !evaluate_at_init(it.first, loop, initValue))
+            continue;
+        long long offset = initValue - info.scale * init;  // 派生值 = scale * basic + offset
+        long long limit = upward ? max(boundNumber, init) + induction.step : min(boundNumber, init) + induction.step;
+        long long newBound = info.scale * boundNumber + offset;
+        long long extreme1 = info.scale * limit + offset, extreme2 = info.scale * init + offset;
+        if (newBound < INT_MIN || newBound > INT_MAX || extreme1 < INT_MIN || extreme1 > INT_MAX || extreme2 < INT_MIN || extreme2 > INT_MAX)
+            continue;
+        // 比较 next op bound 换为 phi的自增值 op' newBound，scale为负时比较方向相反
+        shared_ptr<Value> reducedNext = it.second->operands.at(latch);
+        shared_ptr<Value> newBoundValue = Number((int)newBound);
+        cmp->lhs->users.erase(cmp);
+        cmp->rhs->users.erase(cmp);
+        cmp->op = info.scale > 0 ? op : BinaryInstruction::swapOpConst(op);
+        cmp->lhs = reducedNext;
+        cmp->rhs = newBoundValue;
+        user_use(cmp, {reducedNext, newBoundValue});
+        // 删除基本归纳变量的环
+        basic->operands.clear();
+        next->lhs->users.erase(next);
+        next->rhs->users.erase(next);
+        induction.init->users.erase(basic);
+        next->users.clear();
+        basic->users.clear();
+        next->block->instructions.erase(find(next->block->instructions.begin(), next->block->instructions.end(), next));
+        next->valid = false;
+        loop->header->phis.erase(basic);
+        basic->valid = false;
+        return;
+    }
+}
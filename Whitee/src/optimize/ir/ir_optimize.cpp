@@ -22,9 +22,34 @@ extern bool needIrPassCheck;  // 需要每次检查IR
  */
 void optimizeIr(shared_ptr<Module> &module, OptimizeLevel level)
 {
+    if (_debugIrOptimize)
+    {
+        ofstream irStream(debugMessageDirectory + "ir_gvn.txt", ios::out | ios::trunc);
+        irStream << "[Global Value Numbering]" << endl;
+        irStream.close();
+        irStream.open(debugMessageDirectory + "ir_memory.txt", ios::out | ios::trunc);
+        irStream << "[Memory Access Elimination]" << endl;
+        irStream.close();
+    }
     for (int i = 0; i < OPTIMIZE_TIMES; ++i)  // 连续优化2次，以防顺序原因优化失败
     {
         globalIrCorrect = true;
+        if (level >= O1)  // 先于内联，避免尾递归函数被展开后无法转为循环
+        {
+            tail_recursion_elimination(module);
+            dead_code_delete(module);
+            if (needIrPassCheck && !irCheck(module))
+                cerr << "Error: Tail Recursion Elimination." << endl;
+        }
+
+        if (level >= O1)
+        {
+            functionInline(module);
+            dead_code_delete(module);
+            if (needIrPassCheck && !irCheck(module))
+                cerr << "Error: Function Inline." << endl;
+        }
+
         if (level >= O1)
         {
             read_only_variable_to_constant(module);
@@ -41,6 +66,14 @@ void optimizeIr(shared_ptr<Module> &module, OptimizeLevel level)
                 cerr << "Error: Constant Folding." << endl;
         }
 
+        if (level >= O1)  // 同时完成常量分支转换与不可达块删除
+        {
+            sparse_conditional_constant_propagation(module);
+            dead_code_delete(module);
+            if (needIrPassCheck && !irCheck(module))
+                cerr << "Error: Sparse Conditional Constant Propagation." << endl;
+        }
+
         if (level >= O1)  // 可以不用
         {
             array_folding(module);
@@ -65,6 +98,14 @@ void optimizeIr(shared_ptr<Module> &module, OptimizeLevel level)
                 cerr << "Error: Array External Lift." << endl;
         }
 
+        if (level >= O1 && i == 0)  // 在循环不变量外提之前，外层循环体中只有内层循环
+        {
+            loop_interchange(module);
+            dead_code_delete(module);
+            if (needIrPassCheck && !irCheck(module))
+                cerr << "Error: Loop Interchange." << endl;
+        }
+
         if (level >= O1)
         {
             loop_invariant_code_motion(module);
@@ -73,6 +114,22 @@ void optimizeIr(shared_ptr<Module> &module, OptimizeLevel level)
                 cerr << "Error: Loop Invariant Code Motion." << endl;
         }
 
+        if (level >= O1)
+        {
+            induction_variable_strength_reduction(module);
+            dead_code_delete(module);
+            if (needIrPassCheck && !irCheck(module))
+                cerr << "Error: Induction Variable Strength Reduction." << endl;
+        }
+
+        if (level >= O1 && i == 0)  // 只展开一次，展开产生的循环不再展开
+        {
+            loop_unroll(module);
+            dead_code_delete(module);
+            if (needIrPassCheck && !irCheck(module))
+                cerr << "Error: Loop Unroll." << endl;
+        }
+
         if (level >= O1)
         {
             local_common_subexpression_elimination(module);
@@ -83,10 +140,34 @@ void optimizeIr(shared_ptr<Module> &module, OptimizeLevel level)
 
         if (level >= O1)
         {
-            constant_branch_conversion(module);
+            global_value_numbering(module);
             dead_code_delete(module);
             if (needIrPassCheck && !irCheck(module))
-                cerr << "Error: Constant Branch Conversion." << endl;
+                cerr << "Error: Global Value Numbering." << endl;
+        }
+
+        if (level >= O1)
+        {
+            memory_access_elimination(module);
+            dead_code_delete(module);
+            if (needIrPassCheck && !irCheck(module))
+                cerr << "Error: Memory Access Elimination." << endl;
+        }
+
+        if (level >= O1)  // 在冗余load删除之后，只替换剩余的访问
+        {
+            global_scalar_promotion(module);
+            dead_code_delete(module);
+            if (needIrPassCheck && !irCheck(module))
+                cerr << "Error: Global Scalar Promotion." << endl;
+        }
+
+        if (level >= O1)  // 在冗余计算删除之后，重新安排剩余的运算
+        {
+            global_code_motion(module);
+            dead_code_delete(module);
+            if (needIrPassCheck && !irCheck(module))
+                cerr << "Error: Global Code Motion." << endl;
         }
 
         if (level >= O1)
@@ -113,6 +194,14 @@ void optimizeIr(shared_ptr<Module> &module, OptimizeLevel level)
         }
     }
 
+    if (level >= O1 && _parallelizeLoop)  // 在所有优化之后，外提的循环不再被内联回去
+    {
+        loop_parallelization(module);
+        dead_code_delete(module);
+        if (needIrPassCheck && !irCheck(module))
+            cerr << "Error: Loop Parallelization." << endl;
+    }
+
     for (int i = 0; i < OPTIMIZE_TIMES; ++i)
         dead_code_delete(module);
 
@@ -12,6 +12,11 @@
 #include "../../ir/ir_utils.h"
 #include "../../ir/ir_ssa.h"
 #include "../../ir/ir_check.h"
+#include "../../ir/ir_liveness.h"
+#include "../../ir/ir_loop.h"
+#include "../../ir/ir_alias.h"
+#include "../../ir/ir_memory_ssa.h"
+#include "../../ir/ir_vector.h"
 
 #include <iostream>
 #include <fstream>
@@ -21,7 +26,6 @@ extern string debugMessageDirectory;
 extern const unsigned int OPTIMIZE_TIMES;
 
 extern unsigned long DEAD_BLOCK_CODE_GROUP_DELETE_TIMEOUT;
-extern unsigned long CONFLICT_GRAPH_TIMEOUT;
 
 extern void optimizeIr(shared_ptr<Module> &module, OptimizeLevel level);
 
@@ -29,10 +33,14 @@ void constant_folding(shared_ptr<Module> &module);
 
 void dead_code_delete(shared_ptr<Module> &module);
 
-//void functionInline(shared_ptr<Module> &module);
+void functionInline(shared_ptr<Module> &module);
+
+void tail_recursion_elimination(shared_ptr<Module> &module);
 
 void constant_branch_conversion(shared_ptr<Module> &module);
 
+void sparse_conditional_constant_propagation(shared_ptr<Module> &module);
+
 void block_combination(shared_ptr<Module> &module);
 
 void read_only_variable_to_constant(shared_ptr<Module> &module);
@@ -47,8 +55,24 @@ void array_external(shared_ptr<Module> &module);
 
 void loop_invariant_code_motion(shared_ptr<Module> &module);
 
+void induction_variable_strength_reduction(shared_ptr<Module> &module);
+
+void loop_interchange(shared_ptr<Module> &module);
+
+void loop_unroll(shared_ptr<Module> &module);
+
 void local_common_subexpression_elimination(shared_ptr<Module> &module);
 
+void global_value_numbering(shared_ptr<Module> &module);
+
+void memory_access_elimination(shared_ptr<Module> &module);
+
+void global_scalar_promotion(shared_ptr<Module> &module);
+
+void global_code_motion(shared_ptr<Module> &module);
+
+void loop_parallelization(shared_ptr<Module> &module);
+
 // some end optimize functions.
 void endOptimize(shared_ptr<Module> &module, OptimizeLevel level);
 
@@ -56,4 +80,8 @@ void calculateVariableWeight(shared_ptr<Function> &func);
 
 void registerAlloc(shared_ptr<Function> &func);
 
+void linearScanRegisterAlloc(shared_ptr<Function> &func);
+
+bool splitLiveRangeAroundLoops(shared_ptr<Function> &func);
+
 #endif
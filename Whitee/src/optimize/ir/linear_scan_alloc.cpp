@@ -0,0 +1,288 @@
+﻿#include "ir_optimize.h"
+
+#include <algorithm>
+#include <climits>
+
+/**
+ * 活跃区间：按Function::blocks的线性顺序编号指令，区间由若干不相交的[start, end)段组成，段之间为空洞
+ */
+struct LiveInterval
+{
+    unsigned int value = 0;                               // 活跃变量分析中的编号
+    vector<pair<unsigned int, unsigned int>> ranges;      // 按起点升序的段
+    unsigned int weight = 0;
+    int reg = -1;                                         // 分配的寄存器，-1为未分配
+    vector<unsigned int> hints;                           // 传送另一端的区间，优先使用其寄存器
+
+    inline unsigned int start() const { return ranges.front().first; }
+
+    inline unsigned int end() const { return ranges.back().second; }
+
+    bool covers(unsigned int pos) const;
+
+    bool intersects(const LiveInterval &other) const;
+};
+
+/**
+ * @brief 区间在pos处是否活跃
+ * @param pos 
+ * @return 活跃则为true
+ */
+bool LiveInterval::covers(unsigned int pos) const
+{
+    auto it = upper_bound(ranges.begin(), ranges.end(), make_pair(pos, UINT_MAX));  // 第一个起点大于pos的段
+    return it != ranges.begin() && pos < (it - 1)->second;
+}
+
+/**
+ * @brief 两个区间是否有重叠的段
+ * @param other 
+ * @return 重叠则为true
+ */
+bool LiveInterval::intersects(const LiveInterval &other) const
+{
+    unsigned int i = 0, j = 0;
+    while (i < ranges.size() && j < other.ranges.size())
+    {
+        if (ranges[i].second <= other.ranges[j].first)
+            ++i;
+        else if (other.ranges[j].second <= ranges[i].first)
+            ++j;
+        else
+            return true;
+    }
+    return false;
+}
+
+void buildLiveIntervals(shared_ptr<Function> &func, LivenessAnalysis &liveness, vector<LiveInterval> &intervals);
+
+void linearScan(vector<LiveInterval> &intervals);
+
+/**
+ * @brief 线性扫描寄存器分配，快速编译模式下替代图着色；溢出按variableWeight选择，不拆分区间
+ * @param func 
+ */
+void linearScanRegisterAlloc(shared_ptr<Function> &func)
+{
+    LivenessAnalysis liveness(func);
+    vector<LiveInterval> intervals;
+    buildLiveIntervals(func, liveness, intervals);
+    linearScan(intervals);
+    for (auto &interval : intervals)
+    {
+        shared_ptr<Value> value = liveness.values[interval.value];
+        if (interval.reg >= 0)
+            func->variableRegs[value] = to_string(interval.reg + _GLB_REG_START);  // 寄存器R4-R12为有效寄存器
+        else
+            func->variableWithoutReg.insert(value);
+    }
+}
+
+/**
+ * @brief 构建活跃区间：每个块自出口向前遍历，出口活跃的值覆盖到块尾，使用处延伸至块首，定义处截断
+ * @param func 
+ * @param liveness 
+ * @param intervals 每个被追踪的值一个区间
+ */
+void buildLiveIntervals(shared_ptr<Function> &func, LivenessAnalysis &liveness, vector<LiveInterval> &intervals)
+{
+    unsigned int size = liveness.values.size();
+    intervals.assign(size, LiveInterval());
+    for (unsigned int i = 0; i < size; ++i)
+    {
+        intervals[i].value = i;
+        intervals[i].weight = func->variableWeight.at(liveness.values[i]);
+    }
+    vector<unsigned int> openEnd(size);  // 向前遍历时仍活跃的值，其段的终点
+    vector<bool> open(size, false);
+    vector<unsigned int> used;
+    unsigned int blockStart = 2;  // 位置0为参数的定义
+    for (auto &bb : func->blocks)
+    {
+        unsigned int blockEnd = blockStart + 2 * bb->instructions.size();
+        BitVector live = liveness.liveOut.at(bb);
+        for (unsigned int i = live.findNext(0); i < live.size; i = live.findNext(i + 1))
+        {
+            open[i] = true;
+            openEnd[i] = blockEnd;
+        }
+        unsigned int pos = blockEnd;
+        for (auto it = bb->instructions.rbegin(); it != bb->instructions.rend(); ++it)
+        {
+            shared_ptr<Instruction> ins = *it;
+            pos -= 2;
+            int defined = liveness.getDefinedValue(ins);
+            if (defined >= 0)  // 定义处截断，未使用的定义也占据一个位置
+            {
+                intervals[defined].ranges.emplace_back(pos, open[defined] ? openEnd[defined] : pos + 1);
+                open[defined] = false;
+            }
+            liveness.getUsedValues(ins, bb, used);
+            for (auto u : used)  // 使用处之前活跃，与此处定义的值可共用寄存器
+            {
+                if (!open[u])
+                {
+                    open[u] = true;
+                    openEnd[u] = pos;
+                }
+            }
+        }
+        unsigned int liveInStart = bb == func->entryBlock ? 0 : blockStart;  // 入口处活跃的值自参数定义起活跃
+        for (unsigned int i = 0; i < size; ++i)
+        {
+            if (open[i])
+            {
+                if (liveInStart < openEnd[i])
+                    intervals[i].ranges.emplace_back(liveInStart, openEnd[i]);
+                open[i] = false;
+            }
+        }
+        blockStart = blockEnd;
+    }
+    for (auto &arg : func->params)  // 参数在入口同时定义，彼此冲突
+        intervals[liveness.valueIndex.at(arg)].ranges.emplace_back(0, 1);
+    for (auto &interval : intervals)  // 段排序并合并相邻的段
+    {
+        sort(interval.ranges.begin(), interval.ranges.end());
+        vector<pair<unsigned int, unsigned int>> merged;
+        for (auto &range : interval.ranges)
+        {
+            if (!merged.empty() && range.first <= merged.back().second)
+                merged.back().second = max(merged.back().second, range.second);
+            else
+                merged.push_back(range);
+        }
+        interval.ranges = merged;
+    }
+    for (auto &bb : func->blocks)  // phi与phi_move、phi_move与phi的操作数互为提示
+    {
+        for (auto &ins : bb->instructions)
+        {
+            if (ins->type != PHI)
+                continue;
+            shared_ptr<PhiInstruction> phi = s_p_c<PhiInstruction>(ins);
+            if (phi->phiMove == nullptr || !liveness.isTracked(phi->phiMove))
+                continue;
+            unsigned int phiMove = liveness.valueIndex.at(phi->phiMove);
+            vector<unsigned int> partners;
+            if (liveness.isTracked(ins))
+                partners.push_back(liveness.valueIndex.at(ins));
+            for (auto &operand : phi->operands)
+            {
+                if (liveness.isTracked(operand.second))
+                    partners.push_back(liveness.valueIndex.at(operand.second));
+            }
+            for (auto partner : partners)
+            {
+                if (partner == phiMove)
+                    continue;
+                intervals[phiMove].hints.push_back(partner);
+                intervals[partner].hints.push_back(phiMove);
+            }
+        }
+    }
+}
+
+/**
+ * @brief 区间按起点升序依次分配：先退出已结束的区间，寄存器被活跃区间或与之重叠的非活跃区间占用则不可用；
+ *        无空闲寄存器时，比较占用各寄存器的区间权重之和，溢出权重较小的一方
+ * @param intervals 
+ */
+void linearScan(vector<LiveInterval> &intervals)
+{
+    vector<pair<unsigned int, unsigned int>> unhandled;  // 起点 <--> 区间
+    for (unsigned int i = 0; i < intervals.size(); ++i)
+    {
+        if (!intervals[i].ranges.empty())
+            unhandled.emplace_back(intervals[i].start(), i);
+    }
+    sort(unhandled.begin(), unhandled.end());
+    vector<unsigned int> active, inactive;  // 在当前位置活跃 / 处于空洞中
+    for (auto &item : unhandled)
+    {
+        unsigned int current = item.second;
+        LiveInterval &cur = intervals[current];
+        unsigned int pos = cur.start();
+        vector<unsigned int> nextActive, nextInactive;
+        for (auto i : active)
+        {
+            if (intervals[i].end() <= pos)
+                continue;
+            if (intervals[i].covers(pos))
+                nextActive.push_back(i);
+            else
+                nextInactive.push_back(i);
+        }
+        for (auto i : inactive)
+        {
+            if (intervals[i].end() <= pos)
+                continue;
+            if (intervals[i].covers(pos))
+                nextActive.push_back(i);
+            else
+                nextInactive.push_back(i);
+        }
+        active.swap(nextActive);
+        inactive.swap(nextInactive);
+
+        vector<unsigned long long> blockedWeight(_GLB_REG_CNT, 0);  // 占用寄存器且与当前区间重叠的区间权重之和
+        vector<bool> free(_GLB_REG_CNT, true);
+        for (auto i : active)
+        {
+            free[intervals[i].reg] = false;
+            blockedWeight[intervals[i].reg] += intervals[i].weight;
+        }
+        for (auto i : inactive)
+        {
+            if (intervals[i].intersects(cur))
+            {
+                free[intervals[i].reg] = false;
+                blockedWeight[intervals[i].reg] += intervals[i].weight;
+            }
+        }
+        for (auto hint : cur.hints)  // 优先与传送另一端共用寄存器
+        {
+            if (intervals[hint].reg >= 0 && free[intervals[hint].reg])
+            {
+                cur.reg = intervals[hint].reg;
+                break;
+            }
+        }
+        for (int reg = 0; cur.reg < 0 && reg < _GLB_REG_CNT; ++reg)
+        {
+            if (free[reg])
+                cur.reg = reg;
+        }
+        if (cur.reg < 0)
+        {
+            int cheapest = 0;
+            for (int reg = 1; reg < _GLB_REG_CNT; ++reg)
+            {
+                if (blockedWeight[reg] < blockedWeight[cheapest])
+                    cheapest = reg;
+            }
+            if (blockedWeight[cheapest] >= cur.weight)  // 当前区间的权重最小，放入内存
+                continue;
+            vector<unsigned int> kept;
+            for (auto i : active)  // 溢出占用该寄存器的区间
+            {
+                if (intervals[i].reg == cheapest)
+                    intervals[i].reg = -1;
+                else
+                    kept.push_back(i);
+            }
+            active.swap(kept);
+            kept.clear();
+            for (auto i : inactive)
+            {
+                if (intervals[i].reg == cheapest && intervals[i].intersects(cur))
+                    intervals[i].reg = -1;
+                else
+                    kept.push_back(i);
+            }
+            inactive.swap(kept);
+            cur.reg = cheapest;
+        }
+        active.push_back(current);
+    }
+}
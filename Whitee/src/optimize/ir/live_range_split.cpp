@@ -0,0 +1,169 @@
+﻿#include "ir_optimize.h"
+
+#include <algorithm>
+#include <map>
+
+struct WeightGreater
+{
+    bool operator()(const pair<unsigned int, shared_ptr<Value>> &a, const pair<unsigned int, shared_ptr<Value>> &b) const
+    {
+        return a.first > b.first;
+    }
+};
+
+shared_ptr<Loop> outermostLoopWithoutDefine(shared_ptr<Loop> loop, shared_ptr<BasicBlock> &defineBlock);
+
+void insertSplitCopy(shared_ptr<Value> &value, shared_ptr<Loop> &loop, vector<pair<shared_ptr<Instruction>, shared_ptr<BasicBlock>>> &uses);
+
+/**
+ * @brief 在循环边界拆分溢出值的活跃范围：溢出值在循环外定义而在循环内使用时，于循环前置块复制一次，
+ *        循环内改用此复制；重新分配后复制可占据寄存器，原值只在循环外的冷区访问内存。
+ *        每个循环内已分配寄存器的值同时活跃的最大数目决定可容纳的复制数，按权重选取
+ * @param func 
+ * @return 是否进行了拆分
+ */
+bool splitLiveRangeAroundLoops(shared_ptr<Function> &func)
+{
+    DominatorTree domTree(func);
+    LoopInfo loopInfo(domTree);
+    if (loopInfo.loops.empty())
+        return false;
+    map<unsigned int, shared_ptr<Value>> spilledValues;  // id <--> 溢出值，保证顺序确定
+    for (auto &value : func->variableWithoutReg)
+    {
+        if (value->value_type == INSTRUCTION && s_p_c<Instruction>(value)->type == PHI_MOV)
+            continue;
+        spilledValues[value->id] = value;
+    }
+    map<unsigned int, shared_ptr<Loop>> loops;  // 循环头id <--> 需拆分的循环
+    map<unsigned int, vector<pair<unsigned int, shared_ptr<Value>>>> loopValues;  // 循环头id <--> (权重, 溢出值)
+    map<pair<unsigned int, unsigned int>, vector<pair<shared_ptr<Instruction>, shared_ptr<BasicBlock>>>> loopUses;  // (循环头id, 值id) <--> 循环内的使用，phi的使用附带前驱块
+    for (auto &item : spilledValues)
+    {
+        shared_ptr<Value> value = item.second;
+        shared_ptr<BasicBlock> defineBlock;  // 参数在入口定义，不属于任何循环
+        if (value->value_type == INSTRUCTION)
+            defineBlock = s_p_c<Instruction>(value)->block;
+        for (auto &user : value->users)
+        {
+            if (user->value_type != INSTRUCTION)
+                continue;
+            shared_ptr<Instruction> ins = s_p_c<Instruction>(user);
+            vector<shared_ptr<BasicBlock>> useBlocks;
+            if (ins->type == PHI)  // phi的使用位于对应的前驱块
+            {
+                for (auto &operand : s_p_c<PhiInstruction>(ins)->operands)
+                {
+                    if (operand.second == value)
+                        useBlocks.push_back(operand.first);
+                }
+            }
+            else
+            {
+                useBlocks.push_back(ins->block);
+            }
+            for (auto &useBlock : useBlocks)
+            {
+                shared_ptr<Loop> loop = outermostLoopWithoutDefine(loopInfo.getLoop(useBlock), defineBlock);
+                if (loop == nullptr || loop->preheader == nullptr)
+                    continue;
+                auto key = make_pair(loop->header->id, value->id);
+                if (loopUses.count(key) == 0)
+                {
+                    loops[loop->header->id] = loop;
+                    loopValues[loop->header->id].emplace_back(func->variableWeight.at(value), value);
+                }
+                loopUses[key].emplace_back(ins, ins->type == PHI ? useBlock : nullptr);
+            }
+        }
+    }
+    if (loops.empty())
+        return false;
+
+    LivenessAnalysis liveness(func);
+    unordered_map<shared_ptr<BasicBlock>, unsigned int> blockPressure;  // 块内已分配寄存器的值同时活跃的最大数目
+    for (auto &bb : func->blocks)
+    {
+        BitVector live = liveness.liveOut.at(bb);
+        unsigned int maxPressure = 0;
+        for (auto it = bb->instructions.rbegin(); it != bb->instructions.rend(); ++it)
+        {
+            unsigned int pressure = 0;
+            for (unsigned int i = live.findNext(0); i < live.size; i = live.findNext(i + 1))
+                pressure += func->variableRegs.count(liveness.values[i]);
+            maxPressure = max(maxPressure, pressure);
+            shared_ptr<Instruction> ins = *it;
+            liveness.stepBackward(ins, bb, live);
+        }
+        blockPressure[bb] = maxPressure;
+    }
+
+    bool changed = false;
+    for (auto &item : loops)
+    {
+        shared_ptr<Loop> loop = item.second;
+        unsigned int pressure = 0;
+        for (auto &bb : loop->blocks)
+            pressure = max(pressure, blockPressure.at(bb));
+        vector<pair<unsigned int, shared_ptr<Value>>> &candidates = loopValues.at(item.first);
+        stable_sort(candidates.begin(), candidates.end(), WeightGreater());
+        for (unsigned int i = 0; i < candidates.size() && pressure + i < _GLB_REG_CNT; ++i)  // 复制在整个循环内活跃
+        {
+            insertSplitCopy(candidates[i].second, loop, loopUses.at(make_pair(item.first, candidates[i].second->id)));
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+/**
+ * @brief 包含使用块、但不包含定义块的最外层循环
+ * @param loop 使用块所在的最内层循环
+ * @param defineBlock 定义所在的块，参数为nullptr
+ * @return 没有则为nullptr
+ */
+shared_ptr<Loop> outermostLoopWithoutDefine(shared_ptr<Loop> loop, shared_ptr<BasicBlock> &defineBlock)
+{
+    shared_ptr<Loop> result;
+    while (loop != nullptr && (defineBlock == nullptr || !loop->contains(defineBlock)))
+    {
+        result = loop;
+        loop = loop->parent;
+    }
+    return result;
+}
+
+/**
+ * @brief 在循环前置块末尾（跳转及其比较之前）插入复制，循环内的使用改为使用复制
+ * @param value 被拆分的值
+ * @param loop 
+ * @param uses 循环内的使用，phi的使用附带前驱块
+ */
+void insertSplitCopy(shared_ptr<Value> &value, shared_ptr<Loop> &loop, vector<pair<shared_ptr<Instruction>, shared_ptr<BasicBlock>>> &uses)
+{
+    shared_ptr<BasicBlock> preheader = loop->preheader;
+    string op = "+";
+    shared_ptr<Instruction> copy = make_shared<UnaryInstruction>(op, value, preheader);
+    copy->resultType = L_VAL_RESULT;
+    copy->caughtVarName = generateTempLeftValueName();
+    value->users.insert(copy);
+    auto it = preheader->instructions.end() - 1;
+    if ((*it)->type == BR && it != preheader->instructions.begin() && (*(it - 1))->type == CMP)
+        --it;
+    preheader->instructions.insert(it, copy);
+
+    shared_ptr<Value> copyValue = copy;
+    for (auto &use : uses)
+    {
+        if (use.second == nullptr)
+        {
+            use.first->replaceUse(value, copyValue);
+            continue;
+        }
+        shared_ptr<PhiInstruction> phi = s_p_c<PhiInstruction>(use.first);  // 只替换来自循环内前驱的操作数
+        phi->operands[use.second] = copyValue;
+        copyValue->users.insert(phi);
+        if (phi->getOperandValueCount(value) == 0)
+            value->users.erase(phi);
+    }
+}
@@ -0,0 +1,475 @@
+﻿#include "ir_optimize.h"
+
+#include <algorithm>
+#include <map>
+
+/**
+ * 可交换的计数循环：循环头只有归纳变量一个phi，唯一的回边块以 iv+step 与循环不变量的比较决定是否继续
+ */
+struct NestLoop
+{
+    shared_ptr<Loop> loop;
+    shared_ptr<BasicBlock> header;
+    shared_ptr<BasicBlock> latch;       // 唯一的回边块，也是唯一的出口块
+    shared_ptr<BasicBlock> preheader;
+    shared_ptr<PhiInstruction> iv;      // 归纳变量
+    shared_ptr<Instruction> ivNext;     // iv + step，只被iv与cmp使用
+    shared_ptr<Instruction> cmp;        // 回边块的比较，只被分支使用
+    shared_ptr<BranchInstruction> br;   // 回边块的分支
+};
+
+/**
+ * 仿射下标：constant + Σ 系数 * 项；项为 (归纳变量, nullptr)、(nullptr, 不变量) 或二者的乘积 (归纳变量, 不变量)
+ */
+struct AffineForm
+{
+    long long constant = 0;
+    map<pair<shared_ptr<Value>, shared_ptr<Value>>, long long> terms;
+};
+
+bool interchange_loop_nest(shared_ptr<Loop> &outerLoop, AliasAnalysis &aliasAnalysis);
+
+bool analyse_nest_loop(shared_ptr<Loop> &loop, NestLoop &nest);
+
+bool is_perfect_nest(NestLoop &outer, NestLoop &inner);
+
+bool compute_affine(const shared_ptr<Value> &value, NestLoop &outer, NestLoop &inner, AffineForm &form, unsigned int depth);
+
+void add_affine(AffineForm &form, const AffineForm &other, long long scale);
+
+bool multiply_affine(const AffineForm &lhs, const AffineForm &rhs, AffineForm &form);
+
+int stride_cost(const AffineForm &form, const shared_ptr<Value> &iv);
+
+bool check_interchange_dependence(vector<shared_ptr<Instruction>> &accesses, vector<AffineForm> &forms, vector<bool> &affine,
+                                  NestLoop &outer, AliasAnalysis &aliasAnalysis);
+
+int innermost_dimension(const shared_ptr<Value> &address);
+
+void interchange_loops(NestLoop &outer, NestLoop &inner);
+
+void swap_instructions(shared_ptr<Instruction> a, shared_ptr<Instruction> b);
+
+extern bool is_loop_invariant(const shared_ptr<Value> &value, shared_ptr<Loop> &loop);
+
+/**
+ * @brief 循环交换：对两层的完美嵌套计数循环（外层循环体只有内层循环），若交换后最内层的数组访问步长更小且依赖允许，
+ *        则交换两层循环的控制（phi、归纳变量更新、比较），循环体不变
+ * @param module 
+ */
+void loop_interchange(shared_ptr<Module> &module)
+{
+    for (auto &func : module->functions)
+    {
+        if (func->entryBlock == nullptr)
+            continue;
+        DominatorTree domTree(func);
+        LoopInfo loopInfo(domTree);
+        AliasAnalysis aliasAnalysis(func);
+        for (auto &loop : loopInfo.loops)  // 交换只移动指令，不改变循环包含的块
+        {
+            if (loop->children.size() == 1 && loop->children.front()->children.empty())
+                interchange_loop_nest(loop, aliasAnalysis);
+        }
+    }
+}
+
+/**
+ * @brief 尝试交换外层循环与其唯一的内层循环
+ * @param outerLoop 
+ * @param aliasAnalysis 
+ * @return 是否交换
+ */
+bool interchange_loop_nest(shared_ptr<Loop> &outerLoop, AliasAnalysis &aliasAnalysis)
+{
+    NestLoop outer, inner;
+    if (!analyse_nest_loop(outerLoop, outer) || !analyse_nest_loop(outerLoop->children.front(), inner) || !is_perfect_nest(outer, inner))
+        return false;
+    vector<shared_ptr<Instruction>> accesses;
+    vector<AffineForm> forms;
+    vector<bool> affine;
+    for (auto &bb : inner.loop->blocks)
+    {
+        for (auto &ins : bb->instructions)
+        {
+            if (ins->type != LOAD && ins->type != STORE)
+                continue;
+            shared_ptr<Value> offset = ins->type == LOAD ? s_p_c<LoadInstruction>(ins)->offset : s_p_c<StoreInstruction>(ins)->offset;
+            AffineForm form;
+            accesses.push_back(ins);
+            affine.push_back(compute_affine(offset, outer, inner, form, 0));
+            forms.push_back(form);
+        }
+    }
+    // 最内层的步长代价：不变为0，单位步长为1，其他为2；外层作为最内层时代价更小才交换
+    // 在当前内层循环中不变的访问（如矩阵乘中的C[i][j]）不计入代价
+    int outerCost = 0, innerCost = 0;
+    for (unsigned int i = 0; i < accesses.size(); ++i)
+    {
+        if (!affine.at(i) || stride_cost(forms.at(i), inner.iv) == 0)
+            continue;
+        outerCost += stride_cost(forms.at(i), outer.iv);
+        innerCost += stride_cost(forms.at(i), inner.iv);
+    }
+    if (outerCost >= innerCost || !check_interchange_dependence(accesses, forms, affine, outer, aliasAnalysis))
+        return false;
+    interchange_loops(outer, inner);
+    return true;
+}
+
+/**
+ * @brief 识别可交换的计数循环
+ * @param loop 
+ * @param nest 识别结果
+ * @return 
+ */
+bool analyse_nest_loop(shared_ptr<Loop> &loop, NestLoop &nest)
+{
+    if (loop->latches.size() != 1 || loop->preheader == nullptr || loop->header->phis.size() != 1 || loop->header->predecessors.size() != 2)
+        return false;
+    nest.loop = loop;
+    nest.header = loop->header;
+    nest.latch = loop->latches.front();
+    nest.preheader = loop->preheader;
+    nest.iv = *loop->header->phis.begin();
+    for (auto &bb : loop->blocks)
+    {
+        for (auto &suc : bb->successors)
+        {
+            if (!loop->contains(suc) && bb != nest.latch)  // 只允许从回边块退出
+                return false;
+        }
+    }
+    if (nest.latch->instructions.empty() || nest.latch->instructions.back()->type != BR)
+        return false;
+    nest.br = s_p_c<BranchInstruction>(nest.latch->instructions.back());
+    if (nest.br->trueBlock != nest.header || loop->contains(nest.br->falseBlock))
+        return false;
+    if (nest.br->condition->value_type != INSTRUCTION || s_p_c<Instruction>(nest.br->condition)->type != CMP)
+        return false;
+    nest.cmp = s_p_c<Instruction>(nest.br->condition);
+    if (nest.cmp->block != nest.latch || nest.cmp->users.size() != 1)
+        return false;
+    if (nest.iv->operands.size() != 2 || nest.iv->operands.count(nest.latch) == 0 || nest.iv->operands.count(nest.preheader) == 0)
+        return false;
+    shared_ptr<Value> next = nest.iv->operands.at(nest.latch);
+    if (next->value_type != INSTRUCTION || s_p_c<Instruction>(next)->type != BINARY || !loop->contains(s_p_c<Instruction>(next)->block))
+        return false;
+    shared_ptr<BinaryInstruction> increment = s_p_c<BinaryInstruction>(next);
+    bool stepped = (increment->op == "+" && ((increment->lhs == nest.iv && increment->rhs->value_type == NUMBER) ||
+                                             (increment->rhs == nest.iv && increment->lhs->value_type == NUMBER))) ||
+                   (increment->op == "-" && increment->lhs == nest.iv && increment->rhs->value_type == NUMBER);
+    if (!stepped)
+        return false;
+    nest.ivNext = increment;
+    shared_ptr<BinaryInstruction> cmp = s_p_c<BinaryInstruction>(nest.cmp);
+    if (!((cmp->lhs == nest.ivNext && is_loop_invariant(cmp->rhs, loop)) || (cmp->rhs == nest.ivNext && is_loop_invariant(cmp->lhs, loop))))
+        return false;
+    for (auto &user : nest.ivNext->users)  // 更新只用于循环控制，交换后才能移动
+    {
+        if (user->value_type == INSTRUCTION && user != nest.iv && user != nest.cmp)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 完美嵌套：外层循环中内层循环以外只有控制流、外层的归纳变量更新与比较、循环不变的内层入口判断；
+ *        内层的范围与外层无关，循环体不调用函数，嵌套中的值不在嵌套外使用
+ * @param outer 
+ * @param inner 
+ * @return 
+ */
+bool is_perfect_nest(NestLoop &outer, NestLoop &inner)
+{
+    if (inner.preheader != outer.header)
+        return false;
+    for (auto &bb : outer.loop->blocks)
+    {
+        if (inner.loop->contains(bb))
+            continue;
+        if (bb != outer.header && !bb->phis.empty())
+            return false;
+        for (auto &ins : bb->instructions)
+        {
+            if (ins == outer.ivNext || ins == outer.cmp || ins->type == JMP || ins->type == BR)
+                continue;
+            if (bb == outer.header && ins->type == CMP && is_loop_invariant(s_p_c<BinaryInstruction>(ins)->lhs, outer.loop) &&
+                is_loop_invariant(s_p_c<BinaryInstruction>(ins)->rhs, outer.loop))
+                continue;
+            return false;
+        }
+    }
+    for (auto &bb : inner.loop->blocks)
+    {
+        for (auto &ins : bb->instructions)
+        {
+            if (ins->type == INVOKE || ins->type == ALLOC || ins->type == RET)
+                return false;
+        }
+    }
+    shared_ptr<BinaryInstruction> cmp = s_p_c<BinaryInstruction>(inner.cmp);
+    if (!is_loop_invariant(inner.iv->operands.at(inner.preheader), outer.loop) || !is_loop_invariant(cmp->lhs == inner.ivNext ? cmp->rhs : cmp->lhs, outer.loop))
+        return false;
+    for (auto &bb : outer.loop->blocks)
+    {
+        vector<shared_ptr<Value>> defs(bb->phis.begin(), bb->phis.end());
+        defs.insert(defs.end(), bb->instructions.begin(), bb->instructions.end());
+        for (auto &def : defs)
+        {
+            for (auto &user : def->users)
+            {
+                if (user->value_type == INSTRUCTION && !outer.loop->contains(s_p_c<Instruction>(user)->block))
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 将下标表示为两层归纳变量与外层循环不变量的仿射式
+ * @param value 
+ * @param outer 
+ * @param inner 
+ * @param form 结果
+ * @param depth 递归深度
+ * @return 是否为仿射式
+ */
+bool compute_affine(const shared_ptr<Value> &value, NestLoop &outer, NestLoop &inner, AffineForm &form, unsigned int depth)
+{
+    if (depth > 16)
+        return false;
+    if (value->value_type == NUMBER)
+    {
+        form.constant = s_p_c<NumberValue>(value)->number;
+        return true;
+    }
+    if (value == outer.iv || value == inner.iv)
+    {
+        form.terms[make_pair(value, shared_ptr<Value>())] = 1;
+        return true;
+    }
+    if (is_loop_invariant(value, outer.loop))
+    {
+        form.terms[make_pair(shared_ptr<Value>(), value)] = 1;
+        return true;
+    }
+    if (value->value_type != INSTRUCTION || s_p_c<Instruction>(value)->type != BINARY)
+        return false;
+    shared_ptr<BinaryInstruction> bi = s_p_c<BinaryInstruction>(value);
+    AffineForm lhs, rhs;
+    if (!compute_affine(bi->lhs, outer, inner, lhs, depth + 1) || !compute_affine(bi->rhs, outer, inner, rhs, depth + 1))
+        return false;
+    if (bi->op == "+" || bi->op == "-")
+    {
+        add_affine(form, lhs, 1);
+        add_affine(form, rhs, bi->op == "+" ? 1 : -1);
+        return true;
+    }
+    if (bi->op == "*")
+        return multiply_affine(lhs, rhs, form);
+    return false;
+}
+
+/**
+ * @brief form += other * scale，去掉系数为0的项
+ * @param form 
+ * @param other 
+ * @param scale 
+ */
+void add_affine(AffineForm &form, const AffineForm &other, long long scale)
+{
+    form.constant += other.constant * scale;
+    for (auto &term : other.terms)
+    {
+        long long &coefficient = form.terms[term.first];
+        coefficient += term.second * scale;
+        if (coefficient == 0)
+            form.terms.erase(term.first);
+    }
+}
+
+/**
+ * @brief 仿射式相乘：一方为常数，或一方只含不变量、另一方只含归纳变量
+ * @param lhs 
+ * @param rhs 
+ * @param form 结果
+ * @return 乘积是否可表示
+ */
+bool multiply_affine(const AffineForm &lhs, const AffineForm &rhs, AffineForm &form)
+{
+    if (rhs.terms.empty())
+    {
+        add_affine(form, lhs, rhs.constant);
+        return true;
+    }
+    if (lhs.terms.empty())
+    {
+        add_affine(form, rhs, lhs.constant);
+        return true;
+    }
+    bool lhsInvariant = true, rhsInvariant = true, lhsInduction = true, rhsInduction = true;
+    for (auto &term : lhs.terms)
+    {
+        lhsInvariant = lhsInvariant && term.first.first == nullptr;
+        lhsInduction = lhsInduction && term.first.second == nullptr;
+    }
+    for (auto &term : rhs.terms)
+    {
+        rhsInvariant = rhsInvariant && term.first.first == nullptr;
+        rhsInduction = rhsInduction && term.first.second == nullptr;
+    }
+    if (!(lhsInvariant && rhsInduction) && !(lhsInduction && rhsInvariant))
+        return false;
+    const AffineForm &invariant = lhsInvariant && rhsInduction ? lhs : rhs;
+    const AffineForm &induction = lhsInvariant && rhsInduction ? rhs : lhs;
+    form.constant = invariant.constant * induction.constant;
+    add_affine(form, invariant, induction.constant);
+    form.constant -= invariant.constant * induction.constant;
+    add_affine(form, induction, invariant.constant);
+    for (auto &a : invariant.terms)
+    {
+        for (auto &b : induction.terms)
+        {
+            AffineForm product;
+            product.terms[make_pair(b.first.first, a.first.second)] = a.second * b.second;
+            add_affine(form, product, 1);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 以iv为最内层时访问的步长代价：与iv无关为0，单位步长为1，其他（包括步长含不变量）为2
+ * @param form 
+ * @param iv 
+ * @return 
+ */
+int stride_cost(const AffineForm &form, const shared_ptr<Value> &iv)
+{
+    int cost = 0;
+    for (auto &term : form.terms)
+    {
+        if (term.first.first != iv)
+            continue;
+        if (term.first.second == nullptr && (term.second == 1 || term.second == -1))
+            cost = max(cost, 1);
+        else
+            cost = 2;
+    }
+    return cost;
+}
+
+/**
+ * @brief 依赖检查：可能相关的两个访问（至少一个为store）须访问同一数组且下标相同；
+ *        下标与两层都无关时任意两次迭代都相关，不能交换；与两层都相关时，要求一层为单位步长、另一层的步长不小于最内维，
+ *        则（下标在界内时）不同迭代不会访问同一位置；只与一层相关时依赖方向为 (=, *) 或 (*, =)，交换后不变
+ * @param accesses 内层循环中的load、store
+ * @param forms 下标的仿射式
+ * @param affine 下标是否为仿射式
+ * @param outer 
+ * @param aliasAnalysis 
+ * @return 是否允许交换
+ */
+bool check_interchange_dependence(vector<shared_ptr<Instruction>> &accesses, vector<AffineForm> &forms, vector<bool> &affine,
+                                  NestLoop &outer, AliasAnalysis &aliasAnalysis)
+{
+    for (unsigned int i = 0; i < accesses.size(); ++i)
+    {
+        if (accesses.at(i)->type != STORE)
+            continue;
+        MemoryLocation store = AliasAnalysis::getLocation(accesses.at(i));
+        shared_ptr<Value> address = s_p_c<StoreInstruction>(accesses.at(i))->address;
+        for (unsigned int j = 0; j < accesses.size(); ++j)
+        {
+            if (aliasAnalysis.alias(store, AliasAnalysis::getLocation(accesses.at(j))) == NO_ALIAS)
+                continue;
+            shared_ptr<Value> other = accesses.at(j)->type == LOAD ? s_p_c<LoadInstruction>(accesses.at(j))->address : s_p_c<StoreInstruction>(accesses.at(j))->address;
+            if (!affine.at(i) || !affine.at(j) || address != other || forms.at(i).constant != forms.at(j).constant || forms.at(i).terms != forms.at(j).terms)
+                return false;
+        }
+        long long outerStride = 0, innerStride = 0;
+        for (auto &term : forms.at(i).terms)
+        {
+            if (term.first.first == nullptr)
+                continue;
+            if (term.first.second != nullptr)  // 步长含不变量
+                return false;
+            if (term.first.first == outer.iv)
+                outerStride = term.second;
+            else
+                innerStride = term.second;
+        }
+        if (outerStride == 0 && innerStride == 0)
+            return false;
+        if (outerStride != 0 && innerStride != 0)
+        {
+            long long small = min(llabs(outerStride), llabs(innerStride)), large = max(llabs(outerStride), llabs(innerStride));
+            int dimension = innermost_dimension(address);
+            if (small != 1 || dimension <= 1 || large < dimension)
+                return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 多维数组最内维的长度
+ * @param address 
+ * @return 长度；一维数组或未知时为0
+ */
+int innermost_dimension(const shared_ptr<Value> &address)
+{
+    const vector<int> *dimensions = nullptr;
+    if (address->value_type == GLOBAL)
+        dimensions = &s_p_c<GlobalValue>(address)->dimensions;
+    else if (address->value_type == PARAMETER)
+        dimensions = &s_p_c<ParameterValue>(address)->dimensions;
+    if (dimensions == nullptr || dimensions->size() < 2)
+        return 0;
+    return dimensions->back();
+}
+
+/**
+ * @brief 交换两层循环的控制：外层的phi移到内层循环头、内层的phi移到外层循环头，归纳变量更新与回边比较交换位置；
+ *        内层入口判断循环不变，原样保留
+ * @param outer 
+ * @param inner 
+ */
+void interchange_loops(NestLoop &outer, NestLoop &inner)
+{
+    shared_ptr<Value> outerInit = outer.iv->operands.at(outer.preheader);
+    shared_ptr<Value> innerInit = inner.iv->operands.at(inner.preheader);
+    outer.header->phis.erase(outer.iv);
+    inner.header->phis.erase(inner.iv);
+    outer.header->phis.insert(inner.iv);
+    inner.header->phis.insert(outer.iv);
+    outer.iv->block = inner.header;
+    inner.iv->block = outer.header;
+    outer.iv->operands.clear();
+    outer.iv->operands[inner.preheader] = outerInit;
+    outer.iv->operands[inner.latch] = outer.ivNext;
+    inner.iv->operands.clear();
+    inner.iv->operands[outer.preheader] = innerInit;
+    inner.iv->operands[outer.latch] = inner.ivNext;
+    swap_instructions(outer.ivNext, inner.ivNext);
+    swap_instructions(outer.cmp, inner.cmp);
+    shared_ptr<Value> outerCmp = outer.cmp, innerCmp = inner.cmp;
+    outer.br->replaceUse(outerCmp, innerCmp);
+    inner.br->replaceUse(innerCmp, outerCmp);
+}
+
+/**
+ * @brief 交换两条指令在块中的位置
+ * @param a 
+ * @param b 
+ */
+void swap_instructions(shared_ptr<Instruction> a, shared_ptr<Instruction> b)
+{
+    auto posA = find(a->block->instructions.begin(), a->block->instructions.end(), a);
+    auto posB = find(b->block->instructions.begin(), b->block->instructions.end(), b);
+    *posA = b;
+    *posB = a;
+    swap(a->block, b->block);
+}
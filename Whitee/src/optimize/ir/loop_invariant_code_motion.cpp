@@ -14,7 +14,32 @@ void build_dominate_tree(shared_ptr<BasicBlock> &entryBlock, shared_ptr<Function
 
 void find_loop_blocks(shared_ptr<Function> &func);
 
-void find_invariant_codes(shared_ptr<BasicBlock> &firstBlock);
+void find_invariant_codes(shared_ptr<BasicBlock> &firstBlock, MemorySSA &memorySSA);
+
+bool is_invariant_load(shared_ptr<Instruction> &ins, unordered_set<shared_ptr<BasicBlock>> &blocksInLoop, MemorySSA &memorySSA);
+
+bool is_pure_invoke(shared_ptr<Instruction> &ins, unordered_set<shared_ptr<BasicBlock>> &blocksInLoop);
+
+bool is_invariant_readonly_invoke(shared_ptr<Instruction> &ins, unordered_set<shared_ptr<BasicBlock>> &blocksInLoop, vector<shared_ptr<Instruction>> &loopDefs,
+                                  AliasAnalysis &aliasAnalysis);
+
+void promote_loop_global_scalars(shared_ptr<Function> &func);
+
+bool promote_one_global_scalar(shared_ptr<Function> &func, unordered_map<shared_ptr<BasicBlock>, unordered_set<shared_ptr<Value>>> &visited);
+
+bool promote_global_scalar(shared_ptr<Function> &func, shared_ptr<Loop> &loop, shared_ptr<Value> &global, DominatorTree &domTree, AliasAnalysis &aliasAnalysis);
+
+void store_on_exit_edge(shared_ptr<Function> &func, shared_ptr<BasicBlock> &exiting, shared_ptr<BasicBlock> &exit, shared_ptr<Value> &global, shared_ptr<Value> &value);
+
+extern void make_left_value(const shared_ptr<Value> &value);
+
+extern void replace_load(shared_ptr<Instruction> &load, const shared_ptr<Value> &value);
+
+extern void remove_store(shared_ptr<Instruction> &store);
+
+extern void insert_before_terminator(shared_ptr<BasicBlock> &bb, const shared_ptr<Instruction> &ins);
+
+bool dominate_loop_exits(shared_ptr<BasicBlock> &bb, unordered_set<shared_ptr<BasicBlock>> &blocksInLoop);
 
 void fix_new_forward_block(shared_ptr<Function> &func, shared_ptr<BasicBlock> &firstBlock);
 
@@ -40,15 +65,19 @@ void loop_invariant_motion(shared_ptr<Function> &func)
     newForwardBlocks.clear();
     build_dominate_tree(func->entryBlock, func);
     find_loop_blocks(func);
+    DominatorTree domTree(func);
+    AliasAnalysis aliasAnalysis(func);
+    MemorySSA memorySSA(func, domTree, aliasAnalysis);  // 只移动load，不改变def，移动过程中仍有效
     for (auto &bb : func->blocks)
     {
-        find_invariant_codes(bb);
+        find_invariant_codes(bb, memorySSA);
     }
     for (auto &item : newForwardBlocks)
     {
         shared_ptr<BasicBlock> first = item.first;
         fix_new_forward_block(func, first);
     }
+    promote_loop_global_scalars(func);
 }
 
 /**
@@ -168,12 +197,22 @@ void find_loop_blocks(shared_ptr<Function> &func)
 /**
  * @brief 寻找不动代码
  * @param firstBlock 开始寻找的块
+ * @param memorySSA 
  */
-void find_invariant_codes(shared_ptr<BasicBlock> &firstBlock)
+void find_invariant_codes(shared_ptr<BasicBlock> &firstBlock, MemorySSA &memorySSA)
 {
     if (loopBlocks.count(firstBlock) == 0)
         return;
     unordered_set<shared_ptr<BasicBlock>> blocksInLoop = loopBlocks.at(firstBlock);
+    vector<shared_ptr<Instruction>> loopDefs;  // 循环的写集合：store与写内存的调用
+    for (auto &bb : blocksInLoop)
+    {
+        for (auto &ins : bb->instructions)
+        {
+            if (AliasAnalysis::isMemoryDef(ins))
+                loopDefs.push_back(ins);
+        }
+    }
     for (auto &bb : loopBlocks.at(firstBlock))
     {
         for (auto it = bb->instructions.begin(); it != bb->instructions.end();)
@@ -194,7 +233,17 @@ void find_invariant_codes(shared_ptr<BasicBlock> &firstBlock)
                 motion = !judge_loop(unary->value, blocksInLoop);
                 break;
             }
-            default:; // TODO: judge invoke, load or store.
+            case LOAD:
+            {
+                shared_ptr<LoadInstruction> load = s_p_c<LoadInstruction>(ins);
+                motion = !judge_loop(load->address, blocksInLoop) && !judge_loop(load->offset, blocksInLoop) && is_invariant_load(ins, blocksInLoop, memorySSA);
+                break;
+            }
+            case INVOKE:
+                motion = is_pure_invoke(ins, blocksInLoop) || is_invariant_readonly_invoke(ins, blocksInLoop, loopDefs, memorySSA.aliasAnalysis);
+                break;
+            default:  // store不外提，循环中全局标量的读写由promote_loop_global_scalars替换
+                break;
             }
             if (motion)  // 此指令无变量在循环内
             {
@@ -219,6 +268,100 @@ void find_invariant_codes(shared_ptr<BasicBlock> &firstBlock)
     }
 }
 
+/**
+ * @brief 循环中没有可能写此位置的指令，且load所在块支配循环的所有出口（进入循环即会执行，提前执行不会多出越界访问）
+ * @param ins load指令
+ * @param blocksInLoop 在循环里的块
+ * @param memorySSA 
+ * @return 
+ */
+bool is_invariant_load(shared_ptr<Instruction> &ins, unordered_set<shared_ptr<BasicBlock>> &blocksInLoop, MemorySSA &memorySSA)
+{
+    shared_ptr<MemoryAccess> clobber = memorySSA.getClobberingAccess(ins);
+    if (clobber == nullptr || (clobber->type != LIVE_ON_ENTRY && blocksInLoop.count(clobber->block) != 0))
+        return false;
+    return dominate_loop_exits(ins->block, blocksInLoop);
+}
+
+/**
+ * @brief 纯函数（不读写内存、不输入输出）的调用，实参都不在循环内，且所在块支配循环的所有出口
+ * @param ins 调用指令
+ * @param blocksInLoop 在循环里的块
+ * @return 
+ */
+bool is_pure_invoke(shared_ptr<Instruction> &ins, unordered_set<shared_ptr<BasicBlock>> &blocksInLoop)
+{
+    shared_ptr<InvokeInstruction> invoke = s_p_c<InvokeInstruction>(ins);
+    if (invoke->invokeType != COMMON || invoke->resultType == OTHER_RESULT || invoke->targetFunction->side_effect || invoke->targetFunction->readsMemory())
+        return false;
+    for (auto &param : invoke->params)
+    {
+        if (judge_loop(param, blocksInLoop))
+            return false;
+    }
+    return dominate_loop_exits(ins->block, blocksInLoop);
+}
+
+/**
+ * @brief 只读内存的函数的调用，实参都不在循环内，循环中的写都不会改变被调用函数可能读的位置，且所在块支配循环的所有出口
+ * @param ins 调用指令
+ * @param blocksInLoop 在循环里的块
+ * @param loopDefs 循环中的store与写内存的调用
+ * @param aliasAnalysis 
+ * @return 
+ */
+bool is_invariant_readonly_invoke(shared_ptr<Instruction> &ins, unordered_set<shared_ptr<BasicBlock>> &blocksInLoop, vector<shared_ptr<Instruction>> &loopDefs,
+                                  AliasAnalysis &aliasAnalysis)
+{
+    shared_ptr<InvokeInstruction> invoke = s_p_c<InvokeInstruction>(ins);
+    if (invoke->invokeType != COMMON || invoke->resultType == OTHER_RESULT || invoke->targetFunction->side_effect || invoke->targetFunction->modifiesMemory())
+        return false;
+    for (auto &param : invoke->params)
+    {
+        if (judge_loop(param, blocksInLoop))
+            return false;
+    }
+    shared_ptr<Function> &callee = invoke->targetFunction;
+    vector<MemoryLocation> reads;  // 被调用函数可能读的位置
+    if (callee->refUnknown)
+        reads.emplace_back();
+    for (auto &global : callee->refGlobals)
+        reads.push_back(AliasAnalysis::getLocation(global, nullptr));
+    for (auto index : callee->refParams)
+    {
+        if (index < invoke->params.size())
+            reads.push_back(AliasAnalysis::getLocation(invoke->params.at(index), nullptr));
+    }
+    for (auto &def : loopDefs)
+    {
+        for (auto &location : reads)
+        {
+            if (aliasAnalysis.mayModify(def, location))
+                return false;
+        }
+    }
+    return dominate_loop_exits(ins->block, blocksInLoop);
+}
+
+/**
+ * @brief 块支配循环的所有出口，即进入循环就会执行
+ * @param bb 
+ * @param blocksInLoop 在循环里的块
+ * @return 
+ */
+bool dominate_loop_exits(shared_ptr<BasicBlock> &bb, unordered_set<shared_ptr<BasicBlock>> &blocksInLoop)
+{
+    for (auto &exiting : blocksInLoop)
+    {
+        for (auto &suc : exiting->successors)
+        {
+            if (blocksInLoop.count(suc) == 0 && outDominate.at(exiting).count(bb) == 0)
+                return false;
+        }
+    }
+    return true;
+}
+
 /**
  * @brief 插入循环不变量的块
  * @param func 所在函数
@@ -318,3 +461,183 @@ inline bool judge_loop(shared_ptr<Value> &value, unordered_set<shared_ptr<BasicB
 {
     return value->value_type == INSTRUCTION && blocksInLoop.count(s_p_c<Instruction>(value)->block) != 0;
 }
+
+/**
+ * @brief 循环中全局标量的标量替换：循环中的读写换为SSA值，进入循环前load一次，在循环的出口store回去；外层循环优先
+ * @param func 
+ */
+void promote_loop_global_scalars(shared_ptr<Function> &func)
+{
+    unordered_map<shared_ptr<BasicBlock>, unordered_set<shared_ptr<Value>>> visited;  // 循环头 --> 已尝试的全局标量
+    while (promote_one_global_scalar(func, visited));
+}
+
+/**
+ * @brief 替换一个未尝试过的（循环，全局标量）；出口边的拆分会改变控制流，每次替换后重新计算支配树与循环信息
+ * @param func 
+ * @param visited 循环头 --> 已尝试的全局标量
+ * @return 是否有全局标量被替换
+ */
+bool promote_one_global_scalar(shared_ptr<Function> &func, unordered_map<shared_ptr<BasicBlock>, unordered_set<shared_ptr<Value>>> &visited)
+{
+    DominatorTree domTree(func);
+    LoopInfo loopInfo(domTree);
+    AliasAnalysis aliasAnalysis(func);
+    for (auto &loop : loopInfo.loops)
+    {
+        unordered_set<shared_ptr<Value>> globals;  // 循环中写的全局标量
+        for (auto &bb : loop->blocks)
+        {
+            for (auto &ins : bb->instructions)
+            {
+                if (ins->type == STORE && AliasAnalysis::isScalarGlobal(s_p_c<StoreInstruction>(ins)->address))
+                    globals.insert(s_p_c<StoreInstruction>(ins)->address);
+            }
+        }
+        for (auto global : globals)
+        {
+            if (!visited[loop->header].insert(global).second)
+                continue;
+            if (promote_global_scalar(func, loop, global, domTree, aliasAnalysis))
+                return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 在循环中把一个全局标量替换为SSA值：有多个前驱的块放置phi，沿逆后序求各块末尾的值；
+ *        循环中不能有其他可能读写此变量的指令（调用按读写摘要）
+ * @param func 
+ * @param loop 
+ * @param global 全局标量
+ * @param domTree 
+ * @param aliasAnalysis 
+ * @return 是否替换
+ */
+bool promote_global_scalar(shared_ptr<Function> &func, shared_ptr<Loop> &loop, shared_ptr<Value> &global, DominatorTree &domTree, AliasAnalysis &aliasAnalysis)
+{
+    if (loop->preheader == nullptr)
+        return false;
+    MemoryLocation location = AliasAnalysis::getLocation(global, nullptr);
+    for (auto &bb : loop->blocks)
+    {
+        for (auto &ins : bb->instructions)
+        {
+            bool direct = (ins->type == LOAD && s_p_c<LoadInstruction>(ins)->address == global) || (ins->type == STORE && s_p_c<StoreInstruction>(ins)->address == global);
+            if (!direct && (aliasAnalysis.mayModify(ins, location) || aliasAnalysis.mayRead(ins, location)))
+                return false;
+        }
+    }
+    // 进入循环前的值
+    shared_ptr<Value> zero = Number(0);
+    shared_ptr<BasicBlock> preheader = loop->preheader;
+    shared_ptr<Instruction> init = make_shared<LoadInstruction>(global, zero, preheader);
+    user_use(init, {global, zero});
+    make_left_value(init);
+    insert_before_terminator(preheader, init);
+    // 有多个前驱的块放置phi
+    unordered_map<shared_ptr<BasicBlock>, shared_ptr<PhiInstruction>> blockPhis;
+    for (auto bb : loop->blocks)
+    {
+        if (bb->predecessors.size() > 1 || bb == loop->header)
+        {
+            string name = generateTempLeftValueName();
+            shared_ptr<PhiInstruction> phi = make_shared<PhiInstruction>(name, bb);
+            bb->phis.insert(phi);
+            blockPhis[bb] = phi;
+        }
+    }
+    // 逆后序中单前驱块的前驱在前，load换为当前值，store更新当前值
+    unordered_map<shared_ptr<BasicBlock>, shared_ptr<Value>> blockValues;  // 块末尾的值
+    for (auto &bb : domTree.reversePostOrder)
+    {
+        if (!loop->contains(bb))
+            continue;
+        shared_ptr<Value> current = blockPhis.count(bb) != 0 ? blockPhis.at(bb) : blockValues.at(*bb->predecessors.begin());
+        for (auto it = bb->instructions.begin(); it != bb->instructions.end();)
+        {
+            shared_ptr<Instruction> ins = *it;
+            if (ins->type == LOAD && s_p_c<LoadInstruction>(ins)->address == global)
+            {
+                replace_load(ins, current);
+                it = bb->instructions.erase(it);
+            }
+            else if (ins->type == STORE && s_p_c<StoreInstruction>(ins)->address == global)
+            {
+                current = s_p_c<StoreInstruction>(ins)->value;
+                make_left_value(current);
+                remove_store(ins);
+                it = bb->instructions.erase(it);
+            }
+            else
+                ++it;
+        }
+        blockValues[bb] = current;
+    }
+    for (auto &it : blockPhis)
+    {
+        for (auto &pred : it.first->predecessors)
+        {
+            shared_ptr<Value> value = loop->contains(pred) ? blockValues.at(pred) : init;
+            it.second->operands[pred] = value;
+            value->users.insert(it.second);
+        }
+    }
+    // 出口处写回
+    vector<pair<shared_ptr<BasicBlock>, shared_ptr<BasicBlock>>> exitEdges;
+    for (auto &bb : loop->blocks)
+    {
+        for (auto &suc : bb->successors)
+        {
+            if (!loop->contains(suc))
+                exitEdges.emplace_back(bb, suc);
+        }
+    }
+    for (auto &edge : exitEdges)
+        store_on_exit_edge(func, edge.first, edge.second, global, blockValues.at(edge.first));
+    for (auto &it : blockPhis)
+        remove_trivial_phi(it.second);
+    return true;
+}
+
+/**
+ * @brief 在循环的出口边上store；出口块只有这一个前驱时放在出口块开头，否则拆分此边
+ * @param func 
+ * @param exiting 循环中的块
+ * @param exit 循环外的后继
+ * @param global 全局标量
+ * @param value 写回的值
+ */
+void store_on_exit_edge(shared_ptr<Function> &func, shared_ptr<BasicBlock> &exiting, shared_ptr<BasicBlock> &exit, shared_ptr<Value> &global, shared_ptr<Value> &value)
+{
+    shared_ptr<Value> zero = Number(0);
+    if (exit->predecessors.size() == 1)
+    {
+        shared_ptr<Instruction> store = make_shared<StoreInstruction>(value, global, zero, exit);
+        user_use(store, {value, global, zero});
+        exit->instructions.insert(exit->instructions.begin(), store);
+        return;
+    }
+    shared_ptr<BasicBlock> edgeBlock = make_shared<BasicBlock>(func, true, exit->loopDepth);
+    shared_ptr<Instruction> store = make_shared<StoreInstruction>(value, global, zero, edgeBlock);
+    user_use(store, {value, global, zero});
+    edgeBlock->instructions.push_back(store);
+    edgeBlock->instructions.push_back(make_shared<JumpInstruction>(exit, edgeBlock));
+    shared_ptr<Instruction> terminator = exiting->instructions.back();
+    if (terminator->type == JMP)
+        s_p_c<JumpInstruction>(terminator)->targetBlock = edgeBlock;
+    else if (s_p_c<BranchInstruction>(terminator)->trueBlock == exit)
+        s_p_c<BranchInstruction>(terminator)->trueBlock = edgeBlock;
+    else
+        s_p_c<BranchInstruction>(terminator)->falseBlock = edgeBlock;
+    exiting->successors.erase(exit);
+    exiting->successors.insert(edgeBlock);
+    edgeBlock->predecessors.insert(exiting);
+    edgeBlock->successors.insert(exit);
+    exit->predecessors.erase(exiting);
+    exit->predecessors.insert(edgeBlock);
+    for (auto &phi : exit->phis)
+        phi->replaceUse(exiting, edgeBlock);
+    func->blocks.insert(find(func->blocks.begin(), func->blocks.end(), exit), edgeBlock);
+}
@@ -0,0 +1,583 @@
+﻿#include "ir_optimize.h"
+
+#include <algorithm>
+#include <climits>
+
+/**
+ * 可并行的外层计数循环：步长为1的归纳变量与循环不变的上界比较，其余循环头phi每次迭代加上循环不变的步长
+ */
+struct ParallelLoop
+{
+    shared_ptr<Loop> loop;
+    shared_ptr<BasicBlock> latch;     // 唯一的回边块，也是唯一的出口块
+    shared_ptr<BasicBlock> exit;
+    shared_ptr<PhiInstruction> iv;    // 归纳变量
+    shared_ptr<Instruction> cmp;      // 回边块的比较 iv + 1 < bound
+    shared_ptr<Value> bound;
+    unordered_map<shared_ptr<PhiInstruction>, shared_ptr<Value>> steps;  // 其余循环头phi --> 每次迭代的步长
+};
+
+/**
+ * 下标：coefficient * iv + Σ 系数 * 项 + constant，项在一次迭代中与iv无关
+ */
+struct ParallelSubscript
+{
+    long long coefficient = 0;
+    long long constant = 0;
+    map<shared_ptr<Value>, long long> terms;
+};
+
+bool analyse_parallel_loop(shared_ptr<Loop> &loop, ParallelLoop &parallel);
+
+bool check_parallel_dependence(ParallelLoop &parallel, AliasAnalysis &aliasAnalysis);
+
+bool is_row_exact_access(const shared_ptr<Instruction> &ins, ParallelLoop &parallel, unordered_set<shared_ptr<Value>> &variant);
+
+bool compute_parallel_subscript(const shared_ptr<Value> &value, ParallelLoop &parallel, unordered_set<shared_ptr<Value>> &variant,
+                                ParallelSubscript &subscript, unsigned int depth);
+
+void add_parallel_subscript(ParallelSubscript &subscript, const ParallelSubscript &other, long long scale);
+
+void outline_parallel_loop(shared_ptr<Module> &module, shared_ptr<Function> &func, ParallelLoop &parallel, unsigned int index);
+
+void get_parallel_operands(const shared_ptr<Instruction> &ins, vector<shared_ptr<Value>> &operands);
+
+shared_ptr<Value> make_parallel_binary(string op, shared_ptr<Value> lhs, shared_ptr<Value> rhs, shared_ptr<BasicBlock> &bb);
+
+extern bool is_loop_invariant(const shared_ptr<Value> &value, shared_ptr<Loop> &loop);
+
+/**
+ * @brief 自动并行化：没有跨迭代依赖的最外层计数循环（内含循环）外提为新函数，原位置改为并行调用，
+ *        运行时把迭代范围分给多个线程；循环中不能有调用，数组的写只能落在以归纳变量为最高维下标的行上
+ * @param module 
+ */
+void loop_parallelization(shared_ptr<Module> &module)
+{
+    unsigned int index = 0;
+    vector<shared_ptr<Function>> functions = module->functions;  // 外提的函数加入module
+    for (auto &func : functions)
+    {
+        if (func->entryBlock == nullptr)
+            continue;
+        bool changed = true;
+        while (changed)  // 外提后函数的块改变，重新分析
+        {
+            changed = false;
+            DominatorTree domTree(func);
+            LoopInfo loopInfo(domTree);
+            AliasAnalysis aliasAnalysis(func);
+            for (auto &loop : loopInfo.loops)
+            {
+                ParallelLoop parallel;
+                if (loop->parent != nullptr || loop->children.empty() || !analyse_parallel_loop(loop, parallel) || !check_parallel_dependence(parallel, aliasAnalysis))
+                    continue;
+                outline_parallel_loop(module, func, parallel, index++);
+                changed = true;
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief 识别可并行的计数循环：从唯一的回边块退出，循环中没有调用、局部数组与返回，循环中定义的值不在循环外使用
+ * @param loop 
+ * @param parallel 识别结果
+ * @return 
+ */
+bool analyse_parallel_loop(shared_ptr<Loop> &loop, ParallelLoop &parallel)
+{
+    if (loop->latches.size() != 1 || loop->preheader == nullptr || loop->header->predecessors.size() != 2)
+        return false;
+    shared_ptr<BasicBlock> preheader = loop->preheader;
+    if (preheader->instructions.empty() || (preheader->instructions.back()->type == BR && s_p_c<BranchInstruction>(preheader->instructions.back())->trueBlock ==
+                                                                                            s_p_c<BranchInstruction>(preheader->instructions.back())->falseBlock))
+        return false;
+    parallel.loop = loop;
+    parallel.latch = loop->latches.front();
+    for (auto &bb : loop->blocks)
+    {
+        for (auto &suc : bb->successors)
+        {
+            if (!loop->contains(suc) && bb != parallel.latch)
+                return false;
+        }
+        for (auto &ins : bb->instructions)
+        {
+            if (ins->type == INVOKE || ins->type == ALLOC || ins->type == RET)
+                return false;
+        }
+    }
+    if (parallel.latch->instructions.empty() || parallel.latch->instructions.back()->type != BR)
+        return false;
+    shared_ptr<BranchInstruction> br = s_p_c<BranchInstruction>(parallel.latch->instructions.back());
+    if (br->trueBlock != loop->header || loop->contains(br->falseBlock))
+        return false;
+    parallel.exit = br->falseBlock;
+    if (br->condition->value_type != INSTRUCTION || s_p_c<Instruction>(br->condition)->type != CMP)
+        return false;
+    shared_ptr<BinaryInstruction> cmp = s_p_c<BinaryInstruction>(br->condition);
+    if (cmp->block != parallel.latch || cmp->users.size() != 1)
+        return false;
+    shared_ptr<Value> next;
+    if (cmp->op == "<" && is_loop_invariant(cmp->rhs, loop))
+    {
+        next = cmp->lhs;
+        parallel.bound = cmp->rhs;
+    }
+    else if (cmp->op == ">" && is_loop_invariant(cmp->lhs, loop))
+    {
+        next = cmp->rhs;
+        parallel.bound = cmp->lhs;
+    }
+    else
+        return false;
+    parallel.cmp = cmp;
+    if (next->value_type != INSTRUCTION || s_p_c<Instruction>(next)->type != BINARY || s_p_c<BinaryInstruction>(next)->op != "+")
+        return false;
+    shared_ptr<BinaryInstruction> increment = s_p_c<BinaryInstruction>(next);
+    shared_ptr<Value> base = increment->rhs->value_type == NUMBER && s_p_c<NumberValue>(increment->rhs)->number == 1   ? increment->lhs
+                             : increment->lhs->value_type == NUMBER && s_p_c<NumberValue>(increment->lhs)->number == 1 ? increment->rhs
+                                                                                                                       : nullptr;
+    for (auto &phi : loop->header->phis)
+    {
+        if (phi->operands.size() != 2 || phi->operands.count(preheader) == 0 || phi->operands.count(parallel.latch) == 0)
+            return false;
+        if (phi == base && phi->operands.at(parallel.latch) == increment)
+        {
+            parallel.iv = phi;
+            continue;
+        }
+        // 其余phi：phi + 循环不变量，或 phi - 常数
+        shared_ptr<Value> update = phi->operands.at(parallel.latch);
+        if (update->value_type != INSTRUCTION || s_p_c<Instruction>(update)->type != BINARY || !loop->contains(s_p_c<Instruction>(update)->block))
+            return false;
+        shared_ptr<BinaryInstruction> binary = s_p_c<BinaryInstruction>(update);
+        if (binary->op == "+" && binary->lhs == phi && is_loop_invariant(binary->rhs, loop))
+            parallel.steps[phi] = binary->rhs;
+        else if (binary->op == "+" && binary->rhs == phi && is_loop_invariant(binary->lhs, loop))
+            parallel.steps[phi] = binary->lhs;
+        else if (binary->op == "-" && binary->lhs == phi && binary->rhs->value_type == NUMBER && s_p_c<NumberValue>(binary->rhs)->number != INT_MIN)
+            parallel.steps[phi] = Number(-s_p_c<NumberValue>(binary->rhs)->number);
+        else
+            return false;
+    }
+    if (parallel.iv == nullptr)
+        return false;
+    for (auto &bb : loop->blocks)
+    {
+        vector<shared_ptr<Value>> defs(bb->phis.begin(), bb->phis.end());
+        defs.insert(defs.end(), bb->instructions.begin(), bb->instructions.end());
+        for (auto &def : defs)
+        {
+            for (auto &user : def->users)
+            {
+                if (user->value_type == INSTRUCTION && !loop->contains(s_p_c<Instruction>(user)->block))
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 跨迭代依赖检查：可能相关的两个访问（至少一个为store）须访问同一数组，且下标都恰好以归纳变量为最高维下标，
+ *        即 最高维的跨度 * iv + 与iv无关、绝对值小于跨度的部分；（下标在界内时）不同迭代访问不同的行，没有依赖
+ * @param parallel 
+ * @param aliasAnalysis 
+ * @return 是否可以并行
+ */
+bool check_parallel_dependence(ParallelLoop &parallel, AliasAnalysis &aliasAnalysis)
+{
+    // 随迭代变化的值：循环头phi、load及其在循环中的使用者
+    unordered_set<shared_ptr<Value>> variant;
+    vector<shared_ptr<Value>> workList(parallel.loop->header->phis.begin(), parallel.loop->header->phis.end());
+    vector<shared_ptr<Instruction>> accesses;
+    for (auto &bb : parallel.loop->blocks)
+    {
+        for (auto &ins : bb->instructions)
+        {
+            if (ins->type == LOAD)
+                workList.push_back(ins);
+            if (ins->type == LOAD || ins->type == STORE)
+                accesses.push_back(ins);
+        }
+    }
+    while (!workList.empty())
+    {
+        shared_ptr<Value> value = workList.back();
+        workList.pop_back();
+        if (!variant.insert(value).second)
+            continue;
+        for (auto &user : value->users)
+        {
+            if (user->value_type == INSTRUCTION && parallel.loop->contains(s_p_c<Instruction>(user)->block))
+                workList.push_back(user);
+        }
+    }
+    for (auto &store : accesses)
+    {
+        if (store->type != STORE)
+            continue;
+        MemoryLocation location = AliasAnalysis::getLocation(store);
+        for (auto &access : accesses)
+        {
+            if (aliasAnalysis.alias(location, AliasAnalysis::getLocation(access)) == NO_ALIAS)
+                continue;
+            shared_ptr<Value> address = access->type == LOAD ? s_p_c<LoadInstruction>(access)->address : s_p_c<StoreInstruction>(access)->address;
+            if (address != s_p_c<StoreInstruction>(store)->address || !is_row_exact_access(store, parallel, variant) || !is_row_exact_access(access, parallel, variant))
+                return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 访问的下标是否为 跨度 * iv + 行内部分；跨度为最高维以外各维长度之积，局部数组与一维数组为1
+ * @param ins load或store
+ * @param parallel 
+ * @param variant 随迭代变化的值
+ * @return 
+ */
+bool is_row_exact_access(const shared_ptr<Instruction> &ins, ParallelLoop &parallel, unordered_set<shared_ptr<Value>> &variant)
+{
+    shared_ptr<Value> address = ins->type == LOAD ? s_p_c<LoadInstruction>(ins)->address : s_p_c<StoreInstruction>(ins)->address;
+    shared_ptr<Value> offset = ins->type == LOAD ? s_p_c<LoadInstruction>(ins)->offset : s_p_c<StoreInstruction>(ins)->offset;
+    vector<int> dimensions;
+    if (address->value_type == GLOBAL)
+        dimensions = s_p_c<GlobalValue>(address)->dimensions;
+    else if (address->value_type == PARAMETER && s_p_c<ParameterValue>(address)->variableType == POINTER)
+        dimensions = s_p_c<ParameterValue>(address)->dimensions;
+    else if (address->value_type == INSTRUCTION && s_p_c<Instruction>(address)->type == ALLOC)
+        dimensions.push_back(s_p_c<AllocInstruction>(address)->units);
+    else
+        return false;
+    if (dimensions.empty())  // 全局变量
+        return false;
+    long long span = 1;
+    for (unsigned int i = 1; i < dimensions.size(); ++i)
+        span *= dimensions.at(i);
+    ParallelSubscript subscript;
+    if (!compute_parallel_subscript(offset, parallel, variant, subscript, 0) || subscript.coefficient != span || llabs(subscript.constant) >= span)
+        return false;
+    for (auto &term : subscript.terms)
+    {
+        if (llabs(term.second) >= span)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 把下标展开为iv的仿射式；其余循环头phi按 初值 + 步长 * (iv - iv初值) 展开，不随迭代变化的值作为项
+ * @param value 
+ * @param parallel 
+ * @param variant 随迭代变化的值
+ * @param subscript 结果
+ * @param depth 递归深度
+ * @return 是否可以展开
+ */
+bool compute_parallel_subscript(const shared_ptr<Value> &value, ParallelLoop &parallel, unordered_set<shared_ptr<Value>> &variant,
+                                ParallelSubscript &subscript, unsigned int depth)
+{
+    if (depth > 16)
+        return false;
+    if (value->value_type == NUMBER)
+    {
+        subscript.constant = s_p_c<NumberValue>(value)->number;
+        return true;
+    }
+    if (value == parallel.iv)
+    {
+        subscript.coefficient = 1;
+        return true;
+    }
+    if (value->value_type == INSTRUCTION && s_p_c<Instruction>(value)->type == PHI && parallel.steps.count(s_p_c<PhiInstruction>(value)) != 0)
+    {
+        shared_ptr<PhiInstruction> phi = s_p_c<PhiInstruction>(value);
+        shared_ptr<Value> step = parallel.steps.at(phi);
+        if (step->value_type != NUMBER)
+            return false;
+        ParallelSubscript init, ivInit;
+        if (!compute_parallel_subscript(phi->operands.at(parallel.loop->preheader), parallel, variant, init, depth + 1) ||
+            !compute_parallel_subscript(parallel.iv->operands.at(parallel.loop->preheader), parallel, variant, ivInit, depth + 1))
+            return false;
+        add_parallel_subscript(subscript, init, 1);
+        add_parallel_subscript(subscript, ivInit, -s_p_c<NumberValue>(step)->number);
+        subscript.coefficient += s_p_c<NumberValue>(step)->number;
+        return true;
+    }
+    if (value->value_type == INSTRUCTION && s_p_c<Instruction>(value)->type == BINARY && (s_p_c<BinaryInstruction>(value)->op == "+" ||
+                                                                                       s_p_c<BinaryInstruction>(value)->op == "-" || s_p_c<BinaryInstruction>(value)->op == "*"))
+    {
+        shared_ptr<BinaryInstruction> binary = s_p_c<BinaryInstruction>(value);
+        ParallelSubscript lhs, rhs;
+        if (!compute_parallel_subscript(binary->lhs, parallel, variant, lhs, depth + 1) || !compute_parallel_subscript(binary->rhs, parallel, variant, rhs, depth + 1))
+            return false;
+        if (binary->op != "*")
+        {
+            add_parallel_subscript(subscript, lhs, 1);
+            add_parallel_subscript(subscript, rhs, binary->op == "+" ? 1 : -1);
+            return true;
+        }
+        if (rhs.coefficient == 0 && rhs.terms.empty())
+        {
+            add_parallel_subscript(subscript, lhs, rhs.constant);
+            return true;
+        }
+        if (lhs.coefficient == 0 && lhs.terms.empty())
+        {
+            add_parallel_subscript(subscript, rhs, lhs.constant);
+            return true;
+        }
+        if (lhs.coefficient != 0 || rhs.coefficient != 0 || variant.count(value) != 0)  // 与iv有关的非线性下标
+            return false;
+        subscript.terms[value] = 1;
+        return true;
+    }
+    if (variant.count(value) != 0)
+        return false;
+    subscript.terms[value] = 1;
+    return true;
+}
+
+/**
+ * @brief subscript += other * scale，去掉系数为0的项
+ * @param subscript 
+ * @param other 
+ * @param scale 
+ */
+void add_parallel_subscript(ParallelSubscript &subscript, const ParallelSubscript &other, long long scale)
+{
+    subscript.coefficient += other.coefficient * scale;
+    subscript.constant += other.constant * scale;
+    for (auto &term : other.terms)
+    {
+        long long &coefficient = subscript.terms[term.first];
+        coefficient += term.second * scale;
+        if (coefficient == 0)
+            subscript.terms.erase(term.first);
+    }
+}
+
+/**
+ * @brief 把循环外提为函数 (lo, hi, 循环中使用的循环外的值...)，循环执行 iv = lo 至 hi - 1；
+ *        循环原来的位置换为一个并行调用此函数后跳到出口块的块
+ * @param module 
+ * @param func 循环所在的函数
+ * @param parallel 
+ * @param index 外提函数的编号
+ */
+void outline_parallel_loop(shared_ptr<Module> &module, shared_ptr<Function> &func, ParallelLoop &parallel, unsigned int index)
+{
+    shared_ptr<Loop> &loop = parallel.loop;
+    shared_ptr<BasicBlock> preheader = loop->preheader;
+    shared_ptr<BasicBlock> header = loop->header;
+    shared_ptr<Function> worker = make_shared<Function>();
+    worker->name = "__parallel_" + func->name + "_" + to_string(index);
+    worker->funcType = FUNC_VOID;
+    shared_ptr<BasicBlock> entry = make_shared<BasicBlock>(worker, true, preheader->loopDepth);
+    shared_ptr<BasicBlock> retBlock = make_shared<BasicBlock>(worker, true, preheader->loopDepth);
+    shared_ptr<Value> lo = make_shared<ParameterValue>(worker, "Parallel_lo", INT, vector<int>());
+    shared_ptr<Value> hi = make_shared<ParameterValue>(worker, "Parallel_hi", INT, vector<int>());
+    worker->params = {lo, hi};
+
+    // 循环控制：上界换为hi，循环头phi的初值改为外提函数入口块中的值
+    shared_ptr<Value> bound = parallel.bound;
+    parallel.cmp->replaceUse(bound, hi);
+    shared_ptr<Value> ivInit = parallel.iv->operands.at(preheader);
+    unordered_map<shared_ptr<PhiInstruction>, shared_ptr<Value>> inits;
+    vector<shared_ptr<Value>> outsideValues{ivInit};  // 入口块计算初值用到的循环外的值
+    for (auto &phi : header->phis)
+    {
+        inits[phi] = phi->operands.at(preheader);
+        phi->operands.erase(preheader);
+        inits.at(phi)->users.erase(phi);
+        if (phi != parallel.iv)
+        {
+            outsideValues.push_back(inits.at(phi));
+            outsideValues.push_back(parallel.steps.at(phi));
+        }
+    }
+
+    // 循环中使用的循环外的值作为参数
+    vector<shared_ptr<BasicBlock>> loopBlocks;
+    for (auto &bb : func->blocks)
+    {
+        if (loop->contains(bb))
+            loopBlocks.push_back(bb);
+    }
+    vector<shared_ptr<Value>> args{ivInit, bound};
+    unordered_map<shared_ptr<Value>, shared_ptr<Value>> argMap;  // 循环外的值 --> 形参
+    vector<shared_ptr<Value>> operands;
+    for (auto &bb : loopBlocks)
+    {
+        for (auto &phi : bb->phis)
+        {
+            for (auto &it : phi->operands)
+                outsideValues.push_back(it.second);
+        }
+        for (auto &ins : bb->instructions)
+        {
+            get_parallel_operands(ins, operands);
+            outsideValues.insert(outsideValues.end(), operands.begin(), operands.end());
+        }
+    }
+    for (auto &value : outsideValues)
+    {
+        bool outside = (value->value_type == PARAMETER && value != hi) || (value->value_type == INSTRUCTION && !loop->contains(s_p_c<Instruction>(value)->block));
+        if (!outside || argMap.count(value) != 0)
+            continue;
+        shared_ptr<Value> param;
+        if (AliasAnalysis::isPointer(value))
+        {
+            vector<int> dimensions;  // 指针运算的结果（如内联后的行地址）没有维度
+            if (value->value_type == PARAMETER)
+                dimensions = s_p_c<ParameterValue>(value)->dimensions;
+            else if (s_p_c<Instruction>(value)->type == ALLOC)
+                dimensions.push_back(s_p_c<AllocInstruction>(value)->units);
+            param = make_shared<ParameterValue>(worker, "Parallel_arg_" + to_string(args.size()), POINTER, dimensions);
+        }
+        else
+            param = make_shared<ParameterValue>(worker, "Parallel_arg_" + to_string(args.size()), INT, vector<int>());
+        worker->params.push_back(param);
+        args.push_back(value);
+        argMap[value] = param;
+        unordered_set<shared_ptr<Value>> users = value->users;
+        for (auto &user : users)
+        {
+            if (user->value_type == INSTRUCTION && loop->contains(s_p_c<Instruction>(user)->block))
+                user->replaceUse(value, param);
+        }
+    }
+
+    // 入口块：其余phi的初值为 init + step * (lo - ivInit)
+    shared_ptr<Value> distance = make_parallel_binary("-", lo, mapValue(argMap, ivInit), entry);
+    for (auto &phi : header->phis)
+    {
+        shared_ptr<Value> init = lo;
+        if (phi != parallel.iv)
+        {
+            shared_ptr<Value> offset = make_parallel_binary("*", mapValue(argMap, parallel.steps.at(phi)), distance, entry);
+            init = make_parallel_binary("+", mapValue(argMap, inits.at(phi)), offset, entry);
+        }
+        phi->operands[entry] = init;
+        init->users.insert(phi);
+    }
+    entry->instructions.push_back(make_shared<JumpInstruction>(header, entry));
+    entry->successors.insert(header);
+    header->predecessors.erase(preheader);
+    header->predecessors.insert(entry);
+
+    // 循环的块移入外提函数，出口改为返回
+    shared_ptr<BasicBlock> exit = parallel.exit;
+    shared_ptr<BasicBlock> latch = parallel.latch;
+    shared_ptr<BranchInstruction> br = s_p_c<BranchInstruction>(latch->instructions.back());
+    br->falseBlock = retBlock;
+    latch->successors.erase(exit);
+    latch->successors.insert(retBlock);
+    retBlock->predecessors.insert(latch);
+    shared_ptr<Value> noValue = nullptr;
+    retBlock->instructions.push_back(make_shared<ReturnInstruction>(FUNC_VOID, noValue, retBlock));
+    shared_ptr<BasicBlock> callBlock = make_shared<BasicBlock>(func, true, preheader->loopDepth);
+    func->blocks.insert(find(func->blocks.begin(), func->blocks.end(), loopBlocks.front()), callBlock);
+    worker->entryBlock = entry;
+    worker->blocks.push_back(entry);
+    for (auto &bb : loopBlocks)
+    {
+        bb->function = worker;
+        worker->blocks.push_back(bb);
+        func->blocks.erase(find(func->blocks.begin(), func->blocks.end(), bb));
+    }
+    worker->blocks.push_back(retBlock);
+
+    // 前置块跳到并行调用块，然后跳到出口块
+    shared_ptr<Instruction> terminator = preheader->instructions.back();
+    if (terminator->type == JMP)
+        s_p_c<JumpInstruction>(terminator)->targetBlock = callBlock;
+    else if (s_p_c<BranchInstruction>(terminator)->trueBlock == header)
+        s_p_c<BranchInstruction>(terminator)->trueBlock = callBlock;
+    else
+        s_p_c<BranchInstruction>(terminator)->falseBlock = callBlock;
+    preheader->successors.erase(header);
+    preheader->successors.insert(callBlock);
+    callBlock->predecessors.insert(preheader);
+    for (auto &phi : exit->phis)
+        phi->replaceUse(latch, callBlock);
+    exit->predecessors.erase(latch);
+    exit->predecessors.insert(callBlock);
+    callBlock->successors.insert(exit);
+    shared_ptr<InvokeInstruction> invoke = make_shared<InvokeInstruction>(worker, args, callBlock);
+    invoke->parallel = true;
+    user_use(invoke, args);
+    callBlock->instructions.push_back(invoke);
+    callBlock->instructions.push_back(make_shared<JumpInstruction>(exit, callBlock));
+    func->callees.insert(worker);
+    worker->callers.insert(func);
+    module->functions.push_back(worker);
+}
+
+/**
+ * @brief 指令的操作数
+ * @param ins 非phi指令
+ * @param operands 结果
+ */
+void get_parallel_operands(const shared_ptr<Instruction> &ins, vector<shared_ptr<Value>> &operands)
+{
+    operands.clear();
+    switch (ins->type)
+    {
+    case BR:
+        operands.push_back(s_p_c<BranchInstruction>(ins)->condition);
+        break;
+    case UNARY:
+        operands.push_back(s_p_c<UnaryInstruction>(ins)->value);
+        break;
+    case BINARY:
+    case CMP:
+        operands.push_back(s_p_c<BinaryInstruction>(ins)->lhs);
+        operands.push_back(s_p_c<BinaryInstruction>(ins)->rhs);
+        break;
+    case STORE:
+        operands.push_back(s_p_c<StoreInstruction>(ins)->value);
+        operands.push_back(s_p_c<StoreInstruction>(ins)->address);
+        operands.push_back(s_p_c<StoreInstruction>(ins)->offset);
+        break;
+    case LOAD:
+        operands.push_back(s_p_c<LoadInstruction>(ins)->address);
+        operands.push_back(s_p_c<LoadInstruction>(ins)->offset);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief 在块末尾生成二元运算，操作数为常数时直接折叠
+ * @param op 
+ * @param lhs 
+ * @param rhs 
+ * @param bb 
+ * @return 运算结果
+ */
+shared_ptr<Value> make_parallel_binary(string op, shared_ptr<Value> lhs, shared_ptr<Value> rhs, shared_ptr<BasicBlock> &bb)
+{
+    bool lhsNumber = lhs->value_type == NUMBER, rhsNumber = rhs->value_type == NUMBER;
+    int l = lhsNumber ? s_p_c<NumberValue>(lhs)->number : 0, r = rhsNumber ? s_p_c<NumberValue>(rhs)->number : 0;
+    if (lhsNumber && rhsNumber)
+        return Number(op == "+" ? (int)((unsigned)l + (unsigned)r) : op == "-" ? (int)((unsigned)l - (unsigned)r) : (int)((unsigned)l * (unsigned)r));
+    if (rhsNumber && r == 0 && op != "*")
+        return lhs;
+    if (lhsNumber && l == 0 && op == "+")
+        return rhs;
+    if (((lhsNumber && l == 0) || (rhsNumber && r == 0)) && op == "*")
+        return Number(0);
+    if (rhsNumber && r == 1 && op == "*")
+        return lhs;
+    if (lhsNumber && l == 1 && op == "*")
+        return rhs;
+    shared_ptr<Instruction> ins = make_shared<BinaryInstruction>(op, lhs, rhs, bb);
+    user_use(ins, {lhs, rhs});
+    bb->instructions.push_back(ins);
+    return ins;
+}
@@ -0,0 +1,596 @@
+﻿#include "ir_optimize.h"
+
+#include <algorithm>
+#include <climits>
+
+const unsigned int _UNROLL_FULL_MAX_TRIP = 32;      // 完全展开的最大迭代次数
+const unsigned int _UNROLL_FULL_MAX_INS_CNT = 256;  // 完全展开后的最大指令数
+const unsigned int _UNROLL_PARTIAL_MAX_INS_CNT = 96;  // 部分展开后循环体的最大指令数
+const unsigned int _UNROLL_FACTORS[] = {8, 4, 2};   // 部分展开的候选因子
+
+/**
+ * 计数循环：循环头的phi归纳变量每次迭代增加常数步长，唯一的回边块以其与循环不变量的比较决定是否继续
+ */
+struct CountedLoop
+{
+    shared_ptr<BasicBlock> header;
+    shared_ptr<BasicBlock> latch;      // 唯一的回边块，也是唯一的出口块
+    shared_ptr<BasicBlock> preheader;
+    shared_ptr<BasicBlock> exit;       // 唯一的出口目标
+    vector<shared_ptr<BasicBlock>> blocks;  // 循环内的块，逆后序
+    shared_ptr<PhiInstruction> iv;     // 归纳变量
+    shared_ptr<Instruction> ivNext;    // iv + step
+    shared_ptr<BinaryInstruction> cmp; // ivNext op bound，为真时继续
+    string op;                         // 比较操作符，ivNext在左
+    shared_ptr<Value> bound;           // 循环不变的边界
+    int step;
+    unsigned int size;                 // 循环的指令数，包括phi
+};
+
+/**
+ * 循环体的一份复制
+ */
+struct LoopCopy
+{
+    unordered_map<shared_ptr<Value>, shared_ptr<Value>> valueMap;
+    unordered_map<shared_ptr<BasicBlock>, shared_ptr<BasicBlock>> blockMap;
+    vector<shared_ptr<BasicBlock>> blocks;
+};
+
+bool unroll_one_loop(shared_ptr<Function> &func, unordered_set<shared_ptr<BasicBlock>> &visitedHeaders);
+
+bool analyse_counted_loop(shared_ptr<Loop> &loop, DominatorTree &domTree, CountedLoop &counted);
+
+bool is_loop_invariant(const shared_ptr<Value> &value, shared_ptr<Loop> &loop);
+
+bool compare(const string &op, long long lhs, long long rhs);
+
+int constant_trip_count(CountedLoop &counted);
+
+void create_copy_blocks(shared_ptr<Function> &func, CountedLoop &counted, LoopCopy &copy);
+
+void clone_loop_body(CountedLoop &counted, LoopCopy &copy);
+
+void add_edge(const shared_ptr<BasicBlock> &from, const shared_ptr<BasicBlock> &to);
+
+void redirect_edge(shared_ptr<BasicBlock> &from, shared_ptr<BasicBlock> &oldTarget, shared_ptr<BasicBlock> &newTarget);
+
+shared_ptr<BinaryInstruction> append_cmp_branch(string op, shared_ptr<Value> lhs, shared_ptr<Value> rhs, shared_ptr<BasicBlock> &bb,
+                                                shared_ptr<BasicBlock> trueBlock, shared_ptr<BasicBlock> falseBlock);
+
+void full_unroll(shared_ptr<Function> &func, CountedLoop &counted, int tripCount);
+
+bool partial_unroll(shared_ptr<Function> &func, CountedLoop &counted, unsigned int factor, unordered_set<shared_ptr<BasicBlock>> &visitedHeaders);
+
+/**
+ * @brief 循环展开：对最内层的计数循环，迭代次数为常数且较小时完全展开，否则按8/4/2展开并保留原循环处理余下的迭代
+ * @param module 
+ */
+void loop_unroll(shared_ptr<Module> &module)
+{
+    for (auto &func : module->functions)
+    {
+        unordered_set<shared_ptr<BasicBlock>> visitedHeaders;  // 已处理的循环头，包括展开产生的循环
+        while (unroll_one_loop(func, visitedHeaders))
+            unused_block_delete(func);
+    }
+}
+
+/**
+ * @brief 展开函数中一个未处理的最内层循环，每次展开后重新计算循环信息
+ * @param func 
+ * @param visitedHeaders 已处理的循环头
+ * @return 是否有循环被展开
+ */
+bool unroll_one_loop(shared_ptr<Function> &func, unordered_set<shared_ptr<BasicBlock>> &visitedHeaders)
+{
+    if (func->entryBlock == nullptr)
+        return false;
+    DominatorTree domTree(func);
+    LoopInfo loopInfo(domTree);
+    for (auto &loop : loopInfo.loops)
+    {
+        if (!loop->children.empty() || visitedHeaders.count(loop->header) != 0)
+            continue;
+        visitedHeaders.insert(loop->header);
+        CountedLoop counted;
+        if (!analyse_counted_loop(loop, domTree, counted))
+            continue;
+        int tripCount = constant_trip_count(counted);
+        if (tripCount > 0 && (unsigned int)tripCount <= _UNROLL_FULL_MAX_TRIP && tripCount * counted.size <= _UNROLL_FULL_MAX_INS_CNT)
+        {
+            full_unroll(func, counted, tripCount);
+            return true;
+        }
+        AliasAnalysis aliasAnalysis(func);
+        VectorLoop vectorLoop;
+        if (VectorLoop::analyse(loop, aliasAnalysis, vectorLoop))  // 留给后端生成向量循环
+            continue;
+        for (auto factor : _UNROLL_FACTORS)
+        {
+            if (factor * counted.size <= _UNROLL_PARTIAL_MAX_INS_CNT && (tripCount < 0 || (unsigned int)tripCount >= factor * 2))
+            {
+                if (partial_unroll(func, counted, factor, visitedHeaders))
+                    return true;
+                break;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 识别计数循环：单回边、有前置块、只从回边块退出，回边块的分支条件为 iv+step op 不变量 且为真时回到循环头
+ * @param loop 
+ * @param domTree 
+ * @param counted 识别结果
+ * @return 是否为计数循环
+ */
+bool analyse_counted_loop(shared_ptr<Loop> &loop, DominatorTree &domTree, CountedLoop &counted)
+{
+    if (loop->latches.size() != 1 || loop->preheader == nullptr || loop->header->predecessors.size() != 2)
+        return false;
+    counted.header = loop->header;
+    counted.latch = loop->latches.front();
+    counted.preheader = loop->preheader;
+    counted.size = 0;
+    for (auto &bb : domTree.reversePostOrder)
+    {
+        if (!loop->contains(bb))
+            continue;
+        counted.blocks.push_back(bb);
+        counted.size += bb->instructions.size() + bb->phis.size();
+        for (auto &suc : bb->successors)
+        {
+            if (!loop->contains(suc) && bb != counted.latch)  // 只允许从回边块退出
+                return false;
+        }
+        for (auto &ins : bb->instructions)
+        {
+            if (ins->type == ALLOC || ins->type == RET)
+                return false;
+        }
+    }
+    shared_ptr<Instruction> last = counted.latch->instructions.back();
+    if (last->type != BR)
+        return false;
+    shared_ptr<BranchInstruction> br = s_p_c<BranchInstruction>(last);
+    if (br->trueBlock != counted.header || loop->contains(br->falseBlock))
+        return false;
+    counted.exit = br->falseBlock;
+    if (br->condition->value_type != INSTRUCTION || s_p_c<Instruction>(br->condition)->type != CMP)
+        return false;
+    counted.cmp = s_p_c<BinaryInstruction>(br->condition);
+    counted.op = counted.cmp->op;
+    shared_ptr<Value> ivNext = counted.cmp->lhs;
+    counted.bound = counted.cmp->rhs;
+    if (!is_loop_invariant(counted.bound, loop))
+    {
+        ivNext = counted.cmp->rhs;
+        counted.bound = counted.cmp->lhs;
+        counted.op = BinaryInstruction::swapOpConst(counted.op);
+        if (!is_loop_invariant(counted.bound, loop))
+            return false;
+    }
+    if (ivNext->value_type != INSTRUCTION || s_p_c<Instruction>(ivNext)->type != BINARY)
+        return false;
+    shared_ptr<BinaryInstruction> increment = s_p_c<BinaryInstruction>(ivNext);
+    shared_ptr<Value> base, stepValue;
+    if (increment->op == "+" && increment->rhs->value_type == NUMBER)
+        base = increment->lhs, stepValue = increment->rhs;
+    else if (increment->op == "+" && increment->lhs->value_type == NUMBER)
+        base = increment->rhs, stepValue = increment->lhs;
+    else if (increment->op == "-" && increment->rhs->value_type == NUMBER)
+        base = increment->lhs, stepValue = increment->rhs;
+    else
+        return false;
+    counted.step = s_p_c<NumberValue>(stepValue)->number;
+    if (increment->op == "-")
+        counted.step = -counted.step;
+    if (base->value_type != INSTRUCTION || s_p_c<Instruction>(base)->type != PHI || s_p_c<Instruction>(base)->block != counted.header)
+        return false;
+    counted.iv = s_p_c<PhiInstruction>(base);
+    counted.ivNext = increment;
+    if (counted.iv->operands.count(counted.latch) == 0 || counted.iv->operands.at(counted.latch) != counted.ivNext)
+        return false;
+    if (counted.step > 0 ? counted.op != "<" && counted.op != "<=" : counted.step < 0 ? counted.op != ">" && counted.op != ">=" : true)
+        return false;
+    if (counted.step > 1024 || counted.step < -1024)
+        return false;
+    for (auto &phi : counted.header->phis)
+    {
+        if (phi->operands.size() != 2 || phi->operands.count(counted.preheader) == 0 || phi->operands.count(counted.latch) == 0)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 值是否为循环不变量：非指令，或定义在循环外的指令
+ * @param value 
+ * @param loop 
+ * @return 
+ */
+bool is_loop_invariant(const shared_ptr<Value> &value, shared_ptr<Loop> &loop)
+{
+    if (value->value_type != INSTRUCTION)
+        return value->value_type != UNDEFINED;
+    return !loop->contains(s_p_c<Instruction>(value)->block);
+}
+
+bool compare(const string &op, long long lhs, long long rhs)
+{
+    if (op == "<")
+        return lhs < rhs;
+    if (op == "<=")
+        return lhs <= rhs;
+    if (op == ">")
+        return lhs > rhs;
+    return lhs >= rhs;
+}
+
+/**
+ * @brief 常数迭代次数：初值与边界都为常数时模拟计算
+ * @param counted 
+ * @return 迭代次数；不是常数或超过完全展开的限制时返回-1
+ */
+int constant_trip_count(CountedLoop &counted)
+{
+    shared_ptr<Value> init = counted.iv->operands.at(counted.preheader);
+    if (init->value_type != NUMBER || counted.bound->value_type != NUMBER)
+        return -1;
+    long long iv = s_p_c<NumberValue>(init)->number;
+    long long bound = s_p_c<NumberValue>(counted.bound)->number;
+    int tripCount = 1;  // 进入循环头即执行一次
+    for (iv += counted.step; compare(counted.op, iv, bound); iv += counted.step)
+    {
+        if (iv < INT_MIN || iv > INT_MAX || ++tripCount > (int)_UNROLL_FULL_MAX_TRIP * 8)
+            return -1;
+    }
+    return tripCount;
+}
+
+/**
+ * @brief 为循环体的一份复制建立空块
+ * @param func 
+ * @param counted 
+ * @param copy 
+ */
+void create_copy_blocks(shared_ptr<Function> &func, CountedLoop &counted, LoopCopy &copy)
+{
+    for (auto &bb : counted.blocks)
+    {
+        shared_ptr<BasicBlock> newBlock = make_shared<BasicBlock>(func, true, bb->loopDepth);
+        copy.blockMap[bb] = newBlock;
+        copy.blocks.push_back(newBlock);
+    }
+}
+
+/**
+ * @brief 复制一次循环体到已建立的块中：copy.valueMap需预先给出循环头phi的值；
+ *        回边块的分支（以及只被其使用的比较）不复制，由调用者补上
+ * @param counted 
+ * @param copy 
+ */
+void clone_loop_body(CountedLoop &counted, LoopCopy &copy)
+{
+    vector<pair<shared_ptr<PhiInstruction>, shared_ptr<PhiInstruction>>> phis;
+    for (auto &bb : counted.blocks)
+    {
+        shared_ptr<BasicBlock> newBlock = copy.blockMap.at(bb);
+        if (bb != counted.header)
+        {
+            for (auto &phi : bb->phis)
+            {
+                shared_ptr<PhiInstruction> newPhi = make_shared<PhiInstruction>(phi->localVarName, newBlock);
+                newBlock->phis.insert(newPhi);
+                copy.valueMap[phi] = newPhi;
+                phis.emplace_back(phi, newPhi);
+            }
+        }
+        for (auto &ins : bb->instructions)
+        {
+            if (bb == counted.latch && (ins == bb->instructions.back() || (ins == counted.cmp && ins->users.size() == 1)))
+                continue;
+            shared_ptr<Instruction> newIns = cloneInstruction(ins, newBlock, copy.valueMap, copy.blockMap);
+            copy.valueMap[ins] = newIns;
+            newBlock->instructions.push_back(newIns);
+        }
+        for (auto &suc : bb->successors)
+        {
+            if (bb != counted.latch)
+                add_edge(newBlock, copy.blockMap.at(suc));
+        }
+    }
+    for (auto &it : phis)
+    {
+        for (auto &operand : it.first->operands)
+        {
+            shared_ptr<Value> value = mapValue(copy.valueMap, operand.second);
+            it.second->operands[copy.blockMap.at(operand.first)] = value;
+            value->users.insert(it.second);
+        }
+    }
+}
+
+void add_edge(const shared_ptr<BasicBlock> &from, const shared_ptr<BasicBlock> &to)
+{
+    from->successors.insert(to);
+    to->predecessors.insert(from);
+}
+
+/**
+ * @brief 将from末尾跳转到oldTarget的边改为跳转到newTarget，不修改phi
+ * @param from 
+ * @param oldTarget 
+ * @param newTarget 
+ */
+void redirect_edge(shared_ptr<BasicBlock> &from, shared_ptr<BasicBlock> &oldTarget, shared_ptr<BasicBlock> &newTarget)
+{
+    shared_ptr<Instruction> last = from->instructions.back();
+    if (last->type == JMP)
+    {
+        s_p_c<JumpInstruction>(last)->targetBlock = newTarget;
+    }
+    else if (last->type == BR)
+    {
+        shared_ptr<BranchInstruction> br = s_p_c<BranchInstruction>(last);
+        if (br->trueBlock == oldTarget)
+            br->trueBlock = newTarget;
+        if (br->falseBlock == oldTarget)
+            br->falseBlock = newTarget;
+    }
+    from->successors.erase(oldTarget);
+    oldTarget->predecessors.erase(from);
+    add_edge(from, newTarget);
+}
+
+/**
+ * @brief 在块末尾加入 比较 + 分支
+ * @return 比较指令
+ */
+shared_ptr<BinaryInstruction> append_cmp_branch(string op, shared_ptr<Value> lhs, shared_ptr<Value> rhs, shared_ptr<BasicBlock> &bb,
+                                                shared_ptr<BasicBlock> trueBlock, shared_ptr<BasicBlock> falseBlock)
+{
+    shared_ptr<BinaryInstruction> cmp = make_shared<BinaryInstruction>(op, lhs, rhs, bb);
+    user_use(cmp, {lhs, rhs});
+    shared_ptr<Value> condition = cmp;
+    shared_ptr<BranchInstruction> br = make_shared<BranchInstruction>(condition, trueBlock, falseBlock, bb);
+    user_use(br, {condition});
+    bb->instructions.push_back(cmp);
+    bb->instructions.push_back(br);
+    add_edge(bb, trueBlock);
+    add_edge(bb, falseBlock);
+    return cmp;
+}
+
+/**
+ * @brief 完全展开：依次复制tripCount份循环体，前一份回边块的值作为下一份循环头phi的值，原循环变为不可达
+ * @param func 
+ * @param counted 
+ * @param tripCount 迭代次数
+ */
+void full_unroll(shared_ptr<Function> &func, CountedLoop &counted, int tripCount)
+{
+    vector<LoopCopy> copies(tripCount);
+    for (int k = 0; k < tripCount; ++k)
+    {
+        create_copy_blocks(func, counted, copies[k]);
+        for (auto &phi : counted.header->phis)
+        {
+            copies[k].valueMap[phi] = k == 0 ? phi->operands.at(counted.preheader)
+                                             : mapValue(copies[k - 1].valueMap, phi->operands.at(counted.latch));
+        }
+        clone_loop_body(counted, copies[k]);
+        if (k > 0)
+        {
+            shared_ptr<BasicBlock> prevLatch = copies[k - 1].blockMap.at(counted.latch);
+            shared_ptr<BasicBlock> header = copies[k].blockMap.at(counted.header);
+            prevLatch->instructions.push_back(make_shared<JumpInstruction>(header, prevLatch));
+            add_edge(prevLatch, header);
+        }
+    }
+    LoopCopy &lastCopy = copies.back();
+    shared_ptr<BasicBlock> lastLatch = lastCopy.blockMap.at(counted.latch);
+    lastLatch->instructions.push_back(make_shared<JumpInstruction>(counted.exit, lastLatch));
+    add_edge(lastLatch, counted.exit);
+
+    // 循环外的使用改为最后一份复制的值
+    for (auto &phi : counted.exit->phis)
+    {
+        if (phi->operands.count(counted.latch) == 0)
+            continue;
+        shared_ptr<Value> value = phi->operands.at(counted.latch);
+        if (phi->getOperandValueCount(value) == 1)
+            value->users.erase(phi);
+        phi->operands.erase(counted.latch);
+        shared_ptr<Value> newValue = mapValue(lastCopy.valueMap, value);
+        phi->operands[lastLatch] = newValue;
+        newValue->users.insert(phi);
+    }
+    for (auto &bb : counted.blocks)
+    {
+        vector<shared_ptr<Value>> defs(bb->phis.begin(), bb->phis.end());
+        defs.insert(defs.end(), bb->instructions.begin(), bb->instructions.end());
+        for (auto &def : defs)
+        {
+            unordered_set<shared_ptr<Value>> users = def->users;
+            shared_ptr<Value> newValue = mapValue(lastCopy.valueMap, def);
+            for (auto &user : users)
+            {
+                if (user->value_type == INSTRUCTION && find(counted.blocks.begin(), counted.blocks.end(), s_p_c<Instruction>(user)->block) == counted.blocks.end())
+                    user->replaceUse(def, newValue);
+            }
+        }
+    }
+    counted.exit->predecessors.erase(counted.latch);
+    counted.latch->successors.erase(counted.exit);
+    for (auto &bb : counted.blocks)  // 原循环将作为不可达块删除，先解除phi的使用
+    {
+        for (auto &phi : bb->phis)
+        {
+            for (auto &operand : phi->operands)
+                operand.second->users.erase(phi);
+        }
+    }
+
+    redirect_edge(counted.preheader, counted.header, copies.front().blockMap.at(counted.header));
+    auto pos = find(func->blocks.begin(), func->blocks.end(), counted.header);
+    for (auto it = copies.rbegin(); it != copies.rend(); ++it)
+        pos = func->blocks.insert(pos, it->blocks.begin(), it->blocks.end());
+}
+
+/**
+ * @brief 部分展开：
+ *        preheader -> guard（边界调整无溢出，且至少还有factor次迭代）-> 展开factor份的主循环 -> check（是否还有迭代）-> 原循环（余数循环）-> exit
+ *        主循环在回边块判断 ivNext op (bound - (factor-1)*step)，保证下一轮的factor次迭代都有效
+ * @param func 
+ * @param counted 
+ * @param factor 展开因子
+ * @param visitedHeaders 已处理的循环头，加入主循环的循环头
+ * @return 是否展开
+ */
+bool partial_unroll(shared_ptr<Function> &func, CountedLoop &counted, unsigned int factor, unordered_set<shared_ptr<BasicBlock>> &visitedHeaders)
+{
+    int adjust = (int)(factor - 1) * counted.step;
+    bool increasing = counted.step > 0;
+    shared_ptr<BasicBlock> guardAdjust;  // 判断边界调整是否溢出，边界为常数时不需要
+    shared_ptr<BasicBlock> guard = make_shared<BasicBlock>(func, true, counted.preheader->loopDepth);
+    shared_ptr<Value> adjustedBound;
+    if (counted.bound->value_type == NUMBER)
+    {
+        long long bound = (long long)s_p_c<NumberValue>(counted.bound)->number - adjust;
+        if (bound < INT_MIN || bound > INT_MAX)
+            return false;
+        adjustedBound = Number((int)bound);
+    }
+    else
+    {
+        guardAdjust = make_shared<BasicBlock>(func, true, counted.preheader->loopDepth);
+        string subOp = "-";
+        shared_ptr<Value> adjustValue = Number(adjust);
+        adjustedBound = make_shared<BinaryInstruction>(subOp, counted.bound, adjustValue, guardAdjust);
+        user_use(adjustedBound, {counted.bound, adjustValue});
+        guardAdjust->instructions.push_back(s_p_c<Instruction>(adjustedBound));
+    }
+
+    // 主循环
+    vector<LoopCopy> copies(factor);
+    vector<pair<shared_ptr<PhiInstruction>, shared_ptr<PhiInstruction>>> mainPhis;  // (原循环头phi, 主循环头phi)
+    for (unsigned int k = 0; k < factor; ++k)
+    {
+        create_copy_blocks(func, counted, copies[k]);
+        for (auto &phi : counted.header->phis)
+        {
+            if (k != 0)
+            {
+                copies[k].valueMap[phi] = mapValue(copies[k - 1].valueMap, phi->operands.at(counted.latch));
+                continue;
+            }
+            shared_ptr<BasicBlock> header = copies[k].blockMap.at(counted.header);
+            shared_ptr<PhiInstruction> newPhi = make_shared<PhiInstruction>(phi->localVarName, header);
+            header->phis.insert(newPhi);
+            copies[k].valueMap[phi] = newPhi;
+            mainPhis.emplace_back(phi, newPhi);
+        }
+        clone_loop_body(counted, copies[k]);
+        if (k > 0)
+        {
+            shared_ptr<BasicBlock> prevLatch = copies[k - 1].blockMap.at(counted.latch);
+            shared_ptr<BasicBlock> header = copies[k].blockMap.at(counted.header);
+            prevLatch->instructions.push_back(make_shared<JumpInstruction>(header, prevLatch));
+            add_edge(prevLatch, header);
+        }
+    }
+    shared_ptr<BasicBlock> mainHeader = copies.front().blockMap.at(counted.header);
+    shared_ptr<BasicBlock> mainLatch = copies.back().blockMap.at(counted.latch);
+    visitedHeaders.insert(mainHeader);
+
+    shared_ptr<BasicBlock> check = make_shared<BasicBlock>(func, true, counted.preheader->loopDepth);
+    shared_ptr<Value> lastIvNext = mapValue(copies.back().valueMap, counted.ivNext);
+    append_cmp_branch(counted.op, lastIvNext, adjustedBound, mainLatch, mainHeader, check);
+    append_cmp_branch(counted.op, lastIvNext, counted.bound, check, counted.header, counted.exit);
+
+    // 入口：preheader -> [guardAdjust] -> guard
+    shared_ptr<Value> init = counted.iv->operands.at(counted.preheader);
+    shared_ptr<BasicBlock> entry = guardAdjust != nullptr ? guardAdjust : guard;
+    redirect_edge(counted.preheader, counted.header, entry);
+    if (guardAdjust != nullptr)
+        append_cmp_branch(increasing ? "<" : ">", adjustedBound, counted.bound, guardAdjust, guard, counted.header);
+    append_cmp_branch(counted.op, init, adjustedBound, guard, mainHeader, counted.header);
+
+    // 主循环头phi：初值来自guard，回边来自主循环的最后一份复制
+    for (auto &it : mainPhis)
+    {
+        shared_ptr<Value> initValue = it.first->operands.at(counted.preheader);
+        shared_ptr<Value> latchValue = mapValue(copies.back().valueMap, it.first->operands.at(counted.latch));
+        it.second->operands[guard] = initValue;
+        it.second->operands[mainLatch] = latchValue;
+        user_use(it.second, {initValue, latchValue});
+    }
+
+    // 余数循环头phi：初值来自guardAdjust与guard，或来自check（主循环的结果）
+    for (auto &phi : counted.header->phis)
+    {
+        shared_ptr<Value> initValue = phi->operands.at(counted.preheader);
+        shared_ptr<Value> mainValue = mapValue(copies.back().valueMap, phi->operands.at(counted.latch));
+        phi->operands.erase(counted.preheader);
+        if (guardAdjust != nullptr)
+            phi->operands[guardAdjust] = initValue;
+        phi->operands[guard] = initValue;
+        phi->operands[check] = mainValue;
+        mainValue->users.insert(phi);
+    }
+
+    // 出口：原有的phi加入check的值；循环外对循环内值的直接使用，由新phi合并两条出口路径
+    for (auto &phi : counted.exit->phis)
+    {
+        if (phi->operands.count(counted.latch) == 0)
+            continue;
+        shared_ptr<Value> mainValue = mapValue(copies.back().valueMap, phi->operands.at(counted.latch));
+        phi->operands[check] = mainValue;
+        mainValue->users.insert(phi);
+    }
+    for (auto &bb : counted.blocks)
+    {
+        vector<shared_ptr<Value>> defs(bb->phis.begin(), bb->phis.end());
+        defs.insert(defs.end(), bb->instructions.begin(), bb->instructions.end());
+        for (auto &def : defs)
+        {
+            vector<shared_ptr<Value>> outsideUsers;
+            for (auto &user : def->users)
+            {
+                if (user->value_type != INSTRUCTION)
+                    continue;
+                shared_ptr<Instruction> userIns = s_p_c<Instruction>(user);
+                if (find(counted.blocks.begin(), counted.blocks.end(), userIns->block) != counted.blocks.end())
+                    continue;
+                if (userIns->type == PHI && userIns->block == counted.exit)
+                    continue;
+                outsideUsers.push_back(user);
+            }
+            if (outsideUsers.empty())
+                continue;
+            shared_ptr<Value> mainValue = mapValue(copies.back().valueMap, def);
+            shared_ptr<PhiInstruction> phi = make_shared<PhiInstruction>(s_p_c<Instruction>(def)->caughtVarName, counted.exit);
+            phi->operands[counted.latch] = def;
+            phi->operands[check] = mainValue;
+            counted.exit->phis.insert(phi);
+            shared_ptr<Value> newValue = phi;
+            for (auto &user : outsideUsers)
+                user->replaceUse(def, newValue);
+            user_use(phi, {def, mainValue});
+        }
+    }
+
+    auto pos = find(func->blocks.begin(), func->blocks.end(), counted.header);
+    vector<shared_ptr<BasicBlock>> newBlocks;
+    if (guardAdjust != nullptr)
+        newBlocks.push_back(guardAdjust);
+    newBlocks.push_back(guard);
+    for (auto &copy : copies)
+        newBlocks.insert(newBlocks.end(), copy.blocks.begin(), copy.blocks.end());
+    newBlocks.push_back(check);
+    func->blocks.insert(pos, newBlocks.begin(), newBlocks.end());
+    return true;
+}
@@ -0,0 +1,220 @@
+﻿#include "ir_optimize.h"
+
+#include "../../basic/std/compile_std.h"
+
+const unsigned int _DSE_MAX_BLOCKS = 32;  // 死存储删除向后查找的最多块数
+
+unsigned int eliminatedLoadCount;   // 当前函数删除的load数
+unsigned int eliminatedStoreCount;  // 当前函数删除的store数
+
+void redundant_load_elimination(DominatorTree &domTree, AliasAnalysis &aliasAnalysis, MemorySSA &memorySSA);
+
+void dead_store_elimination(shared_ptr<Function> &func, AliasAnalysis &aliasAnalysis, MemorySSA &memorySSA);
+
+bool is_store_dead(const MemoryLocation &location, shared_ptr<BasicBlock> &bb, unsigned int index, AliasAnalysis &aliasAnalysis, unsigned int &blockCount);
+
+void replace_load(shared_ptr<Instruction> &load, const shared_ptr<Value> &value);
+
+void make_left_value(const shared_ptr<Value> &value);
+
+void remove_store(shared_ptr<Instruction> &store);
+
+/**
+ * @brief 基于别名分析与Memory SSA的访存优化：跨块的冗余load删除（store到load的转发、相同内存版本的load合并），
+ *        死存储删除（之后被覆盖且未被读的store、写回刚读出的值的store）
+ * @param module 
+ */
+void memory_access_elimination(shared_ptr<Module> &module)
+{
+    ofstream irStream;
+    if (_debugIrOptimize)
+        irStream.open(debugMessageDirectory + "ir_memory.txt", ios::out | ios::app);
+    for (auto &func : module->functions)
+    {
+        eliminatedLoadCount = 0;
+        eliminatedStoreCount = 0;
+        if (func->entryBlock == nullptr)
+            continue;
+        DominatorTree domTree(func);
+        AliasAnalysis aliasAnalysis(func);
+        MemorySSA memorySSA(func, domTree, aliasAnalysis);
+        redundant_load_elimination(domTree, aliasAnalysis, memorySSA);
+        dead_store_elimination(func, aliasAnalysis, memorySSA);
+        if (_debugIrOptimize)
+            irStream << "function <" << func->name << ">: " << eliminatedLoadCount << " loads, " << eliminatedStoreCount << " stores eliminated" << endl;
+    }
+    if (_debugIrOptimize)
+        irStream.close();
+}
+
+/**
+ * @brief 冗余load删除：最近的写为同一位置的store时直接使用存入的值；
+ *        最近的写相同、地址相同且支配它的load已存在时使用其结果
+ * @param domTree 
+ * @param aliasAnalysis 
+ * @param memorySSA 
+ */
+void redundant_load_elimination(DominatorTree &domTree, AliasAnalysis &aliasAnalysis, MemorySSA &memorySSA)
+{
+    unordered_map<shared_ptr<MemoryAccess>, vector<shared_ptr<Instruction>>> clobberLoads;  // 最近的写 --> 之后的load
+    for (auto &bb : domTree.reversePostOrder)
+    {
+        for (auto it = bb->instructions.begin(); it != bb->instructions.end();)
+        {
+            shared_ptr<Instruction> ins = *it;
+            if (ins->type != LOAD)
+            {
+                ++it;
+                continue;
+            }
+            shared_ptr<LoadInstruction> load = s_p_c<LoadInstruction>(ins);
+            shared_ptr<MemoryAccess> clobber = memorySSA.getClobberingAccess(ins);
+            shared_ptr<Value> available;
+            if (clobber->type == MEMORY_DEF && clobber->ins->type == STORE && clobber->ins->valid
+                && aliasAnalysis.alias(AliasAnalysis::getLocation(clobber->ins), AliasAnalysis::getLocation(ins)) == MUST_ALIAS)
+                available = s_p_c<StoreInstruction>(clobber->ins)->value;
+            else if (clobberLoads.count(clobber) != 0)
+            {
+                for (auto &other : clobberLoads.at(clobber))
+                {
+                    shared_ptr<LoadInstruction> otherLoad = s_p_c<LoadInstruction>(other);
+                    if (other->valid && otherLoad->address == load->address && otherLoad->offset->equals(load->offset)
+                        && (other->block == bb || domTree.dominates(other->block, bb)))
+                    {
+                        available = other;
+                        break;
+                    }
+                }
+            }
+            if (available == nullptr)
+            {
+                clobberLoads[clobber].push_back(ins);
+                ++it;
+                continue;
+            }
+            replace_load(ins, available);
+            it = bb->instructions.erase(it);
+            ++eliminatedLoadCount;
+        }
+    }
+}
+
+/**
+ * @brief 死存储删除
+ * @param func 
+ * @param aliasAnalysis 
+ * @param memorySSA 
+ */
+void dead_store_elimination(shared_ptr<Function> &func, AliasAnalysis &aliasAnalysis, MemorySSA &memorySSA)
+{
+    for (auto &bb : func->blocks)
+    {
+        for (unsigned int i = 0; i < bb->instructions.size();)
+        {
+            shared_ptr<Instruction> ins = bb->instructions.at(i);
+            if (ins->type != STORE || memorySSA.accesses.count(ins) == 0)
+            {
+                ++i;
+                continue;
+            }
+            shared_ptr<StoreInstruction> store = s_p_c<StoreInstruction>(ins);
+            MemoryLocation location = AliasAnalysis::getLocation(ins);
+            bool dead = false;
+            if (store->value->value_type == INSTRUCTION && s_p_c<Instruction>(store->value)->type == LOAD)  // 写回读出的值，其间内存未变
+            {
+                shared_ptr<Instruction> load = s_p_c<Instruction>(store->value);
+                dead = memorySSA.accesses.count(load) != 0 && aliasAnalysis.alias(AliasAnalysis::getLocation(load), location) == MUST_ALIAS
+                       && memorySSA.getClobberingAccess(load) == memorySSA.getClobberingAccess(ins);
+            }
+            unsigned int blockCount = 0;
+            if (!dead)
+                dead = is_store_dead(location, bb, i + 1, aliasAnalysis, blockCount);
+            if (dead)
+            {
+                remove_store(ins);
+                bb->instructions.erase(bb->instructions.begin() + i);
+                ++eliminatedStoreCount;
+            }
+            else
+                ++i;
+        }
+    }
+}
+
+/**
+ * @brief 从bb的第index条指令开始，每条路径上location都在被读之前被覆盖，或为函数返回时不再存在的局部数组；
+ *        只沿唯一前驱的后继向后查找，路径上的SSA值不变
+ * @param location store的位置
+ * @param bb 
+ * @param index 
+ * @param aliasAnalysis 
+ * @param blockCount 已查找的块数
+ * @return 
+ */
+bool is_store_dead(const MemoryLocation &location, shared_ptr<BasicBlock> &bb, unsigned int index, AliasAnalysis &aliasAnalysis, unsigned int &blockCount)
+{
+    if (++blockCount > _DSE_MAX_BLOCKS)
+        return false;
+    for (unsigned int i = index; i < bb->instructions.size(); ++i)
+    {
+        shared_ptr<Instruction> ins = bb->instructions.at(i);
+        if (aliasAnalysis.mayRead(ins, location))
+            return false;
+        if (ins->type == STORE && aliasAnalysis.alias(AliasAnalysis::getLocation(ins), location) == MUST_ALIAS)
+            return true;
+        if (ins->type == RET)
+            return aliasAnalysis.isLocalObject(location.base);
+    }
+    if (bb->successors.empty())
+        return false;
+    for (auto &suc : bb->successors)
+    {
+        shared_ptr<BasicBlock> next = suc;
+        if (next->predecessors.size() != 1 || !is_store_dead(location, next, 0, aliasAnalysis, blockCount))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 将load的使用替换为value，并删除load；操作数不级联删除
+ * @param load 
+ * @param value 
+ */
+void replace_load(shared_ptr<Instruction> &load, const shared_ptr<Value> &value)
+{
+    make_left_value(value);
+    unordered_set<shared_ptr<Value>> users = load->users;
+    shared_ptr<Value> toBeReplaced = load;
+    shared_ptr<Value> replaceValue = value;
+    for (auto &user : users)
+        user->replaceUse(toBeReplaced, replaceValue);
+    s_p_c<LoadInstruction>(load)->address->users.erase(load);
+    s_p_c<LoadInstruction>(load)->offset->users.erase(load);
+    load->valid = false;
+}
+
+/**
+ * @brief 右值只能使用一次，在其他块或phi中使用时改为左值
+ * @param value 
+ */
+void make_left_value(const shared_ptr<Value> &value)
+{
+    if (value->value_type == INSTRUCTION && s_p_c<Instruction>(value)->resultType == R_VAL_RESULT)
+    {
+        s_p_c<Instruction>(value)->resultType = L_VAL_RESULT;
+        s_p_c<Instruction>(value)->caughtVarName = generateTempLeftValueName();
+    }
+}
+
+/**
+ * @brief 删除store的使用关系
+ * @param store 
+ */
+void remove_store(shared_ptr<Instruction> &store)
+{
+    s_p_c<StoreInstruction>(store)->value->users.erase(store);
+    s_p_c<StoreInstruction>(store)->address->users.erase(store);
+    s_p_c<StoreInstruction>(store)->offset->users.erase(store);
+    store->valid = false;
+}
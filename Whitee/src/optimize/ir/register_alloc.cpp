@@ -1,643 +1,613 @@
 ﻿#include "ir_optimize.h"
 
-#include <stack>
-#include <queue>
-#include <ctime>
 #include <set>
 
-time_t startAllocTime;  // 开始构建冲突图时间
-bool conflictGraphBuildSuccess;   // 冲突图成功构建
-unsigned long CONFLICT_GRAPH_TIMEOUT = 10;  // 冲突图构建超时限度：10s
+vector<shared_ptr<Value>> conflictValues;       // 冲突图结点，编号与活跃变量分析一致
+BitVector conflictMatrix;                        // 下三角位矩阵：结点a、b(a > b)冲突则第a * (a - 1) / 2 + b位置位
+vector<vector<unsigned int>> conflictAdjacency;  // 邻接表  结点 <--> 冲突结点
 
-unordered_map<shared_ptr<Value>, shared_ptr<unordered_set<shared_ptr<Value>>>> conflictGraph;  // 冲突图  V <--> 冲突对象
-// 块的路径  起始块 <--> 中止块 <--> 路径块
-unordered_map<shared_ptr<BasicBlock>, shared_ptr<unordered_map<shared_ptr<BasicBlock>, unordered_set<shared_ptr<BasicBlock>>>>> blockPath;
-
-/**
- * @brief 冲突图是否构建超时
- * @param startTime 开始时间
- * @param timeout 超时限度
- * @return true 超时；false 未超时
- */
-inline bool checkRegAllocTimeout(time_t startTime, unsigned long timeout)
+enum NodeState  // 迭代寄存器合并中结点所处的工作表
 {
-    if (time(nullptr) - startTime > timeout)
-    {
-        conflictGraphBuildSuccess = false;
-        return true;
-    }
-    return false;
-}
+    INITIAL_NODE,
+    SIMPLIFY_NODE,   // 低度数且与传送无关
+    FREEZE_NODE,     // 低度数且与传送有关
+    SPILL_NODE,      // 高度数
+    SELECT_NODE,     // 已入栈
+    COALESCED_NODE,  // 已合并到别名结点
+    COLORED_NODE,    // 已着色
+    SPILLED_NODE     // 实际溢出
+};
 
-void initConflictGraph(shared_ptr<Function> &func);
-
-void buildConflictGraph(shared_ptr<Function> &func);
+enum MoveState
+{
+    WORKLIST_MOVE,     // 待合并
+    ACTIVE_MOVE,       // 暂不能合并
+    COALESCED_MOVE,    // 已合并
+    CONSTRAINED_MOVE,  // 两端冲突
+    FROZEN_MOVE        // 放弃合并
+};
 
-void allocRegister(shared_ptr<Function> &func);
+vector<pair<unsigned int, unsigned int>> moves;  // 传送的两端结点
+vector<MoveState> moveState;
+vector<vector<unsigned int>> moveList;  // 结点 <--> 相关传送
+vector<NodeState> nodeState;
+vector<unsigned int> degree;
+vector<unsigned int> alias;            // 被合并结点 --> 合并到的结点
+vector<unsigned long long> spillCost;  // 合并结点的权重之和
+vector<int> color;
+vector<unsigned int> simplifyWorklist, freezeWorklist, spillWorklist, worklistMoves, selectStack;  // 工作表中的过期项在取出时按状态跳过
 
-void addAliveValue(shared_ptr<Instruction> &value, shared_ptr<Instruction> &owner, shared_ptr<BasicBlock> &ownerBlock);
+void initConflictGraph(LivenessAnalysis &liveness);
 
-void addAliveValue(shared_ptr<Value> &value, shared_ptr<Instruction> &owner, shared_ptr<BasicBlock> &ownerBlock);
+void buildConflictGraph(shared_ptr<Function> &func, LivenessAnalysis &liveness);
 
-unordered_set<shared_ptr<BasicBlock>> getBlockPathPoints(shared_ptr<BasicBlock> &from, shared_ptr<BasicBlock> &to);
+void collectMoves(shared_ptr<Function> &func, LivenessAnalysis &liveness);
 
-void getBlockReachableBlocks(shared_ptr<BasicBlock> &bb, shared_ptr<BasicBlock> &cannotArrive, unordered_set<shared_ptr<BasicBlock>> &ans);
+void allocRegister(shared_ptr<Function> &func);
 
 void outputConflictGraph(const string &funcName);
 
+void colorRegister(shared_ptr<Function> &func);
+
 /**
- * @brief 寄存器分配
+ * @brief 寄存器分配：图着色后若有溢出，在循环边界拆分溢出值并重新分配一次
  * @param func 
  */
 void registerAlloc(shared_ptr<Function> &func)
 {
-    conflictGraph.clear();
-    blockPath.clear();
-    initConflictGraph(func);
-    conflictGraphBuildSuccess = true;
-    startAllocTime = time(nullptr);
-    buildConflictGraph(func);
+    colorRegister(func);
+    if (!func->variableWithoutReg.empty() && splitLiveRangeAroundLoops(func))
+    {
+        func->variableWeight.clear();
+        func->variableRegs.clear();
+        func->variableWithoutReg.clear();
+        calculateVariableWeight(func);
+        colorRegister(func);
+    }
+}
+
+/**
+ * @brief 图着色分配寄存器
+ * @param func 
+ */
+void colorRegister(shared_ptr<Function> &func)
+{
+    LivenessAnalysis liveness(func);
+    initConflictGraph(liveness);
+    buildConflictGraph(func, liveness);
+    collectMoves(func, liveness);
     if (_debugIrOptimize)
         outputConflictGraph(func->name);
+    allocRegister(func);
+}
 
-    if (conflictGraphBuildSuccess)  // 冲突图构建成功
-        allocRegister(func);
-    else
-    {
-        cerr << "Time out when building conflict graph of function " << func->name << "." << endl;
-    }
+/**
+ * @brief 初始化冲突图，结点为活跃变量分析编号的参数与左值，目前无冲突
+ * @param liveness 
+ */
+void initConflictGraph(LivenessAnalysis &liveness)
+{
+    size_t size = liveness.values.size();
+    conflictValues = liveness.values;
+    conflictMatrix = BitVector(size < 2 ? 1 : size * (size - 1) / 2);  // 以size_t计算，结点数较多时不溢出
+    conflictAdjacency.assign(size, vector<unsigned int>());
 }
 
 /**
- * @brief 初始化冲突图，给每个左值赋予一个空set，即每个值目前无冲突
+ * @brief 位矩阵中结点a与b对应的位
+ * @param a 
+ * @param b 
+ * @return 位的编号
+ */
+inline size_t conflictBit(size_t a, size_t b)
+{
+    if (a < b)
+        swap(a, b);
+    return a * (a - 1) / 2 + b;
+}
+
+/**
+ * @brief 在冲突图中加入a与b的冲突边，位矩阵去重，邻接表中每条边只出现一次
+ * @param a 
+ * @param b 
+ */
+inline void addConflict(unsigned int a, unsigned int b)
+{
+    if (a == b)
+        return;
+    size_t bit = conflictBit(a, b);
+    if (conflictMatrix.test(bit))
+        return;
+    conflictMatrix.set(bit);
+    conflictAdjacency[a].push_back(b);
+    conflictAdjacency[b].push_back(a);
+}
+
+/**
+ * @brief 传送指令的源值：phi_move复制所在块对应的phi操作数，phi复制其phi_move
+ * @param ins 指令
+ * @param bb 指令所在的块
+ * @param liveness 
+ * @return 源值的编号，不是传送或源值未被追踪时为-1
+ */
+int getMoveSource(shared_ptr<Instruction> &ins, shared_ptr<BasicBlock> &bb, LivenessAnalysis &liveness)
+{
+    shared_ptr<Value> source;
+    if (ins->type == PHI_MOV && s_p_c<PhiMoveInstruction>(ins)->phi->operands.count(bb) != 0)
+        source = s_p_c<PhiMoveInstruction>(ins)->phi->operands.at(bb);
+    else if (ins->type == PHI)
+        source = s_p_c<PhiInstruction>(ins)->phiMove;
+    if (source == nullptr || !liveness.isTracked(source))
+        return -1;
+    return liveness.valueIndex.at(source);
+}
+
+/**
+ * @brief 构建冲突图：每个块自出口向前遍历一次，定义的值与其后活跃的值冲突，总代价与边数近似线性
  * @param func 
+ * @param liveness 活跃变量分析结果
  */
-void initConflictGraph(shared_ptr<Function> &func)
+void buildConflictGraph(shared_ptr<Function> &func, LivenessAnalysis &liveness)
 {
-    for (auto &arg : func->params)  // 函数参数冲突初始化为空
+    const BitVector &entryLive = liveness.liveIn.at(func->entryBlock);
+    for (auto &arg : func->params)  // 函数参数在入口同时定义，彼此冲突，并与入口处活跃的值冲突
     {
-        shared_ptr<unordered_set<shared_ptr<Value>>> tempSet = make_shared<unordered_set<shared_ptr<Value>>>();
-        conflictGraph[arg] = tempSet;
+        unsigned int argIndex = liveness.valueIndex.at(arg);
+        for (auto &other : func->params)
+            addConflict(argIndex, liveness.valueIndex.at(other));
+        for (unsigned int i = entryLive.findNext(0); i < entryLive.size; i = entryLive.findNext(i + 1))
+            addConflict(argIndex, i);
     }
-    for (auto &bb : func->blocks)
+    for (auto &bb : liveness.reversePostOrder)
     {
-        for (auto &ins : bb->instructions)
+        BitVector live = liveness.liveOut.at(bb);
+        for (auto it = bb->instructions.rbegin(); it != bb->instructions.rend(); ++it)  // 自块出口向前
         {
-            if (ins->resultType == L_VAL_RESULT && conflictGraph.count(ins) == 0)  // 所有左值的冲突初始化为空
+            shared_ptr<Instruction> ins = *it;
+            int defined = liveness.getDefinedValue(ins);
+            if (defined >= 0)  // 定义的值与此指令后活跃的值冲突
             {
-                shared_ptr<unordered_set<shared_ptr<Value>>> tempSet = make_shared<unordered_set<shared_ptr<Value>>>();
-                conflictGraph[ins] = tempSet;
+                int source = getMoveSource(ins, bb, liveness);  // 传送的目的与源值相同，不因源值仍活跃而冲突
+                for (unsigned int i = live.findNext(0); i < live.size; i = live.findNext(i + 1))
+                {
+                    if ((int)i != source)
+                        addConflict(defined, i);
+                }
             }
+            liveness.stepBackward(ins, bb, live);
         }
     }
 }
 
 /**
- * @brief 构建冲突图
+ * @brief 收集传送：phi_move <-- phi的各个操作数，phi <-- phi_move，两端值若分配同一寄存器则MOV可省去
  * @param func 
+ * @param liveness 
  */
-void buildConflictGraph(shared_ptr<Function> &func)
+void collectMoves(shared_ptr<Function> &func, LivenessAnalysis &liveness)
 {
-    for (auto &ins : func->params)  // 函数参数，从函数开始，至使用完毕，都是保持活跃的
+    unsigned int size = conflictValues.size();
+    moves.clear();
+    moveList.assign(size, vector<unsigned int>());
+    set<pair<unsigned int, unsigned int>> moveSet;  // 同一phi_move可能复制同一操作数多次
+    for (auto &bb : func->blocks)
     {
-        if (checkRegAllocTimeout(startAllocTime, CONFLICT_GRAPH_TIMEOUT))
-            return;
-        for (auto &user : ins->users)
+        for (auto &ins : bb->instructions)
         {
-            if (checkRegAllocTimeout(startAllocTime, CONFLICT_GRAPH_TIMEOUT))
-                return;
-            if (user->value_type != INSTRUCTION)
-            {
-                cerr << "Error occurs in register alloc: got a non-instruction user." << endl;
-            }
-            shared_ptr<Instruction> userIns = s_p_c<Instruction>(user);
-            if (userIns->type == PHI)
-            {
-                shared_ptr<PhiMoveInstruction> phiMov = s_p_c<PhiInstruction>(userIns)->phiMove;
-                for (auto &op : phiMov->phi->operands)  // 此phi对应的所有操作数
-                {
-                    if (op.second == ins)  // 操作数为ins
-                    {
-                        shared_ptr<BasicBlock> phiMovLocation = op.first;
-                        if (phiMovLocation->aliveValues.count(ins) != 0)
-                            continue;
-                        else if (phiMov->blockALiveValues.at(phiMovLocation).count(ins) != 0)
-                            continue;
-                        auto it = func->entryBlock->instructions.begin();
-                        bool searchOtherBlocks = true;
-                        // userIns在insVal块内，entryBlock至phiMov设为活跃
-                        while (it != func->entryBlock->instructions.end())
-                        {
-                            addAliveValue(ins, *it, func->entryBlock);
-                            if (*it == phiMov && phiMovLocation == func->entryBlock)
-                            {
-                                searchOtherBlocks = false;
-                                break;
-                            }
-                            ++it;
-                        }
-                        if (searchOtherBlocks)
-                        {
-                            // 维护路径块，并将它们添加到活跃节点中：路径为entryBlock所在块至phiMovLocation的对应指令
-                            unordered_set<shared_ptr<BasicBlock>> pathNodes;
-                            if (blockPath.count(func->entryBlock) != 0)
-                            {
-                                if (blockPath.at(func->entryBlock)->count(phiMovLocation) != 0)
-                                {
-                                    pathNodes = blockPath.at(func->entryBlock)->at(phiMovLocation);
-                                }
-                                else
-                                {
-                                    pathNodes = getBlockPathPoints(func->entryBlock, phiMovLocation);
-                                }
-                            }
-                            else
-                                pathNodes = getBlockPathPoints(func->entryBlock, phiMovLocation);
-                            for (auto &b : pathNodes)
-                            {
-                                b->aliveValues.insert(ins);
-                            }
-                            it = phiMovLocation->instructions.begin();
-                            while (it != phiMovLocation->instructions.end())
-                            {
-                                addAliveValue(ins, *it, phiMovLocation);
-                                if (*it == phiMov)
-                                    break;
-                                ++it;
-                            }
-                        }
-                    }
-                }
-            }
-            else  // 非phi指令
+            if (ins->type != PHI)
+                continue;
+            shared_ptr<PhiInstruction> phi = s_p_c<PhiInstruction>(ins);
+            if (phi->phiMove == nullptr || !liveness.isTracked(phi->phiMove))
+                continue;
+            unsigned int phiMove = liveness.valueIndex.at(phi->phiMove);
+            if (liveness.isTracked(ins))
+                moveSet.insert(make_pair(liveness.valueIndex.at(ins), phiMove));
+            for (auto &operand : phi->operands)
             {
-                if (userIns->block->aliveValues.count(ins) != 0 || userIns->aliveValues.count(ins) != 0)
-                {
-                    continue;
-                }
-                else  // 此指令未将ins设为活跃，则在通往userIns的所有路径上都将ins标记为活跃。
-                {
-                    auto it = func->entryBlock->instructions.begin();
-                    bool searchOtherBlocks = true;  // userIns不再entryBlock中
-                    // 从头至userIns将ins设为活跃
-                    while (it != func->entryBlock->instructions.end())
-                    {
-                        addAliveValue(ins, *it, func->entryBlock);
-                        if (*it == userIns)     // 直到在entryBlock找到userIns
-                        {
-                            searchOtherBlocks = false;
-                            break;
-                        }
-                        ++it;
-                    }
-                    // userIns在entryBlock外
-                    if (searchOtherBlocks)
-                    {
-                        // 维护路径块，并将它们添加到活跃节点中：路径为entryBlock至userIns->block的对应指令
-                        unordered_set<shared_ptr<BasicBlock>> pathNodes;
-                        if (blockPath.count(func->entryBlock) != 0)  // entryBlock已加入blockPath
-                        {
-                            if (blockPath.at(func->entryBlock)->count(userIns->block) != 0)  // 已计算entryBlock至userIns->block路径
-                            {
-                                pathNodes = blockPath.at(func->entryBlock)->at(userIns->block);
-                            }
-                            else
-                            {
-                                pathNodes = getBlockPathPoints(func->entryBlock, userIns->block);
-                            }
-                        }
-                        else  // entryBlock未加入blockPath，即未作为起点
-                        {
-                            pathNodes = getBlockPathPoints(func->entryBlock, userIns->block);
-                        }
-                        for (auto &b : pathNodes)  // 路径块中的每个块，将ins视为活跃
-                        {
-                            b->aliveValues.insert(ins);
-                        }
-                        // 搜索userIns->block并标记为活跃
-                        it = userIns->block->instructions.begin();
-                        while (it != userIns->block->instructions.end())
-                        {
-                            addAliveValue(ins, *it, userIns->block);
-                            if (*it == userIns)  // 将userIns->block中直到userIns均为活跃
-                            {
-                                break;
-                            }
-                            ++it;
-                        }
-                    }
-                }
+                if (liveness.isTracked(operand.second) && liveness.valueIndex.at(operand.second) != phiMove)
+                    moveSet.insert(make_pair(phiMove, liveness.valueIndex.at(operand.second)));
             }
         }
     }
-    for (auto &bb : func->blocks)
+    for (auto &move : moveSet)
     {
-        if (checkRegAllocTimeout(startAllocTime, CONFLICT_GRAPH_TIMEOUT))
-            return;
-        for (auto ins = bb->instructions.begin(); ins != bb->instructions.end(); ++ins)  // 遍历每条指令
-        {
-            if (checkRegAllocTimeout(startAllocTime, CONFLICT_GRAPH_TIMEOUT))
-                return;
-            shared_ptr<Instruction> insVal = *ins;
-            if (insVal->type != PHI_MOV && insVal->resultType == L_VAL_RESULT)  // 左值
-            {
-                for (auto &user : insVal->users)
-                {
-                    if (checkRegAllocTimeout(startAllocTime, CONFLICT_GRAPH_TIMEOUT))
-                        return;
-                    if (user->value_type != INSTRUCTION)
-                    {
-                        cerr << "Error occurs in register alloc: got a non-instruction user." << endl;
-                    }
-                    shared_ptr<Instruction> userIns = s_p_c<Instruction>(user);
-                    if (userIns->type == PHI)
-                    {
-                        // 找到所有的phi_mov位置
-                        shared_ptr<PhiMoveInstruction> phiMov = s_p_c<PhiInstruction>(userIns)->phiMove;
-                        for (auto &op : phiMov->phi->operands)
-                        {
-                            if (op.second == insVal)
-                            {
-                                shared_ptr<BasicBlock> phiMovLocation = op.first;  // phi操作数为insVal所在的块phiMovLocation
-                                if (phiMovLocation->aliveValues.count(insVal) != 0)
-                                {
-                                    continue;
-                                }
-                                else if (phiMov->blockALiveValues.at(phiMovLocation).count(insVal) != 0)
-                                {
-                                    continue;
-                                }
-                                auto it = ins + 1;
-                                bool searchOtherBlocks = true;
-                                // userIns在insVal块内，ins至userIns设为活跃
-                                while (it != bb->instructions.end())
-                                {
-                                    addAliveValue(insVal, *it, bb);
-                                    if (*it == phiMov && phiMovLocation == bb)
-                                    {
-                                        searchOtherBlocks = false;
-                                        break;
-                                    }
-                                    ++it;
-                                }
-                                // userIns不是在phiMovLocation块内，搜索整个块路径。
-                                if (searchOtherBlocks)
-                                {
-                                    // 维护路径块，并将它们添加到活跃节点中：路径为insVal所在块至phiMovLocation的对应指令
-                                    unordered_set<shared_ptr<BasicBlock>> pathNodes;
-                                    if (blockPath.count(bb) != 0)
-                                    {
-                                        if (blockPath.at(bb)->count(phiMovLocation) != 0)
-                                        {
-                                            pathNodes = blockPath.at(bb)->at(phiMovLocation);
-                                        }
-                                        else
-                                        {
-                                            pathNodes = getBlockPathPoints(bb, phiMovLocation);
-                                        }
-                                    }
-                                    else
-                                        pathNodes = getBlockPathPoints(bb, phiMovLocation);
-                                    for (auto &b : pathNodes)
-                                    {
-                                        b->aliveValues.insert(insVal);
-                                    }
-                                    it = phiMovLocation->instructions.begin();
-                                    while (it != phiMovLocation->instructions.end())
-                                    {
-                                        addAliveValue(insVal, *it, phiMovLocation);
-                                        if (*it == phiMov)
-                                            break;
-                                        ++it;
-                                    }
-                                }
-                            }
-                        }
-                    }
-                    else
-                    {
-                        if (userIns->block->aliveValues.count(insVal) != 0 || userIns->aliveValues.count(insVal) != 0)
-                        {
-                            continue;
-                        }
-                        else  // 此指令未将ins设为活跃，则在通往userIns的所有路径上都将ins标记为活跃。
-                        {
-                            auto it = ins + 1;
-                            bool searchOtherBlocks = true;
-                            // userIns在insVal块内，ins至userIns设为活跃
-                            while (it != bb->instructions.end())
-                            {
-                                addAliveValue(insVal, *it, bb);
-                                if (*it == userIns)
-                                {
-                                    searchOtherBlocks = false;
-                                    break;
-                                }
-                                ++it;
-                            }
-                            // userIns不是在insVal块内，搜索整个块路径。
-                            if (searchOtherBlocks)
-                            {
-                                // 维护路径块，并将它们添加到活跃节点中：路径为insVal所在块至userIns->block的对应指令
-                                unordered_set<shared_ptr<BasicBlock>> pathNodes;
-                                if (blockPath.count(bb) != 0)
-                                {
-                                    if (blockPath.at(bb)->count(userIns->block) != 0)
-                                    {
-                                        pathNodes = blockPath.at(bb)->at(userIns->block);
-                                    }
-                                    else
-                                    {
-                                        pathNodes = getBlockPathPoints(bb, userIns->block);
-                                    }
-                                }
-                                else
-                                {
-                                    pathNodes = getBlockPathPoints(bb, userIns->block);
-                                }
-                                for (auto &b : pathNodes)
-                                {
-                                    b->aliveValues.insert(insVal);
-                                }
-                                // search the user block and mark alive.
-                                it = userIns->block->instructions.begin();
-                                while (it != userIns->block->instructions.end())
-                                {
-                                    addAliveValue(insVal, *it, userIns->block);
-                                    if (*it == userIns)
-                                    {
-                                        break;
-                                    }
-                                    ++it;
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-            else if (insVal->type == PHI_MOV)
-            {
-                shared_ptr<PhiMoveInstruction> phiMove = s_p_c<PhiMoveInstruction>(insVal);
-                shared_ptr<BasicBlock> targetPhiBlock = phiMove->phi->block;  // phi所在的目标块
-                auto it = ins + 1;
-                while (it != bb->instructions.end())  // 将insVal至块末尾指令，将insVal设为活跃
-                {
-                    addAliveValue(insVal, *it, bb);
-                    ++it;
-                }
-                if (targetPhiBlock->aliveValues.count(insVal) != 0 || phiMove->phi->aliveValues.count(insVal) != 0)
-                    continue;
-                it = targetPhiBlock->instructions.begin();
-                while (it != targetPhiBlock->instructions.end())   // 将phi所在的目标块内从头至phi指令，将insVal设为活跃
-                {
-                    addAliveValue(insVal, *it, targetPhiBlock);
-                    if (*it == phiMove->phi)
-                        break;
-                    ++it;
-                }
-            }
-        }
+        moveList[move.first].push_back(moves.size());
+        moveList[move.second].push_back(moves.size());
+        moves.push_back(move);
     }
-    // 计算完了所有值的活跃期
-    for (auto &bb : func->blocks)  // bb运行期间
+}
+
+/**
+ * @brief 合并后结点的代表结点
+ * @param n 
+ * @return 代表结点
+ */
+unsigned int getAlias(unsigned int n)
+{
+    while (nodeState[n] == COALESCED_NODE)
+        n = alias[n];
+    return n;
+}
+
+/**
+ * @brief 结点是否仍有可能合并的传送
+ * @param n 
+ * @return 有则为true
+ */
+bool moveRelated(unsigned int n)
+{
+    for (auto move : moveList[n])
     {
-        for (auto &aliveVal : bb->aliveValues)
-        {
-            for (auto &aliveValInside : bb->aliveValues)  // bb期间活跃的值相互冲突，aliveValInside和aliveValInside都在bb期间活跃
-            {
-                if (aliveVal != aliveValInside)  // 如果两个值不一样，则冲突
-                {
-                    if (conflictGraph.count(aliveVal) == 0)
-                    {
-                        cerr << "Error occurs in process register alloc: conflict graph does not have a l-value." << endl;
-                    }
-                    else
-                    {
-                        conflictGraph.at(aliveVal)->insert(aliveValInside);
-                    }
-                }
-            }
-            for (auto &ins : bb->instructions)  // aliveValInside在bb期间活跃，则与bb内指令冲突
-            {
-                if (ins->resultType == L_VAL_RESULT)
-                {
-                    conflictGraph.at(aliveVal)->insert(ins);
-                    conflictGraph.at(ins)->insert(aliveVal);
-                }
-            }
-        }
-        for (auto &ins : bb->instructions)  // ins期间
-        {
-            unordered_set<shared_ptr<Value>> aliveValues;  // ins期间活跃的值
-            if (ins->type != PHI_MOV)
-            {
-                aliveValues = ins->aliveValues;
-            }
-            else
-            {
-                aliveValues = s_p_c<PhiMoveInstruction>(ins)->blockALiveValues.at(bb);
-            }
-            for (auto &aliveVal : aliveValues)
-            {
-                for (auto &aliveValInside : aliveValues)
-                {
-                    if (aliveVal != aliveValInside)   // ins期间活跃的值相互冲突
-                    {
-                        if (conflictGraph.count(aliveVal) == 0)
-                        {
-                            cerr << "Error occurs in process register alloc: conflict graph does not have a l-value." << endl;
-                        }
-                        else
-                        {
-                            conflictGraph.at(aliveVal)->insert(aliveValInside);
-                        }
-                    }
-                }
-            }
-        }
+        if (moveState[move] == WORKLIST_MOVE || moveState[move] == ACTIVE_MOVE)
+            return true;
     }
+    return false;
 }
 
 /**
- * @brief 分配物理寄存器，图着色
- * @param func 
+ * @brief 结点是否仍在图中（未入栈也未被合并）
+ * @param n 
+ * @return 在则为true
  */
-void allocRegister(shared_ptr<Function> &func)
+inline bool inGraph(unsigned int n)
+{
+    return nodeState[n] != SELECT_NODE && nodeState[n] != COALESCED_NODE;
+}
+
+/**
+ * @brief 合并时加入冲突边，并增加两端的度
+ * @param u 
+ * @param v 
+ */
+void addEdge(unsigned int u, unsigned int v)
 {
-    stack<shared_ptr<Value>> variableWithRegs;
-    unordered_map<shared_ptr<Value>, shared_ptr<unordered_set<shared_ptr<Value>>>> tempGraph = conflictGraph;
-ALLOC_REGISTER_START:
-    for (auto &it : tempGraph)
+    if (u == v || conflictMatrix.test(conflictBit(u, v)))
+        return;
+    addConflict(u, v);
+    ++degree[u];
+    ++degree[v];
+}
+
+/**
+ * @brief 结点及其邻居的暂不能合并的传送重新加入工作表
+ * @param n 
+ */
+void enableMoves(unsigned int n)
+{
+    for (auto move : moveList[n])
     {
-        shared_ptr<Value> var = it.first;
-        if (it.second->size() < _GLB_REG_CNT)  // 与_GLB_REG_CNT以下值冲突
+        if (moveState[move] == ACTIVE_MOVE)
         {
-            for (auto &val : *it.second)
-            {
-                tempGraph.at(val)->erase(var);  // 减去与var连接的边
-            }
-            tempGraph.erase(var);
-            variableWithRegs.push(var);  // 将var入栈
-            goto ALLOC_REGISTER_START;
+            moveState[move] = WORKLIST_MOVE;
+            worklistMoves.push_back(move);
         }
     }
-    if (!tempGraph.empty())  // 其中有着溢出的值，即最终也与_GLB_REG_CNT以上值冲突
+}
+
+/**
+ * @brief 减少结点的度，度降至_GLB_REG_CNT以下时离开溢出工作表
+ * @param m 
+ */
+void decrementDegree(unsigned int m)
+{
+    if (degree[m]-- != _GLB_REG_CNT)
+        return;
+    enableMoves(m);
+    for (auto adj : conflictAdjacency[m])
     {
-        shared_ptr<Value> abandon = tempGraph.begin()->first;  // 选取一个必须舍弃的值，即放入内存的值
-        for (auto &it : tempGraph)
-        {
-            shared_ptr<Value> ins = it.first;
-            // 选取权重最小的值
-            if (func->variableWeight.at(ins) < func->variableWeight.at(abandon) || (func->variableWeight.at(ins) == func->variableWeight.at(abandon) && ins->id < abandon->id))
-            {
-                abandon = ins;
-            }
-        }
-        for (auto &it : *tempGraph.at(abandon))
-        {
-            tempGraph.at(it)->erase(abandon);
-        }
-        tempGraph.erase(abandon);
-        for (auto &it : *conflictGraph.at(abandon))
-        {
-            conflictGraph.at(it)->erase(abandon);
-        }
-        conflictGraph.erase(abandon);
-        func->variableWithoutReg.insert(abandon);  // 将此值计划放入内存
-        goto ALLOC_REGISTER_START;   // 重新分配
+        if (inGraph(adj))
+            enableMoves(adj);
+    }
+    if (nodeState[m] != SPILL_NODE)
+        return;
+    if (moveRelated(m))
+    {
+        nodeState[m] = FREEZE_NODE;
+        freezeWorklist.push_back(m);
+    }
+    else
+    {
+        nodeState[m] = SIMPLIFY_NODE;
+        simplifyWorklist.push_back(m);
+    }
+}
+
+/**
+ * @brief 低度数且与传送无关的结点由冻结工作表移至简化工作表
+ * @param u 
+ */
+void addWorkList(unsigned int u)
+{
+    if (nodeState[u] == FREEZE_NODE && degree[u] < _GLB_REG_CNT && !moveRelated(u))
+    {
+        nodeState[u] = SIMPLIFY_NODE;
+        simplifyWorklist.push_back(u);
     }
+}
 
-    unordered_set<string> validRegs;
-    for (int i = 0; i < _GLB_REG_CNT; ++i)
-        validRegs.insert(to_string(i + _GLB_REG_START));  // 寄存器R4-R12为有效寄存器
-    while (!variableWithRegs.empty())
+/**
+ * @brief George测试：v的每个邻居度小于_GLB_REG_CNT或已与u冲突
+ * @param u 
+ * @param v 
+ * @return 合并安全则为true
+ */
+bool georgeTest(unsigned int u, unsigned int v)
+{
+    for (auto t : conflictAdjacency[v])
     {
-        unordered_set<string> regs = validRegs;
-        shared_ptr<Value> value = variableWithRegs.top();  // 依次出栈分配寄存器
-        variableWithRegs.pop();
-        for (auto &it : *conflictGraph.at(value))  // 避免冲突
-        {
-            if (func->variableRegs.count(it) != 0)
-                regs.erase(func->variableRegs.at(it));
-        }
-        func->variableRegs[value] = *regs.begin();  // 分配成功寄存器
+        if (inGraph(t) && degree[t] >= _GLB_REG_CNT && !conflictMatrix.test(conflictBit(t, u)))
+            return false;
     }
+    return true;
 }
 
 /**
- * @brief 获得从from至to的经过的块
- * @param from 起始块
- * @param to 终点快
- * @return 路径
+ * @brief Briggs测试：合并后高度数的邻居少于_GLB_REG_CNT个
+ * @param u 
+ * @param v 
+ * @return 合并安全则为true
  */
-unordered_set<shared_ptr<BasicBlock>> getBlockPathPoints(shared_ptr<BasicBlock> &from, shared_ptr<BasicBlock> &to)
+bool briggsTest(unsigned int u, unsigned int v)
 {
-    unordered_set<shared_ptr<BasicBlock>> fromReachable;
-    unordered_set<shared_ptr<BasicBlock>> ans;
-    unordered_set<shared_ptr<BasicBlock>> tempReachable;
-    getBlockReachableBlocks(from, from, fromReachable);  // 从from开始的路径，如果回到from则是循环的路径，如果不循环是到函数尾的路径
-    for (auto bb : fromReachable)
+    unsigned int highDegree = 0;
+    for (auto t : conflictAdjacency[u])
     {
-        tempReachable.clear();
-        getBlockReachableBlocks(bb, from, tempReachable);  // 从from开始路径的每个块开始，如果路径包含to，则ans加上此块
-        if (tempReachable.count(to) != 0)
-        {
-            ans.insert(bb);
-        }
+        if (inGraph(t) && degree[t] >= _GLB_REG_CNT)
+            ++highDegree;
     }
-    ans.erase(from);
-    if (blockPath.count(from) != 0)  // from做过起点
+    for (auto t : conflictAdjacency[v])  // 与u共同的邻居已计数
     {
-        shared_ptr<unordered_map<shared_ptr<BasicBlock>, unordered_set<shared_ptr<BasicBlock>>>> tempMap = blockPath.at(from);
-        if (tempMap->count(to) != 0)
-        {
-            cerr << "Error occurs in process register alloc: search path twice." << endl;
-        }
-        else
-        {
-            tempMap->insert({to, ans});  // 将路径加入blockPath
-            blockPath[from] = tempMap;
-        }
+        if (inGraph(t) && degree[t] >= _GLB_REG_CNT && !conflictMatrix.test(conflictBit(t, u)))
+            ++highDegree;
+    }
+    return highDegree < _GLB_REG_CNT;
+}
+
+/**
+ * @brief 将v合并到u
+ * @param u 
+ * @param v 
+ */
+void combine(unsigned int u, unsigned int v)
+{
+    nodeState[v] = COALESCED_NODE;
+    alias[v] = u;
+    moveList[u].insert(moveList[u].end(), moveList[v].begin(), moveList[v].end());
+    spillCost[u] += spillCost[v];
+    enableMoves(v);
+    vector<unsigned int> adjacent = conflictAdjacency[v];  // addEdge会修改邻接表
+    for (auto t : adjacent)
+    {
+        if (!inGraph(t))
+            continue;
+        addEdge(t, u);
+        decrementDegree(t);
+    }
+    if (degree[u] >= _GLB_REG_CNT && nodeState[u] == FREEZE_NODE)
+    {
+        nodeState[u] = SPILL_NODE;
+        spillWorklist.push_back(u);
+    }
+}
+
+/**
+ * @brief 取出一个待合并的传送，保守地合并其两端
+ */
+void coalesce()
+{
+    unsigned int move = worklistMoves.back();
+    worklistMoves.pop_back();
+    if (moveState[move] != WORKLIST_MOVE)
+        return;
+    unsigned int u = getAlias(moves[move].first);
+    unsigned int v = getAlias(moves[move].second);
+    if (u == v)
+    {
+        moveState[move] = COALESCED_MOVE;
+        addWorkList(u);
+    }
+    else if (conflictMatrix.test(conflictBit(u, v)))
+    {
+        moveState[move] = CONSTRAINED_MOVE;
+        addWorkList(u);
+        addWorkList(v);
     }
-    else  // from未做过起点
+    else if (georgeTest(u, v) || briggsTest(u, v))
     {
-        shared_ptr<unordered_map<shared_ptr<BasicBlock>, unordered_set<shared_ptr<BasicBlock>>>> tempMap = make_shared<unordered_map<shared_ptr<BasicBlock>, unordered_set<shared_ptr<BasicBlock>>>>();
-        tempMap->insert({to, ans});
-        blockPath[from] = tempMap;
+        moveState[move] = COALESCED_MOVE;
+        combine(u, v);
+        addWorkList(u);
+    }
+    else
+    {
+        moveState[move] = ACTIVE_MOVE;
     }
-    return ans;
 }
 
 /**
- * @brief 获得从bb至cannotArrive的可能经过的块，如果bb不经过cannotArrive，则ans为从bb开始的所有路径
- * @param bb 起始块
- * @param cannotArrive 终点块
- * @param ans 路径块
+ * @brief 冻结结点u的全部传送，放弃合并
+ * @param u 
  */
-void getBlockReachableBlocks(shared_ptr<BasicBlock> &bb, shared_ptr<BasicBlock> &cannotArrive, unordered_set<shared_ptr<BasicBlock>> &ans)
+void freezeMoves(unsigned int u)
 {
-    queue<shared_ptr<BasicBlock>> blockQueue;
-    blockQueue.push(bb);
-    while (!blockQueue.empty())
+    for (auto move : moveList[u])
     {
-        shared_ptr<BasicBlock> top = blockQueue.front();
-        blockQueue.pop();
-        for (auto &suc : top->successors)
+        if (moveState[move] != WORKLIST_MOVE && moveState[move] != ACTIVE_MOVE)
+            continue;
+        moveState[move] = FROZEN_MOVE;
+        unsigned int v = getAlias(moves[move].first);
+        if (v == getAlias(u))
+            v = getAlias(moves[move].second);
+        if (!moveRelated(v) && degree[v] < _GLB_REG_CNT && nodeState[v] == FREEZE_NODE)
         {
-            if (ans.count(suc) == 0 && suc != cannotArrive)
-            {
-                ans.insert(suc);
-                blockQueue.push(suc);
-            }
+            nodeState[v] = SIMPLIFY_NODE;
+            simplifyWorklist.push_back(v);
         }
     }
 }
 
 /**
- * @brief 将ownerBlock中owner时，value设为活跃
- * @param value 活跃的值
- * @param owner 活跃期间的指令
- * @param ownerBlock 活跃期间指令存在的块
+ * @brief 简化：结点入栈并减去与其连接的边
+ */
+void simplify()
+{
+    unsigned int n = simplifyWorklist.back();
+    simplifyWorklist.pop_back();
+    if (nodeState[n] != SIMPLIFY_NODE)
+        return;
+    nodeState[n] = SELECT_NODE;
+    selectStack.push_back(n);
+    for (auto adj : conflictAdjacency[n])
+    {
+        if (inGraph(adj))
+            decrementDegree(adj);
+    }
+}
+
+/**
+ * @brief 冻结：放弃一个低度数结点的传送，使其可以简化
+ */
+void freeze()
+{
+    unsigned int u = freezeWorklist.back();
+    freezeWorklist.pop_back();
+    if (nodeState[u] != FREEZE_NODE)
+        return;
+    nodeState[u] = SIMPLIFY_NODE;
+    simplifyWorklist.push_back(u);
+    freezeMoves(u);
+}
+
+/**
+ * @brief 选择潜在溢出：权重最小的高度数结点，乐观地入栈，着色时可能仍有寄存器
+ * @return 未找到时为false
+ */
+bool selectSpill()
+{
+    unsigned int abandon = conflictValues.size();
+    unsigned int remain = 0;
+    for (auto n : spillWorklist)  // 顺便去除已离开溢出工作表的结点，重复项在状态改变后一并去除
+    {
+        if (nodeState[n] != SPILL_NODE)
+            continue;
+        spillWorklist[remain++] = n;
+        if (abandon == conflictValues.size() || spillCost[n] < spillCost[abandon] || (spillCost[n] == spillCost[abandon] && conflictValues[n]->id < conflictValues[abandon]->id))
+            abandon = n;
+    }
+    spillWorklist.resize(remain);
+    if (abandon == conflictValues.size())
+        return false;
+    nodeState[abandon] = SIMPLIFY_NODE;
+    simplifyWorklist.push_back(abandon);
+    freezeMoves(abandon);
+    return true;
+}
+
+/**
+ * @brief 出栈着色，优先选择已着色的传送另一端的寄存器，否则选择编号最小的寄存器
+ * @param func 
  */
-void addAliveValue(shared_ptr<Instruction> &value, shared_ptr<Instruction> &owner, shared_ptr<BasicBlock> &ownerBlock)
+void assignColors(shared_ptr<Function> &func)
 {
-    if (value->resultType == L_VAL_RESULT)
+    unsigned int size = conflictValues.size();
+    color.assign(size, -1);
+    while (!selectStack.empty())
     {
-        if (owner->type == PHI_MOV)  // phi_move指令，在blockALiveValues加入活跃value
+        unsigned int n = selectStack.back();
+        selectStack.pop_back();
+        vector<bool> used(_GLB_REG_CNT, false);
+        for (auto adj : conflictAdjacency[n])  // 避免冲突
+        {
+            unsigned int w = getAlias(adj);
+            if (nodeState[w] == COLORED_NODE)
+                used[color[w]] = true;
+        }
+        int reg = -1;
+        for (auto move : moveList[n])  // 偏向着色，使未能合并的传送两端仍可能相同
+        {
+            unsigned int partner = getAlias(moves[move].first) == n ? getAlias(moves[move].second) : getAlias(moves[move].first);
+            if (nodeState[partner] == COLORED_NODE && !used[color[partner]])
+            {
+                reg = color[partner];
+                break;
+            }
+        }
+        if (reg < 0)
         {
-            s_p_c<PhiMoveInstruction>(owner)->blockALiveValues.at(ownerBlock).insert(value);
+            reg = 0;
+            while (reg < _GLB_REG_CNT && used[reg])
+                ++reg;
         }
+        if (reg == _GLB_REG_CNT)  // 实际溢出：将此值计划放入内存
+        {
+            nodeState[n] = SPILLED_NODE;
+            continue;
+        }
+        nodeState[n] = COLORED_NODE;
+        color[n] = reg;
+    }
+    for (unsigned int i = 0; i < size; ++i)
+    {
+        unsigned int n = getAlias(i);
+        if (nodeState[n] == COLORED_NODE)
+            func->variableRegs[conflictValues[i]] = to_string(color[n] + _GLB_REG_START);  // 寄存器R4-R12为有效寄存器
         else
-            owner->aliveValues.insert(value);
+            func->variableWithoutReg.insert(conflictValues[i]);
     }
 }
 
 /**
- * @brief 将ownerBlock中owner时，value设为活跃
- * @param value 活跃的值
- * @param owner 活跃期间的指令
- * @param ownerBlock 活跃期间指令存在的块
+ * @brief 分配物理寄存器，迭代寄存器合并（George & Appel）：简化、合并、冻结、溢出交替进行直至图为空，再出栈着色
+ * @param func 
  */
-void addAliveValue(shared_ptr<Value> &value, shared_ptr<Instruction> &owner, shared_ptr<BasicBlock> &ownerBlock)
+void allocRegister(shared_ptr<Function> &func)
 {
-    if (value->value_type == INSTRUCTION)
+    unsigned int size = conflictValues.size();
+    moveState.assign(moves.size(), WORKLIST_MOVE);
+    nodeState.assign(size, INITIAL_NODE);
+    degree.assign(size, 0);
+    alias.assign(size, 0);
+    spillCost.assign(size, 0);
+    simplifyWorklist.clear();
+    freezeWorklist.clear();
+    spillWorklist.clear();
+    selectStack.clear();
+    worklistMoves.clear();
+    for (unsigned int i = 0; i < moves.size(); ++i)
+        worklistMoves.push_back(moves.size() - 1 - i);  // 自后向前取出，即按收集顺序合并
+    for (unsigned int i = 0; i < size; ++i)
     {
-        shared_ptr<Instruction> insVal = s_p_c<Instruction>(value);
-        addAliveValue(insVal, owner, ownerBlock);
-    }
-    else if (value->value_type == PARAMETER)
-    {
-        if (owner->type == PHI_MOV)  // phi_move指令，在blockALiveValues加入活跃value
+        degree[i] = conflictAdjacency[i].size();
+        alias[i] = i;
+        spillCost[i] = func->variableWeight.at(conflictValues[i]);
+        if (degree[i] >= _GLB_REG_CNT)
+        {
+            nodeState[i] = SPILL_NODE;
+            spillWorklist.push_back(i);
+        }
+        else if (moveRelated(i))
         {
-            s_p_c<PhiMoveInstruction>(owner)->blockALiveValues.at(ownerBlock).insert(value);
+            nodeState[i] = FREEZE_NODE;
+            freezeWorklist.push_back(i);
         }
         else
-            owner->aliveValues.insert(value);
+        {
+            nodeState[i] = SIMPLIFY_NODE;
+            simplifyWorklist.push_back(i);
+        }
     }
-    else
+    while (true)
     {
-        cerr << "Error occurs in process add alive value: add a non-instruction and non-parameter value." << endl;
+        if (!simplifyWorklist.empty())
+            simplify();
+        else if (!worklistMoves.empty())
+            coalesce();
+        else if (!freezeWorklist.empty())
+            freeze();
+        else if (spillWorklist.empty() || !selectSpill())
+            break;
     }
+    assignColors(func);
 }
 
 void outputConflictGraph(const string &funcName)
@@ -647,18 +617,18 @@ void outputConflictGraph(const string &funcName)
         const string fileName = debugMessageDirectory + "ir_conflict_graph.txt";
         ofstream irOptimizeStream(fileName, ios::app);
         irOptimizeStream << "Function <" << funcName << ">:" << endl;
-        map<unsigned int, shared_ptr<unordered_set<shared_ptr<Value>>>> tempMap;
-        for (auto &val : conflictGraph)
+        map<unsigned int, unsigned int> tempMap;  // id <--> 结点
+        for (unsigned int i = 0; i < conflictValues.size(); ++i)
         {
-            tempMap[val.first->id] = val.second;
+            tempMap[conflictValues[i]->id] = i;
         }
         for (auto &value : tempMap)
         {
             irOptimizeStream << "<" << value.first << ">:";
             set<unsigned int> tempValSet;
-            for (auto &edge : *value.second)
+            for (auto edge : conflictAdjacency[value.second])
             {
-                tempValSet.insert(edge->id);
+                tempValSet.insert(conflictValues[edge]->id);
             }
             for (auto &edge : tempValSet)
             {
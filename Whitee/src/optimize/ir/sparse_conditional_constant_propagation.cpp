@@ -0,0 +1,317 @@
+﻿#include "ir_optimize.h"
+
+#include <climits>
+
+enum LatticeState
+{
+    LATTICE_TOP,     // 未确定
+    LATTICE_CONST,   // 常数
+    LATTICE_BOTTOM   // 不是常数
+};
+
+/**
+ * 格上的值
+ */
+struct LatticeValue
+{
+    LatticeState state;
+    int number;  // state为LATTICE_CONST时的常数
+};
+
+unordered_map<shared_ptr<Value>, LatticeValue> latticeValues;  // 指令 --> 格上的值，不在表中为LATTICE_TOP
+unordered_map<shared_ptr<BasicBlock>, unordered_set<shared_ptr<BasicBlock>>> executableEdges;  // 可执行的边，起点 --> 终点
+unordered_set<shared_ptr<BasicBlock>> executableBlocks;  // 可执行的块
+vector<pair<shared_ptr<BasicBlock>, shared_ptr<BasicBlock>>> cfgWorkList;  // 新的可执行边
+vector<shared_ptr<Instruction>> ssaWorkList;  // 操作数的格值发生变化的指令
+
+void sccp_function(shared_ptr<Function> &func);
+
+LatticeValue get_lattice(const shared_ptr<Value> &value);
+
+void mark_edge_executable(const shared_ptr<BasicBlock> &from, const shared_ptr<BasicBlock> &to);
+
+void visit_instruction(shared_ptr<Instruction> &ins);
+
+LatticeValue evaluate_instruction(shared_ptr<Instruction> &ins);
+
+bool fold_binary(const string &op, int lhs, int rhs, int &result);
+
+void sccp_rewrite(shared_ptr<Function> &func);
+
+/**
+ * @brief 稀疏条件常量传播（Wegman-Zadeck）：在SSA值的格与CFG边的可执行性上同时迭代，
+ *        只沿可执行边合并phi的操作数；之后将常数值替换为NumberValue，常数条件的分支变为跳转，并删除不可执行的块
+ * @param module 
+ */
+void sparse_conditional_constant_propagation(shared_ptr<Module> &module)
+{
+    for (auto &func : module->functions)
+    {
+        if (func->entryBlock == nullptr)
+            continue;
+        sccp_function(func);
+        sccp_rewrite(func);
+        unused_block_delete(func);
+    }
+}
+
+/**
+ * @brief 对一个函数求解格值与可执行边
+ * @param func 
+ */
+void sccp_function(shared_ptr<Function> &func)
+{
+    latticeValues.clear();
+    executableEdges.clear();
+    executableBlocks.clear();
+    cfgWorkList.clear();
+    ssaWorkList.clear();
+    cfgWorkList.emplace_back(nullptr, func->entryBlock);  // 入口块视为有一条可执行的入边
+    while (!cfgWorkList.empty() || !ssaWorkList.empty())
+    {
+        while (!cfgWorkList.empty())
+        {
+            shared_ptr<BasicBlock> bb = cfgWorkList.back().second;
+            cfgWorkList.pop_back();
+            for (auto &phi : bb->phis)
+            {
+                shared_ptr<Instruction> ins = phi;
+                visit_instruction(ins);
+            }
+            if (executableBlocks.count(bb) != 0)  // 已执行过的块，只有phi受新边影响
+                continue;
+            executableBlocks.insert(bb);
+            for (auto &ins : bb->instructions)
+                visit_instruction(ins);
+        }
+        while (!ssaWorkList.empty())
+        {
+            shared_ptr<Instruction> ins = ssaWorkList.back();
+            ssaWorkList.pop_back();
+            if (executableBlocks.count(ins->block) != 0)
+                visit_instruction(ins);
+        }
+    }
+}
+
+/**
+ * @brief 值在格上的值：常数为LATTICE_CONST，参数、全局变量、未定义值等为LATTICE_BOTTOM
+ * @param value 
+ * @return 
+ */
+LatticeValue get_lattice(const shared_ptr<Value> &value)
+{
+    if (value->value_type == NUMBER)
+        return {LATTICE_CONST, s_p_c<NumberValue>(value)->number};
+    if (value->value_type != INSTRUCTION)
+        return {LATTICE_BOTTOM, 0};
+    if (latticeValues.count(value) == 0)
+        return {LATTICE_TOP, 0};
+    return latticeValues.at(value);
+}
+
+/**
+ * @brief 标记一条CFG边可执行
+ * @param from 
+ * @param to 
+ */
+void mark_edge_executable(const shared_ptr<BasicBlock> &from, const shared_ptr<BasicBlock> &to)
+{
+    if (executableEdges[from].count(to) != 0)
+        return;
+    executableEdges[from].insert(to);
+    cfgWorkList.emplace_back(from, to);
+}
+
+/**
+ * @brief 访问指令：跳转与分支标记可执行的出边，其他指令重新求值，格值降低时将使用者加入工作表
+ * @param ins 
+ */
+void visit_instruction(shared_ptr<Instruction> &ins)
+{
+    if (ins->type == JMP)
+    {
+        mark_edge_executable(ins->block, s_p_c<JumpInstruction>(ins)->targetBlock);
+        return;
+    }
+    if (ins->type == BR)
+    {
+        shared_ptr<BranchInstruction> br = s_p_c<BranchInstruction>(ins);
+        LatticeValue condition = get_lattice(br->condition);
+        if (condition.state == LATTICE_BOTTOM || (condition.state == LATTICE_CONST && condition.number != 0))
+            mark_edge_executable(ins->block, br->trueBlock);
+        if (condition.state == LATTICE_BOTTOM || (condition.state == LATTICE_CONST && condition.number == 0))
+            mark_edge_executable(ins->block, br->falseBlock);
+        return;
+    }
+    if (ins->type == RET || ins->type == STORE)
+        return;
+    LatticeValue oldValue = get_lattice(ins);
+    LatticeValue newValue = evaluate_instruction(ins);
+    if (oldValue.state == newValue.state && (newValue.state != LATTICE_CONST || oldValue.number == newValue.number))
+        return;
+    latticeValues[ins] = newValue;
+    for (auto &user : ins->users)
+    {
+        if (user->value_type == INSTRUCTION)
+            ssaWorkList.push_back(s_p_c<Instruction>(user));
+    }
+}
+
+/**
+ * @brief 由操作数的格值求指令的格值
+ * @param ins 
+ * @return 
+ */
+LatticeValue evaluate_instruction(shared_ptr<Instruction> &ins)
+{
+    switch (ins->type)
+    {
+    case PHI:
+    {
+        shared_ptr<PhiInstruction> phi = s_p_c<PhiInstruction>(ins);
+        LatticeValue result = {LATTICE_TOP, 0};
+        for (auto &operand : phi->operands)
+        {
+            if (executableEdges.count(operand.first) == 0 || executableEdges.at(operand.first).count(phi->block) == 0)  // 只合并可执行边上的值
+                continue;
+            LatticeValue value = get_lattice(operand.second);
+            if (value.state == LATTICE_BOTTOM || (result.state == LATTICE_CONST && value.state == LATTICE_CONST && result.number != value.number))
+                return {LATTICE_BOTTOM, 0};
+            if (value.state == LATTICE_CONST)
+                result = value;
+        }
+        return result;
+    }
+    case BINARY:
+    case CMP:
+    {
+        shared_ptr<BinaryInstruction> binary = s_p_c<BinaryInstruction>(ins);
+        LatticeValue lhs = get_lattice(binary->lhs);
+        LatticeValue rhs = get_lattice(binary->rhs);
+        if (lhs.state == LATTICE_BOTTOM || rhs.state == LATTICE_BOTTOM)
+            return {LATTICE_BOTTOM, 0};
+        if (lhs.state == LATTICE_TOP || rhs.state == LATTICE_TOP)
+            return {LATTICE_TOP, 0};
+        int result;
+        if (!fold_binary(binary->op, lhs.number, rhs.number, result))
+            return {LATTICE_BOTTOM, 0};
+        return {LATTICE_CONST, result};
+    }
+    case UNARY:
+    {
+        shared_ptr<UnaryInstruction> unary = s_p_c<UnaryInstruction>(ins);
+        LatticeValue value = get_lattice(unary->value);
+        if (value.state != LATTICE_CONST)
+            return value;
+        if (unary->op == "+")
+            return value;
+        if (unary->op == "-")
+            return {LATTICE_CONST, (int)(0U - (unsigned)value.number)};
+        if (unary->op == "!")
+            return {LATTICE_CONST, !value.number};
+        return {LATTICE_BOTTOM, 0};
+    }
+    case LOAD:
+    {
+        shared_ptr<LoadInstruction> load = s_p_c<LoadInstruction>(ins);
+        if (load->address->value_type != CONSTANT)
+            return {LATTICE_BOTTOM, 0};
+        LatticeValue offset = get_lattice(load->offset);
+        if (offset.state != LATTICE_CONST)
+            return offset;
+        shared_ptr<ConstantValue> constArray = s_p_c<ConstantValue>(load->address);
+        if (constArray->values.count(offset.number) != 0)  // const array中的值，未初始化的为0
+            return {LATTICE_CONST, constArray->values.at(offset.number)};
+        return {LATTICE_CONST, 0};
+    }
+    default:
+        return {LATTICE_BOTTOM, 0};
+    }
+}
+
+/**
+ * @brief 计算两个常数的二元运算，与constant_folding一致，加减乘按补码回绕
+ * @param op 操作符
+ * @param lhs 
+ * @param rhs 
+ * @param result 结果
+ * @return false 不可计算（除零、溢出的除法或未知操作符）
+ */
+bool fold_binary(const string &op, int lhs, int rhs, int &result)
+{
+    if ((op == "/" || op == "%") && (rhs == 0 || (lhs == INT_MIN && rhs == -1)))
+        return false;
+    if (op == "+")
+        result = (int)((unsigned)lhs + (unsigned)rhs);
+    else if (op == "-")
+        result = (int)((unsigned)lhs - (unsigned)rhs);
+    else if (op == "*")
+        result = (int)((unsigned)lhs * (unsigned)rhs);
+    else if (op == "/")
+        result = lhs / rhs;
+    else if (op == "%")
+        result = lhs % rhs;
+    else if (op == ">")
+        result = lhs > rhs;
+    else if (op == "<")
+        result = lhs < rhs;
+    else if (op == "<=")
+        result = lhs <= rhs;
+    else if (op == ">=")
+        result = lhs >= rhs;
+    else if (op == "==")
+        result = lhs == rhs;
+    else if (op == "!=")
+        result = lhs != rhs;
+    else if (op == "&&")
+        result = (int)((unsigned)lhs & (unsigned)rhs);
+    else if (op == "||")
+        result = (int)((unsigned)lhs | (unsigned)rhs);
+    else
+        return false;
+    return true;
+}
+
+/**
+ * @brief 按求解结果改写函数：可执行块中的常数值替换为NumberValue，常数条件的分支变为跳转并断开另一条边
+ * @param func 
+ */
+void sccp_rewrite(shared_ptr<Function> &func)
+{
+    for (auto &bb : func->blocks)
+    {
+        if (executableBlocks.count(bb) == 0)
+            continue;
+        vector<shared_ptr<Instruction>> constants(bb->phis.begin(), bb->phis.end());
+        for (auto &ins : bb->instructions)
+        {
+            if (ins->type == BINARY || ins->type == CMP || ins->type == UNARY || ins->type == LOAD)
+                constants.push_back(ins);
+        }
+        for (auto &ins : constants)
+        {
+            LatticeValue value = get_lattice(ins);
+            if (value.state != LATTICE_CONST)
+                continue;
+            shared_ptr<Value> toBeReplaced = ins;
+            shared_ptr<Value> number = Number(value.number);
+            unordered_set<shared_ptr<Value>> users = ins->users;
+            for (auto &user : users)
+                user->replaceUse(toBeReplaced, number);
+        }
+        if (bb->instructions.empty() || bb->instructions.back()->type != BR)
+            continue;
+        shared_ptr<Instruction> &last = bb->instructions.back();
+        shared_ptr<BranchInstruction> br = s_p_c<BranchInstruction>(last);
+        LatticeValue condition = get_lattice(br->condition);
+        if (condition.state != LATTICE_CONST)
+            continue;
+        shared_ptr<BasicBlock> target = condition.number != 0 ? br->trueBlock : br->falseBlock;
+        shared_ptr<BasicBlock> other = condition.number != 0 ? br->falseBlock : br->trueBlock;
+        if (other != target)
+            block_predecessor_delete(other, bb);
+        last = make_shared<JumpInstruction>(target, bb);
+        br->abandonUse();
+    }
+}
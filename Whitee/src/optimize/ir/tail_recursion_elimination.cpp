@@ -0,0 +1,162 @@
+﻿#include "ir_optimize.h"
+
+#include <queue>
+
+bool is_tail_recursion(shared_ptr<BasicBlock> &bb, shared_ptr<Function> &func);
+
+void eliminate_tail_recursion(shared_ptr<Function> &func, vector<shared_ptr<BasicBlock>> &tailBlocks);
+
+/**
+ * @brief 尾递归消除：函数末尾调用自身并直接返回其结果时，改为跳回函数开头；
+ *        新建入口块，原入口块成为循环头，形参换为循环头的phi，尾调用的实参为回边上的值
+ * @param module 
+ */
+void tail_recursion_elimination(shared_ptr<Module> &module)
+{
+    for (auto &func : module->functions)
+    {
+        if (func->entryBlock == nullptr)
+            continue;
+        vector<shared_ptr<BasicBlock>> tailBlocks;
+        for (auto &bb : func->blocks)
+        {
+            if (is_tail_recursion(bb, func))
+                tailBlocks.push_back(bb);
+        }
+        if (!tailBlocks.empty())
+            eliminate_tail_recursion(func, tailBlocks);
+    }
+}
+
+/**
+ * @brief 块以 调用自身 + 返回调用结果 结束；实参不能是局部数组，否则循环中的数组会被下一次递归覆盖
+ * @param bb 
+ * @param func 
+ * @return 
+ */
+bool is_tail_recursion(shared_ptr<BasicBlock> &bb, shared_ptr<Function> &func)
+{
+    if (bb->instructions.size() < 2 || bb->instructions.back()->type != RET)
+        return false;
+    shared_ptr<Instruction> last = *(bb->instructions.end() - 2);
+    if (last->type != INVOKE || s_p_c<InvokeInstruction>(last)->invokeType != COMMON || s_p_c<InvokeInstruction>(last)->targetFunction != func)
+        return false;
+    shared_ptr<ReturnInstruction> ret = s_p_c<ReturnInstruction>(bb->instructions.back());
+    if (func->funcType == FUNC_INT ? (ret->value != last || last->users.size() != 1) : !last->users.empty())
+        return false;
+    for (auto &param : s_p_c<InvokeInstruction>(last)->params)
+    {
+        if (AliasAnalysis::isPointer(param))
+        {
+            shared_ptr<Value> base = AliasAnalysis::getLocation(param, nullptr).base;
+            if (base == nullptr || base->value_type == INSTRUCTION)
+                return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 将尾递归改为循环
+ * @param func 
+ * @param tailBlocks 以尾递归结束的块
+ */
+void eliminate_tail_recursion(shared_ptr<Function> &func, vector<shared_ptr<BasicBlock>> &tailBlocks)
+{
+    shared_ptr<BasicBlock> header = func->entryBlock;
+    shared_ptr<BasicBlock> entry = make_shared<BasicBlock>(func, true, header->loopDepth);
+
+    // 自然循环中的块：从回边起点向前到循环头，循环深度加一
+    unordered_set<shared_ptr<BasicBlock>> loopBlocks{header};
+    queue<shared_ptr<BasicBlock>> workList;
+    for (auto &bb : tailBlocks)
+    {
+        if (loopBlocks.insert(bb).second)
+            workList.push(bb);
+    }
+    while (!workList.empty())
+    {
+        shared_ptr<BasicBlock> bb = workList.front();
+        workList.pop();
+        for (auto &pred : bb->predecessors)
+        {
+            if (loopBlocks.insert(pred).second)
+                workList.push(pred);
+        }
+    }
+    for (auto &bb : loopBlocks)
+        ++bb->loopDepth;
+
+    // 局部数组移到新的入口块，只分配一次
+    for (auto &bb : func->blocks)
+    {
+        for (auto it = bb->instructions.begin(); it != bb->instructions.end();)
+        {
+            if ((*it)->type == ALLOC)
+            {
+                (*it)->block = entry;
+                entry->instructions.push_back(*it);
+                it = bb->instructions.erase(it);
+            }
+            else
+                ++it;
+        }
+    }
+    entry->instructions.push_back(make_shared<JumpInstruction>(header, entry));
+    entry->successors.insert(header);
+    header->predecessors.insert(entry);
+
+    // 形参换为循环头的phi
+    vector<shared_ptr<PhiInstruction>> phis;
+    for (auto &param : func->params)
+    {
+        shared_ptr<PhiInstruction> phi = make_shared<PhiInstruction>(s_p_c<ParameterValue>(param)->name, header);
+        unordered_set<shared_ptr<Value>> users = param->users;
+        shared_ptr<Value> phiValue = phi;
+        for (auto &user : users)
+            user->replaceUse(param, phiValue);
+        phi->operands[entry] = param;
+        param->users.insert(phi);
+        header->phis.insert(phi);
+        phis.push_back(phi);
+    }
+
+    // 尾调用改为跳回循环头
+    for (auto &bb : tailBlocks)
+    {
+        shared_ptr<ReturnInstruction> ret = s_p_c<ReturnInstruction>(bb->instructions.back());
+        shared_ptr<InvokeInstruction> invoke = s_p_c<InvokeInstruction>(*(bb->instructions.end() - 2));
+        for (unsigned int i = 0; i < phis.size(); ++i)
+        {
+            phis.at(i)->operands[bb] = invoke->params.at(i);
+            invoke->params.at(i)->users.erase(invoke);
+            invoke->params.at(i)->users.insert(phis.at(i));
+        }
+        invoke->users.clear();
+        invoke->valid = false;
+        ret->valid = false;
+        bb->instructions.erase(bb->instructions.end() - 2, bb->instructions.end());
+        bb->instructions.push_back(make_shared<JumpInstruction>(header, bb));
+        bb->successors.insert(header);
+        header->predecessors.insert(bb);
+    }
+    func->blocks.insert(func->blocks.begin(), entry);
+    func->entryBlock = entry;
+    for (auto &phi : phis)
+        remove_trivial_phi(phi);
+
+    bool selfCall = false;
+    for (auto &bb : func->blocks)
+    {
+        for (auto &ins : bb->instructions)
+        {
+            if (ins->type == INVOKE && s_p_c<InvokeInstruction>(ins)->targetFunction == func)
+                selfCall = true;
+        }
+    }
+    if (!selfCall)
+    {
+        func->callees.erase(func);
+        func->callers.erase(func);
+    }
+}